@@ -0,0 +1,96 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "../export/EmeraldsCollector.h" /* IWYU pragma: keep */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Measures small object allocation throughput as mutator threads are added */
+
+#define ALLOCATIONS_PER_THREAD (1000000)
+#define MAX_THREADS            (64)
+
+struct node {
+  struct node *next;
+  size_t value;
+};
+
+EmeraldsCollector gc;
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* Keeps a short list alive so collections always find something to trace */
+static void allocate(void) {
+  struct node *volatile head = NULL;
+  size_t i;
+
+  for(i = 0; i < ALLOCATIONS_PER_THREAD; i++) {
+    struct node *n = mmalloc(sizeof(struct node));
+    n->value       = i;
+    n->next        = i % 64 == 0 ? NULL : head;
+    head           = n;
+  }
+}
+
+static void *mutator(void *arg) {
+  void *base                  = NULL;
+  void (*volatile work)(void) = allocate;
+
+  (void)arg;
+  collector_register_thread(&gc, &base);
+  work();
+  collector_unregister_thread(&gc);
+  return NULL;
+}
+
+static void run(void) {
+  pthread_t threads[MAX_THREADS];
+  long cores      = sysconf(_SC_NPROCESSORS_ONLN);
+  double baseline = 0;
+  size_t number_of_threads;
+
+  printf("threads   allocations/ms   scaling\n");
+  for(number_of_threads = 1;
+      number_of_threads <= (size_t)(cores < 1 ? 1 : cores) &&
+      number_of_threads <= MAX_THREADS;
+      number_of_threads *= 2) {
+    double start = now_ms();
+    double throughput;
+    size_t i;
+
+    for(i = 0; i < number_of_threads; i++) {
+      pthread_create(&threads[i], NULL, mutator, NULL);
+    }
+    for(i = 0; i < number_of_threads; i++) {
+      pthread_join(threads[i], NULL);
+    }
+    throughput =
+      number_of_threads * ALLOCATIONS_PER_THREAD / (now_ms() - start);
+    if(number_of_threads == 1) {
+      baseline = throughput;
+    }
+    printf(
+      "%7lu %16.0f %8.2fx\n",
+      (unsigned long)number_of_threads,
+      throughput,
+      throughput / baseline
+    );
+  }
+}
+
+int main(void) {
+  void *dummy                  = NULL;
+  void (*volatile bench)(void) = run;
+
+  collector_new(&gc, &dummy);
+  bench();
+  collector_terminate(&gc);
+
+  return 0;
+}
@@ -0,0 +1,211 @@
+#ifndef __BENCH_H_
+#define __BENCH_H_
+
+#include "../export/EmeraldsCollector.h" /* IWYU pragma: keep */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Shared by the benchmarks comparing the collector with malloc and free.
+ * Every run forks, so that peak RSS is measured for that run alone.
+ * Collections happen inside of allocation calls, so the latency of those
+ * calls is what a mutator sees as the pause */
+
+/* 8 buckets for every power of two nanoseconds, within 12.5% */
+#define BENCH_SUB_BUCKETS (8)
+#define BENCH_BUCKETS     (64 * BENCH_SUB_BUCKETS)
+
+struct bench_histogram {
+  size_t counts[BENCH_BUCKETS];
+  size_t number_of_samples;
+  double max_ns;
+  double total_ns;
+};
+
+EmeraldsCollector gc;
+
+/* Set in runs on the collector, frees only drop the reference there */
+static bool bench_collected;
+
+static double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench_histogram_new(struct bench_histogram *histogram) {
+  size_t i;
+  for(i = 0; i < BENCH_BUCKETS; i++) {
+    histogram->counts[i] = 0;
+  }
+  histogram->number_of_samples = 0;
+  histogram->max_ns            = 0;
+  histogram->total_ns          = 0;
+}
+
+static size_t bench_bucket_of(size_t ns) {
+  size_t exponent = 0;
+
+  if(ns < BENCH_SUB_BUCKETS) {
+    return ns;
+  }
+  while((ns >> exponent) >= 2 * BENCH_SUB_BUCKETS) {
+    exponent++;
+  }
+  return (exponent + 1) * BENCH_SUB_BUCKETS +
+         (ns >> exponent) % BENCH_SUB_BUCKETS;
+}
+
+static double bench_bucket_start(size_t bucket) {
+  size_t exponent = bucket / BENCH_SUB_BUCKETS;
+
+  if(exponent == 0) {
+    return (double)bucket;
+  }
+  return (double)(BENCH_SUB_BUCKETS + bucket % BENCH_SUB_BUCKETS) *
+         (double)((size_t)1 << (exponent - 1));
+}
+
+static void bench_record(struct bench_histogram *histogram, double ns) {
+  histogram->counts[bench_bucket_of((size_t)ns)]++;
+  histogram->number_of_samples++;
+  histogram->total_ns += ns;
+  if(ns > histogram->max_ns) {
+    histogram->max_ns = ns;
+  }
+}
+
+static void bench_histogram_merge(
+  struct bench_histogram *to, const struct bench_histogram *from
+) {
+  size_t i;
+  for(i = 0; i < BENCH_BUCKETS; i++) {
+    to->counts[i] += from->counts[i];
+  }
+  to->number_of_samples += from->number_of_samples;
+  to->total_ns += from->total_ns;
+  if(from->max_ns > to->max_ns) {
+    to->max_ns = from->max_ns;
+  }
+}
+
+static double
+bench_percentile(const struct bench_histogram *histogram, double percent) {
+  size_t wanted = (size_t)(histogram->number_of_samples * percent / 100);
+  size_t seen   = 0;
+  size_t i;
+
+  for(i = 0; i < BENCH_BUCKETS; i++) {
+    seen += histogram->counts[i];
+    if(seen > wanted) {
+      return bench_bucket_start(i);
+    }
+  }
+  return histogram->max_ns;
+}
+
+static void *bench_malloc(struct bench_histogram *histogram, size_t size) {
+  double start = bench_now_ns();
+  void *ptr    = bench_collected ? collector_malloc(&gc, size) : malloc(size);
+  bench_record(histogram, bench_now_ns() - start);
+  return ptr;
+}
+
+static void *
+bench_realloc(struct bench_histogram *histogram, void *ptr, size_t size) {
+  double start = bench_now_ns();
+
+  if(bench_collected) {
+    ptr = collector_realloc(&gc, ptr, size);
+  } else {
+    ptr = realloc(ptr, size);
+  }
+  bench_record(histogram, bench_now_ns() - start);
+  return ptr;
+}
+
+static void bench_free(struct bench_histogram *histogram, void *ptr) {
+  double start;
+
+  if(bench_collected) {
+    return;
+  }
+  start = bench_now_ns();
+  free(ptr);
+  bench_record(histogram, bench_now_ns() - start);
+}
+
+static double bench_peak_rss_mb(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+  return usage.ru_maxrss / 1048576.0;
+#else
+  return usage.ru_maxrss / 1024.0;
+#endif
+}
+
+static void bench_header(void) {
+  printf(
+    "%-18s %-10s %12s %9s %9s %9s %8s\n",
+    "workload",
+    "allocator",
+    "ops/ms",
+    "p99 (us)",
+    "max (ms)",
+    "peak (MB)",
+    "alloc %"
+  );
+}
+
+/* The share of the run spent in allocation calls, for the collector that
+ * includes the marking and sweeping those calls paid for */
+static void bench_report(
+  const char *workload,
+  size_t operations,
+  double elapsed_ns,
+  const struct bench_histogram *histogram
+) {
+  printf(
+    "%-18s %-10s %12.0f %9.2f %9.2f %9.1f %7.1f%%\n",
+    workload,
+    bench_collected ? "collector" : "malloc",
+    operations / (elapsed_ns / 1e6),
+    bench_percentile(histogram, 99) / 1e3,
+    histogram->max_ns / 1e6,
+    bench_peak_rss_mb(),
+    100 * histogram->total_ns / elapsed_ns
+  );
+  fflush(stdout);
+}
+
+/* Runs `workload` in a child process, on the collector or on malloc */
+static void bench_fork(void (*workload)(void), bool collected) {
+  pid_t child;
+
+  fflush(stdout);
+  child = fork();
+  if(child == 0) {
+    void *base                 = NULL;
+    void (*volatile run)(void) = workload;
+
+    bench_collected = collected;
+    if(collected) {
+      collector_new(&gc, &base);
+    }
+    run();
+    if(collected) {
+      collector_terminate(&gc);
+    }
+    exit(0);
+  }
+  if(child > 0) {
+    waitpid(child, NULL, 0);
+  }
+}
+
+#endif
@@ -0,0 +1,332 @@
+#define _DEFAULT_SOURCE
+
+#include "bench.h"
+
+#include <pthread.h>
+
+/* Runs every workload on the collector and on malloc and free */
+
+#define STRETCH_TREE_DEPTH    (18)
+#define LONG_LIVED_TREE_DEPTH (16)
+#define MIN_TREE_DEPTH        (4)
+#define MAX_TREE_DEPTH        (16)
+
+#define LIST_LENGTH     (100000)
+#define LIST_OPERATIONS (4000000)
+
+#define RETAINED_ARRAYS  (256)
+#define ARRAY_OPERATIONS (4000)
+#define MAX_ARRAY_WORDS  (1 << 18)
+
+#define STRINGS           (64)
+#define STRING_LENGTH     (1 << 16)
+#define STRING_OPERATIONS (4000000)
+
+#define STORM_THREADS      (8)
+#define STORM_ALLOCATIONS  (1000000)
+#define STORM_LIVE_OBJECTS (256)
+
+struct node {
+  struct node *left;
+  struct node *right;
+  size_t i;
+  size_t j;
+};
+
+struct link {
+  struct link *next;
+  size_t payload[1];
+};
+
+static size_t random_state = 1;
+
+static size_t next_random(void) {
+  random_state = random_state * 1103515245 + 12345;
+  return (random_state >> 16) & 0x7fff;
+}
+
+static size_t tree_size(size_t depth) {
+  return ((size_t)1 << (depth + 1)) - 1;
+}
+
+static struct node *new_node(struct bench_histogram *histogram) {
+  struct node *node = bench_malloc(histogram, sizeof(struct node));
+  node->left        = NULL;
+  node->right       = NULL;
+  return node;
+}
+
+static void populate(
+  struct bench_histogram *histogram, size_t depth, struct node *node
+) {
+  if(depth == 0) {
+    return;
+  }
+  node->left  = new_node(histogram);
+  node->right = new_node(histogram);
+  populate(histogram, depth - 1, node->left);
+  populate(histogram, depth - 1, node->right);
+}
+
+static struct node *make_tree(struct bench_histogram *histogram, size_t depth) {
+  struct node *node = new_node(histogram);
+  if(depth > 0) {
+    node->left  = make_tree(histogram, depth - 1);
+    node->right = make_tree(histogram, depth - 1);
+  }
+  return node;
+}
+
+static void free_tree(struct bench_histogram *histogram, struct node *node) {
+  if(node == NULL || bench_collected) {
+    return;
+  }
+  free_tree(histogram, node->left);
+  free_tree(histogram, node->right);
+  bench_free(histogram, node);
+}
+
+/* GCBench: short lived trees built top down and bottom up next to a
+ * long lived tree and a large array */
+static void binary_trees(void) {
+  struct bench_histogram histogram;
+  struct node *volatile long_lived;
+  double *volatile array;
+  size_t operations = 0;
+  size_t depth;
+  double start;
+  size_t i;
+
+  bench_histogram_new(&histogram);
+  start = bench_now_ns();
+
+  free_tree(&histogram, make_tree(&histogram, STRETCH_TREE_DEPTH));
+  operations += tree_size(STRETCH_TREE_DEPTH);
+
+  long_lived = new_node(&histogram);
+  populate(&histogram, LONG_LIVED_TREE_DEPTH, long_lived);
+  array = bench_malloc(&histogram, 500000 * sizeof(double));
+  for(i = 0; i < 500000 / 2; i++) {
+    array[i] = 1.0 / (double)(i + 1);
+  }
+  operations += tree_size(LONG_LIVED_TREE_DEPTH) + 1;
+
+  for(depth = MIN_TREE_DEPTH; depth <= MAX_TREE_DEPTH; depth += 2) {
+    size_t iterations =
+      2 * tree_size(STRETCH_TREE_DEPTH) / tree_size(depth);
+
+    for(i = 0; i < iterations; i++) {
+      struct node *top_down = new_node(&histogram);
+      populate(&histogram, depth, top_down);
+      free_tree(&histogram, top_down);
+      free_tree(&histogram, make_tree(&histogram, depth));
+    }
+    operations += 2 * iterations * tree_size(depth);
+  }
+
+  if(long_lived == NULL || array[1000] != 1.0 / 1001) {
+    printf("binary trees: long lived data lost\n");
+  }
+  bench_report(
+    "binary trees", operations, bench_now_ns() - start, &histogram
+  );
+  free_tree(&histogram, long_lived);
+  bench_free(&histogram, array);
+}
+
+/* A queue of links of random sizes, every push drops the oldest one */
+static void list_churn(void) {
+  struct bench_histogram histogram;
+  struct link *volatile head = NULL;
+  struct link *tail          = NULL;
+  double start;
+  size_t i;
+
+  bench_histogram_new(&histogram);
+  start = bench_now_ns();
+  for(i = 0; i < LIST_OPERATIONS; i++) {
+    size_t words      = 1 + next_random() % 31;
+    struct link *link = bench_malloc(
+      &histogram, sizeof(struct link) + (words - 1) * sizeof(size_t)
+    );
+
+    link->next       = NULL;
+    link->payload[0] = i;
+    if(tail != NULL) {
+      tail->next = link;
+    } else {
+      head = link;
+    }
+    tail = link;
+
+    if(i >= LIST_LENGTH) {
+      struct link *oldest = head;
+      head                = oldest->next;
+      bench_free(&histogram, oldest);
+    }
+  }
+  bench_report(
+    "list churn", LIST_OPERATIONS, bench_now_ns() - start, &histogram
+  );
+  while(head != NULL && !bench_collected) {
+    struct link *oldest = head;
+    head                = oldest->next;
+    free(oldest);
+  }
+}
+
+/* Arrays of up to 2 MiB kept alive in a table, replaced at random */
+static void array_retention(void) {
+  struct bench_histogram histogram;
+  size_t **volatile arrays;
+  double start;
+  size_t i;
+
+  bench_histogram_new(&histogram);
+  start  = bench_now_ns();
+  arrays = bench_malloc(&histogram, RETAINED_ARRAYS * sizeof(size_t *));
+  for(i = 0; i < RETAINED_ARRAYS; i++) {
+    arrays[i] = NULL;
+  }
+  for(i = 0; i < ARRAY_OPERATIONS; i++) {
+    size_t slot  = next_random() % RETAINED_ARRAYS;
+    size_t words = 1 + (next_random() * next_random()) % MAX_ARRAY_WORDS;
+
+    bench_free(&histogram, arrays[slot]);
+    arrays[slot]            = bench_malloc(&histogram, words * sizeof(size_t));
+    arrays[slot][0]         = i;
+    arrays[slot][words - 1] = i;
+  }
+  bench_report(
+    "array retention", ARRAY_OPERATIONS, bench_now_ns() - start, &histogram
+  );
+  for(i = 0; i < RETAINED_ARRAYS && !bench_collected; i++) {
+    free(arrays[i]);
+  }
+  bench_free(&histogram, arrays);
+}
+
+/* Strings grown a few bytes at a time with realloc, some of them kept */
+static void string_building(void) {
+  struct bench_histogram histogram;
+  char **volatile strings;
+  char *string  = NULL;
+  size_t length = 0;
+  double start;
+  size_t i;
+
+  bench_histogram_new(&histogram);
+  start   = bench_now_ns();
+  strings = bench_malloc(&histogram, STRINGS * sizeof(char *));
+  for(i = 0; i < STRINGS; i++) {
+    strings[i] = NULL;
+  }
+  for(i = 0; i < STRING_OPERATIONS; i++) {
+    size_t append = 1 + next_random() % 16;
+    size_t j;
+
+    string = bench_realloc(&histogram, string, length + append + 1);
+    for(j = 0; j < append; j++) {
+      string[length++] = (char)('a' + j);
+    }
+    string[length] = '\0';
+
+    if(length >= STRING_LENGTH - 16) {
+      size_t slot = next_random() % STRINGS;
+      bench_free(&histogram, strings[slot]);
+      strings[slot] = string;
+      string        = NULL;
+      length        = 0;
+    }
+  }
+  bench_report(
+    "string building", STRING_OPERATIONS, bench_now_ns() - start, &histogram
+  );
+  for(i = 0; i < STRINGS && !bench_collected; i++) {
+    free(strings[i]);
+  }
+  bench_free(&histogram, string);
+  bench_free(&histogram, strings);
+}
+
+static struct bench_histogram storm_histograms[STORM_THREADS];
+
+static void storm(struct bench_histogram *histogram) {
+  void **volatile live;
+  size_t seed = (size_t)histogram;
+  size_t i;
+
+  bench_histogram_new(histogram);
+  live = bench_malloc(histogram, STORM_LIVE_OBJECTS * sizeof(void *));
+  for(i = 0; i < STORM_LIVE_OBJECTS; i++) {
+    live[i] = NULL;
+  }
+  for(i = 0; i < STORM_ALLOCATIONS; i++) {
+    size_t slot;
+
+    seed = seed * 1103515245 + 12345;
+    slot = (seed >> 16) % STORM_LIVE_OBJECTS;
+    bench_free(histogram, live[slot]);
+    live[slot] = bench_malloc(histogram, 16 + (seed >> 8) % 112);
+    *(size_t *)live[slot] = i;
+  }
+  for(i = 0; i < STORM_LIVE_OBJECTS; i++) {
+    bench_free(histogram, live[i]);
+  }
+  bench_free(histogram, live);
+}
+
+static void *storm_thread(void *arg) {
+  void *base = NULL;
+  void (*volatile run)(struct bench_histogram *) = storm;
+
+  if(bench_collected) {
+    collector_register_thread(&gc, &base);
+  }
+  run(arg);
+  if(bench_collected) {
+    collector_unregister_thread(&gc);
+  }
+  return NULL;
+}
+
+/* Every thread allocates short lived objects at once */
+static void allocation_storm(void) {
+  pthread_t threads[STORM_THREADS];
+  struct bench_histogram histogram;
+  double start;
+  size_t i;
+
+  bench_histogram_new(&histogram);
+  start = bench_now_ns();
+  for(i = 0; i < STORM_THREADS; i++) {
+    pthread_create(&threads[i], NULL, storm_thread, &storm_histograms[i]);
+  }
+  for(i = 0; i < STORM_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+    bench_histogram_merge(&histogram, &storm_histograms[i]);
+  }
+
+  /* The threads ran side by side, their time in calls is averaged */
+  histogram.total_ns /= STORM_THREADS;
+  bench_report(
+    "allocation storm",
+    STORM_THREADS * STORM_ALLOCATIONS,
+    bench_now_ns() - start,
+    &histogram
+  );
+}
+
+int main(void) {
+  void (*workloads[])(void) = {
+    binary_trees, list_churn, array_retention, string_building, allocation_storm
+  };
+  size_t i;
+
+  bench_header();
+  for(i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+    bench_fork(workloads[i], false);
+    bench_fork(workloads[i], true);
+  }
+  return 0;
+}
@@ -0,0 +1,79 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "../export/EmeraldsCollector.h" /* IWYU pragma: keep */
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Measures how the mark pause shrinks as marker threads are added */
+
+#define TREE_DEPTH  (20)
+#define COLLECTIONS (10)
+
+struct node {
+  struct node *left;
+  struct node *right;
+};
+
+EmeraldsCollector gc;
+
+static struct node *build(int depth) {
+  struct node *n = mmalloc(sizeof(struct node));
+  if(depth > 0) {
+    n->left  = build(depth - 1);
+    n->right = build(depth - 1);
+  }
+  return n;
+}
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void run(void) {
+  struct node *volatile tree = build(TREE_DEPTH);
+  long cores                 = sysconf(_SC_NPROCESSORS_ONLN);
+  double baseline            = 0;
+  size_t threads;
+
+  printf("%lu objects live\n", (unsigned long)gc.heap.number_of_objects);
+  printf("threads   pause (ms)   speedup\n");
+  for(threads = 1; threads <= (size_t)(cores < 1 ? 1 : cores); threads *= 2) {
+    double start;
+    double pause;
+    int i;
+
+    if(!collector_set_marker_threads(&gc, threads)) {
+      printf("could not start %lu threads\n", (unsigned long)threads);
+      break;
+    }
+
+    start = now_ms();
+    for(i = 0; i < COLLECTIONS; i++) {
+      collector_collect(&gc);
+    }
+    pause = (now_ms() - start) / COLLECTIONS;
+    if(threads == 1) {
+      baseline = pause;
+    }
+    printf(
+      "%7lu %12.2f %9.2fx\n", (unsigned long)threads, pause, baseline / pause
+    );
+  }
+
+  (void)tree->left;
+}
+
+int main(void) {
+  void *dummy                  = NULL;
+  void (*volatile bench)(void) = run;
+
+  collector_new(&gc, &dummy);
+  bench();
+  collector_terminate(&gc);
+
+  return 0;
+}
@@ -0,0 +1,156 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "../export/EmeraldsCollector.h" /* IWYU pragma: keep */
+
+#include <stdio.h>
+#include <time.h>
+
+/* Compares the word at a time bounds check conservative scans used to do
+ * with the range filtering kernel, then times collections dominated by
+ * conservative scans of a large pointer array and of a deep stack */
+
+#define NUMBER_OF_WORDS ((size_t)1 << 22)
+#define POINTER_EVERY   (97)
+#define REPETITIONS     (20)
+#define COLLECTIONS     (10)
+#define STACK_DEPTH     (1000)
+#define FRAME_WORDS     (256)
+
+EmeraldsCollector gc;
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* Mostly integers, with a pointer to a live object every few words */
+static void fill(void **words, void **objects, size_t number_of_objects) {
+  size_t seed = 7;
+  size_t i;
+
+  for(i = 0; i < NUMBER_OF_WORDS; i++) {
+    seed     = seed * 1103515245 + 12345;
+    words[i] = i % POINTER_EVERY == 0 ? objects[i % number_of_objects]
+                                      : (void *)(seed % 1000003);
+  }
+}
+
+static size_t count_word_at_a_time(void **words) {
+  size_t found = 0;
+  size_t i;
+
+  for(i = 0; i < NUMBER_OF_WORDS; i++) {
+    if((size_t)words[i] >= gc.low_memory_bound &&
+       (size_t)words[i] <= gc.high_memory_bound) {
+      found++;
+    }
+  }
+  return found;
+}
+
+static size_t count_filtered(void **words) {
+  size_t found = 0;
+  size_t i;
+
+  for(i = collector_scan_next(
+        words, 0, NUMBER_OF_WORDS, gc.low_memory_bound, gc.high_memory_bound
+      );
+      i < NUMBER_OF_WORDS;
+      i = collector_scan_next(
+        words,
+        i + 1,
+        NUMBER_OF_WORDS,
+        gc.low_memory_bound,
+        gc.high_memory_bound
+      )) {
+    found++;
+  }
+  return found;
+}
+
+static double time_collections(void) {
+  double start = now_ms();
+  int i;
+
+  for(i = 0; i < COLLECTIONS; i++) {
+    collector_collect(&gc);
+  }
+  return (now_ms() - start) / COLLECTIONS;
+}
+
+/* Frames full of integers between the collection and the stack base */
+static double deep_stack(size_t depth) {
+  volatile size_t frame[FRAME_WORDS];
+  double pause;
+  size_t i;
+
+  for(i = 0; i < FRAME_WORDS; i++) {
+    frame[i] = depth * FRAME_WORDS + i;
+  }
+  pause = depth == 0 ? time_collections() : deep_stack(depth - 1);
+
+  /* Read after the call so that the frame stays on the stack */
+  (void)frame[0];
+  return pause;
+}
+
+static void run(void) {
+  void *objects[1024];
+  void **volatile words;
+  double start;
+  double before;
+  double after;
+  size_t found_before = 0;
+  size_t found_after  = 0;
+  size_t i;
+
+  for(i = 0; i < 1024; i++) {
+    objects[i] = mmalloc(64);
+  }
+  words = mmalloc(NUMBER_OF_WORDS * sizeof(void *));
+  fill(words, objects, 1024);
+
+  start = now_ms();
+  for(i = 0; i < REPETITIONS; i++) {
+    found_before += count_word_at_a_time(words);
+  }
+  before = (now_ms() - start) / REPETITIONS;
+  start  = now_ms();
+  for(i = 0; i < REPETITIONS; i++) {
+    found_after += count_filtered(words);
+  }
+  after = (now_ms() - start) / REPETITIONS;
+
+  printf("%lu words\n", (unsigned long)NUMBER_OF_WORDS);
+  printf("filter          time (ms)   candidates\n");
+  printf(
+    "word at a time %10.2f %12lu\n",
+    before,
+    (unsigned long)(found_before / REPETITIONS)
+  );
+  printf(
+    "%-14s %10.2f %12lu\n",
+    collector_scan_kernel(),
+    after,
+    (unsigned long)(found_after / REPETITIONS)
+  );
+  printf("speedup %.2fx\n\n", before / after);
+
+  printf("collection                pause (ms)\n");
+  printf("large conservative array %11.2f\n", time_collections());
+  words = NULL;
+  collector_collect(&gc);
+  printf("deep stack               %11.2f\n", deep_stack(STACK_DEPTH));
+}
+
+int main(void) {
+  void *dummy                  = NULL;
+  void (*volatile bench)(void) = run;
+
+  collector_new(&gc, &dummy);
+  bench();
+  collector_terminate(&gc);
+
+  return 0;
+}
@@ -0,0 +1,197 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "../export/EmeraldsCollector.h" /* IWYU pragma: keep */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Compares the ways of indexing the table of saved elements on pointers
+ * from malloc, whose low bits are always zero. Every scheme fills a linear
+ * probing table sized the way the collector sizes it, then looks every
+ * pointer up again. The table used to grow by 1.5 until it was full and
+ * took a modulo of a mixed hash, it now doubles past three quarters and
+ * keeps the top bits of a Fibonacci product. Masking the pointer itself
+ * shows why the bits have to be mixed first. The last part times the
+ * collector itself on objects that live in the table */
+
+#define NUMBER_OF_POINTERS ((size_t)1 << 17)
+#define LOOKUP_ROUNDS      (20)
+#define MEDIUM_OBJECTS     ((size_t)100000)
+#define COLLECTIONS        (10)
+
+EmeraldsCollector gc;
+
+struct scheme {
+  const char *name;
+  size_t (*size_for)(size_t number_of_pointers);
+  size_t (*home)(void *ptr, size_t size, size_t shift);
+};
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* The size the table had once it grew by 1.5 whenever it was full */
+static size_t size_by_half(size_t number_of_pointers) {
+  size_t size = 0;
+  size_t n;
+
+  for(n = 1; n <= number_of_pointers; n++) {
+    if(size < n + 1) {
+      size = (size_t)((double)(n + 1) * 1.5);
+    }
+  }
+  return size;
+}
+
+/* The power of two that keeps the table at most three quarters full */
+static size_t size_by_doubling(size_t number_of_pointers) {
+  size_t size = COLLECTOR_MINIMUM_TABLE_SIZE;
+
+  while(number_of_pointers * 4 > size * 3) {
+    size *= 2;
+  }
+  return size;
+}
+
+static size_t home_modulo(void *ptr, size_t size, size_t shift) {
+  (void)shift;
+  return _64bit_integer_hash(ptr) % size;
+}
+
+static size_t home_mask(void *ptr, size_t size, size_t shift) {
+  (void)shift;
+  return (size_t)ptr & (size - 1);
+}
+
+static size_t home_fibonacci(void *ptr, size_t size, size_t shift) {
+  (void)size;
+  return ((size_t)ptr * COLLECTOR_FIBONACCI_MULTIPLIER) >> shift;
+}
+
+static size_t next_slot(size_t slot, size_t size) {
+  return slot + 1 == size ? 0 : slot + 1;
+}
+
+static void compare(const struct scheme *scheme, void **pointers) {
+  size_t size  = scheme->size_for(NUMBER_OF_POINTERS);
+  size_t shift = sizeof(size_t) * 8;
+  void **table = calloc(size, sizeof(void *));
+  size_t total = 0;
+  size_t worst = 0;
+  size_t found = 0;
+  double start;
+  size_t round;
+  size_t i;
+
+  for(i = 1; i < size; i *= 2) {
+    shift--;
+  }
+  for(i = 0; i < NUMBER_OF_POINTERS; i++) {
+    size_t slot   = scheme->home(pointers[i], size, shift);
+    size_t probes = 0;
+
+    while(table[slot] != NULL) {
+      slot = next_slot(slot, size);
+      probes++;
+    }
+    table[slot] = pointers[i];
+    total += probes;
+    worst = probes > worst ? probes : worst;
+  }
+
+  start = now_ms();
+  for(round = 0; round < LOOKUP_ROUNDS; round++) {
+    for(i = 0; i < NUMBER_OF_POINTERS; i++) {
+      size_t slot = scheme->home(pointers[i], size, shift);
+
+      while(table[slot] != pointers[i]) {
+        slot = next_slot(slot, size);
+      }
+      found++;
+    }
+  }
+  printf(
+    "%-10s %9lu %6.2f %9.2f %9lu %12.1f\n",
+    scheme->name,
+    (unsigned long)size,
+    (double)NUMBER_OF_POINTERS / (double)size,
+    (double)total / (double)NUMBER_OF_POINTERS,
+    (unsigned long)worst,
+    (double)found / (now_ms() - start) / 1e3
+  );
+  free(table);
+}
+
+/* Medium objects are the ones saved in the table */
+static void time_collector(void) {
+  void **objects = collector_malloc(&gc, MEDIUM_OBJECTS * sizeof(void *));
+  double start   = now_ms();
+  size_t i;
+
+  for(i = 0; i < MEDIUM_OBJECTS; i++) {
+    objects[i] = collector_malloc(&gc, COLLECTOR_MAX_SMALL_SIZE + 64);
+  }
+  printf("\ncollector                    time (ms)\n");
+  printf("allocate %lu medium %14.2f\n", (unsigned long)i, now_ms() - start);
+
+  start = now_ms();
+  for(i = 0; i < COLLECTIONS; i++) {
+    collector_collect(&gc);
+  }
+  printf("collect, all live %19.2f\n", (now_ms() - start) / COLLECTIONS);
+
+  start = now_ms();
+  for(i = 0; i < MEDIUM_OBJECTS; i++) {
+    collector_free(&gc, objects[i]);
+  }
+  printf("free every object %19.2f\n", now_ms() - start);
+  collector_free(&gc, objects);
+}
+
+static void run(void) {
+  struct scheme schemes[3];
+  void **pointers = malloc(NUMBER_OF_POINTERS * sizeof(void *));
+  size_t i;
+
+  schemes[0].name     = "modulo";
+  schemes[0].size_for = size_by_half;
+  schemes[0].home     = home_modulo;
+  schemes[1].name     = "mask";
+  schemes[1].size_for = size_by_doubling;
+  schemes[1].home     = home_mask;
+  schemes[2].name     = "fibonacci";
+  schemes[2].size_for = size_by_doubling;
+  schemes[2].home     = home_fibonacci;
+
+  /* Sizes of medium objects, so the addresses spread like theirs */
+  for(i = 0; i < NUMBER_OF_POINTERS; i++) {
+    pointers[i] = malloc(COLLECTOR_MAX_SMALL_SIZE + (i % 13) * 64);
+  }
+
+  printf("%lu pointers\n", (unsigned long)NUMBER_OF_POINTERS);
+  printf("scheme          size   load   probes     worst  lookups/us\n");
+  for(i = 0; i < 3; i++) {
+    compare(&schemes[i], pointers);
+  }
+
+  for(i = 0; i < NUMBER_OF_POINTERS; i++) {
+    free(pointers[i]);
+  }
+  free(pointers);
+  time_collector();
+}
+
+int main(void) {
+  void *dummy                  = NULL;
+  void (*volatile bench)(void) = run;
+
+  collector_new(&gc, &dummy);
+  bench();
+  collector_terminate(&gc);
+
+  return 0;
+}
@@ -0,0 +1,125 @@
+#define _DEFAULT_SOURCE
+
+#include "bench.h"
+
+/* Replays a recorded allocation trace on the collector and on malloc and
+ * free. A trace holds one operation per line, ids name the blocks:
+ *
+ *   m <id> <size>   allocates a block
+ *   r <id> <size>   resizes a block, allocates it when the id is unused
+ *   f <id>          frees a block, on the collector it is only dropped
+ *
+ * Lines starting with anything else are ignored.
+ *
+ *   ./trace_replay.out trace.txt */
+
+struct operation {
+  char kind;
+  size_t id;
+  size_t size;
+};
+
+static struct operation *operations;
+static size_t number_of_operations;
+static size_t number_of_ids;
+
+static bool read_trace(const char *path) {
+  FILE *file    = fopen(path, "r");
+  size_t length = 0;
+  char line[128];
+
+  if(file == NULL) {
+    return false;
+  }
+  while(fgets(line, sizeof(line), file) != NULL) {
+    struct operation operation;
+    unsigned long id;
+    unsigned long size = 0;
+
+    if((line[0] != 'm' && line[0] != 'r' && line[0] != 'f') ||
+       sscanf(line + 1, "%lu %lu", &id, &size) < 1) {
+      continue;
+    }
+    if(number_of_operations == length) {
+      struct operation *grown;
+      length = length == 0 ? 4096 : length * 2;
+      grown  = realloc(operations, length * sizeof(struct operation));
+      if(grown == NULL) {
+        fclose(file);
+        return false;
+      }
+      operations = grown;
+    }
+    operation.kind = line[0];
+    operation.id   = id;
+    operation.size = size;
+    operations[number_of_operations++] = operation;
+    if(id + 1 > number_of_ids) {
+      number_of_ids = id + 1;
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+static void replay(void) {
+  struct bench_histogram histogram;
+  void **volatile blocks;
+  double start;
+  size_t i;
+
+  bench_histogram_new(&histogram);
+  start  = bench_now_ns();
+  blocks = bench_malloc(&histogram, number_of_ids * sizeof(void *));
+  for(i = 0; i < number_of_ids; i++) {
+    blocks[i] = NULL;
+  }
+
+  for(i = 0; i < number_of_operations; i++) {
+    struct operation *operation = &operations[i];
+    void *block                 = blocks[operation->id];
+
+    if(operation->kind == 'f') {
+      bench_free(&histogram, block);
+      blocks[operation->id] = NULL;
+      continue;
+    }
+    if(operation->kind == 'm') {
+      bench_free(&histogram, block);
+      block = bench_malloc(&histogram, operation->size);
+    } else {
+      block = bench_realloc(&histogram, block, operation->size);
+    }
+
+    /* Blocks are written to, as the traced program would have done */
+    if(block != NULL && operation->size >= sizeof(size_t)) {
+      *(size_t *)block = i;
+    }
+    blocks[operation->id] = block;
+  }
+
+  bench_report(
+    "trace", number_of_operations, bench_now_ns() - start, &histogram
+  );
+  for(i = 0; i < number_of_ids; i++) {
+    bench_free(&histogram, blocks[i]);
+  }
+  bench_free(&histogram, blocks);
+}
+
+int main(int argc, char **argv) {
+  if(argc < 2 || !read_trace(argv[1])) {
+    fprintf(stderr, "usage: %s <trace>\n", argv[0]);
+    return 1;
+  }
+  printf(
+    "%lu operations on %lu ids\n",
+    (unsigned long)number_of_operations,
+    (unsigned long)number_of_ids
+  );
+  bench_header();
+  bench_fork(replay, false);
+  bench_fork(replay, true);
+  free(operations);
+  return 0;
+}
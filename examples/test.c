@@ -21,7 +21,7 @@ int main(void) {
   int *arr    = NULL;
   int value;
 
-  collector_new(&gc, dummy);
+  collector_new(&gc, &dummy);
 
   arr = (int *)mmalloc(sizeof(int) * 10);
 
@@ -1,5 +1,33 @@
+#include "collector_background/collector_background.module.spec.h"
 #include "collector_base/collector_base.module.spec.h"
+#include "collector_finalizers/collector_finalizers.module.spec.h"
+#include "collector_heap/collector_heap.module.spec.h"
+#include "collector_large/collector_large.module.spec.h"
+#include "collector_layout/collector_layout.module.spec.h"
+#include "collector_markers/collector_markers.module.spec.h"
+#include "collector_page_map/collector_page_map.module.spec.h"
+#include "collector_profile/collector_profile.module.spec.h"
+#include "collector_roots/collector_roots.module.spec.h"
+#include "collector_scan/collector_scan.module.spec.h"
+#include "collector_stats/collector_stats.module.spec.h"
+#include "collector_threads/collector_threads.module.spec.h"
+#include "collector_worklist/collector_worklist.module.spec.h"
 
 int main(void) {
-  cspec_run_suite("all", { T_collector_base(); });
+  cspec_run_suite("all", {
+    T_collector_background();
+    T_collector_base();
+    T_collector_finalizers();
+    T_collector_heap();
+    T_collector_large();
+    T_collector_layout();
+    T_collector_markers();
+    T_collector_page_map();
+    T_collector_profile();
+    T_collector_roots();
+    T_collector_scan();
+    T_collector_stats();
+    T_collector_threads();
+    T_collector_worklist();
+  });
 }
@@ -0,0 +1,59 @@
+#include "../../libs/cSpec/export/cSpec.h"
+#include "../../src/collector_background/collector_background.h"
+
+#include <sched.h>
+
+/* Counts down one piece of work per call */
+static bool collector_background_spec_work(void *context) {
+  size_t *remaining = context;
+  size_t left       = __atomic_load_n(remaining, __ATOMIC_ACQUIRE);
+
+  if(left == 0) {
+    return true;
+  }
+  __atomic_store_n(remaining, left - 1, __ATOMIC_RELEASE);
+  return left == 1;
+}
+
+static void collector_background_spec_wait(size_t *remaining) {
+  while(__atomic_load_n(remaining, __ATOMIC_ACQUIRE) != 0) {
+    sched_yield();
+  }
+}
+
+module(T_collector_background, {
+  describe("background worker", {
+    it("works until done every time it is woken", {
+      struct EmeraldsCollectorBackground background;
+      size_t remaining = 0;
+
+      collector_background_new(&background);
+      assert_that(collector_background_start(
+        &background, collector_background_spec_work, &remaining
+      ));
+      assert_that(background.running);
+
+      __atomic_store_n(&remaining, 100, __ATOMIC_RELEASE);
+      collector_background_wake(&background);
+      collector_background_spec_wait(&remaining);
+
+      __atomic_store_n(&remaining, 5, __ATOMIC_RELEASE);
+      collector_background_wake(&background);
+      collector_background_spec_wait(&remaining);
+      assert_that(remaining == 0);
+
+      collector_background_terminate(&background);
+      nassert_that(background.running);
+    });
+
+    it("ignores wakes without a thread", {
+      struct EmeraldsCollectorBackground background;
+
+      collector_background_new(&background);
+      collector_background_wake(&background);
+      nassert_that(background.pending);
+      collector_background_stop(&background);
+      collector_background_terminate(&background);
+    });
+  });
+})
@@ -1,3 +1,1582 @@
 #include "../../libs/cSpec/export/cSpec.h"
+#include "../../src/collector_base/collector_base.h"
 
-module(T_collector_base, {})
+/** The objects the specs link into lists and graphs **/
+struct collector_base_spec_node {
+  struct collector_base_spec_node *next;
+  struct collector_base_spec_node *child;
+  size_t value;
+};
+
+/* Its own fields are left out of the data segment the collector scans */
+static EmeraldsCollector collector_base_spec_gc;
+
+/* A global root, found in the data segment */
+static struct collector_base_spec_node *volatile collector_base_spec_root;
+
+/* 1 once a parked thread registered, 2 once it may return */
+static int collector_base_spec_state;
+
+/* The same numbers on every run */
+static size_t collector_base_spec_random(size_t *seed) {
+  *seed = *seed * 1103515245 + 12345;
+  return (*seed >> 16) & 0x7fff;
+}
+
+/* Runs a scenario on a new collector, from a frame below its stack base */
+static void collector_base_spec_run(
+  void (*scenario)(EmeraldsCollector *gc, size_t *results), size_t *results
+) {
+  void *stack_base                                    = NULL;
+  void (*volatile run)(EmeraldsCollector *, size_t *) = scenario;
+
+  collector_new(&collector_base_spec_gc, &stack_base);
+  run(&collector_base_spec_gc, results);
+  collector_terminate(&collector_base_spec_gc);
+}
+
+/* Zeroes the stack below the caller, dead frames keep stale pointers */
+__COLLECTOR_NO_SANITIZE static void collector_base_spec_scrub(void) {
+  volatile char frame[16384];
+  size_t i;
+
+  for(i = 0; i < sizeof(frame); i++) {
+    frame[i] = 0;
+  }
+}
+
+static void collector_base_spec_scrub_stack(void) {
+  void (*volatile scrub)(void) = collector_base_spec_scrub;
+  scrub();
+}
+
+/* Prepends a node numbered one past the head */
+static struct collector_base_spec_node *collector_base_spec_push(
+  EmeraldsCollector *gc, struct collector_base_spec_node *head, size_t size
+) {
+  struct collector_base_spec_node *node = collector_malloc(gc, size);
+
+  node->next  = head;
+  node->child = NULL;
+  node->value = head == NULL ? 0 : head->value + 1;
+  return node;
+}
+
+static struct collector_base_spec_node *
+collector_base_spec_list(EmeraldsCollector *gc, size_t length) {
+  struct collector_base_spec_node *head = NULL;
+  size_t i;
+
+  for(i = 0; i < length; i++) {
+    head = collector_base_spec_push(gc, head, sizeof(*head));
+  }
+  return head;
+}
+
+/* A node freed while reachable was handed out again and rewritten */
+static bool collector_base_spec_intact(
+  struct collector_base_spec_node *head, size_t length
+) {
+  for(; head != NULL && length > 0; head = head->next) {
+    if(head->value != --length) {
+      return false;
+    }
+  }
+  return head == NULL && length == 0;
+}
+
+/* Allocates an object only a weak reference knows of, its address is
+    kept inverted so that no word of the stack points at it */
+static size_t collector_base_spec_hide(
+  EmeraldsCollector *gc, size_t size, EmeraldsCollectorWeak **weak
+) {
+  struct collector_base_spec_node *node =
+    collector_base_spec_push(gc, NULL, size);
+
+  node->value = 7;
+  *weak       = collector_weak_new(gc, node);
+  return ~(size_t)node;
+}
+
+/* Never inlined, the frame left with the address is below the caller's */
+static size_t collector_base_spec_hidden(
+  EmeraldsCollector *gc, size_t size, EmeraldsCollectorWeak **weak
+) {
+  size_t (*volatile hide)(
+    EmeraldsCollector *, size_t, EmeraldsCollectorWeak **
+  ) = collector_base_spec_hide;
+  return hide(gc, size, weak);
+}
+
+/* Builds lists of small nodes mixed with medium ones. The medium blocks
+    come from malloc unzeroed, their stale words are what the marker finds
+    when slots are handed out while marking */
+static void
+collector_base_spec_lists(EmeraldsCollector *gc, size_t *broken_lists) {
+  struct EmeraldsCollectorPolicy policy = {100, 0, 0, 1 << 20};
+  size_t seed                           = 1;
+  size_t round;
+
+  collector_set_incremental(gc, true);
+  collector_set_policy(gc, &policy);
+  *broken_lists = 0;
+  for(round = 0; round < 200; round++) {
+    struct collector_base_spec_node *head = NULL;
+    size_t length = 500 + collector_base_spec_random(&seed) % 501;
+    size_t i;
+
+    for(i = 0; i < length; i++) {
+      size_t r = collector_base_spec_random(&seed);
+      head     = collector_base_spec_push(
+        gc, head, r % 2 == 0 ? 2100 + r % 5000 : sizeof(*head)
+      );
+    }
+    if(!collector_base_spec_intact(head, length)) {
+      (*broken_lists)++;
+    }
+  }
+}
+
+/* Builds the same lists while a background thread marks and sweeps */
+static void
+collector_base_spec_concurrent(EmeraldsCollector *gc, size_t *results) {
+  struct EmeraldsCollectorStats stats;
+
+  results[0] = collector_set_concurrent(gc, true);
+  collector_base_spec_lists(gc, &results[1]);
+  collector_stats(gc, &stats);
+  results[2] = stats.collections > 0;
+  collector_set_concurrent(gc, false);
+}
+
+/* Starts a cycle on a list and finishes it one slice per call, growing
+    the list between the slices */
+static void collector_base_spec_slices(EmeraldsCollector *gc, size_t *results) {
+  struct EmeraldsCollectorPolicy policy = {0, 0, 0, 0};
+  struct collector_base_spec_node *head;
+  size_t length = 4000;
+  size_t i;
+
+  collector_set_incremental(gc, true);
+  head = collector_base_spec_list(gc, length);
+  collector_collect(gc);
+
+  /* The trigger is the heap as it is, the next allocation outgrows it */
+  collector_set_policy(gc, &policy);
+  head = collector_base_spec_push(gc, head, sizeof(*head));
+  length++;
+
+  results[0] = 0;
+  while(!collector_step(gc, 0)) {
+    head = collector_base_spec_push(gc, head, sizeof(*head));
+    length++;
+    results[0]++;
+  }
+  results[1] = collector_base_spec_intact(head, length);
+
+  /* Wrongly freed slots are handed out again and rewritten */
+  for(i = 0; i < 2 * length; i++) {
+    collector_base_spec_push(gc, NULL, sizeof(*head));
+  }
+  results[2] = collector_base_spec_intact(head, length);
+}
+
+/* Measures the longest call of a cycle stepped with a 2ms budget */
+static void collector_base_spec_budget(EmeraldsCollector *gc, size_t *results) {
+  struct EmeraldsCollectorPolicy policy = {0, 0, 0, 0};
+  struct collector_base_spec_node *head;
+  size_t budget_ns = 2000000;
+
+  collector_set_incremental(gc, true);
+  head = collector_base_spec_list(gc, 200000);
+  collector_collect(gc);
+  collector_set_policy(gc, &policy);
+  head = collector_base_spec_push(gc, head, sizeof(*head));
+
+  results[0] = 0;
+  results[1] = 0;
+  while(true) {
+    clock_t start = clock();
+    bool done     = collector_step(gc, budget_ns);
+    size_t ns     = (size_t)((double)(clock() - start) * 1e9 / CLOCKS_PER_SEC);
+
+    results[0]++;
+    results[1] = ns > results[1] ? ns : results[1];
+    if(done) {
+      break;
+    }
+  }
+  results[2] = collector_base_spec_intact(head, 200001);
+}
+
+/* Stores an unmarked object into a scanned one in the middle of a cycle */
+static void
+collector_base_spec_barrier(EmeraldsCollector *gc, size_t *results) {
+  struct EmeraldsCollectorPolicy policy = {0, 0, 0, 0};
+  struct collector_base_spec_node *object;
+  EmeraldsCollectorWeak *weak;
+  size_t hidden;
+  size_t i;
+
+  collector_set_incremental(gc, true);
+  object       = collector_base_spec_push(gc, NULL, sizeof(*object));
+  object->next = collector_base_spec_list(gc, 2000);
+  collector_collect(gc);
+  collector_set_policy(gc, &policy);
+  hidden = collector_base_spec_hidden(gc, sizeof(*object), &weak);
+
+  /* The object is the only root, the first slices scan it and leave the
+      rest of the list for later ones */
+  collector_base_spec_scrub_stack();
+  for(i = 0; i < 10; i++) {
+    collector_step(gc, 0);
+  }
+  object->child = (struct collector_base_spec_node *)~hidden;
+  collector_remember(gc, object);
+  while(!collector_step(gc, 0)) {
+  }
+
+  results[0] = collector_weak_get(gc, weak) == object->child;
+  results[1] = object->child->value == 7;
+  collector_weak_free(gc, weak);
+}
+
+/* Looks an object up the way the collector does, from its home slot
+    until an empty slot or an entry closer to its own home */
+static bool collector_base_spec_saved(EmeraldsCollector *gc, void *ptr) {
+  size_t mask = gc->gc_size - 1;
+  size_t value;
+  size_t distance;
+
+  if(gc->gc_size == 0) {
+    return false;
+  }
+  value = ((size_t)ptr * COLLECTOR_FIBONACCI_MULTIPLIER) >> gc->hash_shift;
+  for(distance = 0; distance < gc->gc_size; distance++) {
+    struct EmeraldsCollectorGarbage *entry = &gc->garbage[value];
+
+    if(entry->id == 0 || ((value - (entry->id - 1)) & mask) < distance) {
+      return false;
+    }
+    if(entry->ptr == ptr) {
+      return true;
+    }
+    value = (value + 1) & mask;
+  }
+  return false;
+}
+
+/* Checks the live objects are found and the dead ones, unless a later
+    object took their address, are gone. The count holds once swept */
+static bool collector_base_spec_table_holds(
+  EmeraldsCollector *gc,
+  void **objects,
+  size_t number_of_objects,
+  size_t *dead,
+  size_t number_of_dead
+) {
+  size_t live = 0;
+  size_t i;
+  size_t j;
+
+  for(i = 0; i < number_of_objects; i++) {
+    if(objects[i] == NULL) {
+      continue;
+    }
+    if(!collector_base_spec_saved(gc, objects[i])) {
+      return false;
+    }
+    live++;
+  }
+  if(gc->sweeping) {
+    return true;
+  }
+  for(i = 0; i < number_of_dead; i++) {
+    for(j = 0; j < number_of_objects; j++) {
+      if(objects[j] == (void *)~dead[i]) {
+        break;
+      }
+    }
+    if(j == number_of_objects &&
+       collector_base_spec_saved(gc, (void *)~dead[i])) {
+      return false;
+    }
+  }
+  return gc->number_of_garbage == live;
+}
+
+/* Sweeps a table of 256 slots a slice at a time, saving new objects in
+    between the slices. The objects are zeroed, stale words left in their
+    blocks would keep dead ones alive */
+static void
+collector_base_spec_lazy_sweep(EmeraldsCollector *gc, size_t *results) {
+  struct EmeraldsCollectorPolicy policy = {0, 0, 0, 0};
+  void *objects[200];
+  size_t dead[60];
+  size_t number_of_objects = 150;
+  size_t i;
+
+  for(i = 0; i < number_of_objects; i++) {
+    objects[i] = collector_calloc(gc, 1, 2100 + (i % 13) * 64);
+  }
+  for(i = 0; i < 60; i++) {
+    dead[i]        = ~(size_t)objects[2 * i];
+    objects[2 * i] = NULL;
+  }
+
+  /* The next allocation outgrows the trigger, the step after it marks
+      and leaves the sweep to the steps that follow */
+  collector_set_policy(gc, &policy);
+  collector_malloc(gc, 16);
+  collector_base_spec_scrub_stack();
+  collector_step(gc, 0);
+  results[0] = gc->sweeping && gc->gc_size == 256;
+
+  results[1] = 0;
+  results[2] = true;
+  while(gc->sweeping && number_of_objects < 200) {
+    collector_step(gc, 0);
+    results[1]++;
+    results[2] = results[2] && collector_base_spec_table_holds(
+                                 gc, objects, number_of_objects, NULL, 0
+                               );
+    objects[number_of_objects++] = collector_calloc(gc, 1, 2200);
+  }
+  results[3] = !gc->sweeping;
+  results[4] =
+    collector_base_spec_table_holds(gc, objects, number_of_objects, dead, 60);
+}
+
+/* Shrinks the table to 16 slots around eight objects homed in its last
+    four, their cluster wraps past the end, then sweeps two of them */
+static void collector_base_spec_wrap(EmeraldsCollector *gc, size_t *results) {
+  struct EmeraldsCollectorPolicy policy = {0, 0, 0, 0};
+  void *objects[400];
+  size_t dead[2];
+  size_t number_of_tail = 0;
+  size_t number_of_head = 0;
+  size_t number_of_dead = 0;
+  size_t i;
+
+  /* Where libc places the blocks depends on the specs before, enough of
+      them leave eight homed in the last four slots */
+  for(i = 0; i < 400; i++) {
+    objects[i] = collector_calloc(gc, 1, 2100 + i * 16);
+  }
+  for(i = 0; i < 400; i++) {
+    size_t home = ((size_t)objects[i] * COLLECTOR_FIBONACCI_MULTIPLIER) >>
+                  (sizeof(size_t) * 8 - 4);
+
+    if(home >= 12 && number_of_tail < 8) {
+      number_of_tail++;
+    }
+    else if(home < 12 && number_of_head < 3) {
+      number_of_head++;
+    }
+    else {
+      collector_free(gc, objects[i]);
+      objects[i] = NULL;
+    }
+  }
+  collector_collect(gc);
+  results[0] = number_of_tail == 8 && gc->gc_size == 16;
+  results[1] = false;
+  for(i = 0; i < 4; i++) {
+    results[1] = results[1] || gc->garbage[i].id > 12;
+  }
+
+  /* A hole in the last slot pulls the wrapped entries back over the end */
+  for(i = 0; i < 400; i++) {
+    if(objects[i] != NULL && (objects[i] == gc->garbage[15].ptr ||
+                              objects[i] == gc->garbage[0].ptr)) {
+      dead[number_of_dead++] = ~(size_t)objects[i];
+      objects[i]             = NULL;
+    }
+  }
+  collector_set_policy(gc, &policy);
+  collector_malloc(gc, 16);
+  collector_base_spec_scrub_stack();
+  while(!collector_step(gc, 0)) {
+  }
+  results[2] = number_of_dead == 2 &&
+               collector_base_spec_table_holds(gc, objects, 400, dead, 2);
+}
+
+/* Fills the nursery and runs the minor collection that follows */
+static bool collector_base_spec_minor(EmeraldsCollector *gc) {
+  struct EmeraldsCollectorStats before;
+  struct EmeraldsCollectorStats after;
+  size_t i;
+
+  collector_stats(gc, &before);
+  for(i = 0; i < 64; i++) {
+    collector_base_spec_push(gc, NULL, sizeof(struct collector_base_spec_node));
+  }
+  collector_base_spec_scrub_stack();
+  while(!collector_step(gc, 0)) {
+  }
+  collector_stats(gc, &after);
+  return after.minor_collections > before.minor_collections &&
+         after.collections - before.collections ==
+           after.minor_collections - before.minor_collections;
+}
+
+/* Allocates an object and collects until it is promoted. Promoted slots
+    start out remembered, a minor collection leaves them clean */
+static struct collector_base_spec_node *
+collector_base_spec_old(EmeraldsCollector *gc) {
+  struct collector_base_spec_node *old =
+    collector_base_spec_push(gc, NULL, sizeof(*old));
+
+  collector_set_generational(gc, 64, 1);
+  collector_collect(gc);
+  collector_collect(gc);
+  collector_base_spec_minor(gc);
+  return old;
+}
+
+/* Stores a hidden object into another from a frame of its own, no
+    register of the caller is left holding its address */
+static void collector_base_spec_link_to(
+  struct collector_base_spec_node *object, size_t hidden
+) {
+  object->child = (struct collector_base_spec_node *)~hidden;
+}
+
+static void collector_base_spec_link(
+  struct collector_base_spec_node *object, size_t hidden
+) {
+  void (*volatile link)(struct collector_base_spec_node *, size_t) =
+    collector_base_spec_link_to;
+  link(object, hidden);
+}
+
+/* Drops the child of an object from a frame of its own, returns where
+    it was inverted */
+static size_t
+collector_base_spec_unlink_from(struct collector_base_spec_node *object) {
+  size_t hidden = ~(size_t)object->child;
+
+  object->child = NULL;
+  return hidden;
+}
+
+static size_t
+collector_base_spec_unlink(struct collector_base_spec_node *object) {
+  size_t (*volatile unlink)(struct collector_base_spec_node *) =
+    collector_base_spec_unlink_from;
+  return unlink(object);
+}
+
+/* Stores a young object into an old one through the barrier, then drops
+    the old one */
+static void
+collector_base_spec_remembered(EmeraldsCollector *gc, size_t *results) {
+  EmeraldsCollectorWeak *weak;
+  size_t hidden;
+
+  collector_base_spec_root = collector_base_spec_old(gc);
+  hidden                   = collector_base_spec_hidden(
+    gc, sizeof(struct collector_base_spec_node), &weak
+  );
+  collector_base_spec_link(collector_base_spec_root, hidden);
+  collector_base_spec_scrub_stack();
+  collector_remember(gc, collector_base_spec_root);
+  results[0] = collector_base_spec_minor(gc);
+  results[1] = collector_weak_get(gc, weak) != NULL &&
+               collector_base_spec_root->child->value == 7;
+
+  /* Only a full collection finds the old object unreachable */
+  collector_base_spec_root = NULL;
+  collector_base_spec_scrub_stack();
+  collector_collect(gc);
+  results[2] = collector_weak_get(gc, weak) == NULL;
+  collector_weak_free(gc, weak);
+}
+
+/* Stores a young object into an old one behind the barrier's back */
+static void
+collector_base_spec_forgotten(EmeraldsCollector *gc, size_t *results) {
+  EmeraldsCollectorWeak *weak;
+  size_t hidden;
+
+  collector_base_spec_root = collector_base_spec_old(gc);
+  hidden                   = collector_base_spec_hidden(
+    gc, sizeof(struct collector_base_spec_node), &weak
+  );
+  collector_base_spec_link(collector_base_spec_root, hidden);
+  collector_base_spec_scrub_stack();
+  results[0] = collector_base_spec_minor(gc);
+  results[1] = collector_weak_get(gc, weak) == NULL;
+  collector_base_spec_root = NULL;
+  collector_weak_free(gc, weak);
+}
+
+/* Allocates unreachable medium objects until a collection starts, the
+    heap outgrew the trigger right before and not earlier */
+static bool
+collector_base_spec_triggers_at(EmeraldsCollector *gc, size_t trigger) {
+  struct EmeraldsCollectorStats before;
+  struct EmeraldsCollectorStats after;
+
+  while(true) {
+    collector_stats(gc, &before);
+    collector_malloc(gc, 4000);
+    collector_stats(gc, &after);
+    if(after.collections > before.collections) {
+      return before.heap_bytes > trigger;
+    }
+    if(before.heap_bytes > trigger) {
+      return false;
+    }
+  }
+}
+
+/* Schedules collections from the live bytes, then from the minimum heap */
+static void collector_base_spec_paced(EmeraldsCollector *gc, size_t *results) {
+  struct EmeraldsCollectorPolicy growth  = {50, 0, 0, 64 << 10};
+  struct EmeraldsCollectorPolicy minimum = {50, 0, 0, 8 << 20};
+  struct EmeraldsCollectorStats stats;
+  struct collector_base_spec_node *head = NULL;
+  size_t i;
+
+  for(i = 0; i < 300; i++) {
+    head = collector_base_spec_push(gc, head, 4000);
+  }
+  collector_set_policy(gc, &growth);
+  collector_collect(gc);
+  collector_stats(gc, &stats);
+  results[0] =
+    stats.collection_trigger == stats.heap_bytes + stats.heap_bytes / 2;
+  results[1] = collector_base_spec_triggers_at(gc, stats.collection_trigger);
+  while(!collector_step(gc, 0)) {
+  }
+
+  collector_set_policy(gc, &minimum);
+  collector_stats(gc, &stats);
+  results[2] = stats.collection_trigger == minimum.minimum_heap &&
+               stats.heap_bytes < minimum.minimum_heap / 4;
+  results[3] = collector_base_spec_triggers_at(gc, minimum.minimum_heap);
+  results[4] = collector_base_spec_intact(head, 300);
+}
+
+/* Fills the heap up to a limit, first with garbage that a collection
+    makes room from, then with objects that stay reachable. The minimum
+    heap keeps the trigger at the limit, only the limit collects */
+static void
+collector_base_spec_limited(EmeraldsCollector *gc, size_t *results) {
+  struct EmeraldsCollectorPolicy policy = {100, 4 << 20, 0, 4 << 20};
+  struct EmeraldsCollectorStats before;
+  struct EmeraldsCollectorStats after;
+  struct collector_base_spec_node *head = NULL;
+  struct collector_base_spec_node *node;
+  size_t length = 0;
+
+  collector_set_policy(gc, &policy);
+  results[0] = true;
+  do {
+    collector_stats(gc, &before);
+    node = collector_malloc(gc, 4000);
+    collector_stats(gc, &after);
+    results[0] = results[0] && node != NULL &&
+                 after.heap_bytes <= policy.memory_limit;
+  } while(after.collections == before.collections);
+  results[1] = before.heap_bytes + 4000 > policy.memory_limit;
+
+  while(true) {
+    collector_stats(gc, &before);
+    node = collector_malloc(gc, 4000);
+    collector_stats(gc, &after);
+    results[0] = results[0] && after.heap_bytes <= policy.memory_limit;
+    if(node == NULL) {
+      break;
+    }
+    node->next  = head;
+    node->child = NULL;
+    node->value = length++;
+    head        = node;
+  }
+  results[2] = after.collections > before.collections &&
+               length > policy.memory_limit / 4000 - 16;
+  results[3] = collector_base_spec_intact(head, length);
+}
+
+/* Allocates a batch, keeps it across a collection and frees it again,
+    the heap is back to its size from before the batch */
+static bool collector_base_spec_batch(EmeraldsCollector *gc, size_t size) {
+  struct EmeraldsCollectorStats before;
+  struct EmeraldsCollectorStats after;
+  void *ptrs[32];
+  size_t count = size < COLLECTOR_LARGE_THRESHOLD ? 32 : 4;
+  bool kept    = true;
+  size_t i;
+
+  collector_collect(gc);
+  collector_stats(gc, &before);
+  if(collector_malloc_batch(gc, size, count, ptrs) != count) {
+    return false;
+  }
+  for(i = 0; i < count; i++) {
+    ((size_t *)ptrs[i])[0]      = i;
+    ((char *)ptrs[i])[size - 1] = 1;
+  }
+  collector_collect(gc);
+  for(i = 0; i < count; i++) {
+    kept = kept && ((size_t *)ptrs[i])[0] == i &&
+           ((char *)ptrs[i])[size - 1] == 1;
+  }
+  collector_free_batch(gc, ptrs, count);
+  collector_stats(gc, &after);
+  return kept && after.heap_bytes == before.heap_bytes &&
+         after.number_of_garbage == before.number_of_garbage &&
+         after.number_of_large_objects == before.number_of_large_objects;
+}
+
+static void
+collector_base_spec_batches(EmeraldsCollector *gc, size_t *results) {
+  results[0] = collector_base_spec_batch(gc, 24);
+  results[1] = collector_base_spec_batch(gc, COLLECTOR_MAX_SMALL_SIZE);
+  results[2] = collector_base_spec_batch(gc, 4000);
+  results[3] = collector_base_spec_batch(gc, COLLECTOR_LARGE_THRESHOLD);
+}
+
+/* Fills the heap with reachable objects up to a few below the limit,
+    then asks for more than still fit */
+static void
+collector_base_spec_partial(EmeraldsCollector *gc, size_t *results) {
+  struct EmeraldsCollectorPolicy policy = {100, 4 << 20, 0, 4 << 20};
+  struct EmeraldsCollectorStats stats;
+  struct collector_base_spec_node *head = NULL;
+  void *ptrs[32];
+  size_t length = 0;
+  size_t room;
+  size_t i;
+
+  collector_set_policy(gc, &policy);
+  do {
+    head = collector_base_spec_push(gc, head, 4000);
+    length++;
+    collector_stats(gc, &stats);
+  } while(stats.heap_bytes + 10 * 4000 < policy.memory_limit);
+
+  results[0] = collector_malloc_batch(gc, 4000, 32, ptrs);
+  collector_stats(gc, &stats);
+  room       = policy.memory_limit - (stats.heap_bytes - results[0] * 4000);
+  results[1] = results[0] > 0 && results[0] == room / 4000 &&
+               stats.heap_bytes <= policy.memory_limit;
+  results[2] = true;
+  for(i = 0; i < 32; i++) {
+    results[2] = results[2] && (ptrs[i] == NULL) == (i >= results[0]);
+  }
+  results[3] = collector_base_spec_intact(head, length);
+}
+
+/* Grows the table past three quarters of its slots and shrinks it below
+    a quarter, every rehash keeps finding the saved objects */
+static void
+collector_base_spec_resized(EmeraldsCollector *gc, size_t *results) {
+  struct EmeraldsCollectorStats stats;
+  void *objects[200];
+  size_t dead[200];
+  size_t rehashes = 0;
+  size_t i;
+
+  results[0] = 0;
+  results[1] = true;
+  for(i = 0; i < 200; i++) {
+    /* Stale words of earlier frames would keep dropped objects alive */
+    dead[i]    = 0;
+    objects[i] = collector_calloc(gc, 1, 2100 + i % 7 * 64);
+    collector_stats(gc, &stats);
+    if(stats.rehashes > rehashes) {
+      rehashes = stats.rehashes;
+      results[0]++;
+      results[1] = results[1] &&
+                   stats.number_of_garbage * 4 <= stats.gc_size * 3 &&
+                   collector_base_spec_table_holds(gc, objects, i + 1, NULL, 0);
+    }
+  }
+  results[2] = stats.gc_size == 512;
+
+  /* Only the end of a sweep shrinks the table */
+  results[3] = 0;
+  results[4] = true;
+  for(i = 0; i < 198; i++) {
+    dead[i]    = ~(size_t)objects[i];
+    objects[i] = NULL;
+    if(i % 22 == 21) {
+      collector_base_spec_scrub_stack();
+      collector_collect(gc);
+      collector_stats(gc, &stats);
+      if(stats.rehashes > rehashes) {
+        rehashes = stats.rehashes;
+        results[3]++;
+        results[4] =
+          results[4] &&
+          collector_base_spec_table_holds(gc, objects, 200, dead, i + 1);
+      }
+    }
+  }
+  results[5] = stats.gc_size == COLLECTOR_MINIMUM_TABLE_SIZE &&
+               collector_base_spec_table_holds(gc, objects, 200, dead, 198);
+}
+
+/* Allocates a pinned object only a weak reference knows of */
+static size_t collector_base_spec_hide_root(
+  EmeraldsCollector *gc, EmeraldsCollectorWeak **weak
+) {
+  struct collector_base_spec_node *node =
+    collector_malloc_root(gc, sizeof(*node));
+
+  node->next  = NULL;
+  node->child = NULL;
+  node->value = 7;
+  *weak       = collector_weak_new(gc, node);
+  return ~(size_t)node;
+}
+
+/* Stores a hidden object into a root from a frame of its own */
+static void collector_base_spec_store_to(
+  struct collector_base_spec_node *volatile *root, size_t hidden
+) {
+  *root = (struct collector_base_spec_node *)~hidden;
+}
+
+static void collector_base_spec_store(
+  struct collector_base_spec_node *volatile *root, size_t hidden
+) {
+  void (*volatile store)(struct collector_base_spec_node *volatile *, size_t) =
+    collector_base_spec_store_to;
+  store(root, hidden);
+}
+
+/* Pins or unpins a hidden object from a frame of its own */
+static bool collector_base_spec_pin_to(
+  EmeraldsCollector *gc, size_t hidden, bool pinned
+) {
+  if(!pinned) {
+    collector_unpin(gc, (void *)~hidden);
+    return true;
+  }
+  return collector_pin(gc, (void *)~hidden);
+}
+
+static bool
+collector_base_spec_pin(EmeraldsCollector *gc, size_t hidden, bool pinned) {
+  bool (*volatile pin)(EmeraldsCollector *, size_t, bool) =
+    collector_base_spec_pin_to;
+  return pin(gc, hidden, pinned);
+}
+
+/* Checks a hidden object is still there, from a frame below the caller's */
+static bool
+collector_base_spec_alive(EmeraldsCollector *gc, EmeraldsCollectorWeak *weak) {
+  struct collector_base_spec_node *node = collector_weak_get(gc, weak);
+
+  return node != NULL && node->value == 7;
+}
+
+/* Keeps objects alive only through a global, a root range, a pinned
+    allocation and a pin, then drops every root */
+static void collector_base_spec_rooted(EmeraldsCollector *gc, size_t *results) {
+  size_t (*volatile hide_root)(EmeraldsCollector *, EmeraldsCollectorWeak **) =
+    collector_base_spec_hide_root;
+  bool (*volatile alive)(EmeraldsCollector *, EmeraldsCollectorWeak *) =
+    collector_base_spec_alive;
+  struct collector_base_spec_node *volatile *range;
+  EmeraldsCollectorWeak *weak[4];
+  size_t hidden[4];
+  size_t size = sizeof(struct collector_base_spec_node);
+  size_t i;
+
+  range     = malloc(sizeof(*range));
+  range[0]  = NULL;
+  hidden[0] = collector_base_spec_hidden(gc, size, &weak[0]);
+  collector_base_spec_store(&collector_base_spec_root, hidden[0]);
+  hidden[1] = collector_base_spec_hidden(gc, size, &weak[1]);
+  collector_base_spec_store(range, hidden[1]);
+  results[0] = collector_add_root_range(gc, (void *)range, sizeof(*range));
+  hidden[2]  = hide_root(gc, &weak[2]);
+  hidden[3]  = collector_base_spec_hidden(gc, size, &weak[3]);
+  results[0] = results[0] && collector_base_spec_pin(gc, hidden[3], true);
+
+  collector_base_spec_scrub_stack();
+  collector_collect(gc);
+  collector_collect(gc);
+  results[1] = true;
+  for(i = 0; i < 4; i++) {
+    results[1] = results[1] && alive(gc, weak[i]);
+  }
+
+  /* The range still points at its object, it is no longer scanned */
+  collector_base_spec_root = NULL;
+  results[2] = collector_remove_root_range(gc, (void *)range) &&
+               !collector_remove_root_range(gc, (void *)range);
+  collector_base_spec_pin(gc, hidden[2], false);
+  collector_base_spec_pin(gc, hidden[3], false);
+  collector_base_spec_scrub_stack();
+  collector_collect(gc);
+  results[3] = true;
+  for(i = 0; i < 4; i++) {
+    results[3] = results[3] && collector_weak_get(gc, weak[i]) == NULL;
+    collector_weak_free(gc, weak[i]);
+  }
+  free((void *)range);
+}
+
+/* Hides objects in the pointer words and the other words of typed
+    arrays, and in atomic blocks of every size */
+static void
+collector_base_spec_precise(EmeraldsCollector *gc, size_t *results) {
+  bool (*volatile alive)(EmeraldsCollector *, EmeraldsCollectorWeak *) =
+    collector_base_spec_alive;
+  struct EmeraldsCollectorLayout layout;
+  struct collector_base_spec_node *volatile typed[2];
+  struct collector_base_spec_node *volatile atomic[3];
+  struct collector_base_spec_node *last;
+  EmeraldsCollectorWeak *weak[7];
+  size_t size   = sizeof(struct collector_base_spec_node);
+  size_t length = COLLECTOR_LARGE_THRESHOLD / size + 1;
+  size_t sizes[3];
+  size_t i;
+
+  collector_layout_new(&layout, size);
+  collector_layout_set_pointer(
+    &layout, offsetof(struct collector_base_spec_node, next)
+  );
+  typed[0] = collector_malloc_typed(gc, 2 * size, &layout);
+  typed[1] = collector_malloc_typed(gc, length * size, &layout);
+  for(i = 0; i < 2; i++) {
+    last = &typed[i][i == 0 ? 1 : length - 1];
+    collector_base_spec_store(
+      &last->next, collector_base_spec_hidden(gc, size, &weak[2 * i])
+    );
+    collector_base_spec_store(
+      &last->child, collector_base_spec_hidden(gc, size, &weak[2 * i + 1])
+    );
+  }
+
+  sizes[0] = size;
+  sizes[1] = 4000;
+  sizes[2] = COLLECTOR_LARGE_THRESHOLD;
+  for(i = 0; i < 3; i++) {
+    atomic[i] = collector_malloc_atomic(gc, sizes[i]);
+    collector_base_spec_store(
+      &atomic[i]->next, collector_base_spec_hidden(gc, size, &weak[4 + i])
+    );
+  }
+  last = NULL;
+  collector_base_spec_scrub_stack();
+  collector_collect(gc);
+
+  results[0] = alive(gc, weak[0]) && alive(gc, weak[2]);
+  results[1] = collector_weak_get(gc, weak[1]) == NULL &&
+               collector_weak_get(gc, weak[3]) == NULL;
+  results[2] = true;
+  for(i = 4; i < 7; i++) {
+    results[2] = results[2] && collector_weak_get(gc, weak[i]) == NULL;
+  }
+  for(i = 0; i < 7; i++) {
+    collector_weak_free(gc, weak[i]);
+  }
+  collector_layout_terminate(&layout);
+}
+
+/* Checks the first bytes of a block count up and the rest are zero */
+static bool collector_base_spec_filled(
+  const unsigned char *block, size_t filled, size_t size
+) {
+  size_t i;
+
+  for(i = 0; i < size; i++) {
+    if(block[i] != (i < filled ? (unsigned char)i : 0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Shrinks a large object and grows it back, the mapping extends into
+    the pages the shrink gave up without moving. The regrown tail reads
+    as zero again */
+static void
+collector_base_spec_remapped(EmeraldsCollector *gc, size_t *results) {
+  struct EmeraldsCollectorStats stats;
+  size_t size = COLLECTOR_LARGE_THRESHOLD;
+  unsigned char *volatile object;
+  size_t i;
+
+  object = collector_malloc(gc, 3 * size);
+  for(i = 0; i < 3 * size; i++) {
+    object[i] = (unsigned char)i;
+  }
+  results[0] = collector_realloc(gc, object, size) == object;
+  results[1] = collector_realloc(gc, object, 3 * size) == object &&
+               collector_base_spec_filled(object, size, 3 * size);
+  collector_collect(gc);
+  collector_stats(gc, &stats);
+  results[2] = stats.number_of_large_objects == 1 &&
+               collector_base_spec_filled(object, size, 3 * size);
+}
+
+/* Grows a typed element of the table past the large threshold, it keeps
+    its contents and its layout */
+static void
+collector_base_spec_outgrown(EmeraldsCollector *gc, size_t *results) {
+  bool (*volatile alive)(EmeraldsCollector *, EmeraldsCollectorWeak *) =
+    collector_base_spec_alive;
+  struct EmeraldsCollectorLayout layout;
+  struct EmeraldsCollectorStats before;
+  struct EmeraldsCollectorStats after;
+  struct collector_base_spec_node *volatile element;
+  EmeraldsCollectorWeak *weak[2];
+  size_t size   = sizeof(struct collector_base_spec_node);
+  size_t length = 4000 / size;
+  size_t i;
+
+  collector_layout_new(&layout, size);
+  collector_layout_set_pointer(
+    &layout, offsetof(struct collector_base_spec_node, next)
+  );
+  element = collector_malloc_typed(gc, length * size, &layout);
+  for(i = 0; i < length; i++) {
+    element[i].next  = NULL;
+    element[i].child = NULL;
+    element[i].value = i;
+  }
+  collector_base_spec_store(
+    &element[0].next, collector_base_spec_hidden(gc, size, &weak[0])
+  );
+  collector_base_spec_store(
+    &element[0].child, collector_base_spec_hidden(gc, size, &weak[1])
+  );
+
+  collector_stats(gc, &before);
+  element = collector_realloc(gc, element, COLLECTOR_LARGE_THRESHOLD + 4000);
+  collector_stats(gc, &after);
+  results[0] = after.number_of_garbage + 1 == before.number_of_garbage &&
+               after.number_of_large_objects ==
+                 before.number_of_large_objects + 1;
+
+  collector_base_spec_scrub_stack();
+  collector_collect(gc);
+  results[1] = true;
+  for(i = 0; i < length; i++) {
+    results[1] = results[1] && element[i].value == i;
+  }
+  results[2] = alive(gc, weak[0]) && collector_weak_get(gc, weak[1]) == NULL;
+  collector_weak_free(gc, weak[0]);
+  collector_weak_free(gc, weak[1]);
+  collector_layout_terminate(&layout);
+}
+
+/* Stores an object into a large one already marked in the current cycle
+    and moves it with a resize. The move forgets the chunks queued at the
+    old address, the object is traced again where it went */
+static void
+collector_base_spec_regrown(EmeraldsCollector *gc, size_t *results) {
+  bool (*volatile alive)(EmeraldsCollector *, EmeraldsCollectorWeak *) =
+    collector_base_spec_alive;
+  struct EmeraldsCollectorPolicy policy = {0, 0, 0, 0};
+  struct collector_base_spec_node *volatile object;
+  struct collector_base_spec_node *above;
+  struct collector_base_spec_node *head;
+  struct collector_base_spec_node *moved;
+  EmeraldsCollectorWeak *weak;
+  size_t size = COLLECTOR_LARGE_THRESHOLD;
+  size_t hidden;
+
+  collector_set_incremental(gc, true);
+  head   = collector_base_spec_list(gc, 4000);
+  above  = collector_calloc(gc, 1, size);
+  object = collector_calloc(gc, 1, size);
+  collector_collect(gc);
+  hidden = collector_base_spec_hidden(
+    gc, sizeof(struct collector_base_spec_node), &weak
+  );
+
+  /* A block outside the pages outgrows the trigger. The first slice
+      scans the stack, the list is left for later ones */
+  collector_set_policy(gc, &policy);
+  head = collector_base_spec_push(gc, head, 4000);
+  collector_base_spec_scrub_stack();
+  collector_step(gc, 0);
+  results[0] = gc->marking;
+
+  /* The object mapped before sits above it, there is no room to grow */
+  collector_base_spec_store(&object->child, hidden);
+  moved      = collector_realloc(gc, object, 4 * size);
+  results[1] = moved != object && above != NULL;
+  object     = moved;
+  moved      = NULL;
+  while(!collector_step(gc, 0)) {
+  }
+  results[2] = alive(gc, weak) && collector_weak_get(gc, weak) == object->child;
+  results[3] = collector_base_spec_intact(head, 4001);
+  collector_weak_free(gc, weak);
+}
+
+/* Builds a typed list where three of every four nodes die right away, so
+    its pages come out sparse. The child of a node is the one two before
+    it, the addresses are kept inverted and pin nothing */
+static struct collector_base_spec_node *collector_base_spec_graph(
+  EmeraldsCollector *gc,
+  const struct EmeraldsCollectorLayout *layout,
+  size_t *addresses,
+  size_t length
+) {
+  struct collector_base_spec_node *head = NULL;
+  size_t i;
+
+  for(i = 0; i < 4 * length; i++) {
+    struct collector_base_spec_node *node =
+      collector_malloc_typed(gc, sizeof(*node), layout);
+
+    if(i % 4 != 0) {
+      continue;
+    }
+    node->next       = head;
+    node->child      = head == NULL ? NULL : head->next;
+    node->value      = i / 4;
+    addresses[i / 4] = ~(size_t)node;
+    head             = node;
+  }
+  return head;
+}
+
+/* Counts the nodes no longer at their old address, once the values and
+    the children checked out */
+static size_t collector_base_spec_moved(
+  struct collector_base_spec_node *head, size_t *addresses, size_t length
+) {
+  size_t moved = 0;
+
+  if(!collector_base_spec_intact(head, length)) {
+    return 0;
+  }
+  for(; head != NULL; head = head->next) {
+    if(head->child != (head->next == NULL ? NULL : head->next->next)) {
+      return 0;
+    }
+    moved += (size_t)head != ~addresses[head->value];
+  }
+  return moved;
+}
+
+static void collector_base_spec_finalize(void *object, void *data) {
+  *(size_t *)data = ~(size_t)object;
+}
+
+/* Allocates an object only a weak reference and a finalizer know of */
+static size_t collector_base_spec_watch(
+  EmeraldsCollector *gc, EmeraldsCollectorWeak **weak, size_t *finalized
+) {
+  size_t hidden = collector_base_spec_hide(
+    gc, sizeof(struct collector_base_spec_node), weak
+  );
+
+  collector_register_finalizer(
+    gc, (void *)~hidden, collector_base_spec_finalize, finalized
+  );
+  return hidden;
+}
+
+/* Checks the weak reference and the child of `object` agree on where the
+    watched object moved, from a frame below the caller's */
+static bool collector_base_spec_followed(
+  EmeraldsCollector *gc,
+  EmeraldsCollectorWeak *weak,
+  struct collector_base_spec_node *object,
+  size_t hidden
+) {
+  return collector_weak_get(gc, weak) == object->child &&
+         (size_t)object->child != ~hidden && object->child->value == 7;
+}
+
+/* Compacts a typed graph hanging off an anchor. Nodes the stack, a
+    conservative holder and a root range point at share the first page
+    of the graph. The holder gets a size class of its own, a stale word
+    pinning it would keep the watched object in place as well */
+static void
+collector_base_spec_compacted(EmeraldsCollector *gc, size_t *results) {
+  struct EmeraldsCollectorLayout layout;
+  struct collector_base_spec_node *(*volatile graph)(
+    EmeraldsCollector *,
+    const struct EmeraldsCollectorLayout *,
+    size_t *,
+    size_t
+  ) = collector_base_spec_graph;
+  size_t (*volatile watch)(
+    EmeraldsCollector *, EmeraldsCollectorWeak **, size_t *
+  ) = collector_base_spec_watch;
+  bool (*volatile followed)(
+    EmeraldsCollector *,
+    EmeraldsCollectorWeak *,
+    struct collector_base_spec_node *,
+    size_t
+  ) = collector_base_spec_followed;
+  struct collector_base_spec_node *volatile on_stack;
+  struct collector_base_spec_node *anchor;
+  struct collector_base_spec_node *holder;
+  struct collector_base_spec_node **range;
+  EmeraldsCollectorWeak *weak;
+  size_t addresses[2000];
+  size_t ambiguous[3];
+  size_t finalized = 0;
+  size_t hidden;
+  size_t i;
+
+  collector_layout_new(&layout, sizeof(struct collector_base_spec_node));
+  collector_layout_set_pointer(
+    &layout, offsetof(struct collector_base_spec_node, next)
+  );
+  collector_layout_set_pointer(
+    &layout, offsetof(struct collector_base_spec_node, child)
+  );
+  range         = malloc(sizeof(*range));
+  on_stack      = collector_malloc_typed(gc, sizeof(*anchor), &layout);
+  holder        = collector_malloc(gc, 2 * sizeof(*holder));
+  holder->next  = collector_malloc_typed(gc, sizeof(*anchor), &layout);
+  range[0]      = collector_malloc_typed(gc, sizeof(*anchor), &layout);
+  ambiguous[0]  = ~(size_t)on_stack;
+  ambiguous[1]  = ~(size_t)holder->next;
+  ambiguous[2]  = ~(size_t)range[0];
+  on_stack->value     = 1;
+  holder->next->value = 2;
+  range[0]->value     = 3;
+  collector_add_root_range(gc, range, sizeof(*range));
+
+  anchor        = collector_malloc_typed(gc, 2 * sizeof(*anchor), &layout);
+  anchor->next  = graph(gc, &layout, addresses, 2000);
+  anchor->child = holder;
+  hidden        = watch(gc, &weak, &finalized);
+  collector_base_spec_link(&anchor[1], hidden);
+  holder = NULL;
+  collector_base_spec_scrub_stack();
+
+  results[0] = collector_compact(gc);
+  results[1] = collector_base_spec_moved(anchor->next, addresses, 2000);
+  results[2] = (size_t)on_stack == ~ambiguous[0] && on_stack->value == 1 &&
+               (size_t)anchor->child->next == ~ambiguous[1] &&
+               anchor->child->next->value == 2 &&
+               (size_t)range[0] == ~ambiguous[2] && range[0]->value == 3;
+  results[3] = followed(gc, weak, &anchor[1], hidden);
+
+  /* Wrongly freed slots are handed out again and rewritten */
+  for(i = 0; i < 4000; i++) {
+    collector_malloc_typed(gc, sizeof(*anchor), &layout);
+  }
+  results[4] = collector_base_spec_moved(anchor->next, addresses, 2000) ==
+               results[1];
+
+  /* The finalizer is handed the address the object moved to */
+  hidden = collector_base_spec_unlink(&anchor[1]);
+  collector_base_spec_scrub_stack();
+  collector_collect(gc);
+  results[5] = finalized == hidden && collector_weak_get(gc, weak) == NULL;
+
+  collector_weak_free(gc, weak);
+  collector_remove_root_range(gc, range);
+  free(range);
+  collector_layout_terminate(&layout);
+}
+
+/* Registers with the collector and waits, only to be stopped by it */
+static void *collector_base_spec_parked(void *collector) {
+  volatile int base = 0;
+
+  collector_register_thread(collector, (void *)&base);
+  __atomic_store_n(&collector_base_spec_state, 1, __ATOMIC_SEQ_CST);
+  while(__atomic_load_n(&collector_base_spec_state, __ATOMIC_SEQ_CST) != 2) {
+    base++;
+  }
+  collector_unregister_thread(collector);
+  return NULL;
+}
+
+/* Counts the calls, and checks no thread is stopped during any of them */
+static void collector_base_spec_notified(size_t number_of_ready, void *data) {
+  size_t *notified = data;
+
+  notified[0]++;
+  notified[1] = number_of_ready;
+  notified[2] = notified[2] &&
+                !__atomic_load_n(
+                  &collector_base_spec_gc.threads.stopped, __ATOMIC_SEQ_CST
+                );
+}
+
+/* Finalizes an object on a collection, then queues another one for a
+    callback while a second thread is registered, and runs it by hand */
+static void
+collector_base_spec_finalized(EmeraldsCollector *gc, size_t *results) {
+  size_t (*volatile watch)(
+    EmeraldsCollector *, EmeraldsCollectorWeak **, size_t *
+  ) = collector_base_spec_watch;
+  EmeraldsCollectorWeak *weak;
+  size_t notified[3] = {0, 0, true};
+  size_t finalized   = 0;
+  size_t hidden;
+  pthread_t parked;
+
+  hidden = watch(gc, &weak, &finalized);
+  collector_base_spec_scrub_stack();
+  collector_collect(gc);
+  results[0] = finalized == hidden && collector_weak_get(gc, weak) == NULL;
+  collector_weak_free(gc, weak);
+
+  __atomic_store_n(&collector_base_spec_state, 0, __ATOMIC_SEQ_CST);
+  pthread_create(&parked, NULL, collector_base_spec_parked, gc);
+  while(__atomic_load_n(&collector_base_spec_state, __ATOMIC_SEQ_CST) != 1) {
+  }
+  collector_set_finalizer_callback(gc, collector_base_spec_notified, notified);
+  finalized = 0;
+  hidden    = watch(gc, &weak, &finalized);
+  collector_base_spec_scrub_stack();
+  collector_collect(gc);
+  results[1] = notified[0] == 1 && notified[1] == 1 && notified[2];
+  results[2] = finalized == 0;
+  results[3] = collector_run_finalizers(gc) == 1 && finalized == hidden;
+  results[4] = collector_run_finalizers(gc) == 0;
+
+  __atomic_store_n(&collector_base_spec_state, 2, __ATOMIC_SEQ_CST);
+  pthread_join(parked, NULL);
+  collector_weak_free(gc, weak);
+}
+
+/* What a spec hands a second thread and what the thread found */
+struct collector_base_spec_worker {
+  EmeraldsCollector *gc;
+  size_t length;
+  size_t broken_lists;
+};
+
+/* Builds a list only its own stack and registers refer to, parks until
+    the other thread collected and checks the list */
+static void *collector_base_spec_holding(void *data) {
+  struct collector_base_spec_worker *worker = data;
+  struct collector_base_spec_node *head;
+  volatile int base = 0;
+
+  collector_register_thread(worker->gc, (void *)&base);
+  head = collector_base_spec_list(worker->gc, worker->length);
+  __atomic_store_n(&collector_base_spec_state, 1, __ATOMIC_SEQ_CST);
+  while(__atomic_load_n(&collector_base_spec_state, __ATOMIC_SEQ_CST) != 2) {
+    base++;
+  }
+  worker->broken_lists = !collector_base_spec_intact(head, worker->length);
+  collector_unregister_thread(worker->gc);
+  return NULL;
+}
+
+/* Collects while a second thread holds the only references to a list */
+static void collector_base_spec_held(EmeraldsCollector *gc, size_t *results) {
+  struct collector_base_spec_worker worker;
+  pthread_t holding;
+  size_t i;
+
+  worker.gc     = gc;
+  worker.length = 2000;
+  __atomic_store_n(&collector_base_spec_state, 0, __ATOMIC_SEQ_CST);
+  pthread_create(&holding, NULL, collector_base_spec_holding, &worker);
+  while(__atomic_load_n(&collector_base_spec_state, __ATOMIC_SEQ_CST) != 1) {
+  }
+
+  /* Wrongly freed slots are handed out again and rewritten */
+  for(i = 0; i < 3; i++) {
+    collector_collect(gc);
+    collector_base_spec_list(gc, 2 * worker.length);
+  }
+  results[0] = gc->threads.number_of_threads == 2;
+
+  __atomic_store_n(&collector_base_spec_state, 2, __ATOMIC_SEQ_CST);
+  pthread_join(holding, NULL);
+  results[1] = worker.broken_lists == 0;
+}
+
+/* Builds lists from the bins of its own buffer until told to stop */
+static void *collector_base_spec_allocating(void *data) {
+  struct collector_base_spec_worker *worker = data;
+  volatile int base                         = 0;
+  size_t round;
+
+  collector_register_thread(worker->gc, (void *)&base);
+  for(round = 0; round < 100; round++) {
+    struct collector_base_spec_node *head =
+      collector_base_spec_list(worker->gc, worker->length);
+
+    if(!collector_base_spec_intact(head, worker->length)) {
+      worker->broken_lists++;
+    }
+  }
+  collector_unregister_thread(worker->gc);
+  __atomic_store_n(&collector_base_spec_state, 2, __ATOMIC_SEQ_CST);
+  return NULL;
+}
+
+/* Collects over and over while a second thread pops slots from its bins.
+    Every collection flushes the bins, a thread stopped in the middle of a
+    pop has to retry instead of taking a slot handed back to the heap */
+static void
+collector_base_spec_popped(EmeraldsCollector *gc, size_t *results) {
+  struct collector_base_spec_worker worker;
+  struct EmeraldsCollectorStats before;
+  struct EmeraldsCollectorStats after;
+  pthread_t allocating;
+
+  worker.gc           = gc;
+  worker.length       = 500;
+  worker.broken_lists = 0;
+  __atomic_store_n(&collector_base_spec_state, 0, __ATOMIC_SEQ_CST);
+  collector_stats(gc, &before);
+  pthread_create(&allocating, NULL, collector_base_spec_allocating, &worker);
+  while(__atomic_load_n(&collector_base_spec_state, __ATOMIC_SEQ_CST) != 2) {
+    collector_base_spec_list(gc, 50);
+    collector_collect(gc);
+  }
+  pthread_join(allocating, NULL);
+  collector_stats(gc, &after);
+  results[0] = worker.broken_lists == 0;
+  results[1] = after.collections - before.collections;
+}
+
+module(T_collector_base, {
+  describe("incremental marking", {
+    it("keeps every node of lists built while marking", {
+      size_t broken_lists;
+
+      collector_base_spec_run(collector_base_spec_lists, &broken_lists);
+      assert_that(broken_lists == 0);
+    });
+
+    it("keeps every node of lists built while a background thread marks", {
+      size_t results[3];
+
+      collector_base_spec_run(collector_base_spec_concurrent, results);
+      assert_that(results[0]);
+      assert_that(results[1] == 0);
+      assert_that(results[2]);
+    });
+
+    it("spreads a mark phase over slices of collector_step", {
+      size_t results[3];
+
+      collector_base_spec_run(collector_base_spec_slices, results);
+      assert_that(results[0] > 4000 / COLLECTOR_MARK_OBJECTS_PER_STEP / 2);
+      assert_that(results[1]);
+      assert_that(results[2]);
+    });
+
+    it("stays within the budget of collector_step", {
+      size_t results[3];
+
+      collector_base_spec_run(collector_base_spec_budget, results);
+      assert_that(results[0] > 1);
+      assert_that(results[1] < 10 * 2000000);
+      assert_that(results[2]);
+    });
+
+    it("scans marked objects again once a store is remembered", {
+      size_t results[2];
+
+      collector_base_spec_run(collector_base_spec_barrier, results);
+      assert_that(results[0]);
+      assert_that(results[1]);
+    });
+  });
+
+  describe("table of saved elements", {
+    it("sweeps in slices between which new objects are saved", {
+      size_t results[5];
+
+      collector_base_spec_run(collector_base_spec_lazy_sweep, results);
+      assert_that(results[0]);
+      assert_that(results[1] >= 2);
+      assert_that(results[2]);
+      assert_that(results[3]);
+      assert_that(results[4]);
+    })
+    it("grows and shrinks without losing saved objects", {
+      size_t results[6];
+
+      collector_base_spec_run(collector_base_spec_resized, results);
+      assert_that(results[0] >= 5);
+      assert_that(results[1]);
+      assert_that(results[2]);
+      assert_that(results[3] >= 3);
+      assert_that(results[4]);
+      assert_that(results[5]);
+    });
+
+    it("sweeps clusters that wrap past the end of the table", {
+      size_t results[3];
+
+      collector_base_spec_run(collector_base_spec_wrap, results);
+      assert_that(results[0]);
+      assert_that(results[1]);
+      assert_that(results[2]);
+    });
+  });
+
+  describe("collection policy", {
+    it("collects once the heap outgrows the growth or the minimum", {
+      size_t results[5];
+
+      collector_base_spec_run(collector_base_spec_paced, results);
+      assert_that(results[0]);
+      assert_that(results[1]);
+      assert_that(results[2]);
+      assert_that(results[3]);
+      assert_that(results[4]);
+    });
+
+    it("collects and then fails allocations past the memory limit", {
+      size_t results[4];
+
+      collector_base_spec_run(collector_base_spec_limited, results);
+      assert_that(results[0]);
+      assert_that(results[1]);
+      assert_that(results[2]);
+      assert_that(results[3]);
+    });
+  });
+
+  describe("batch allocations", {
+    it("keeps and frees batches of small, medium and large objects", {
+      size_t results[4];
+
+      collector_base_spec_run(collector_base_spec_batches, results);
+      assert_that(results[0]);
+      assert_that(results[1]);
+      assert_that(results[2]);
+      assert_that(results[3]);
+    });
+
+    it("allocates the part of a batch that fits under the limit", {
+      size_t results[4];
+
+      collector_base_spec_run(collector_base_spec_partial, results);
+      assert_that(results[0] < 32);
+      assert_that(results[1]);
+      assert_that(results[2]);
+      assert_that(results[3]);
+    });
+  });
+
+  describe("roots", {
+    it("keeps objects only a global, a range or a pin refers to", {
+      size_t results[4];
+
+      collector_base_spec_run(collector_base_spec_rooted, results);
+      assert_that(results[0]);
+      assert_that(results[1]);
+      assert_that(results[2]);
+      assert_that(results[3]);
+    });
+  });
+
+  describe("precise scanning", {
+    it("traces only the pointer words of typed and no atomic objects", {
+      size_t results[3];
+
+      collector_base_spec_run(collector_base_spec_precise, results);
+      assert_that(results[0]);
+      assert_that(results[1]);
+      assert_that(results[2]);
+    });
+  });
+
+  describe("reallocation", {
+    it("grows a large object in place into a freed mapping", {
+      size_t results[3];
+
+      collector_base_spec_run(collector_base_spec_remapped, results);
+      assert_that(results[0]);
+      assert_that(results[1]);
+      assert_that(results[2]);
+    });
+
+    it("moves an element of the table past the large threshold", {
+      size_t results[3];
+
+      collector_base_spec_run(collector_base_spec_outgrown, results);
+      assert_that(results[0]);
+      assert_that(results[1]);
+      assert_that(results[2]);
+    });
+
+    it("traces a large object again once a resize moved it while marking", {
+      size_t results[4];
+
+      collector_base_spec_run(collector_base_spec_regrown, results);
+      assert_that(results[0]);
+      assert_that(results[1]);
+      assert_that(results[2]);
+      assert_that(results[3]);
+    });
+  });
+
+  describe("compaction", {
+    it("moves a typed graph and keeps ambiguously referenced nodes", {
+      size_t results[6];
+
+      collector_base_spec_run(collector_base_spec_compacted, results);
+      assert_that(results[0] > 0);
+      assert_that(results[1] > 2000 / 2);
+      assert_that(results[2]);
+      assert_that(results[3]);
+      assert_that(results[4]);
+      assert_that(results[5]);
+    });
+  });
+
+  describe("finalization", {
+    it("runs finalizers on collections or hands them to a callback", {
+      size_t results[5];
+
+      collector_base_spec_run(collector_base_spec_finalized, results);
+      assert_that(results[0]);
+      assert_that(results[1]);
+      assert_that(results[2]);
+      assert_that(results[3]);
+      assert_that(results[4]);
+    });
+  });
+
+  describe("threads", {
+    it("keeps objects only a stopped thread refers to", {
+      size_t results[2];
+
+      collector_base_spec_run(collector_base_spec_held, results);
+      assert_that(results[0]);
+      assert_that(results[1]);
+    });
+
+    it("pops slots from the bins of a thread while others collect", {
+      size_t results[2];
+
+      collector_base_spec_run(collector_base_spec_popped, results);
+      assert_that(results[0]);
+      assert_that(results[1] > 1);
+    });
+  });
+
+  describe("generational collection", {
+    it("keeps young objects stored into old ones through the barrier", {
+      size_t results[3];
+
+      collector_base_spec_run(collector_base_spec_remembered, results);
+      assert_that(results[0]);
+      assert_that(results[1]);
+      assert_that(results[2]);
+    });
+
+    it("misses young objects stored behind the barrier's back", {
+      size_t results[2];
+
+      collector_base_spec_run(collector_base_spec_forgotten, results);
+      assert_that(results[0]);
+      assert_that(results[1]);
+    });
+  });
+})
@@ -0,0 +1,128 @@
+#include "../../libs/cSpec/export/cSpec.h"
+#include "../../src/collector_finalizers/collector_finalizers.h"
+
+static void *collector_finalizers_spec_dead;
+
+static void *collector_finalizers_spec_locate(void *ptr, void *data) {
+  if(ptr == collector_finalizers_spec_dead) {
+    return NULL;
+  }
+  return ptr == data ? (char *)data + 1 : ptr;
+}
+
+static void collector_finalizers_spec_finalizer(void *object, void *data) {
+  (void)object;
+  (void)data;
+}
+
+module(T_collector_finalizers, {
+  describe("finalizers and weak references", {
+    it("clears every weak reference to a dead object", {
+      struct EmeraldsCollectorFinalizers finalizers;
+      EmeraldsCollectorWeak *first;
+      EmeraldsCollectorWeak *second;
+      EmeraldsCollectorWeak *other;
+      char objects[2];
+
+      collector_finalizers_new(&finalizers);
+      first  = collector_finalizers_weak_new(&finalizers, &objects[0]);
+      second = collector_finalizers_weak_new(&finalizers, &objects[0]);
+      other  = collector_finalizers_weak_new(&finalizers, &objects[1]);
+      assert_that(finalizers.number_of_entries == 2);
+
+      collector_finalizers_spec_dead = &objects[0];
+      assert_that(
+        collector_finalizers_relocate(
+          &finalizers, collector_finalizers_spec_locate, NULL
+        ) == 0
+      );
+      assert_that(first->target == NULL);
+      assert_that(second->target == NULL);
+      assert_that(other->target == &objects[1]);
+      assert_that(finalizers.number_of_entries == 1);
+
+      collector_finalizers_weak_free(&finalizers, first);
+      collector_finalizers_weak_free(&finalizers, other);
+      assert_that(finalizers.number_of_entries == 0);
+      collector_finalizers_terminate(&finalizers);
+      assert_that(second->target == NULL);
+      collector_finalizers_weak_free(&finalizers, second);
+    });
+
+    it("queues the finalizers of dead objects in order", {
+      struct EmeraldsCollectorFinalizers finalizers;
+      struct EmeraldsCollectorFinalizable ready;
+      char objects[100];
+      bool registered = true;
+      size_t i;
+
+      collector_finalizers_new(&finalizers);
+      for(i = 0; i < 100; i++) {
+        if(!collector_finalizers_register(
+             &finalizers,
+             &objects[i],
+             collector_finalizers_spec_finalizer,
+             &objects[i]
+           )) {
+          registered = false;
+        }
+      }
+      assert_that(registered);
+      collector_finalizers_spec_dead = &objects[10];
+      assert_that(
+        collector_finalizers_relocate(
+          &finalizers, collector_finalizers_spec_locate, NULL
+        ) == 1
+      );
+      collector_finalizers_spec_dead = &objects[20];
+      assert_that(
+        collector_finalizers_relocate(
+          &finalizers, collector_finalizers_spec_locate, NULL
+        ) == 1
+      );
+      assert_that(finalizers.number_of_entries == 98);
+      assert_that(finalizers.number_of_ready == 2);
+
+      assert_that(collector_finalizers_pop(&finalizers, &ready));
+      assert_that(ready.ptr == &objects[10] && ready.data == &objects[10]);
+      assert_that(collector_finalizers_pop(&finalizers, &ready));
+      assert_that(ready.ptr == &objects[20]);
+      assert_that(!collector_finalizers_pop(&finalizers, &ready));
+
+      /* Dropping a finalizer stops watching the object */
+      collector_finalizers_register(&finalizers, &objects[30], NULL, NULL);
+      assert_that(finalizers.number_of_entries == 97);
+      collector_finalizers_terminate(&finalizers);
+    });
+
+    it("follows moved and freed objects", {
+      struct EmeraldsCollectorFinalizers finalizers;
+      struct EmeraldsCollectorFinalizable ready;
+      EmeraldsCollectorWeak *weak;
+      char objects[4];
+
+      collector_finalizers_new(&finalizers);
+      weak = collector_finalizers_weak_new(&finalizers, &objects[0]);
+      collector_finalizers_register(
+        &finalizers, &objects[0], collector_finalizers_spec_finalizer, NULL
+      );
+
+      collector_finalizers_move(&finalizers, &objects[0], &objects[2]);
+      assert_that(weak->target == &objects[2]);
+      collector_finalizers_spec_dead = NULL;
+      collector_finalizers_relocate(
+        &finalizers, collector_finalizers_spec_locate, &objects[2]
+      );
+      assert_that(weak->target == &objects[3]);
+      assert_that(finalizers.number_of_ready == 0);
+
+      /* Freed objects drop their finalizer without queueing it */
+      collector_finalizers_move(&finalizers, &objects[3], NULL);
+      assert_that(weak->target == NULL);
+      assert_that(finalizers.number_of_entries == 0);
+      assert_that(!collector_finalizers_pop(&finalizers, &ready));
+      collector_finalizers_weak_free(&finalizers, weak);
+      collector_finalizers_terminate(&finalizers);
+    });
+  });
+});
@@ -0,0 +1,270 @@
+#include "../../libs/cSpec/export/cSpec.h"
+#include "../../src/collector_heap/collector_heap.h"
+
+module(T_collector_heap, {
+  describe("size classed heap", {
+    it("hands out zeroed slots from the fitting size class", {
+      struct EmeraldsCollectorHeap heap;
+      struct EmeraldsCollectorPage *page;
+      char *ptr;
+
+      collector_heap_new(&heap);
+      ptr  = collector_heap_allocate(&heap, 20);
+      page = collector_heap_find_page(&heap, ptr);
+
+      assert_that(page != NULL);
+      assert_that(page->object_size == 32);
+      assert_that(ptr[0] == 0 && ptr[31] == 0);
+      assert_that(
+        collector_page_slot_of(&heap, page, ptr) != COLLECTOR_NO_SLOT
+      );
+      collector_heap_terminate(&heap);
+    });
+
+    it("resolves interior pointers only when enabled", {
+      struct EmeraldsCollectorHeap heap;
+      struct EmeraldsCollectorPage *page;
+      char *ptr;
+      size_t slot;
+
+      collector_heap_new(&heap);
+      ptr  = collector_heap_allocate(&heap, 64);
+      page = collector_heap_find_page(&heap, ptr);
+      slot = collector_page_slot_of(&heap, page, ptr);
+
+      assert_that(collector_page_slot_of(&heap, page, ptr + 63) == slot);
+      heap.interior_pointers = false;
+      assert_that(
+        collector_page_slot_of(&heap, page, ptr + 8) == COLLECTOR_NO_SLOT
+      );
+      assert_that(collector_page_slot_of(&heap, page, ptr) == slot);
+      collector_heap_terminate(&heap);
+    });
+
+    it("does not find pages for foreign pointers", {
+      struct EmeraldsCollectorHeap heap;
+      int local;
+
+      collector_heap_new(&heap);
+      collector_heap_allocate(&heap, 64);
+      assert_that(collector_heap_find_page(&heap, &local) == NULL);
+      assert_that(collector_heap_find_page(&heap, NULL) == NULL);
+      collector_heap_terminate(&heap);
+    });
+
+    it("sweeps unmarked slots and keeps marked ones", {
+      struct EmeraldsCollectorHeap heap;
+      struct EmeraldsCollectorPage *page;
+      void *kept;
+      size_t i;
+
+      collector_heap_new(&heap);
+      kept = collector_heap_allocate(&heap, 48);
+      for(i = 0; i < 1000; i++) {
+        collector_heap_allocate(&heap, 48);
+      }
+      page = collector_heap_find_page(&heap, kept);
+      collector_bitmap_set(
+        page->marked, collector_page_slot_of(&heap, page, kept)
+      );
+
+      assert_that(collector_heap_sweep(&heap) == 1000);
+      assert_that(heap.number_of_objects == 1);
+      assert_that(heap.number_of_bytes == 48);
+      assert_that(
+        collector_page_slot_of(&heap, page, kept) != COLLECTOR_NO_SLOT
+      );
+      assert_that(collector_heap_sweep(&heap) == 1);
+      assert_that(heap.free_pages == page);
+      collector_heap_terminate(&heap);
+    });
+
+    it("sweeps queued pages a step at a time", {
+      struct EmeraldsCollectorHeap heap;
+      size_t i;
+
+      collector_heap_new(&heap);
+      for(i = 0; i < 3000; i++) {
+        collector_heap_allocate(&heap, 48);
+      }
+      collector_heap_allocate(&heap, 512);
+      collector_heap_sweep_begin(&heap);
+      assert_that(heap.number_of_unswept == 4);
+      assert_that(heap.number_of_objects == 3001);
+
+      /* Allocating from a class sweeps one of its own pages first */
+      collector_heap_allocate(&heap, 512);
+      assert_that(heap.number_of_unswept == 3);
+      assert_that(heap.number_of_objects == 3001);
+
+      nassert_that(collector_heap_sweep_step(&heap, 1));
+      assert_that(heap.number_of_unswept == 2);
+      assert_that(collector_heap_sweep_step(&heap, 10));
+      assert_that(heap.number_of_objects == 1);
+      collector_heap_terminate(&heap);
+    });
+
+    it("promotes slots that survived enough collections", {
+      struct EmeraldsCollectorHeap heap;
+      struct EmeraldsCollectorPage *page;
+      void *survivor;
+      size_t slot;
+
+      collector_heap_new(&heap);
+      collector_heap_set_generational(&heap, true, 2);
+      survivor = collector_heap_allocate(&heap, 32);
+      collector_heap_allocate(&heap, 32);
+      page = collector_heap_find_page(&heap, survivor);
+      slot = collector_page_slot_of(&heap, page, survivor);
+
+      collector_bitmap_set(page->marked, slot);
+      assert_that(collector_heap_sweep(&heap) == 1);
+      nassert_that(collector_bitmap_test(page->old, slot));
+      nassert_that(collector_bitmap_test(page->marked, slot));
+
+      collector_bitmap_set(page->marked, slot);
+      collector_heap_sweep(&heap);
+      assert_that(collector_bitmap_test(page->old, slot));
+      assert_that(collector_bitmap_test(page->dirty, slot));
+
+      /* Old slots stay marked, so a minor sweep keeps them */
+      assert_that(collector_bitmap_test(page->marked, slot));
+      assert_that(collector_heap_sweep(&heap) == 0);
+      collector_heap_clear_marks(&heap);
+      assert_that(collector_heap_sweep(&heap) == 1);
+      collector_heap_terminate(&heap);
+    });
+
+    it("reuses slots released explicitly", {
+      struct EmeraldsCollectorHeap heap;
+      struct EmeraldsCollectorPage *page;
+      void *first;
+
+      collector_heap_new(&heap);
+      first = collector_heap_allocate(&heap, 100);
+      page  = collector_heap_find_page(&heap, first);
+      collector_heap_free(
+        &heap, page, collector_page_slot_of(&heap, page, first)
+      );
+
+      assert_that(heap.number_of_objects == 0);
+      assert_that(heap.number_of_bytes == 0);
+      assert_that(collector_heap_allocate(&heap, 100) == first);
+      collector_heap_terminate(&heap);
+    });
+
+    it("moves the slots of sparse pages and forwards pointers to them", {
+      struct EmeraldsCollectorHeap heap;
+      struct EmeraldsCollectorPage *dense;
+      struct EmeraldsCollectorPage *sparse;
+      void *kept[3];
+      void *moved;
+      size_t i;
+
+      collector_heap_new(&heap);
+      kept[0] = collector_heap_allocate(&heap, 48);
+      for(i = 0; i < 2000; i++) {
+        collector_heap_allocate(&heap, 48);
+      }
+      kept[1] = collector_heap_allocate(&heap, 48);
+      kept[2] = collector_heap_allocate(&heap, 48);
+      dense   = collector_heap_find_page(&heap, kept[0]);
+      sparse  = collector_heap_find_page(&heap, kept[1]);
+      assert_that(dense != sparse);
+
+      /* The first page stays full, only two slots survive in the second.
+          Evacuation runs before the sweep, the dead slots stay behind */
+      for(i = 0; i < dense->number_of_slots; i++) {
+        collector_bitmap_set(dense->marked, i);
+      }
+      for(i = 0; i < 3; i++) {
+        collector_bitmap_set(
+          collector_page_of(kept[i])->marked,
+          collector_page_slot_of(&heap, collector_page_of(kept[i]), kept[i])
+        );
+      }
+      ((size_t *)kept[1])[1] = 42;
+
+      assert_that(collector_heap_evacuate(&heap, 50) == 2);
+      moved = collector_heap_forward(&heap, kept[1]);
+      assert_that(moved != kept[1]);
+      assert_that(collector_heap_find_page(&heap, moved) != sparse);
+      assert_that(((size_t *)moved)[1] == 42);
+      assert_that(
+        collector_heap_forward(&heap, (char *)kept[1] + 8) == (char *)moved + 8
+      );
+      assert_that(collector_heap_forward(&heap, kept[0]) == kept[0]);
+
+      assert_that(collector_heap_release_evacuated(&heap) == 1);
+      assert_that(collector_heap_find_page(&heap, kept[1]) == NULL);
+      assert_that(heap.number_of_objects == dense->number_of_slots + 2);
+      collector_heap_terminate(&heap);
+    });
+
+    it("keeps pages with pinned slots in place", {
+      struct EmeraldsCollectorHeap heap;
+      struct EmeraldsCollectorPage *page;
+      void *pinned;
+
+      collector_heap_new(&heap);
+      pinned = collector_heap_allocate(&heap, 64);
+      page   = collector_heap_find_page(&heap, pinned);
+      collector_bitmap_set(
+        page->pinned, collector_page_slot_of(&heap, page, pinned)
+      );
+
+      assert_that(collector_heap_evacuate(&heap, 50) == 0);
+      assert_that(collector_heap_forward(&heap, pinned) == pinned);
+      assert_that(collector_heap_release_evacuated(&heap) == 0);
+      nassert_that(collector_bitmap_test(
+        page->pinned, collector_page_slot_of(&heap, page, pinned)
+      ));
+      collector_heap_terminate(&heap);
+    });
+
+    it("decommits the free pages past the retained ones", {
+      struct EmeraldsCollectorHeap heap;
+      size_t *slots[3];
+      size_t i;
+
+      collector_heap_new(&heap);
+      for(i = 0; i < 3; i++) {
+        slots[i] = collector_heap_allocate(&heap, (size_t)512 << i);
+        slots[i][0] = 42;
+      }
+      collector_heap_sweep(&heap);
+      assert_that(heap.number_of_free_pages == 3);
+
+      assert_that(collector_heap_scavenge(&heap, 1) == 2 * COLLECTOR_PAGE_SIZE);
+      assert_that(collector_heap_scavenge(&heap, 1) == 0);
+      nassert_that(heap.free_pages->decommitted);
+      assert_that(heap.free_pages->next->decommitted);
+
+      /* Decommitted pages are reused like any other empty page */
+      for(i = 0; i < 3; i++) {
+        slots[i] = collector_heap_allocate(&heap, (size_t)512 << i);
+        assert_that(slots[i][0] == 0);
+        nassert_that(collector_page_of(slots[i])->decommitted);
+      }
+      assert_that(heap.number_of_free_pages == 0);
+      collector_heap_terminate(&heap);
+    });
+
+    it("unmaps every free page", {
+      struct EmeraldsCollectorHeap heap;
+
+      collector_heap_new(&heap);
+      collector_heap_allocate(&heap, 16);
+      collector_heap_allocate(&heap, 2048);
+      collector_heap_sweep(&heap);
+
+      assert_that(
+        collector_heap_release_free_pages(&heap) == 2 * COLLECTOR_PAGE_SIZE
+      );
+      assert_that(heap.free_pages == NULL);
+      assert_that(heap.number_of_free_pages == 0);
+      assert_that(collector_heap_allocate(&heap, 16) != NULL);
+      collector_heap_terminate(&heap);
+    });
+  });
+})
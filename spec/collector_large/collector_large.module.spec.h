@@ -0,0 +1,76 @@
+#include "../../libs/cSpec/export/cSpec.h"
+#include "../../src/collector_large/collector_large.h"
+
+module(T_collector_large, {
+  describe("large object space", {
+    it("maps zeroed objects and finds them by address", {
+      struct EmeraldsCollectorLargeSpace large;
+      char *first;
+      char *second;
+
+      collector_large_new(&large);
+      first  = collector_large_allocate(&large, 1 << 20, NULL);
+      second = collector_large_allocate(&large, 3 << 20, NULL);
+      assert_that(first != NULL && second != NULL);
+      assert_that(first[0] == 0 && second[(3 << 20) - 1] == 0);
+      assert_that(large.number_of_objects == 2);
+      assert_that(
+        large.number_of_bytes == (1 << 20) + (3 << 20)
+      );
+      assert_that((size_t)large.objects[0].ptr < (size_t)large.objects[1].ptr);
+
+      assert_that(collector_large_find(&large, second, false)->ptr == second);
+      assert_that(collector_large_find(&large, second + 100, false) == NULL);
+      assert_that(
+        collector_large_find(&large, second + 100, true)->ptr == second
+      );
+      assert_that(
+        collector_large_find(&large, (char *)large.objects[0].ptr - 1, true) ==
+        NULL
+      );
+      assert_that(collector_large_find(&large, NULL, true) == NULL);
+      collector_large_terminate(&large);
+    });
+
+    it("resizes objects without losing their contents", {
+      struct EmeraldsCollectorLargeSpace large;
+      char *ptr;
+      char *grown;
+
+      collector_large_new(&large);
+      ptr                = collector_large_allocate(&large, 1 << 20, NULL);
+      ptr[0]             = 1;
+      ptr[(1 << 20) - 1] = 2;
+      grown              = collector_large_resize(
+        &large, collector_large_find(&large, ptr, false), 8 << 20
+      );
+
+      assert_that(grown != NULL);
+      assert_that(grown[0] == 1 && grown[(1 << 20) - 1] == 2);
+      assert_that(grown[(8 << 20) - 1] == 0);
+      assert_that(large.number_of_bytes == (size_t)8 << 20);
+      assert_that(collector_large_find(&large, grown, false)->size == 8 << 20);
+      collector_large_terminate(&large);
+    });
+
+    it("unmaps unmarked objects on sweep and promotes survivors", {
+      struct EmeraldsCollectorLargeSpace large;
+      char *kept;
+
+      collector_large_new(&large);
+      kept = collector_large_allocate(&large, 1 << 20, NULL);
+      collector_large_allocate(&large, 2 << 20, NULL);
+      collector_large_find(&large, kept, false)->marked = true;
+
+      assert_that(collector_large_sweep(&large, true, 1) == 1);
+      assert_that(large.number_of_objects == 1);
+      assert_that(large.number_of_bytes == 1 << 20);
+      assert_that(collector_large_find(&large, kept, false)->old);
+      assert_that(collector_large_find(&large, kept, false)->dirty);
+
+      collector_large_free(&large, collector_large_find(&large, kept, false));
+      assert_that(large.number_of_objects == 0);
+      collector_large_terminate(&large);
+    });
+  });
+})
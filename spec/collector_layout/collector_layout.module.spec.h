@@ -0,0 +1,75 @@
+#include "../../libs/cSpec/export/cSpec.h"
+#include "../../src/collector_heap/collector_heap.h"
+#include "../../src/collector_layout/collector_layout.h"
+
+struct T_collector_layout_node {
+  size_t key;
+  void *next;
+  double weight;
+  void *value;
+};
+
+module(T_collector_layout, {
+  describe("object layouts", {
+    it("marks the words of pointer fields", {
+      struct EmeraldsCollectorLayout layout;
+
+      assert_that(
+        collector_layout_new(&layout, sizeof(struct T_collector_layout_node))
+      );
+      collector_layout_set_pointer(
+        &layout, offsetof(struct T_collector_layout_node, next)
+      );
+      collector_layout_set_pointer(
+        &layout, offsetof(struct T_collector_layout_node, value)
+      );
+
+      assert_that(layout.number_of_words == 4);
+      assert_that(!collector_layout_is_pointer(&layout, 0));
+      assert_that(collector_layout_is_pointer(&layout, 1));
+      assert_that(!collector_layout_is_pointer(&layout, 2));
+      assert_that(collector_layout_is_pointer(&layout, 3));
+      collector_layout_terminate(&layout);
+    });
+
+    it("ignores offsets past the end of the element", {
+      struct EmeraldsCollectorLayout layout;
+
+      collector_layout_new(&layout, 2 * sizeof(void *));
+      collector_layout_set_pointer(&layout, 5 * sizeof(void *));
+
+      assert_that(!collector_layout_is_pointer(&layout, 0));
+      assert_that(!collector_layout_is_pointer(&layout, 1));
+      collector_layout_terminate(&layout);
+    });
+
+    it("keeps objects of different kinds on separate pages", {
+      struct EmeraldsCollectorHeap heap;
+      struct EmeraldsCollectorLayout layout;
+      void *conservative;
+      void *atomic;
+      void *typed;
+
+      collector_layout_new(&layout, 32);
+      collector_layout_set_pointer(&layout, 0);
+      collector_heap_new(&heap);
+      conservative = collector_heap_allocate(&heap, 32);
+      atomic =
+        collector_heap_allocate_layout(&heap, 32, COLLECTOR_LAYOUT_ATOMIC);
+      typed = collector_heap_allocate_layout(&heap, 32, &layout);
+
+      assert_that(collector_page_of(conservative) != collector_page_of(atomic));
+      assert_that(collector_page_of(atomic) != collector_page_of(typed));
+      assert_that(collector_page_of(atomic)->kind == COLLECTOR_KIND_ATOMIC);
+      assert_that(collector_page_of(typed)->kind == COLLECTOR_KIND_TYPED);
+      assert_that(
+        collector_page_layout(
+          collector_page_of(typed),
+          collector_page_slot_of(&heap, collector_page_of(typed), typed)
+        ) == &layout
+      );
+      collector_heap_terminate(&heap);
+      collector_layout_terminate(&layout);
+    });
+  });
+})
@@ -0,0 +1,59 @@
+#include "../../libs/cSpec/export/cSpec.h"
+#include "../../src/collector_markers/collector_markers.h"
+
+/* Every item of size n spawns two items of size n - 1 */
+static void collector_markers_spec_scan(
+  void *context,
+  struct EmeraldsCollectorWorklist *worklist,
+  struct EmeraldsCollectorWorkItem *item
+) {
+  __atomic_add_fetch((size_t *)context, 1, __ATOMIC_RELAXED);
+  if(item->size > 0) {
+    collector_worklist_push(worklist, item->ptr, item->size - 1, NULL);
+    collector_worklist_push(worklist, item->ptr, item->size - 1, NULL);
+  }
+}
+
+module(T_collector_markers, {
+  describe("parallel markers", {
+    it("drains the seed on the calling thread without helpers", {
+      struct EmeraldsCollectorMarkers markers;
+      struct EmeraldsCollectorWorklist seed;
+      size_t scanned = 0;
+
+      collector_markers_new(&markers);
+      collector_worklist_new(&seed);
+      collector_worklist_push(&seed, &seed, 10, NULL);
+
+      nassert_that(collector_markers_run(
+        &markers, &seed, collector_markers_spec_scan, &scanned
+      ));
+      assert_that(scanned == 2047);
+      assert_that(seed.number_of_items == 0);
+      collector_worklist_terminate(&seed);
+      collector_markers_terminate(&markers);
+    });
+
+    it("scans every item exactly once across four markers", {
+      struct EmeraldsCollectorMarkers markers;
+      struct EmeraldsCollectorWorklist seed;
+      size_t scanned = 0;
+      size_t round;
+
+      collector_markers_new(&markers);
+      collector_worklist_new(&seed);
+      assert_that(collector_markers_start(&markers, 4));
+
+      for(round = 0; round < 3; round++) {
+        scanned = 0;
+        collector_worklist_push(&seed, &seed, 14, NULL);
+        nassert_that(collector_markers_run(
+          &markers, &seed, collector_markers_spec_scan, &scanned
+        ));
+        assert_that(scanned == 32767);
+      }
+      collector_worklist_terminate(&seed);
+      collector_markers_terminate(&markers);
+    });
+  });
+})
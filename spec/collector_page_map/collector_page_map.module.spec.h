@@ -0,0 +1,41 @@
+#include "../../libs/cSpec/export/cSpec.h"
+#include "../../src/collector_page_map/collector_page_map.h"
+
+module(T_collector_page_map, {
+  describe("two level page map", {
+    it("resolves every address of an inserted range", {
+      struct EmeraldsCollectorPageMap map;
+      char *start = (char *)((size_t)1 << 30);
+      int descriptor;
+
+      collector_page_map_new(&map);
+      assert_that(collector_page_map_find(&map, start) == NULL);
+      assert_that(collector_page_map_insert(&map, start, 3 << 16, &descriptor));
+
+      assert_that(collector_page_map_find(&map, start) == &descriptor);
+      assert_that(collector_page_map_find(&map, start + 12345) == &descriptor);
+      assert_that(
+        collector_page_map_find(&map, start + (3 << 16) - 1) == &descriptor
+      );
+      assert_that(collector_page_map_find(&map, start + (3 << 16)) == NULL);
+      assert_that(collector_page_map_find(&map, start - 1) == NULL);
+      collector_page_map_terminate(&map);
+    });
+
+    it("forgets removed ranges", {
+      struct EmeraldsCollectorPageMap map;
+      char *start = (char *)((size_t)1 << 30);
+      int descriptor;
+
+      collector_page_map_new(&map);
+      collector_page_map_insert(&map, start, 2 << 16, &descriptor);
+      collector_page_map_remove(&map, start, 1 << 16);
+
+      assert_that(collector_page_map_find(&map, start) == NULL);
+      assert_that(
+        collector_page_map_find(&map, start + (1 << 16)) == &descriptor
+      );
+      collector_page_map_terminate(&map);
+    });
+  });
+})
@@ -0,0 +1,132 @@
+#include "../../libs/cSpec/export/cSpec.h"
+#include "../../src/collector_profile/collector_profile.h"
+
+static void *collector_profile_spec_dead;
+
+static void *collector_profile_spec_locate(void *ptr, void *data) {
+  if(ptr == collector_profile_spec_dead) {
+    return NULL;
+  }
+  return ptr == data ? (char *)data + 2 : ptr;
+}
+
+module(T_collector_profile, {
+  describe("sampling heap profiler", {
+    it("draws sample gaps averaging the rate", {
+      struct EmeraldsCollectorProfile profile;
+      size_t shortest = (size_t)-1;
+      double total    = 0;
+      size_t i;
+
+      collector_profile_new(&profile);
+      profile.rate = 1000;
+      for(i = 0; i < 100000; i++) {
+        size_t gap = collector_profile_next(&profile);
+        shortest   = gap < shortest ? gap : shortest;
+        total += (double)gap;
+      }
+      assert_that(shortest >= 1);
+      assert_that(total / 100000 > 950 && total / 100000 < 1050);
+      collector_profile_terminate(&profile);
+    });
+
+    it("groups samples by call stack and weighs them up", {
+      struct EmeraldsCollectorProfile profile;
+      void *first[2];
+      void *second[1];
+      char objects[4];
+
+      first[0]  = &first;
+      first[1]  = &second;
+      second[0] = &objects;
+      collector_profile_new(&profile);
+      profile.rate = 1024;
+
+      assert_that(
+        collector_profile_record(&profile, &objects[0], 16, first, 2)
+      );
+      assert_that(
+        collector_profile_record(&profile, &objects[1], 16, first, 2)
+      );
+      assert_that(
+        collector_profile_record(&profile, &objects[2], 1 << 20, second, 1)
+      );
+      assert_that(profile.number_of_stacks == 2);
+      assert_that(profile.number_of_samples == 3);
+
+      /* Small objects stand for many, huge ones only for themselves */
+      assert_that(profile.stacks[0].live_objects > 120);
+      assert_that(profile.stacks[0].live_bytes > 2000);
+      assert_that(profile.stacks[1].live_objects > 0.99);
+      assert_that(profile.stacks[1].live_objects < 1.01);
+
+      collector_profile_forget(&profile, &objects[0]);
+      collector_profile_forget(&profile, &objects[3]);
+      assert_that(profile.number_of_samples == 2);
+      assert_that(profile.stacks[0].live_objects > 60);
+      assert_that(profile.stacks[0].live_objects < 70);
+      collector_profile_terminate(&profile);
+    });
+
+    it("drops dead samples and follows moved ones", {
+      struct EmeraldsCollectorProfile profile;
+      void *frames[1];
+      char objects[4];
+      size_t i;
+
+      frames[0] = &frames;
+      collector_profile_new(&profile);
+      profile.rate = 64;
+      for(i = 0; i < 3; i++) {
+        collector_profile_record(&profile, &objects[i], 64, frames, 1);
+      }
+
+      collector_profile_spec_dead = &objects[0];
+      collector_profile_relocate(
+        &profile, collector_profile_spec_locate, &objects[1]
+      );
+      assert_that(profile.number_of_samples == 2);
+
+      /* The moved sample is found at its new address */
+      collector_profile_forget(&profile, &objects[1]);
+      assert_that(profile.number_of_samples == 2);
+      collector_profile_forget(&profile, &objects[3]);
+      assert_that(profile.number_of_samples == 1);
+      collector_profile_terminate(&profile);
+    });
+
+    it("writes folded stacks", {
+      struct EmeraldsCollectorProfile profile;
+      FILE *file = tmpfile();
+      void *frames[2];
+      char line[256];
+      char object;
+      size_t length = 0;
+
+      frames[0] = &frames;
+      frames[1] = &object;
+      collector_profile_new(&profile);
+      profile.rate = 1;
+      collector_profile_record(&profile, &object, 100, frames, 2);
+      collector_profile_cycle(&profile);
+
+      assert_that(file != NULL);
+      assert_that(
+        collector_profile_write(&profile, file, COLLECTOR_PROFILE_LIVE_BYTES)
+      );
+      rewind(file);
+      assert_that(fgets(line, sizeof(line), file) != NULL);
+      while(line[length] != '\0' && line[length] != ';') {
+        length++;
+      }
+      assert_that(line[length] == ';');
+      while(line[length] != '\0' && line[length] != ' ') {
+        length++;
+      }
+      assert_that(line[length + 1] == '1' && line[length + 2] == '0');
+      assert_that(line[length + 3] == '0' && line[length + 4] == '\n');
+      fclose(file);
+      collector_profile_terminate(&profile);
+    });
+  });
+})
@@ -0,0 +1,108 @@
+#include "../../libs/cSpec/export/cSpec.h"
+#include "../../src/collector_roots/collector_roots.h"
+
+static void *collector_roots_spec_global;
+
+static bool collector_roots_spec_covers(
+  struct EmeraldsCollectorRoots *roots, void *ptr
+) {
+  size_t i;
+
+  for(i = 0; i < roots->number_of_ranges; i++) {
+    if((void *)roots->ranges[i].start <= ptr &&
+       ptr < (void *)roots->ranges[i].end) {
+      return true;
+    }
+  }
+  return false;
+}
+
+module(T_collector_roots, {
+  describe("root ranges and pinned objects", {
+    it("shrinks ranges to the whole words inside of them", {
+      struct EmeraldsCollectorRoots roots;
+      void *words[4];
+
+      collector_roots_new(&roots);
+      assert_that(
+        collector_roots_add_range(&roots, (char *)&words[0] + 1, 3)
+      );
+      assert_that(roots.number_of_ranges == 0);
+      assert_that(collector_roots_add_range(
+        &roots, (char *)&words[0] + 1, 3 * sizeof(void *)
+      ));
+      assert_that(roots.number_of_ranges == 1);
+      assert_that(roots.ranges[0].start == &words[1]);
+      assert_that(roots.ranges[0].end == &words[3]);
+
+      assert_that(
+        collector_roots_remove_range(&roots, (char *)&words[0] + 1)
+      );
+      assert_that(
+        !collector_roots_remove_range(&roots, (char *)&words[0] + 1)
+      );
+      assert_that(roots.number_of_ranges == 0);
+      collector_roots_terminate(&roots);
+    });
+
+    it("splits ranges around excluded blocks", {
+      struct EmeraldsCollectorRoots roots;
+      void *words[8];
+
+      collector_roots_new(&roots);
+      collector_roots_add_range(&roots, &words[0], sizeof(words));
+      assert_that(
+        collector_roots_exclude(&roots, &words[2], 2 * sizeof(void *))
+      );
+      assert_that(roots.number_of_ranges == 2);
+      assert_that(collector_roots_spec_covers(&roots, &words[1]));
+      assert_that(!collector_roots_spec_covers(&roots, &words[2]));
+      assert_that(!collector_roots_spec_covers(&roots, &words[3]));
+      assert_that(collector_roots_spec_covers(&roots, &words[4]));
+
+      assert_that(collector_roots_exclude(&roots, &words[0], sizeof(words)));
+      assert_that(roots.number_of_ranges == 0);
+      collector_roots_terminate(&roots);
+    });
+
+    it("pins objects until they are unpinned", {
+      struct EmeraldsCollectorRoots roots;
+      char objects[200];
+      bool found = true;
+      size_t i;
+
+      collector_roots_new(&roots);
+      for(i = 0; i < 200; i++) {
+        collector_roots_pin(&roots, &objects[i]);
+      }
+      assert_that(collector_roots_pin(&roots, &objects[0]));
+      assert_that(roots.number_of_objects == 200);
+
+      for(i = 0; i < 200; i += 2) {
+        collector_roots_unpin(&roots, &objects[i]);
+      }
+      assert_that(!collector_roots_unpin(&roots, &objects[0]));
+      assert_that(roots.number_of_objects == 100);
+
+      /* The objects left are still found after the deletions */
+      for(i = 1; i < 200; i += 2) {
+        found = found && collector_roots_unpin(&roots, &objects[i]);
+      }
+      assert_that(found);
+      assert_that(roots.number_of_objects == 0);
+      collector_roots_terminate(&roots);
+    });
+
+    it("finds the data and bss of the program", {
+      struct EmeraldsCollectorRoots roots;
+
+      collector_roots_new(&roots);
+      if(collector_roots_add_data_segments(&roots) > 0) {
+        assert_that(
+          collector_roots_spec_covers(&roots, &collector_roots_spec_global)
+        );
+      }
+      collector_roots_terminate(&roots);
+    });
+  });
+})
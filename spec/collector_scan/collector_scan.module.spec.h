@@ -0,0 +1,56 @@
+#include "../../libs/cSpec/export/cSpec.h"
+#include "../../src/collector_scan/collector_scan.h"
+
+module(T_collector_scan, {
+  describe("range filtered scanning", {
+    it("finds every word within the bounds, in order", {
+      void *words[103];
+      size_t low  = 0x10000;
+      size_t high = 0x20000;
+      size_t seed = 1;
+      size_t from;
+      size_t i;
+
+      for(i = 0; i < 103; i++) {
+        seed     = seed * 1103515245 + 12345;
+        words[i] = (void *)(seed % 7 == 0 ? low + seed % (high - low) : seed);
+      }
+      words[40] = (void *)low;
+      words[41] = (void *)high;
+      words[42] = (void *)(low - 1);
+      words[43] = (void *)(high + 1);
+
+      /* Every start offset, so blocks begin on any alignment */
+      for(from = 0; from < 103; from++) {
+        size_t expected = from;
+        size_t found    = collector_scan_next(words, from, 103, low, high);
+
+        while(expected < 103 && ((size_t)words[expected] < low ||
+                                 (size_t)words[expected] > high)) {
+          expected++;
+        }
+        assert_that(found == expected);
+      }
+      assert_that(collector_scan_next(words, 40, 103, low, high) == 40);
+      assert_that(collector_scan_next(words, 41, 103, low, high) == 41);
+      nassert_that(collector_scan_next(words, 42, 103, low, high) == 42);
+    });
+
+    it("finds nothing without bounds", {
+      void *words[16];
+      size_t i;
+
+      for(i = 0; i < 16; i++) {
+        words[i] = (void *)(i * 4096);
+      }
+      assert_that(collector_scan_next(words, 0, 16, (size_t)-1, 0) == 16);
+      assert_that(collector_scan_next(words, 0, 16, 3, 4095) == 16);
+      assert_that(collector_scan_next(words, 0, 0, 0, (size_t)-1) == 0);
+    });
+
+    it("names the kernel in use", {
+      const char *kernel = collector_scan_kernel();
+      assert_that(kernel[0] == 'a' || kernel[0] == 's');
+    });
+  });
+})
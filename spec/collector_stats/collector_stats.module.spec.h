@@ -0,0 +1,78 @@
+#include "../../libs/cSpec/export/cSpec.h"
+#include "../../src/collector_stats/collector_stats.h"
+
+module(T_collector_stats, {
+  describe("pause histogram", {
+    it("buckets pauses by powers of two microseconds", {
+      assert_that(collector_stats_pause_bucket(0) == 0);
+      assert_that(collector_stats_pause_bucket(999) == 0);
+      assert_that(collector_stats_pause_bucket(1000) == 1);
+      assert_that(collector_stats_pause_bucket(1999) == 1);
+      assert_that(collector_stats_pause_bucket(2000) == 2);
+      assert_that(collector_stats_pause_bucket(1e6) == 10);
+      assert_that(
+        collector_stats_pause_bucket(1e18) == COLLECTOR_STATS_PAUSE_BUCKETS - 1
+      );
+    });
+
+    it("estimates percentiles from the buckets", {
+      struct EmeraldsCollectorRecorder recorder;
+      size_t i;
+
+      collector_recorder_new(&recorder);
+      assert_that(collector_stats_pause_percentile(&recorder.stats, 99) == 0);
+      for(i = 0; i < 99; i++) {
+        recorder.stats.pauses[collector_stats_pause_bucket(500)]++;
+      }
+      recorder.stats.pauses[collector_stats_pause_bucket(3e6)]++;
+      recorder.stats.number_of_pauses = 100;
+      recorder.stats.max_pause_ns     = 3e6;
+
+      assert_that(collector_stats_pause_percentile(&recorder.stats, 50) == 1e3);
+      assert_that(collector_stats_pause_percentile(&recorder.stats, 99) == 3e6);
+      assert_that(
+        collector_stats_pause_percentile(&recorder.stats, 100) == 3e6
+      );
+    });
+  });
+
+  describe("recorder", {
+    it("counts nested pauses once", {
+      struct EmeraldsCollectorRecorder recorder;
+
+      collector_recorder_new(&recorder);
+      collector_recorder_cycle_begin(&recorder, true, 100);
+      collector_recorder_pause_begin(&recorder);
+      collector_recorder_pause_begin(&recorder);
+      collector_recorder_pause_end(&recorder);
+      assert_that(recorder.stats.number_of_pauses == 0);
+      collector_recorder_pause_end(&recorder);
+
+      assert_that(recorder.stats.number_of_pauses == 1);
+      assert_that(recorder.cycle.number_of_pauses == 1);
+      assert_that(recorder.stats.collections == 1);
+      assert_that(recorder.stats.minor_collections == 1);
+    });
+
+    it("keeps the last completed cycle", {
+      struct EmeraldsCollectorRecorder recorder;
+
+      collector_recorder_new(&recorder);
+      nassert_that(collector_recorder_cycle_end(&recorder, 0));
+      collector_recorder_cycle_begin(&recorder, false, 100);
+      collector_recorder_mark(&recorder, 10);
+      collector_recorder_sweep(&recorder, 5, 60, 3);
+      collector_recorder_sweep(&recorder, 5, 20, 1);
+      assert_that(collector_recorder_cycle_end(&recorder, 20));
+
+      assert_that(recorder.stats.last_cycle.heap_before == 100);
+      assert_that(recorder.stats.last_cycle.heap_after == 20);
+      assert_that(recorder.stats.last_cycle.bytes_freed == 80);
+      assert_that(recorder.stats.last_cycle.objects_freed == 4);
+      assert_that(recorder.stats.last_cycle.sweep_ns == 10);
+      assert_that(recorder.stats.mark_ns == 10);
+      assert_that(recorder.stats.bytes_freed == 80);
+      nassert_that(collector_recorder_cycle_end(&recorder, 20));
+    });
+  });
+})
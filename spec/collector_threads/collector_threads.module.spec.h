@@ -0,0 +1,103 @@
+#include "../../libs/cSpec/export/cSpec.h"
+#include "../../src/collector_threads/collector_threads.h"
+
+static struct EmeraldsCollectorThreads collector_threads_spec_registry;
+static int collector_threads_spec_state;
+
+/* Registers, then spins with a marker value on its stack until released */
+static void *collector_threads_spec_thread(void *arg) {
+  volatile size_t marker = (size_t)arg;
+
+  pthread_mutex_lock(&collector_threads_spec_registry.lock);
+  collector_threads_register(
+    &collector_threads_spec_registry, (void *)&marker
+  );
+  pthread_mutex_unlock(&collector_threads_spec_registry.lock);
+
+  __atomic_store_n(&collector_threads_spec_state, 1, __ATOMIC_SEQ_CST);
+  while(__atomic_load_n(&collector_threads_spec_state, __ATOMIC_SEQ_CST) != 2) {
+    marker = (size_t)arg;
+  }
+
+  pthread_mutex_lock(&collector_threads_spec_registry.lock);
+  collector_threads_unregister(&collector_threads_spec_registry);
+  pthread_mutex_unlock(&collector_threads_spec_registry.lock);
+  return NULL;
+}
+
+/* Stacks of other threads hold redzones the sanitizers would complain about */
+#if defined(__GNUC__)
+__attribute__((no_sanitize_address, no_sanitize_thread))
+#endif
+static bool collector_threads_spec_holds(
+  struct EmeraldsCollectorThread *thread, size_t value
+) {
+  size_t *word;
+  for(word = thread->top_of_stack; (void *)word <= thread->bottom_of_stack;
+      word++) {
+    if(*word == value) {
+      return true;
+    }
+  }
+  return false;
+}
+
+module(T_collector_threads, {
+  describe("thread registry", {
+    it("records the calling thread once", {
+      struct EmeraldsCollectorThreads threads;
+      int base;
+
+      collector_threads_new(&threads);
+      assert_that(collector_threads_current(&threads) == NULL);
+      assert_that(collector_threads_register(&threads, &base));
+      assert_that(collector_threads_register(&threads, &base));
+
+      assert_that(threads.number_of_threads == 1);
+      assert_that(
+        collector_threads_current(&threads)->bottom_of_stack == &base
+      );
+      collector_threads_unregister(&threads);
+      assert_that(threads.number_of_threads == 0);
+      assert_that(collector_threads_current(&threads) == NULL);
+      collector_threads_terminate(&threads);
+    });
+
+    it("publishes the stack of a stopped thread", {
+      struct EmeraldsCollectorThreads *threads =
+        &collector_threads_spec_registry;
+      struct EmeraldsCollectorThread *thread;
+      pthread_t other;
+      size_t marker = (size_t)0x5eed1e55;
+      bool found    = false;
+      int base;
+
+      collector_threads_new(threads);
+      collector_threads_register(threads, &base);
+      collector_threads_spec_state = 0;
+      pthread_create(
+        &other, NULL, collector_threads_spec_thread, (void *)marker
+      );
+      while(__atomic_load_n(&collector_threads_spec_state, __ATOMIC_SEQ_CST) !=
+            1) {
+      }
+
+      pthread_mutex_lock(&threads->lock);
+      collector_threads_stop_world(threads);
+      for(thread = threads->threads; thread != NULL; thread = thread->next) {
+        if(thread->top_of_stack != NULL) {
+          assert_that(thread->suspended);
+          found = found || collector_threads_spec_holds(thread, marker);
+        }
+      }
+      collector_threads_start_world(threads);
+      pthread_mutex_unlock(&threads->lock);
+
+      __atomic_store_n(&collector_threads_spec_state, 2, __ATOMIC_SEQ_CST);
+      pthread_join(other, NULL);
+      assert_that(found);
+      assert_that(threads->number_of_threads == 1);
+      collector_threads_terminate(threads);
+    });
+  });
+})
@@ -0,0 +1,65 @@
+#include "../../libs/cSpec/export/cSpec.h"
+#include "../../src/collector_worklist/collector_worklist.h"
+
+module(T_collector_worklist, {
+  describe("mark worklist", {
+    it("pops objects in reverse push order", {
+      struct EmeraldsCollectorWorklist worklist;
+      struct EmeraldsCollectorWorkItem item;
+      int a;
+      int b;
+
+      collector_worklist_new(&worklist);
+      collector_worklist_push(&worklist, &a, sizeof(a), NULL);
+      collector_worklist_push(&worklist, &b, sizeof(b), NULL);
+
+      assert_that(collector_worklist_pop(&worklist, &item));
+      assert_that(item.ptr == &b);
+      assert_that(collector_worklist_pop(&worklist, &item));
+      assert_that(item.ptr == &a);
+      nassert_that(collector_worklist_pop(&worklist, &item));
+      nassert_that(worklist.overflowed);
+      collector_worklist_terminate(&worklist);
+    });
+
+    it("keeps its objects when it grows", {
+      struct EmeraldsCollectorWorklist worklist;
+      struct EmeraldsCollectorWorkItem item;
+      bool in_order = true;
+      size_t i;
+
+      collector_worklist_new(&worklist);
+      worklist.max_capacity = 4 * COLLECTOR_WORKLIST_INITIAL_CAPACITY;
+      for(i = 0; i < 3 * COLLECTOR_WORKLIST_INITIAL_CAPACITY; i++) {
+        collector_worklist_push(&worklist, &worklist, i, NULL);
+      }
+      assert_that(worklist.capacity >= 3 * COLLECTOR_WORKLIST_INITIAL_CAPACITY);
+      nassert_that(worklist.overflowed);
+
+      while(collector_worklist_pop(&worklist, &item)) {
+        in_order = in_order && item.size == --i;
+      }
+      assert_that(in_order);
+      assert_that(i == 0);
+      collector_worklist_terminate(&worklist);
+    });
+
+    it("flags an overflow instead of growing past its limit", {
+      struct EmeraldsCollectorWorklist worklist;
+      struct EmeraldsCollectorWorkItem item;
+      size_t i;
+
+      collector_worklist_new(&worklist);
+      worklist.max_capacity = 2;
+      for(i = 0; i < 3; i++) {
+        collector_worklist_push(&worklist, &worklist, i, NULL);
+      }
+
+      assert_that(worklist.overflowed);
+      assert_that(worklist.number_of_items == 2);
+      assert_that(collector_worklist_pop(&worklist, &item));
+      assert_that(item.size == 1);
+      collector_worklist_terminate(&worklist);
+    });
+  });
+})
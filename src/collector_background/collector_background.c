@@ -0,0 +1,121 @@
+#if defined(__unix__) || defined(__APPLE__)
+  #define _DEFAULT_SOURCE
+#endif
+
+#include "collector_background.h"
+
+#if defined(__COLLECTOR_BACKGROUND_THREADS)
+  #include <sched.h>
+
+static bool
+collector_background_wait(struct EmeraldsCollectorBackground *background) {
+  bool stopping;
+
+  pthread_mutex_lock(&background->lock);
+  while(!background->pending && !background->stopping) {
+    pthread_cond_wait(&background->wake, &background->lock);
+  }
+  background->pending = false;
+  stopping            = background->stopping;
+  pthread_mutex_unlock(&background->lock);
+  return !stopping;
+}
+
+static bool
+collector_background_stopping(struct EmeraldsCollectorBackground *background) {
+  bool stopping;
+
+  pthread_mutex_lock(&background->lock);
+  stopping = background->stopping;
+  pthread_mutex_unlock(&background->lock);
+  return stopping;
+}
+
+static void *collector_background_thread(void *argument) {
+  struct EmeraldsCollectorBackground *background = argument;
+
+  while(collector_background_wait(background)) {
+    /* Yield between pieces so waiting mutators get the collector first */
+    while(!background->work(background->context) &&
+          !collector_background_stopping(background)) {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+#endif
+
+void collector_background_new(struct EmeraldsCollectorBackground *background) {
+  background->work     = NULL;
+  background->context  = NULL;
+  background->running  = false;
+  background->pending  = false;
+  background->stopping = false;
+#if defined(__COLLECTOR_BACKGROUND_THREADS)
+  pthread_mutex_init(&background->lock, NULL);
+  pthread_cond_init(&background->wake, NULL);
+#endif
+}
+
+void collector_background_terminate(
+  struct EmeraldsCollectorBackground *background
+) {
+  collector_background_stop(background);
+#if defined(__COLLECTOR_BACKGROUND_THREADS)
+  pthread_mutex_destroy(&background->lock);
+  pthread_cond_destroy(&background->wake);
+#endif
+}
+
+bool collector_background_start(
+  struct EmeraldsCollectorBackground *background,
+  bool (*work)(void *context),
+  void *context
+) {
+  if(background->running) {
+    return true;
+  }
+  background->work     = work;
+  background->context  = context;
+  background->pending  = false;
+  background->stopping = false;
+#if defined(__COLLECTOR_BACKGROUND_THREADS)
+  /* Nothing the thread reads is written once it runs */
+  background->running = true;
+  if(pthread_create(
+       &background->thread, NULL, collector_background_thread, background
+     ) != 0) {
+    background->running = false;
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+void collector_background_stop(struct EmeraldsCollectorBackground *background) {
+  if(!background->running) {
+    return;
+  }
+#if defined(__COLLECTOR_BACKGROUND_THREADS)
+  pthread_mutex_lock(&background->lock);
+  background->stopping = true;
+  pthread_cond_signal(&background->wake);
+  pthread_mutex_unlock(&background->lock);
+  pthread_join(background->thread, NULL);
+#endif
+  background->running = false;
+}
+
+void collector_background_wake(struct EmeraldsCollectorBackground *background) {
+  if(!background->running) {
+    return;
+  }
+#if defined(__COLLECTOR_BACKGROUND_THREADS)
+  pthread_mutex_lock(&background->lock);
+  background->pending = true;
+  pthread_cond_signal(&background->wake);
+  pthread_mutex_unlock(&background->lock);
+#endif
+}
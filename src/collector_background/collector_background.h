@@ -0,0 +1,82 @@
+#ifndef __COLLECTOR_BACKGROUND_H_
+#define __COLLECTOR_BACKGROUND_H_
+
+#include "../../libs/EmeraldsBool/export/EmeraldsBool.h"
+
+#include <stddef.h>
+
+/* A background worker needs posix threads */
+#if defined(__unix__) || defined(__APPLE__)
+  #define __COLLECTOR_BACKGROUND_THREADS
+  #include <pthread.h>
+#endif
+
+/**
+ * @brief A thread that sleeps until work is requested and then calls
+ *          `work` until it reports that nothing is left
+ *
+ * @param work -> Does a bounded piece of work, returns true once done
+ * @param context -> Passed to `work` unchanged
+ * @param running -> Set while the thread exists
+ * @param pending -> Set when work was requested and not picked up yet
+ * @param stopping -> Set when the thread has to exit
+ * @param thread -> The worker thread
+ * @param lock -> Guards `pending` and `stopping`
+ * @param wake -> Signals the thread that work was requested or it stops
+ **/
+struct EmeraldsCollectorBackground {
+  bool (*work)(void *context);
+  void *context;
+  bool running;
+  bool pending;
+  bool stopping;
+#if defined(__COLLECTOR_BACKGROUND_THREADS)
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+#endif
+};
+
+/**
+ * @brief Initializes a worker without a thread
+ * @param background -> The worker to initialize
+ **/
+void collector_background_new(struct EmeraldsCollectorBackground *background);
+
+/**
+ * @brief Stops the thread and destroys the worker
+ * @param background -> The worker to destroy
+ **/
+void collector_background_terminate(
+  struct EmeraldsCollectorBackground *background
+);
+
+/**
+ * @brief Starts the thread, a running worker is left as it is
+ * @param background -> The worker to start
+ * @param work -> Called from the thread until it returns true, with no
+ *                lock of the worker held
+ * @param context -> Passed to `work` unchanged
+ * @return false if the thread could not be created
+ **/
+bool collector_background_start(
+  struct EmeraldsCollectorBackground *background,
+  bool (*work)(void *context),
+  void *context
+);
+
+/**
+ * @brief Lets the thread finish its current call of `work` and joins it.
+ *          Must not be called while holding a lock `work` takes
+ *
+ * @param background -> The worker to stop
+ **/
+void collector_background_stop(struct EmeraldsCollectorBackground *background);
+
+/**
+ * @brief Asks the thread to call `work` until it is done
+ * @param background -> The worker to wake
+ **/
+void collector_background_wake(struct EmeraldsCollectorBackground *background);
+
+#endif
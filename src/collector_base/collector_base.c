@@ -1,5 +1,9 @@
 #include "collector_base.h"
 
+#if defined(__GLIBC__)
+  #include <malloc.h>
+#endif
+
 /* TODO MAKE INTO A MODULE */
 size_t _simple_integer_hash(void *ptr) {
   size_t key = (size_t)ptr;
@@ -44,8 +48,27 @@ size_t _64bit_integer_hash(void *ptr) {
 }
 
 void collector_collect(EmeraldsCollector *gc) {
-  collector_mark(gc);
+  bool finalize;
+
+  collector_threads_lock(&gc->threads);
+  collector_collect_all(gc);
+  finalize = collector_should_finalize(gc);
+  collector_threads_unlock(&gc->threads);
+
+  /* Finalizers run once the pause is over */
+  if(finalize) {
+    collector_run_finalizers(gc);
+  }
+}
+
+static void collector_collect_all(EmeraldsCollector *gc) {
+  collector_recorder_pause_begin(&gc->recorder);
+  gc->minor = false;
+  collector_mark_begin(gc);
+  collector_mark_finish(gc);
   collector_sweep(gc);
+  collector_sweep_finish(gc);
+  collector_recorder_pause_end(&gc->recorder);
 }
 
 /* 'string.h' replacement */
@@ -66,12 +89,20 @@ static void _memset(void *src, char ch, size_t size) {
   }
 }
 
-/* Flush the registers */
+/* Spill the registers */
 static void collector_mark_register_memory(EmeraldsCollector *gc) {
   jmp_buf regs;
+#if defined(__GNUC__)
+  __builtin_unwind_init();
+#endif
+
+  /* `setjmp` leaves the saved signal mask unwritten, stale words would
+      keep dead objects alive */
+  _memset(&regs, 0, sizeof(regs));
   setjmp(regs);
-  _memset(&regs, 0, sizeof(jmp_buf));
-  (void)gc;
+
+  /* The stack is scanned from a deeper frame so `regs` falls inside of it */
+  collector_mark_volatile_stack(gc);
 }
 
 static void collector_mark_volatile_stack(EmeraldsCollector *gc) {
@@ -79,471 +110,2611 @@ static void collector_mark_volatile_stack(EmeraldsCollector *gc) {
   mark_stack(gc);
 }
 
-static void collector_mark_gc_garbage(EmeraldsCollector *gc, size_t value) {
+static void collector_mark_memory(
+  EmeraldsCollector *gc,
+  struct EmeraldsCollectorWorklist *worklist,
+  void *ptr,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+) {
   size_t i;
-  for(i = 0; i < gc->garbage[value].size / sizeof(void *); i++) {
-    collector_iterate_mark(gc, ((void **)gc->garbage[value].ptr)[i]);
+  size_t word;
+
+  /* Only the words inside of the heap bounds reach the lookups */
+  if(layout == NULL) {
+    size_t number_of_words = size / sizeof(void *);
+    for(i = collector_scan_next(
+          ptr, 0, number_of_words, gc->low_memory_bound, gc->high_memory_bound
+        );
+        i < number_of_words;
+        i = collector_scan_next(
+          ptr,
+          i + 1,
+          number_of_words,
+          gc->low_memory_bound,
+          gc->high_memory_bound
+        )) {
+      collector_iterate_mark(gc, worklist, ((void **)ptr)[i]);
+    }
+    return;
   }
-}
-
-static void collector_mark(EmeraldsCollector *gc) {
-  /* TODO CONCURRENT IMPLEMENTATION */
-  /* Now its still a thread local, stop-the-world iterator */
-  size_t value;
 
-  if(gc->number_of_garbage == 0) {
+  /* Only the pointer words of every repetition of the layout are traced */
+  if(layout->number_of_words == 0) {
     return;
   }
-
-  for(value = 0; value < gc->gc_size; value++) {
-    if(gc->garbage[value].id == 0) {
-      continue;
-    }
-    if(gc->garbage[value].marked) {
-      continue;
+  for(i = 0, word = 0; i < size / sizeof(void *); i++, word++) {
+    if(word == layout->number_of_words) {
+      word = 0;
     }
-    if(gc->garbage[value].root) {
-      gc->garbage[value].marked = true;
-      collector_mark_gc_garbage(gc, value);
-      continue;
+    if(collector_layout_is_pointer(layout, word)) {
+      collector_iterate_mark(gc, worklist, ((void **)ptr)[i]);
     }
   }
-
-  collector_mark_register_memory(gc);
-  /* TODO MEMORY LAYOUT FUCKED -> FIX */
-  collector_mark_volatile_stack(gc);
 }
 
-static void collector_mark_stack(EmeraldsCollector *gc) {
-  /* Use a variable declaration to find the top of the stack */
-  void *stack_top;
-  void *esp = &stack_top;
-  void *ebp = gc->bottom_of_stack;
-  if(ebp == esp) {
+static void collector_mark_gc_garbage(
+  EmeraldsCollector *gc,
+  struct EmeraldsCollectorWorklist *worklist,
+  size_t value
+) {
+  if(gc->garbage[value].layout == COLLECTOR_LAYOUT_ATOMIC) {
     return;
   }
+  collector_worklist_push(
+    worklist,
+    gc->garbage[value].ptr,
+    gc->garbage[value].size,
+    gc->garbage[value].layout
+  );
+}
 
-  /* Mark all stack memory addresses as reachable */
-  if(esp > ebp) {
-    void *ptr;
-    for(ptr = esp; ptr >= ebp; ptr = ((char *)ptr) - sizeof(void *)) {
-      collector_iterate_mark(gc, *((void **)ptr));
-    }
+static void collector_mark_large(
+  struct EmeraldsCollectorWorklist *worklist,
+  struct EmeraldsCollectorLargeObject *object
+) {
+  size_t chunk = COLLECTOR_LARGE_CHUNK_SIZE;
+  size_t offset;
+
+  if(object->layout == COLLECTOR_LAYOUT_ATOMIC) {
+    return;
   }
-  if(esp < ebp) {
-    void *ptr;
-    for(ptr = esp; ptr <= ebp; ptr = ((char *)ptr) + sizeof(void *)) {
-      collector_iterate_mark(gc, *((void **)ptr));
+  /* Every chunk starts on a repetition of the layout */
+  if(object->layout != NULL) {
+    size_t period = object->layout->number_of_words * sizeof(void *);
+    if(period == 0) {
+      return;
     }
+    chunk = chunk > period ? chunk - chunk % period : period;
+  }
+  for(offset = 0; offset < object->size; offset += chunk) {
+    collector_worklist_push(
+      worklist,
+      (char *)object->ptr + offset,
+      object->size - offset < chunk ? object->size - offset : chunk,
+      object->layout
+    );
   }
 }
 
-static void collector_iterate_mark(EmeraldsCollector *gc, void *ptr) {
-  /* Recursively mark all nested pointers */
-  size_t index;
-  size_t value;
-
-  if((size_t)ptr < gc->low_memory_bound ||
-     (size_t)ptr > gc->high_memory_bound) {
-    return;
+static void collector_mark_pop_all(EmeraldsCollector *gc) {
+  struct EmeraldsCollectorWorkItem item;
+  while(collector_worklist_pop(&gc->worklist, &item)) {
+    collector_mark_scan_item(gc, &gc->worklist, &item);
   }
+}
 
-  index = 0;
-  value = collector_hash(ptr) % gc->gc_size;
-
-  while(true) {
-    size_t id = gc->garbage[value].id;
-
-    if(id == 0 || collector_validate_item(gc, value, id) < index) {
+static void collector_mark_scan_item(
+  void *collector,
+  struct EmeraldsCollectorWorklist *worklist,
+  struct EmeraldsCollectorWorkItem *item
+) {
+  EmeraldsCollector *gc = collector;
+
+  /* Saved elements freed between two slices are not there to scan */
+  if(gc->incremental &&
+     collector_heap_find_page(&gc->heap, item->ptr) == NULL) {
+    struct EmeraldsCollectorLargeObject *object =
+      collector_large_find(&gc->large, item->ptr, true);
+    struct EmeraldsCollectorGarbage *entry;
+
+    /* A chunk of an object that shrank in between is cut short */
+    if(object != NULL) {
+      size_t end = (size_t)object->ptr + object->size;
+      if((size_t)item->ptr + item->size > end) {
+        item->size = end - (size_t)item->ptr;
+      }
+      collector_mark_memory(
+        gc, worklist, item->ptr, item->size, object->layout
+      );
       return;
     }
-
-    /* Get reachable pointers that come from the root
-        and check for the next ptr in the tree */
-    if(ptr == gc->garbage[value].ptr) {
-      if(gc->garbage[value].marked) {
-        return;
-      }
-      gc->garbage[value].marked = true;
-
-      /* Abstract the recursion into a callback */
-      collector_mark_gc_garbage(gc, value);
+    entry = gc->gc_size > 0 ? collector_get(gc, item->ptr) : NULL;
+    if(entry == NULL) {
       return;
     }
-    value = (value + 1) % gc->gc_size;
-    index++;
+    collector_mark_memory(gc, worklist, entry->ptr, entry->size, entry->layout);
+    return;
   }
+  collector_mark_memory(gc, worklist, item->ptr, item->size, item->layout);
 }
 
-static void
-collector_zero_out_memory_subtrees(EmeraldsCollector *gc, size_t value) {
-  size_t index;
-
-  _memset(&gc->garbage[value], 0, sizeof(struct EmeraldsCollectorGarbage));
-  index = value;
-
-  while(true) {
-    size_t sub_index = (index + 1) % gc->gc_size;
-    size_t sub_id    = gc->garbage[sub_index].id;
+static bool
+collector_mark_slice(EmeraldsCollector *gc, size_t number_of_objects) {
+  struct EmeraldsCollectorWorkItem item;
 
-    if(sub_id != 0 && collector_validate_item(gc, sub_index, sub_id) > 0) {
-      _memcpy(
-        &gc->garbage[index],
-        &gc->garbage[sub_index],
-        sizeof(struct EmeraldsCollectorGarbage)
-      );
-      _memset(
-        &gc->garbage[sub_index], 0, sizeof(struct EmeraldsCollectorGarbage)
-      );
-      index = sub_index;
-    } else {
-      break;
-    }
+  while(number_of_objects > 0 &&
+        collector_worklist_pop(&gc->worklist, &item)) {
+    collector_mark_scan_item(gc, &gc->worklist, &item);
+    number_of_objects--;
   }
-  gc->number_of_garbage--;
-}
-
-static void *collector_resize_list_of(EmeraldsCollector *gc) {
-  return realloc(
-    gc->list_of_unreachable_elements,
-    sizeof(struct EmeraldsCollectorGarbage) * gc->number_of_unreachable_elements
-  );
+  return gc->worklist.number_of_items == 0;
 }
 
-static size_t collector_count_unreachable_pointers(EmeraldsCollector *gc) {
-  size_t counter = 0;
+static void collector_mark_rescan(EmeraldsCollector *gc) {
+  size_t size_class;
   size_t value;
-  for(value = 0; value < gc->gc_size; value++) {
-    if(gc->garbage[value].id == 0 || gc->garbage[value].marked ||
-       gc->garbage[value].root) {
-      continue;
+  size_t i;
+
+  for(size_class = 0; size_class < COLLECTOR_NUMBER_OF_CLASSES;
+      size_class++) {
+    struct EmeraldsCollectorPage *page;
+    for(page = gc->heap.classes[size_class].pages; page != NULL;
+        page = page->next) {
+      size_t slot;
+      for(slot = 0; slot < page->number_of_slots; slot++) {
+        if(collector_bitmap_test(page->marked, slot)) {
+          collector_mark_memory(
+            gc,
+            &gc->worklist,
+            collector_page_slot_address(page, slot),
+            page->object_size,
+            collector_page_layout(page, slot)
+          );
+          collector_mark_pop_all(gc);
+        }
+      }
     }
-    counter++;
   }
-  return counter;
-}
 
-static void collector_setup_freelist(EmeraldsCollector *gc) {
-  size_t free_index = 0;
-  size_t value;
   for(value = 0; value < gc->gc_size; value++) {
-    if(gc->garbage[value].id == 0 || gc->garbage[value].marked ||
-       gc->garbage[value].root) {
-      continue;
+    if(collector_bitmap_test(gc->flags.marked, value)) {
+      collector_mark_memory(
+        gc,
+        &gc->worklist,
+        gc->garbage[value].ptr,
+        gc->garbage[value].size,
+        gc->garbage[value].layout
+      );
+      collector_mark_pop_all(gc);
     }
+  }
 
-    gc->list_of_unreachable_elements[free_index++] = gc->garbage[value];
-    collector_zero_out_memory_subtrees(gc, value);
-    /* Redo the loop */ value--;
+  for(i = 0; i < gc->large.number_of_objects; i++) {
+    struct EmeraldsCollectorLargeObject *object = &gc->large.objects[i];
+    if(object->marked && object->layout != COLLECTOR_LAYOUT_ATOMIC) {
+      collector_mark_memory(
+        gc, &gc->worklist, object->ptr, object->size, object->layout
+      );
+      collector_mark_pop_all(gc);
+    }
   }
 }
 
-static void collector_unmark_values_for_collection(EmeraldsCollector *gc) {
-  size_t value;
-  for(value = 0; value < gc->gc_size; value++) {
-    if(gc->garbage[value].id == 0) {
-      continue;
-    }
-    if(gc->garbage[value].marked) {
-      gc->garbage[value].marked = false;
-    }
+static void collector_mark_drain(EmeraldsCollector *gc) {
+  if(gc->markers.number_of_markers > 1 &&
+     collector_markers_run(
+       &gc->markers, &gc->worklist, collector_mark_scan_item, gc
+     )) {
+    gc->worklist.overflowed = true;
+  }
+  collector_mark_pop_all(gc);
+
+  /* Dropped objects are marked but unscanned, rescan until none are lost */
+  while(gc->worklist.overflowed) {
+    gc->worklist.overflowed = false;
+    collector_mark_rescan(gc);
   }
 }
 
-static void collector_free_unmarked_values(EmeraldsCollector *gc) {
-  size_t value;
-  for(value = 0; value < gc->number_of_unreachable_elements; value++) {
-    if(gc->list_of_unreachable_elements[value].ptr) {
-      free(gc->list_of_unreachable_elements[value].ptr);
+static void collector_mark_begin(EmeraldsCollector *gc) {
+  clock_t start = clock();
+  double started;
+  size_t word;
+
+  /* Unswept objects still carry the marks of the previous cycle */
+  collector_sweep_finish(gc);
+  collector_cycle_begin(gc);
+  started = collector_stats_now();
+  if(gc->marking) {
+    /* An abandoned cycle left marks and pending objects behind */
+    gc->worklist.number_of_items = 0;
+    gc->worklist.overflowed      = false;
+    collector_heap_clear_marks(&gc->heap);
+  } else if(gc->heap.generational && !gc->minor) {
+    collector_heap_clear_marks(&gc->heap);
+  }
+  if(!gc->minor) {
+    collector_measure(gc, start);
+  }
+  collector_unmark_values_for_collection(gc);
+  gc->number_of_young = 0;
+  gc->marking         = true;
+
+  /* Unmarked roots are found and marked a bitmap word at a time */
+  for(word = 0; word < COLLECTOR_FLAGS_WORDS(gc->gc_size); word++) {
+    size_t roots = gc->flags.root[word] & ~gc->flags.marked[word];
+    size_t bit;
+
+    gc->flags.marked[word] |= roots;
+    for(bit = 0; roots != 0; bit++, roots >>= 1) {
+      if(roots & 1) {
+        collector_mark_gc_garbage(
+          gc, &gc->worklist, word * COLLECTOR_BITS_PER_WORD + bit
+        );
+      }
     }
   }
-}
 
-/* Reallocate the freelist from the previous sweep, reset the freenum */
-static void collector_sweep(EmeraldsCollector *gc) {
-  if(gc->number_of_garbage == 0) {
-    return;
+  /* Slices trace from the stacks as they are now, the last one rescans.
+      Slots left in the bins would sit unscanned across the slices, a
+      stale word marking one hands out an object whose initializing
+      stores skip the barrier */
+  if(gc->incremental) {
+    collector_threads_stop_world(&gc->threads);
+    collector_buffer_flush(gc);
+    collector_mark_register_memory(gc);
+    collector_mark_threads(gc);
+    collector_mark_roots(gc);
+    collector_threads_start_world(&gc->threads);
   }
-  gc->number_of_unreachable_elements = collector_count_unreachable_pointers(gc);
-  gc->list_of_unreachable_elements   = collector_resize_list_of(gc);
-  if(gc->list_of_unreachable_elements == NULL) {
+  collector_mark_clock(gc, start);
+  collector_recorder_mark(&gc->recorder, collector_stats_now() - started);
+}
+
+static void collector_mark_finish(EmeraldsCollector *gc) {
+  /* Roots are found on this thread, the markers drain them in parallel */
+  clock_t start  = clock();
+  double started = collector_stats_now();
+
+  if(gc->number_of_garbage == 0 && gc->heap.number_of_objects == 0 &&
+     gc->large.number_of_objects == 0) {
+    gc->marking = false;
     return;
   }
 
-  collector_setup_freelist(gc);
-  collector_unmark_values_for_collection(gc);
-  collector_decrease_size(gc);
-  collector_free_unmarked_values(gc);
+  /* Other threads stay parked until nothing they point at can be missed */
+  collector_recorder_pause_begin(&gc->recorder);
+  collector_threads_stop_world(&gc->threads);
+  collector_mark_stopped(gc);
+  collector_threads_start_world(&gc->threads);
+  collector_recorder_pause_end(&gc->recorder);
+  collector_notify_finalizers(gc);
+  collector_mark_clock(gc, start);
+  collector_recorder_mark(&gc->recorder, collector_stats_now() - started);
+}
 
-  free(gc->list_of_unreachable_elements);
-  gc->list_of_unreachable_elements   = NULL;
-  gc->number_of_unreachable_elements = 0;
+static void collector_mark_stopped(EmeraldsCollector *gc) {
+  collector_buffer_flush(gc);
+  if(gc->minor) {
+    collector_mark_remembered(gc);
+  }
+  collector_mark_register_memory(gc);
+  collector_mark_threads(gc);
+  collector_mark_roots(gc);
+  collector_mark_ready(gc);
+  collector_mark_drain(gc);
+  collector_mark_finalizable(gc);
+  gc->marking = false;
 }
 
-static bool collector_decrease_size(EmeraldsCollector *gc) {
-  size_t new_size;
-  size_t old_size;
+static void collector_mark_ready(EmeraldsCollector *gc) {
+  struct EmeraldsCollectorFinalizers *finalizers = &gc->finalizers;
+  size_t i;
 
-  gc->available_memory_slots =
-    gc->number_of_garbage + gc->number_of_garbage / 1.5 + 1;
-  new_size = (size_t)((double)(gc->number_of_garbage + 1) * 1.5);
-  old_size = gc->gc_size;
-  return ((size_t)(old_size / 1.5) < new_size) ? collector_rehash(gc, new_size)
-                                               : true;
+  for(i = 0; i < finalizers->number_of_ready; i++) {
+    collector_iterate_mark(
+      gc, &gc->worklist, finalizers->ready[finalizers->ready_start + i].ptr
+    );
+  }
 }
 
-static bool collector_increase_size(EmeraldsCollector *gc) {
-  size_t new_size = (size_t)((double)(gc->number_of_garbage + 1) * 1.5);
-  size_t old_size = gc->gc_size;
-  return (old_size * 1.5 < new_size) ? collector_rehash(gc, new_size) : true;
+static void collector_mark_finalizable(EmeraldsCollector *gc) {
+  struct EmeraldsCollectorFinalizers *finalizers = &gc->finalizers;
+
+  /* Marks are final, the objects queued now survive until finalized */
+  if(collector_finalizers_relocate(finalizers, collector_locate_live, gc) ==
+     0) {
+    return;
+  }
+  collector_mark_ready(gc);
+  collector_mark_drain(gc);
+  finalizers->queued = true;
 }
 
-static bool collector_rehash(EmeraldsCollector *gc, size_t new_size) {
-  /* Rehash all values of the collector to a new bigger sized one */
-  size_t value;
-  struct EmeraldsCollectorGarbage *old_items = gc->garbage;
-  size_t old_size                            = gc->gc_size;
+static void collector_notify_finalizers(EmeraldsCollector *gc) {
+  struct EmeraldsCollectorFinalizers *finalizers = &gc->finalizers;
 
-  gc->gc_size = new_size;
-  gc->garbage = calloc(gc->gc_size, sizeof(struct EmeraldsCollectorGarbage));
+  if(!finalizers->queued) {
+    return;
+  }
+  finalizers->queued = false;
+  if(finalizers->on_ready != NULL) {
+    finalizers->on_ready(finalizers->number_of_ready, finalizers->data);
+  }
+}
 
-  if(gc->garbage == NULL) {
-    /* In case the allocation fails, we restore the items */
-    gc->gc_size = old_size;
-    gc->garbage = old_items;
+static bool
+collector_mark_step(EmeraldsCollector *gc, size_t number_of_objects) {
+  clock_t start  = clock();
+  double started = collector_stats_now();
+  bool drained   = collector_mark_slice(gc, number_of_objects);
+
+  collector_mark_clock(gc, start);
+  collector_recorder_mark(&gc->recorder, collector_stats_now() - started);
+  if(!drained) {
     return false;
   }
+  collector_mark_finish(gc);
+  collector_sweep(gc);
+  return true;
+}
 
-  for(value = 0; value < old_size; value++) {
-    if(old_items[value].id != 0) {
-      collector_set_ptr(
-        gc, old_items[value].ptr, old_items[value].size, old_items[value].root
+static void *collector_locate_live(void *ptr, void *collector) {
+  EmeraldsCollector *gc = collector;
+  struct EmeraldsCollectorPage *page;
+  struct EmeraldsCollectorLargeObject *object;
+  struct EmeraldsCollectorGarbage *item;
+  bool marked = false;
+
+  page   = collector_heap_find_page(&gc->heap, ptr);
+  object = page == NULL ? collector_large_find(&gc->large, ptr, false) : NULL;
+  if(page != NULL) {
+    size_t slot = collector_heap_slot_at(gc, page, ptr);
+    if(slot != COLLECTOR_NO_SLOT) {
+      marked = collector_bitmap_test(page->marked, slot);
+    }
+  } else if(object != NULL) {
+    marked = object->marked;
+  } else if(gc->gc_size > 0) {
+    item = collector_get(gc, ptr);
+    if(item != NULL) {
+      marked = collector_bitmap_test(
+        gc->flags.marked, (size_t)(item - gc->garbage)
       );
     }
   }
-
-  free(old_items);
-  return true;
+  return marked ? ptr : NULL;
 }
 
-static size_t
-collector_validate_item(EmeraldsCollector *gc, size_t index, size_t id) {
-  size_t value = index - (id - 1);
-  if(value < 0) {
-    return value + gc->gc_size;
+/* Dead slots never moved, their first word holds no new address */
+static void *collector_locate_forward(void *ptr, void *collector) {
+  EmeraldsCollector *gc = collector;
+
+  if(collector_locate_live(ptr, gc) == NULL) {
+    return NULL;
   }
-  return value;
+  return collector_heap_forward(&gc->heap, ptr);
 }
 
-static void
-collector_set(EmeraldsCollector *gc, void *ptr, size_t size, bool root) {
-  /* Increase the total items */
-  gc->number_of_garbage++;
+static bool collector_is_young(EmeraldsCollector *gc, void *ptr) {
+  struct EmeraldsCollectorPage *page;
+  struct EmeraldsCollectorLargeObject *object;
+  struct EmeraldsCollectorGarbage *item;
 
-  /* Fix the max and min sizes for the pointer */
-  gc->high_memory_bound = ((size_t)ptr) + size > gc->high_memory_bound
-                            ? ((size_t)ptr) + size
-                            : gc->high_memory_bound;
+  if((size_t)ptr < gc->low_memory_bound ||
+     (size_t)ptr > gc->high_memory_bound) {
+    return false;
+  }
 
-  gc->low_memory_bound =
-    ((size_t)ptr) < gc->low_memory_bound ? ((size_t)ptr) : gc->low_memory_bound;
+  page = collector_heap_find_page(&gc->heap, ptr);
+  if(page != NULL) {
+    size_t slot = collector_page_slot_of(&gc->heap, page, ptr);
+    return slot != COLLECTOR_NO_SLOT && !collector_bitmap_test(page->old, slot);
+  }
+  object = collector_large_find(&gc->large, ptr, gc->heap.interior_pointers);
+  if(object != NULL) {
+    return !object->old;
+  }
+  if(gc->gc_size == 0) {
+    return false;
+  }
+  item = collector_get(gc, ptr);
+  return item != NULL && !collector_bitmap_test(
+                           gc->flags.old, (size_t)(item - gc->garbage)
+                         );
+}
 
-  if(collector_increase_size(gc)) {
-    /*  Add to the list and run the EmeraldsCollector */
-    collector_set_ptr(gc, ptr, size, root);
+static bool collector_mark_remembered_object(
+  EmeraldsCollector *gc,
+  void *ptr,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+) {
+  bool young = false;
+  size_t i;
+  size_t word;
+
+  if(layout != NULL && layout->number_of_words == 0) {
+    return false;
+  }
+  for(i = 0, word = 0; i < size / sizeof(void *); i++, word++) {
+    void *candidate = ((void **)ptr)[i];
 
-    if(gc->number_of_garbage > gc->available_memory_slots) {
-      collector_collect(gc);
+    if(layout != NULL) {
+      if(word == layout->number_of_words) {
+        word = 0;
+      }
+      if(!collector_layout_is_pointer(layout, word)) {
+        continue;
+      }
+    }
+    if(collector_is_young(gc, candidate)) {
+      collector_iterate_mark(gc, &gc->worklist, candidate);
+      young = true;
     }
-  } else {
-    gc->number_of_garbage--;
-    free(ptr);
   }
-  return;
+  return young;
 }
 
-static void
-collector_set_ptr(EmeraldsCollector *gc, void *ptr, size_t size, bool root) {
-  struct EmeraldsCollectorGarbage item;
-  size_t value = collector_hash(ptr) % gc->gc_size;
-  size_t index = 0;
+static void collector_mark_remembered(EmeraldsCollector *gc) {
+  size_t size_class;
+  size_t value;
+  size_t i;
 
-  item.ptr    = ptr;
-  item.id     = value + 1;
-  item.root   = root;
-  item.marked = 0;
-  item.size   = size;
+  for(size_class = 0; size_class < COLLECTOR_NUMBER_OF_CLASSES;
+      size_class++) {
+    struct EmeraldsCollectorPage *page;
+    for(page = gc->heap.classes[size_class].pages; page != NULL;
+        page = page->next) {
+      size_t word;
 
-  /* Find the uniquely ided item and add it to the gc list */
-  while(true) {
-    size_t ptr_location;
-    size_t id = gc->garbage[value].id;
-    if(id == 0) {
-      gc->garbage[value] = item;
-      return;
+      if(!page->remembered) {
+        continue;
+      }
+      page->remembered = false;
+      for(word = 0; word < COLLECTOR_BITMAP_WORDS; word++) {
+        size_t dirty = page->dirty[word] & page->old[word];
+        size_t bit;
+
+        for(bit = 0; dirty != 0; bit++, dirty >>= 1) {
+          size_t slot = word * COLLECTOR_BITS_PER_WORD + bit;
+          if(!(dirty & 1)) {
+            continue;
+          }
+
+          /* Slots with no young object left behind them are clean again */
+          if(collector_mark_remembered_object(
+               gc,
+               collector_page_slot_address(page, slot),
+               page->object_size,
+               collector_page_layout(page, slot)
+             )) {
+            page->remembered = true;
+          } else {
+            collector_bitmap_clear(page->dirty, slot);
+          }
+        }
+      }
     }
-    if(gc->garbage[value].ptr == item.ptr) {
-      return;
+  }
+
+  for(value = 0; value < gc->gc_size; value++) {
+    struct EmeraldsCollectorGarbage *item = &gc->garbage[value];
+    if(collector_bitmap_test(gc->flags.old, value) &&
+       collector_bitmap_test(gc->flags.dirty, value) &&
+       !collector_mark_remembered_object(
+         gc, item->ptr, item->size, item->layout
+       )) {
+      collector_bitmap_clear(gc->flags.dirty, value);
     }
+  }
 
-    ptr_location = collector_validate_item(gc, value, id);
-    if(index >= ptr_location) {
-      struct EmeraldsCollectorGarbage temp = gc->garbage[value];
-      gc->garbage[value]                   = item;
-      item                                 = temp;
-      index                                = ptr_location;
+  for(i = 0; i < gc->large.number_of_objects; i++) {
+    struct EmeraldsCollectorLargeObject *object = &gc->large.objects[i];
+    if(object->old && object->dirty &&
+       object->layout != COLLECTOR_LAYOUT_ATOMIC) {
+      object->dirty = collector_mark_remembered_object(
+        gc, object->ptr, object->size, object->layout
+      );
     }
-    value = (value + 1) % gc->gc_size;
-    index++;
   }
 }
 
-static struct EmeraldsCollectorGarbage *
-collector_get(EmeraldsCollector *gc, void *ptr) {
-  size_t value = collector_hash(ptr) % gc->gc_size;
-  size_t index = 0;
+static void collector_mark_stack(EmeraldsCollector *gc) {
+  /* Use a variable declaration to find the top of the stack */
+  void *stack_top;
+  struct EmeraldsCollectorThread *thread =
+    collector_threads_current(&gc->threads);
 
-  while(true) {
-    size_t id = gc->garbage[value].id;
-    if(id == 0 || collector_validate_item(gc, value, id) < index) {
-      return NULL;
-    }
-    if(gc->garbage[value].ptr == ptr) {
-      return &gc->garbage[value];
-    }
+  collector_mark_range(
+    gc, &stack_top, thread != NULL ? thread->bottom_of_stack : NULL
+  );
+}
 
-    value = (value + 1) % gc->gc_size;
-    index++;
+static void collector_mark_threads(EmeraldsCollector *gc) {
+  struct EmeraldsCollectorThread *thread;
+
+  /* Only parked threads published a top, the caller's stack is done */
+  for(thread = gc->threads.threads; thread != NULL; thread = thread->next) {
+    if(thread->top_of_stack != NULL) {
+      collector_mark_range(gc, thread->top_of_stack, thread->bottom_of_stack);
+    }
   }
+}
 
-  return NULL;
+static void collector_mark_roots(EmeraldsCollector *gc) {
+  struct EmeraldsCollectorRoots *roots = &gc->roots;
+  size_t i;
+
+  for(i = 0; i < roots->number_of_ranges; i++) {
+    collector_mark_range(gc, roots->ranges[i].start, roots->ranges[i].end - 1);
+  }
+  for(i = 0; i < roots->objects_size; i++) {
+    if(roots->objects[i] != NULL) {
+      collector_mark_word(gc, roots->objects[i]);
+    }
+  }
 }
 
-static void collector_remove(EmeraldsCollector *gc, void *ptr) {
+__COLLECTOR_NO_SANITIZE static void
+collector_mark_range(EmeraldsCollector *gc, void *esp, void *ebp) {
+  void **words;
+  size_t number_of_words;
   size_t i;
-  size_t value;
-  size_t index;
 
-  if(gc->gc_size == 0) {
+  if(ebp == NULL) {
     return;
   }
 
-  for(i = 0; i < gc->number_of_unreachable_elements; i++) {
-    if(gc->list_of_unreachable_elements[i].ptr == ptr) {
-      gc->list_of_unreachable_elements[i].ptr = NULL;
-    }
+  /* Scanned upwards from the lowest word, whichever way the stack grows */
+  if(esp < ebp) {
+    number_of_words = ((size_t)ebp - (size_t)esp) / sizeof(void *) + 1;
+    words           = esp;
+  } else {
+    number_of_words = ((size_t)esp - (size_t)ebp) / sizeof(void *) + 1;
+    words = (void **)((char *)esp - (number_of_words - 1) * sizeof(void *));
   }
 
-  value = collector_hash(ptr) % gc->gc_size;
-  index = 0;
-  while(true) {
-    size_t id = gc->garbage[value].id;
-    if(id == 0 || collector_validate_item(gc, value, id) < index) {
-      return;
-    }
-    if(gc->garbage[value].ptr == ptr) {
-      _memset(&gc->garbage[value], 0, sizeof(struct EmeraldsCollectorGarbage));
-      index = value;
-
-      while(true) {
-        size_t sub_index = (index + 1) % gc->gc_size;
-        size_t sub_id    = gc->garbage[sub_index].id;
-
-        if(sub_id != 0 && collector_validate_item(gc, sub_index, sub_id) > 0) {
-          _memcpy(
-            &gc->garbage[index],
-            &gc->garbage[sub_index],
-            sizeof(struct EmeraldsCollectorGarbage)
-          );
-          _memset(
-            &gc->garbage[sub_index], 0, sizeof(struct EmeraldsCollectorGarbage)
-          );
-          index = sub_index;
-        } else {
-          break;
-        }
-      }
-      gc->number_of_garbage--;
-
-      return;
-    }
-    value = (value + 1) % gc->gc_size;
-    index++;
+  /* Mark all stack memory addresses as reachable */
+  for(i = collector_scan_next(
+        words, 0, number_of_words, gc->low_memory_bound, gc->high_memory_bound
+      );
+      i < number_of_words;
+      i = collector_scan_next(
+        words,
+        i + 1,
+        number_of_words,
+        gc->low_memory_bound,
+        gc->high_memory_bound
+      )) {
+    collector_mark_word(gc, words[i]);
   }
+}
 
-  collector_decrease_size(gc);
+static void collector_mark_word(EmeraldsCollector *gc, void *ptr) {
+  if(gc->pinning) {
+    collector_pin_word(gc, ptr);
+  } else {
+    collector_iterate_mark(gc, &gc->worklist, ptr);
+  }
+}
+
+static void collector_pin_word(EmeraldsCollector *gc, void *ptr) {
+  struct EmeraldsCollectorPage *page;
+  size_t slot;
+
+  if((size_t)ptr < gc->low_memory_bound ||
+     (size_t)ptr > gc->high_memory_bound) {
+    return;
+  }
+  page = collector_heap_find_page(&gc->heap, ptr);
+  if(page == NULL) {
+    return;
+  }
+  slot = collector_page_slot_of(&gc->heap, page, ptr);
+  if(slot != COLLECTOR_NO_SLOT) {
+    collector_bitmap_set(page->pinned, slot);
+  }
+}
+
+static void
+collector_pin_memory(EmeraldsCollector *gc, void *ptr, size_t size) {
+  size_t i;
+  for(i = 0; i < size / sizeof(void *); i++) {
+    collector_pin_word(gc, ((void **)ptr)[i]);
+  }
+}
+
+/* Marking leaves the addresses it traced in the frames below the caller,
+    the stack scan of the pinning would find them there */
+__COLLECTOR_NO_SANITIZE static void collector_clear_stack(void) {
+  volatile char frame[COLLECTOR_CLEAR_STACK_SIZE];
+  size_t i;
+
+  for(i = 0; i < sizeof(frame); i++) {
+    frame[i] = 0;
+  }
+}
+
+static void collector_pin_ambiguous(EmeraldsCollector *gc) {
+  size_t size_class;
+  size_t value;
+  size_t i;
+
+  /* Stacks, registers, roots and conservative objects hold ambiguous words */
+  gc->pinning = true;
+  collector_mark_register_memory(gc);
+  collector_mark_threads(gc);
+  collector_mark_roots(gc);
+  gc->pinning = false;
+
+  /* The first size classes are the conservative ones */
+  for(size_class = 0; size_class < COLLECTOR_NUMBER_OF_SIZE_CLASSES;
+      size_class++) {
+    struct EmeraldsCollectorPage *page;
+    for(page = gc->heap.classes[size_class].pages; page != NULL;
+        page = page->next) {
+      size_t slot;
+      for(slot = 0; slot < page->number_of_slots; slot++) {
+        if(collector_bitmap_test(page->marked, slot)) {
+          collector_pin_memory(
+            gc, collector_page_slot_address(page, slot), page->object_size
+          );
+        }
+      }
+    }
+  }
+
+  for(value = 0; value < gc->gc_size; value++) {
+    struct EmeraldsCollectorGarbage *item = &gc->garbage[value];
+    if(collector_bitmap_test(gc->flags.marked, value) &&
+       item->layout == NULL) {
+      collector_pin_memory(gc, item->ptr, item->size);
+    }
+  }
+
+  for(i = 0; i < gc->large.number_of_objects; i++) {
+    struct EmeraldsCollectorLargeObject *object = &gc->large.objects[i];
+    if(object->marked && object->layout == NULL) {
+      collector_pin_memory(gc, object->ptr, object->size);
+    }
+  }
+}
+
+static void collector_fix_memory(
+  EmeraldsCollector *gc,
+  void *ptr,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+) {
+  size_t i;
+  size_t word;
+
+  /* Only precise pointer words are ever rewritten */
+  if(layout == NULL || layout->number_of_words == 0) {
+    return;
+  }
+  for(i = 0, word = 0; i < size / sizeof(void *); i++, word++) {
+    if(word == layout->number_of_words) {
+      word = 0;
+    }
+    if(collector_layout_is_pointer(layout, word)) {
+      ((void **)ptr)[i] = collector_heap_forward(&gc->heap, ((void **)ptr)[i]);
+    }
+  }
+}
+
+static void collector_fix_pointers(EmeraldsCollector *gc) {
+  size_t size_class;
+  size_t value;
+  size_t i;
+
+  /* Dead objects may point at slots that never moved, they are skipped */
+  for(size_class = 0; size_class < COLLECTOR_NUMBER_OF_CLASSES;
+      size_class++) {
+    struct EmeraldsCollectorPage *page;
+    for(page = gc->heap.classes[size_class].pages; page != NULL;
+        page = page->next) {
+      size_t slot;
+
+      /* Moved slots may land in pages the bounds do not cover yet */
+      collector_update_bounds(gc, page, COLLECTOR_PAGE_SIZE);
+      if(page->kind != COLLECTOR_KIND_TYPED) {
+        continue;
+      }
+      for(slot = 0; slot < page->number_of_slots; slot++) {
+        if(collector_bitmap_test(page->marked, slot)) {
+          collector_fix_memory(
+            gc,
+            collector_page_slot_address(page, slot),
+            page->object_size,
+            page->layouts[slot]
+          );
+        }
+      }
+    }
+  }
+
+  for(value = 0; value < gc->gc_size; value++) {
+    struct EmeraldsCollectorGarbage *item = &gc->garbage[value];
+    if(item->id != 0 && item->layout != COLLECTOR_LAYOUT_ATOMIC &&
+       collector_bitmap_test(gc->flags.marked, value)) {
+      collector_fix_memory(gc, item->ptr, item->size, item->layout);
+    }
+  }
+
+  for(i = 0; i < gc->large.number_of_objects; i++) {
+    struct EmeraldsCollectorLargeObject *object = &gc->large.objects[i];
+    if(object->marked && object->layout != COLLECTOR_LAYOUT_ATOMIC) {
+      collector_fix_memory(gc, object->ptr, object->size, object->layout);
+    }
+  }
+}
+
+static void collector_iterate_mark(
+  EmeraldsCollector *gc, struct EmeraldsCollectorWorklist *worklist, void *ptr
+) {
+  /* Mark the pointer and queue its body, nested pointers are not followed */
+  size_t index;
+  size_t value;
+  struct EmeraldsCollectorPage *page;
+  struct EmeraldsCollectorLargeObject *object;
+
+  if((size_t)ptr < gc->low_memory_bound ||
+     (size_t)ptr > gc->high_memory_bound) {
+    return;
+  }
+
+  page = collector_heap_find_page(&gc->heap, ptr);
+  if(page != NULL) {
+    collector_mark_heap_object(gc, worklist, page, ptr);
+    return;
+  }
+  object = collector_large_find(&gc->large, ptr, gc->heap.interior_pointers);
+  if(object != NULL) {
+    if(collector_mark_entry(gc, &object->marked)) {
+      collector_mark_large(worklist, object);
+    }
+    return;
+  }
+  if(gc->gc_size == 0) {
+    return;
+  }
+
+  index = 0;
+  value = collector_home(gc, ptr);
+
+  while(true) {
+    size_t id = gc->garbage[value].id;
+
+    if(id == 0 || collector_validate_item(gc, value, id) < index) {
+      return;
+    }
+
+    /* Get reachable pointers that come from the root
+        and check for the next ptr in the tree */
+    if(ptr == gc->garbage[value].ptr) {
+      if(collector_mark_bit(gc, gc->flags.marked, value)) {
+        collector_mark_gc_garbage(gc, worklist, value);
+      }
+      return;
+    }
+    value = (value + 1) & (gc->gc_size - 1);
+    index++;
+  }
+}
+
+static bool collector_mark_entry(EmeraldsCollector *gc, bool *marked) {
+#if defined(__COLLECTOR_MARKERS_THREADS)
+  if(gc->markers.running) {
+    return !__atomic_load_n(marked, __ATOMIC_RELAXED) &&
+           !__atomic_exchange_n(marked, true, __ATOMIC_RELAXED);
+  }
+#endif
+  (void)gc;
+  if(*marked) {
+    return false;
+  }
+  *marked = true;
+  return true;
+}
+
+static bool
+collector_mark_bit(EmeraldsCollector *gc, size_t *bitmap, size_t bit) {
+  size_t *word = &bitmap[bit / COLLECTOR_BITS_PER_WORD];
+  size_t mask  = (size_t)1 << (bit % COLLECTOR_BITS_PER_WORD);
+
+#if defined(__COLLECTOR_MARKERS_THREADS)
+  if(gc->markers.running) {
+    return !(__atomic_load_n(word, __ATOMIC_RELAXED) & mask) &&
+           !(__atomic_fetch_or(word, mask, __ATOMIC_RELAXED) & mask);
+  }
+#endif
+  (void)gc;
+  if(*word & mask) {
+    return false;
+  }
+  *word |= mask;
+  return true;
+}
+
+static void collector_mark_heap_object(
+  EmeraldsCollector *gc,
+  struct EmeraldsCollectorWorklist *worklist,
+  struct EmeraldsCollectorPage *page,
+  void *ptr
+) {
+  size_t slot = collector_page_slot_of(&gc->heap, page, ptr);
+  if(slot == COLLECTOR_NO_SLOT || !collector_mark_bit(gc, page->marked, slot)) {
+    return;
+  }
+
+  if(page->kind == COLLECTOR_KIND_ATOMIC) {
+    return;
+  }
+
+  /* Interior pointers still scan the whole object from its base */
+  collector_worklist_push(
+    worklist,
+    collector_page_slot_address(page, slot),
+    page->object_size,
+    collector_page_layout(page, slot)
+  );
+}
+
+static void
+collector_zero_out_memory_subtrees(EmeraldsCollector *gc, size_t value) {
+  size_t index;
+
+  gc->bytes_of_garbage -= gc->garbage[value].size;
+  collector_entry_clear(gc, value);
+  index = value;
+
+  while(true) {
+    size_t sub_index = (index + 1) & (gc->gc_size - 1);
+    size_t sub_id    = gc->garbage[sub_index].id;
+
+    if(sub_id != 0 && collector_validate_item(gc, sub_index, sub_id) > 0) {
+      collector_entry_move(gc, index, sub_index);
+      index = sub_index;
+    } else {
+      break;
+    }
+  }
+  gc->number_of_garbage--;
+}
+
+static void collector_unmark_values_for_collection(EmeraldsCollector *gc) {
+  size_t value;
+  for(value = 0; value < COLLECTOR_FLAGS_WORDS(gc->gc_size); value++) {
+    /* Minor collections do not trace through the old generation */
+    gc->flags.marked[value] = gc->minor ? gc->flags.old[value] : 0;
+  }
+  for(value = 0; value < gc->large.number_of_objects; value++) {
+    gc->large.objects[value].marked =
+      gc->minor && gc->large.objects[value].old;
+  }
+}
+
+static void collector_age_entry(EmeraldsCollector *gc, size_t value) {
+  unsigned entry_flags = collector_flags_get(&gc->flags, value);
+
+  if(!gc->heap.generational ||
+     (entry_flags & (COLLECTOR_ENTRY_MARKED | COLLECTOR_ENTRY_ROOT |
+                     COLLECTOR_ENTRY_OLD)) != COLLECTOR_ENTRY_MARKED) {
+    return;
+  }
+  if(++gc->flags.age[value] >= gc->heap.promotion_age) {
+    /* It may point at younger objects that no barrier ever recorded */
+    collector_bitmap_set(gc->flags.old, value);
+    collector_bitmap_set(gc->flags.dirty, value);
+  }
+}
+
+static size_t
+collector_sweep_entry(EmeraldsCollector *gc, size_t value, size_t holes) {
+  struct EmeraldsCollectorGarbage *item = &gc->garbage[value];
+  size_t shift;
+
+  if(item->id == 0) {
+    return 0;
+  }
+  if(!collector_bitmap_test(gc->flags.marked, value) &&
+     !collector_bitmap_test(gc->flags.root, value)) {
+    free(item->ptr);
+    gc->bytes_of_garbage -= item->size;
+    collector_entry_clear(gc, value);
+    gc->number_of_garbage--;
+    return holes + 1;
+  }
+
+  /* Live entries move back over the holes, but never before their home */
+  shift = collector_validate_item(gc, value, item->id);
+  if(shift > holes) {
+    shift = holes;
+  }
+  if(shift > 0) {
+    collector_entry_move(gc, (value - shift) & (gc->gc_size - 1), value);
+  }
+  return shift;
+}
+
+static bool
+collector_sweep_table(EmeraldsCollector *gc, size_t number_of_entries) {
+  size_t holes = 0;
+  size_t value;
+
+  /* A slice only ends once the holes it opened are closed again */
+  while(gc->sweep_cursor < gc->gc_size &&
+        (number_of_entries > 0 || holes > 0)) {
+    collector_age_entry(gc, gc->sweep_cursor);
+    holes = collector_sweep_entry(gc, gc->sweep_cursor++, holes);
+    if(number_of_entries > 0) {
+      number_of_entries--;
+    }
+  }
+
+  /* A cluster wrapping around the end closes up at the front of the table */
+  for(value = 0; holes > 0 && value < gc->gc_size; value++) {
+    holes = collector_sweep_entry(gc, value, holes);
+  }
+  return gc->sweep_cursor >= gc->gc_size;
+}
+
+/* Only queue the work, allocations sweep it a slice at a time */
+static void collector_sweep(EmeraldsCollector *gc) {
+  double started = collector_stats_now();
+  size_t bytes   = gc->large.number_of_bytes;
+  size_t objects = gc->large.number_of_objects;
+
+  /* Marks tell which sampled objects die before anything is freed */
+  collector_profile_relocate(&gc->profile, collector_locate_live, gc);
+  collector_profile_cycle(&gc->profile);
+
+  /* Large objects are few, unmapping them right away costs no more */
+  collector_large_sweep(
+    &gc->large, gc->heap.generational, gc->heap.promotion_age
+  );
+  collector_recorder_sweep(
+    &gc->recorder,
+    collector_stats_now() - started,
+    bytes - gc->large.number_of_bytes,
+    objects - gc->large.number_of_objects
+  );
+  collector_heap_sweep_begin(&gc->heap);
+  gc->sweep_cursor = 0;
+  gc->sweeping     = true;
+}
+
+static void collector_sweep_step(
+  EmeraldsCollector *gc, size_t number_of_pages, size_t number_of_entries
+) {
+  double started;
+  size_t bytes;
+  size_t objects;
+  bool heap_swept;
+  bool table_swept;
+
+  if(!gc->sweeping) {
+    return;
+  }
+  started     = collector_stats_now();
+  bytes       = collector_heap_bytes(gc);
+  objects     = collector_live_objects(gc);
+  heap_swept  = collector_heap_sweep_step(&gc->heap, number_of_pages);
+  table_swept = collector_sweep_table(gc, number_of_entries);
+  collector_recorder_sweep(
+    &gc->recorder,
+    collector_stats_now() - started,
+    bytes - collector_heap_bytes(gc),
+    objects - collector_live_objects(gc)
+  );
+  if(heap_swept && table_swept) {
+    gc->sweeping = false;
+    collector_decrease_size(gc);
+    collector_scavenge(gc);
+    collector_cycle_end(gc);
+  }
+}
+
+static void collector_sweep_finish(EmeraldsCollector *gc) {
+  collector_sweep_step(gc, SIZE_MAX, SIZE_MAX);
+}
+
+static void collector_allocation_step(
+  EmeraldsCollector *gc, size_t number_of_allocations
+) {
+  if(gc->sweeping) {
+    collector_sweep_step(
+      gc,
+      COLLECTOR_SWEEP_PAGES_PER_STEP * number_of_allocations,
+      COLLECTOR_SWEEP_ENTRIES_PER_STEP * number_of_allocations
+    );
+  } else if(gc->marking) {
+    if(collector_should_assist(gc)) {
+      collector_recorder_pause_begin(&gc->recorder);
+      collector_mark_step(
+        gc, COLLECTOR_MARK_OBJECTS_PER_STEP * number_of_allocations
+      );
+      collector_recorder_pause_end(&gc->recorder);
+    }
+  } else if(collector_should_collect(gc)) {
+    collector_start_cycle(gc);
+  }
+}
+
+static bool collector_should_assist(EmeraldsCollector *gc) {
+  /* Allocations outrunning the background thread slow down to its pace */
+  return !gc->concurrent ||
+         collector_heap_bytes(gc) / 3 > gc->collection_trigger / 2;
+}
+
+static void collector_start_cycle(EmeraldsCollector *gc) {
+  collector_recorder_pause_begin(&gc->recorder);
+
+  /* The old generation is only traced once the heap outgrew its limit */
+  gc->minor = gc->heap.generational &&
+              collector_heap_bytes(gc) <= gc->collection_trigger;
+  collector_mark_begin(gc);
+  if(!gc->incremental) {
+    collector_mark_finish(gc);
+    collector_sweep(gc);
+  }
+  if(gc->concurrent) {
+    collector_background_wake(&gc->background);
+  }
+  collector_recorder_pause_end(&gc->recorder);
+}
+
+static bool collector_background_work(void *collector) {
+  EmeraldsCollector *gc = collector;
+  bool done;
+
+  collector_threads_lock(&gc->threads);
+  if(gc->marking) {
+    collector_mark_step(gc, COLLECTOR_MARK_OBJECTS_PER_STEP);
+  } else if(gc->sweeping) {
+    collector_sweep_step(
+      gc, COLLECTOR_SWEEP_PAGES_PER_STEP, COLLECTOR_SWEEP_ENTRIES_PER_STEP
+    );
+  }
+  done = !gc->marking && !gc->sweeping;
+  collector_threads_unlock(&gc->threads);
+  return done;
+}
+
+static bool collector_should_collect(EmeraldsCollector *gc) {
+  if(gc->heap.generational && gc->number_of_young >= gc->nursery_size) {
+    return true;
+  }
+  return collector_heap_bytes(gc) > gc->collection_trigger;
+}
+
+static size_t collector_heap_bytes(EmeraldsCollector *gc) {
+  return gc->heap.number_of_bytes + gc->bytes_of_garbage +
+         gc->large.number_of_bytes;
+}
+
+static size_t collector_live_objects(EmeraldsCollector *gc) {
+  return gc->heap.number_of_objects + gc->number_of_garbage +
+         gc->large.number_of_objects;
+}
+
+static void collector_stats_refresh(EmeraldsCollector *gc) {
+  struct EmeraldsCollectorStats *stats = &gc->recorder.stats;
+
+  stats->bytes_allocated =
+    gc->recorder.bytes_allocated + gc->bytes_since_collection;
+  stats->load_factor =
+    gc->gc_size > 0 ? (double)gc->number_of_garbage / (double)gc->gc_size : 0;
+  stats->heap_bytes              = collector_heap_bytes(gc);
+  stats->collection_trigger      = gc->collection_trigger;
+  stats->number_of_garbage       = gc->number_of_garbage;
+  stats->gc_size                 = gc->gc_size;
+  stats->number_of_large_objects = gc->large.number_of_objects;
+}
+
+static void collector_cycle_begin(EmeraldsCollector *gc) {
+  /* A cycle abandoned for a full collection ends where the next begins */
+  collector_cycle_end(gc);
+  collector_recorder_cycle_begin(
+    &gc->recorder, gc->minor, collector_heap_bytes(gc)
+  );
+  if(gc->recorder.on_start != NULL) {
+    collector_stats_refresh(gc);
+    gc->recorder.on_start(&gc->recorder.stats, gc->recorder.data);
+  }
+}
+
+static void collector_cycle_end(EmeraldsCollector *gc) {
+  if(collector_recorder_cycle_end(&gc->recorder, collector_heap_bytes(gc)) &&
+     gc->recorder.on_end != NULL) {
+    collector_stats_refresh(gc);
+    gc->recorder.on_end(&gc->recorder.stats, gc->recorder.data);
+  }
+}
+
+static void collector_measure(EmeraldsCollector *gc, clock_t start) {
+  gc->allocation_rate =
+    (double)gc->bytes_since_collection /
+    (double)(start > gc->end_of_mark ? start - gc->end_of_mark : 1);
+  gc->recorder.bytes_allocated += gc->bytes_since_collection;
+  gc->bytes_since_collection = 0;
+  gc->mark_time              = 0;
+}
+
+static void collector_mark_clock(EmeraldsCollector *gc, clock_t start) {
+  /* Process time, so parallel markers count for every thread they use */
+  if(!gc->minor) {
+    gc->end_of_mark = clock();
+    gc->mark_time += gc->end_of_mark - start;
+  }
+}
+
+static void collector_pace(EmeraldsCollector *gc) {
+  struct EmeraldsCollectorPolicy *policy = &gc->policy;
+  double live = (double)collector_heap_bytes(gc);
+  double goal = live + live * (double)policy->growth_percent / 100;
+
+  /* Marking takes `mark_time` per cycle, the mutator gets the rest */
+  if(policy->cpu_percent > 0 && policy->cpu_percent < 100) {
+    double headroom = gc->allocation_rate * (double)gc->mark_time *
+                      (double)(100 - policy->cpu_percent) /
+                      (double)policy->cpu_percent;
+    if(live + headroom > goal) {
+      goal = live + headroom;
+    }
+  }
+  if(goal < (double)policy->minimum_heap) {
+    goal = (double)policy->minimum_heap;
+  }
+  if(policy->memory_limit != 0 && goal > (double)policy->memory_limit) {
+    goal = (double)policy->memory_limit;
+  }
+  gc->collection_trigger = goal < (double)SIZE_MAX ? (size_t)goal : SIZE_MAX;
+}
+
+static void collector_scavenge(EmeraldsCollector *gc) {
+  size_t retained = gc->retained_memory;
+  size_t bytes    = collector_heap_bytes(gc);
+
+  /* Pages the heap grows into before its next collection are kept */
+  if(gc->collection_trigger > bytes &&
+     gc->collection_trigger - bytes > retained) {
+    retained = gc->collection_trigger - bytes;
+  }
+  collector_heap_scavenge(&gc->heap, retained / COLLECTOR_PAGE_SIZE);
+}
+
+static bool collector_fits(EmeraldsCollector *gc, size_t size) {
+  return gc->policy.memory_limit == 0 ||
+         (collector_heap_bytes(gc) <= gc->policy.memory_limit &&
+          size <= gc->policy.memory_limit - collector_heap_bytes(gc));
+}
+
+static bool collector_reserve(EmeraldsCollector *gc, size_t size) {
+  if(collector_fits(gc, size)) {
+    return true;
+  }
+  collector_collect_all(gc);
+  return collector_fits(gc, size);
+}
+
+static bool collector_decrease_size(EmeraldsCollector *gc) {
+  size_t needed = gc->number_of_garbage + 1;
+
+  /* Minor collections leave dead old objects behind, they move no limit */
+  if(!gc->minor) {
+    collector_pace(gc);
+  }
+  if(gc->gc_size > COLLECTOR_MINIMUM_TABLE_SIZE && needed * 4 < gc->gc_size) {
+    return collector_rehash(gc, collector_table_size(needed));
+  }
+  return true;
+}
+
+static bool collector_increase_size(EmeraldsCollector *gc) {
+  size_t needed = gc->number_of_garbage + 1;
+
+  if(needed * 4 > gc->gc_size * 3) {
+    return collector_rehash(gc, collector_table_size(needed));
+  }
+  return true;
+}
+
+static size_t collector_table_size(size_t number_of_elements) {
+  size_t size = COLLECTOR_MINIMUM_TABLE_SIZE;
+
+  while(number_of_elements * 4 > size * 3) {
+    size *= 2;
+  }
+  return size;
+}
+
+static bool collector_rehash(EmeraldsCollector *gc, size_t new_size) {
+  /* Rehash all values of the collector to a new bigger sized one */
+  size_t value;
+  struct EmeraldsCollectorGarbage *old_items     = gc->garbage;
+  struct EmeraldsCollectorGarbageFlags old_flags = gc->flags;
+  size_t old_size                                = gc->gc_size;
+
+  /* Reinserted entries lose their marks, so the pending sweep ends first */
+  collector_sweep_table(gc, SIZE_MAX);
+
+  gc->gc_size = new_size;
+  gc->garbage = calloc(gc->gc_size, sizeof(struct EmeraldsCollectorGarbage));
+
+  if(gc->garbage == NULL || !collector_flags_new(&gc->flags, gc->gc_size)) {
+    /* In case the allocation fails, we restore the items */
+    free(gc->garbage);
+    gc->gc_size = old_size;
+    gc->garbage = old_items;
+    gc->flags   = old_flags;
+    return false;
+  }
+
+  /* The product keeps as many top bits as the size has trailing zeros */
+  gc->hash_shift = sizeof(size_t) * 8;
+  for(value = 1; value < gc->gc_size; value *= 2) {
+    gc->hash_shift--;
+  }
+
+  for(value = 0; value < old_size; value++) {
+    if(old_items[value].id != 0) {
+      collector_set_item(
+        gc,
+        old_items[value],
+        collector_flags_get(&old_flags, value),
+        old_flags.age[value]
+      );
+    }
+  }
+
+  free(old_items);
+  free(old_flags.marked);
+  gc->sweep_cursor = gc->gc_size;
+  gc->recorder.stats.rehashes++;
+  return true;
+}
+
+static bool
+collector_flags_new(struct EmeraldsCollectorGarbageFlags *flags, size_t size) {
+  size_t words = COLLECTOR_FLAGS_WORDS(size);
+  size_t *block;
+
+  /* The four bitmaps and the ages share a single allocation */
+  block = calloc(1, words * 4 * sizeof(size_t) + size);
+  if(block == NULL) {
+    return false;
+  }
+  flags->marked = block;
+  flags->root   = block + words;
+  flags->old    = block + words * 2;
+  flags->dirty  = block + words * 3;
+  flags->age    = (unsigned char *)(block + words * 4);
+  return true;
+}
+
+static unsigned collector_flags_get(
+  const struct EmeraldsCollectorGarbageFlags *flags, size_t value
+) {
+  unsigned entry_flags = 0;
+
+  if(collector_bitmap_test(flags->marked, value)) {
+    entry_flags |= COLLECTOR_ENTRY_MARKED;
+  }
+  if(collector_bitmap_test(flags->root, value)) {
+    entry_flags |= COLLECTOR_ENTRY_ROOT;
+  }
+  if(collector_bitmap_test(flags->old, value)) {
+    entry_flags |= COLLECTOR_ENTRY_OLD;
+  }
+  if(collector_bitmap_test(flags->dirty, value)) {
+    entry_flags |= COLLECTOR_ENTRY_DIRTY;
+  }
+  return entry_flags;
+}
+
+static void collector_flags_put(
+  struct EmeraldsCollectorGarbageFlags *flags,
+  size_t value,
+  unsigned entry_flags
+) {
+  size_t *bitmaps[4];
+  size_t i;
+
+  /* In the order of the COLLECTOR_ENTRY_* bits */
+  bitmaps[0] = flags->marked;
+  bitmaps[1] = flags->root;
+  bitmaps[2] = flags->old;
+  bitmaps[3] = flags->dirty;
+  for(i = 0; i < 4; i++) {
+    if(entry_flags & (1U << i)) {
+      collector_bitmap_set(bitmaps[i], value);
+    } else {
+      collector_bitmap_clear(bitmaps[i], value);
+    }
+  }
+}
+
+static void collector_entry_store(
+  EmeraldsCollector *gc,
+  size_t value,
+  const struct EmeraldsCollectorGarbage *item,
+  unsigned entry_flags,
+  unsigned char age
+) {
+  gc->garbage[value] = *item;
+  collector_flags_put(&gc->flags, value, entry_flags);
+  gc->flags.age[value] = age;
+}
+
+static void
+collector_entry_move(EmeraldsCollector *gc, size_t to, size_t from) {
+  collector_entry_store(
+    gc,
+    to,
+    &gc->garbage[from],
+    collector_flags_get(&gc->flags, from),
+    gc->flags.age[from]
+  );
+  collector_entry_clear(gc, from);
+}
+
+static void collector_entry_clear(EmeraldsCollector *gc, size_t value) {
+  _memset(&gc->garbage[value], 0, sizeof(struct EmeraldsCollectorGarbage));
+  collector_flags_put(&gc->flags, value, 0);
+  gc->flags.age[value] = 0;
+}
+
+static size_t
+collector_validate_item(EmeraldsCollector *gc, size_t index, size_t id) {
+  /* Entries of a cluster wrapping around the end sit before their home */
+  return (index - (id - 1)) & (gc->gc_size - 1);
+}
+
+static size_t collector_home(EmeraldsCollector *gc, void *ptr) {
+  return ((size_t)ptr * COLLECTOR_FIBONACCI_MULTIPLIER) >> gc->hash_shift;
+}
+
+static void
+collector_update_bounds(EmeraldsCollector *gc, void *ptr, size_t size) {
+  /* Fix the max and min sizes for the pointer */
+  gc->high_memory_bound = ((size_t)ptr) + size > gc->high_memory_bound
+                            ? ((size_t)ptr) + size
+                            : gc->high_memory_bound;
+
+  gc->low_memory_bound =
+    ((size_t)ptr) < gc->low_memory_bound ? ((size_t)ptr) : gc->low_memory_bound;
+}
+
+static void collector_set(
+  EmeraldsCollector *gc,
+  void *ptr,
+  size_t size,
+  bool root,
+  const struct EmeraldsCollectorLayout *layout
+) {
+  if(collector_insert(gc, ptr, size, root, layout)) {
+    /* Run the EmeraldsCollector */
+    collector_allocation_step(gc, 1);
+  }
+  return;
+}
+
+static bool collector_insert(
+  EmeraldsCollector *gc,
+  void *ptr,
+  size_t size,
+  bool root,
+  const struct EmeraldsCollectorLayout *layout
+) {
+  /* Increase the total items */
+  gc->number_of_garbage++;
+  gc->number_of_young++;
+
+  collector_update_bounds(gc, ptr, size);
+
+  if(!collector_increase_size(gc)) {
+    gc->number_of_garbage--;
+    free(ptr);
+    return false;
+  }
+
+  /* Add to the list */
+  collector_set_ptr(gc, ptr, size, root, layout);
+  return true;
+}
+
+static void collector_set_ptr(
+  EmeraldsCollector *gc,
+  void *ptr,
+  size_t size,
+  bool root,
+  const struct EmeraldsCollectorLayout *layout
+) {
+  struct EmeraldsCollectorGarbage item;
+  unsigned entry_flags = root ? COLLECTOR_ENTRY_ROOT : 0;
+
+  /* Objects allocated while a sweep is pending must survive it */
+  if(gc->sweeping) {
+    entry_flags |= COLLECTOR_ENTRY_MARKED;
+  }
+  item.ptr    = ptr;
+  item.size   = size;
+  item.layout = layout;
+  collector_set_item(gc, item, entry_flags, 0);
+  gc->bytes_of_garbage += size;
+  gc->bytes_since_collection += size;
+}
+
+static void collector_set_item(
+  EmeraldsCollector *gc,
+  struct EmeraldsCollectorGarbage item,
+  unsigned entry_flags,
+  unsigned char age
+) {
+  size_t value = collector_home(gc, item.ptr);
+  size_t index = 0;
+
+  item.id = value + 1;
+
+  /* Find the uniquely ided item and add it to the gc list */
+  while(true) {
+    size_t ptr_location;
+    size_t id = gc->garbage[value].id;
+    if(id == 0) {
+      collector_entry_store(gc, value, &item, entry_flags, age);
+      return;
+    }
+    if(gc->garbage[value].ptr == item.ptr) {
+      return;
+    }
+
+    ptr_location = collector_validate_item(gc, value, id);
+    if(index >= ptr_location) {
+      struct EmeraldsCollectorGarbage temp = gc->garbage[value];
+      unsigned temp_flags;
+      unsigned char temp_age;
+
+      /* The displaced entry carries its flags along to its next slot */
+      temp_flags = collector_flags_get(&gc->flags, value);
+      temp_age   = gc->flags.age[value];
+      collector_entry_store(gc, value, &item, entry_flags, age);
+      item        = temp;
+      entry_flags = temp_flags;
+      age         = temp_age;
+      index       = ptr_location;
+    }
+    value = (value + 1) & (gc->gc_size - 1);
+    index++;
+  }
+}
+
+static struct EmeraldsCollectorGarbage *
+collector_get(EmeraldsCollector *gc, void *ptr) {
+  size_t value = collector_home(gc, ptr);
+  size_t index = 0;
+
+  while(true) {
+    size_t id = gc->garbage[value].id;
+    if(id == 0 || collector_validate_item(gc, value, id) < index) {
+      return NULL;
+    }
+    if(gc->garbage[value].ptr == ptr) {
+      return &gc->garbage[value];
+    }
+
+    value = (value + 1) & (gc->gc_size - 1);
+    index++;
+  }
+
+  return NULL;
+}
+
+static void collector_remove(EmeraldsCollector *gc, void *ptr) {
+  size_t value;
+  size_t index;
+
+  if(gc->gc_size == 0) {
+    return;
+  }
+
+  value = collector_home(gc, ptr);
+  index = 0;
+  while(true) {
+    size_t id = gc->garbage[value].id;
+    if(id == 0 || collector_validate_item(gc, value, id) < index) {
+      return;
+    }
+    if(gc->garbage[value].ptr == ptr) {
+      collector_zero_out_memory_subtrees(gc, value);
+      return;
+    }
+    value = (value + 1) & (gc->gc_size - 1);
+    index++;
+  }
+
+  collector_decrease_size(gc);
 }
 
 void collector_new(EmeraldsCollector *gc, void *stack_base) {
   gc->bottom_of_stack                = stack_base;
   gc->number_of_garbage              = 0;
   gc->gc_size                        = 0;
-  gc->available_memory_slots         = 0;
+  gc->hash_shift                     = 0;
+  gc->bytes_of_garbage               = 0;
+  gc->collection_trigger             = COLLECTOR_MINIMUM_HEAP;
+  gc->policy.growth_percent          = COLLECTOR_GROWTH_PERCENT;
+  gc->policy.memory_limit            = 0;
+  gc->policy.cpu_percent             = 0;
+  gc->policy.minimum_heap            = COLLECTOR_MINIMUM_HEAP;
+  gc->retained_memory                = COLLECTOR_RETAINED_MEMORY;
+  gc->bytes_since_collection         = 0;
+  gc->allocation_rate                = 0;
+  gc->mark_time                      = 0;
+  gc->end_of_mark                    = clock();
   gc->high_memory_bound              = 0;
   gc->low_memory_bound               = SIZE_MAX;
   gc->garbage                        = NULL;
-  gc->list_of_unreachable_elements   = NULL;
-  gc->number_of_unreachable_elements = 0;
+  gc->flags.marked                   = NULL;
+  gc->flags.root                     = NULL;
+  gc->flags.old                      = NULL;
+  gc->flags.dirty                    = NULL;
+  gc->flags.age                      = NULL;
+  gc->sweep_cursor                   = 0;
+  gc->sweeping                       = false;
+  gc->minor                          = false;
+  gc->number_of_young                = 0;
+  gc->nursery_size                   = COLLECTOR_NURSERY_SIZE;
+  gc->marking                        = false;
+  gc->incremental                    = false;
+  gc->concurrent                     = false;
+  gc->pinning                        = false;
+  collector_heap_new(&gc->heap);
+  collector_large_new(&gc->large);
+  collector_worklist_new(&gc->worklist);
+  collector_markers_new(&gc->markers);
+  collector_recorder_new(&gc->recorder);
+  collector_profile_new(&gc->profile);
+  collector_finalizers_new(&gc->finalizers);
+  collector_roots_new(&gc->roots);
+  collector_roots_add_data_segments(&gc->roots);
+
+  /* The bounds and caches of a global collector would keep objects alive */
+  collector_roots_exclude(&gc->roots, gc, sizeof(EmeraldsCollector));
+  collector_threads_new(&gc->threads);
+  collector_background_new(&gc->background);
+  if(collector_threads_register(&gc->threads, stack_base)) {
+    collector_buffer_attach(gc);
+  }
+}
+
+static void collector_buffer_attach(EmeraldsCollector *gc) {
+  struct EmeraldsCollectorThread *thread =
+    collector_threads_current(&gc->threads);
+
+  /* Without a buffer the thread allocates under the lock */
+  if(thread->buffer == NULL) {
+    thread->buffer =
+      calloc(1, sizeof(struct EmeraldsCollectorAllocationBuffer));
+  }
+}
+
+static void collector_buffer_release(
+  EmeraldsCollector *gc, struct EmeraldsCollectorAllocationBuffer *buffer
+) {
+  size_t size_class;
+
+  for(size_class = 0; size_class < COLLECTOR_NUMBER_OF_BUFFERED_CLASSES;
+      size_class++) {
+    struct EmeraldsCollectorBufferBin *bin = &buffer->bins[size_class];
+    size_t i;
+
+    for(i = 0; i < bin->number_of_slots; i++) {
+      struct EmeraldsCollectorPage *page = collector_page_of(bin->slots[i]);
+      collector_heap_free(
+        &gc->heap,
+        page,
+        collector_page_slot_of(&gc->heap, page, bin->slots[i])
+      );
+    }
+    bin->number_of_slots = 0;
+  }
+}
+
+static void collector_buffer_flush(EmeraldsCollector *gc) {
+  struct EmeraldsCollectorThread *thread;
+
+  /* A thread parked inside of a pop fails its exchange and retries */
+  for(thread = gc->threads.threads; thread != NULL; thread = thread->next) {
+    if(thread->buffer != NULL) {
+      collector_buffer_release(gc, thread->buffer);
+    }
+  }
+}
+
+static void collector_buffer_detach(
+  EmeraldsCollector *gc, struct EmeraldsCollectorThread *thread, bool release
+) {
+  if(thread->buffer == NULL) {
+    return;
+  }
+  if(release) {
+    collector_buffer_release(gc, thread->buffer);
+  }
+  free(thread->buffer);
+  thread->buffer = NULL;
+}
+
+bool collector_register_thread(EmeraldsCollector *gc, void *stack_base) {
+  bool registered;
+
+  collector_threads_lock(&gc->threads);
+  registered = collector_threads_register(&gc->threads, stack_base);
+  if(registered) {
+    collector_buffer_attach(gc);
+  }
+  collector_threads_unlock(&gc->threads);
+  return registered;
+}
+
+void collector_unregister_thread(EmeraldsCollector *gc) {
+  struct EmeraldsCollectorThread *thread;
+
+  collector_threads_lock(&gc->threads);
+  thread = collector_threads_current(&gc->threads);
+  if(thread != NULL) {
+    collector_buffer_detach(gc, thread, true);
+    collector_threads_unregister(&gc->threads);
+  }
+  collector_threads_unlock(&gc->threads);
+}
+
+void collector_set_interior_pointers(EmeraldsCollector *gc, bool enabled) {
+  collector_threads_lock(&gc->threads);
+  gc->heap.interior_pointers = enabled;
+  collector_threads_unlock(&gc->threads);
+}
+
+void collector_set_generational(
+  EmeraldsCollector *gc, size_t nursery_size, size_t promotion_age
+) {
+  size_t value;
+
+  collector_threads_lock(&gc->threads);
+  if(gc->marking) {
+    collector_mark_finish(gc);
+    collector_sweep(gc);
+  }
+  collector_sweep_finish(gc);
+  collector_heap_set_generational(&gc->heap, nursery_size > 0, promotion_age);
+  for(value = 0; value < COLLECTOR_FLAGS_WORDS(gc->gc_size); value++) {
+    gc->flags.old[value]   = 0;
+    gc->flags.dirty[value] = 0;
+  }
+  for(value = 0; value < gc->gc_size; value++) {
+    gc->flags.age[value] = 0;
+  }
+  for(value = 0; value < gc->large.number_of_objects; value++) {
+    gc->large.objects[value].old   = false;
+    gc->large.objects[value].dirty = false;
+    gc->large.objects[value].age   = 0;
+  }
+  gc->nursery_size = nursery_size;
+  collector_threads_unlock(&gc->threads);
+}
+
+void collector_remember(EmeraldsCollector *gc, void *object) {
+  struct EmeraldsCollectorPage *page;
+  struct EmeraldsCollectorLargeObject *large;
+  struct EmeraldsCollectorGarbage *item;
+  size_t value;
+
+  if(!gc->heap.generational && !gc->incremental) {
+    return;
+  }
+
+  collector_threads_lock(&gc->threads);
+  page  = collector_heap_find_page(&gc->heap, object);
+  large = page == NULL ? collector_large_find(&gc->large, object, true) : NULL;
+  if(page != NULL) {
+    size_t slot = collector_page_slot_of(&gc->heap, page, object);
+    if(slot != COLLECTOR_NO_SLOT && gc->heap.generational) {
+      collector_page_remember(page, slot);
+    }
+    /* A scanned object is scanned again for whatever was stored into it */
+    if(slot != COLLECTOR_NO_SLOT && gc->marking &&
+       page->kind != COLLECTOR_KIND_ATOMIC &&
+       collector_bitmap_test(page->marked, slot)) {
+      collector_worklist_push(
+        &gc->worklist,
+        collector_page_slot_address(page, slot),
+        page->object_size,
+        collector_page_layout(page, slot)
+      );
+    }
+  } else if(large != NULL) {
+    if(gc->heap.generational) {
+      large->dirty = true;
+    }
+    if(gc->marking && large->marked) {
+      collector_mark_large(&gc->worklist, large);
+    }
+  } else if(gc->gc_size > 0) {
+    item = collector_get(gc, object);
+    value = item != NULL ? (size_t)(item - gc->garbage) : 0;
+    if(item != NULL && gc->heap.generational) {
+      collector_bitmap_set(gc->flags.dirty, value);
+    }
+    if(item != NULL && gc->marking &&
+       collector_bitmap_test(gc->flags.marked, value)) {
+      collector_mark_gc_garbage(gc, &gc->worklist, value);
+    }
+  }
+  collector_threads_unlock(&gc->threads);
+}
+
+void collector_set_incremental(EmeraldsCollector *gc, bool enabled) {
+  collector_threads_lock(&gc->threads);
+  if(!enabled && gc->marking) {
+    collector_mark_finish(gc);
+    collector_sweep(gc);
+  }
+  gc->incremental = enabled;
+  collector_threads_unlock(&gc->threads);
+}
+
+bool collector_set_concurrent(EmeraldsCollector *gc, bool enabled) {
+  bool started;
+
+  /* The thread takes the lock for every slice, it is joined without it */
+  if(!enabled) {
+    collector_threads_lock(&gc->threads);
+    gc->concurrent = false;
+    collector_threads_unlock(&gc->threads);
+    collector_background_stop(&gc->background);
+    return true;
+  }
+  collector_threads_lock(&gc->threads);
+  gc->incremental = true;
+  started =
+    collector_background_start(&gc->background, collector_background_work, gc);
+  gc->concurrent = started;
+  if(started && (gc->marking || gc->sweeping)) {
+    collector_background_wake(&gc->background);
+  }
+  collector_threads_unlock(&gc->threads);
+  return started;
+}
+
+size_t collector_compact(EmeraldsCollector *gc) {
+  void (*volatile clear_stack)(void) = collector_clear_stack;
+  clock_t start;
+  size_t released;
+  bool moved;
+
+  collector_threads_lock(&gc->threads);
+  collector_recorder_pause_begin(&gc->recorder);
+  gc->recorder.stats.compactions++;
+  gc->minor = false;
+  collector_mark_begin(gc);
+  start = clock();
+
+  /* Nothing may load a pointer between the move and the fix up. Parked
+      threads may hold the lock of the malloc arena, so nothing in between
+      calls into libc, dead slots are only freed once the world runs */
+  collector_threads_stop_world(&gc->threads);
+  collector_mark_stopped(gc);
+  clear_stack();
+  collector_pin_ambiguous(gc);
+  moved = collector_heap_evacuate(&gc->heap, COLLECTOR_COMPACT_PERCENT) > 0;
+  if(moved) {
+    collector_fix_pointers(gc);
+    collector_finalizers_relocate(
+      &gc->finalizers, collector_locate_forward, gc
+    );
+  }
+  collector_threads_start_world(&gc->threads);
+  collector_notify_finalizers(gc);
+
+  /* The samples are rehashed into a new table, forwarding needs the pages */
+  if(moved) {
+    collector_profile_relocate(&gc->profile, collector_locate_forward, gc);
+  }
+  released = collector_heap_release_evacuated(&gc->heap);
+  collector_sweep(gc);
+  collector_sweep_finish(gc);
+  collector_mark_clock(gc, start);
+  collector_recorder_pause_end(&gc->recorder);
+  collector_threads_unlock(&gc->threads);
+  return released;
+}
+
+void collector_set_retained_memory(EmeraldsCollector *gc, size_t bytes) {
+  collector_threads_lock(&gc->threads);
+  gc->retained_memory = bytes;
+  collector_scavenge(gc);
+  collector_threads_unlock(&gc->threads);
+}
+
+size_t collector_release_memory(EmeraldsCollector *gc) {
+  size_t released;
+
+  collector_threads_lock(&gc->threads);
+  collector_sweep_finish(gc);
+  released = collector_heap_release_free_pages(&gc->heap);
+#if defined(__GLIBC__)
+  malloc_trim(0);
+#endif
+  collector_threads_unlock(&gc->threads);
+  return released;
+}
+
+bool collector_step(EmeraldsCollector *gc, size_t budget_ns) {
+  clock_t start = clock();
+  clock_t budget =
+    (clock_t)((double)budget_ns * CLOCKS_PER_SEC / 1000000000.0);
+  bool started = false;
+  bool done;
+  bool finalize;
+
+  collector_threads_lock(&gc->threads);
+  do {
+    if(gc->sweeping) {
+      collector_sweep_step(
+        gc, COLLECTOR_SWEEP_PAGES_PER_STEP, COLLECTOR_SWEEP_ENTRIES_PER_STEP
+      );
+    } else if(gc->marking) {
+      collector_mark_step(gc, COLLECTOR_MARK_OBJECTS_PER_STEP);
+    } else if(!started && collector_should_collect(gc)) {
+      /* Idle time is spent on the cycle allocations would start next */
+      collector_start_cycle(gc);
+      started = true;
+    } else {
+      break;
+    }
+  } while(clock() - start < budget);
+  done     = !gc->sweeping && !gc->marking;
+  finalize = collector_should_finalize(gc);
+  collector_threads_unlock(&gc->threads);
+
+  if(finalize) {
+    collector_run_finalizers(gc);
+  }
+  return done;
+}
+
+void collector_stats(
+  EmeraldsCollector *gc, struct EmeraldsCollectorStats *stats
+) {
+  collector_threads_lock(&gc->threads);
+  collector_stats_refresh(gc);
+  *stats = gc->recorder.stats;
+  collector_threads_unlock(&gc->threads);
+}
+
+void collector_set_stats_callbacks(
+  EmeraldsCollector *gc,
+  EmeraldsCollectorStatsCallback on_start,
+  EmeraldsCollectorStatsCallback on_end,
+  void *data
+) {
+  collector_threads_lock(&gc->threads);
+  gc->recorder.on_start = on_start;
+  gc->recorder.on_end   = on_end;
+  gc->recorder.data     = data;
+  collector_threads_unlock(&gc->threads);
+}
+
+void collector_set_profile_rate(EmeraldsCollector *gc, size_t rate) {
+  collector_threads_lock(&gc->threads);
+  gc->profile.rate = rate;
+  collector_threads_unlock(&gc->threads);
+}
+
+bool collector_write_profile(EmeraldsCollector *gc, FILE *file, int kind) {
+  bool written;
+
+  collector_threads_lock(&gc->threads);
+  written = collector_profile_write(&gc->profile, file, kind);
+  collector_threads_unlock(&gc->threads);
+  return written;
+}
+
+bool collector_register_finalizer(
+  EmeraldsCollector *gc,
+  void *ptr,
+  EmeraldsCollectorFinalizer finalizer,
+  void *data
+) {
+  bool registered;
+
+  collector_threads_lock(&gc->threads);
+  registered =
+    collector_finalizers_register(&gc->finalizers, ptr, finalizer, data);
+  collector_threads_unlock(&gc->threads);
+  return registered;
+}
+
+size_t collector_run_finalizers(EmeraldsCollector *gc) {
+  struct EmeraldsCollectorFinalizable ready;
+  size_t number_of_finalizers = 0;
+
+  collector_threads_lock(&gc->threads);
+  if(gc->finalizers.running) {
+    collector_threads_unlock(&gc->threads);
+    return 0;
+  }
+
+  /* The object stays on this stack while its finalizer runs unlocked */
+  gc->finalizers.running = true;
+  while(collector_finalizers_pop(&gc->finalizers, &ready)) {
+    collector_threads_unlock(&gc->threads);
+    ready.finalizer(ready.ptr, ready.data);
+    number_of_finalizers++;
+    collector_threads_lock(&gc->threads);
+  }
+  gc->finalizers.running = false;
+  collector_threads_unlock(&gc->threads);
+  return number_of_finalizers;
+}
+
+void collector_set_finalizer_callback(
+  EmeraldsCollector *gc,
+  EmeraldsCollectorFinalizerCallback on_ready,
+  void *data
+) {
+  collector_threads_lock(&gc->threads);
+  gc->finalizers.on_ready = on_ready;
+  gc->finalizers.data     = data;
+  collector_threads_unlock(&gc->threads);
+}
+
+EmeraldsCollectorWeak *collector_weak_new(EmeraldsCollector *gc, void *target) {
+  EmeraldsCollectorWeak *weak;
+
+  collector_threads_lock(&gc->threads);
+  weak = collector_finalizers_weak_new(&gc->finalizers, target);
+  collector_threads_unlock(&gc->threads);
+  return weak;
+}
+
+void *collector_weak_get(EmeraldsCollector *gc, EmeraldsCollectorWeak *weak) {
+  void *target;
+
+  collector_threads_lock(&gc->threads);
+  target = weak->target;
+
+  /* A target handed out while marking may be stored where it was done */
+  if(target != NULL && gc->marking) {
+    collector_iterate_mark(gc, &gc->worklist, target);
+  }
+  collector_threads_unlock(&gc->threads);
+  return target;
+}
+
+void collector_weak_free(EmeraldsCollector *gc, EmeraldsCollectorWeak *weak) {
+  collector_threads_lock(&gc->threads);
+  collector_finalizers_weak_free(&gc->finalizers, weak);
+  collector_threads_unlock(&gc->threads);
+}
+
+bool collector_add_root_range(EmeraldsCollector *gc, void *start, size_t size) {
+  bool added;
+
+  collector_threads_lock(&gc->threads);
+  added = collector_roots_add_range(&gc->roots, start, size);
+  collector_threads_unlock(&gc->threads);
+  return added;
+}
+
+bool collector_remove_root_range(EmeraldsCollector *gc, void *start) {
+  bool removed;
+
+  collector_threads_lock(&gc->threads);
+  removed = collector_roots_remove_range(&gc->roots, start);
+  collector_threads_unlock(&gc->threads);
+  return removed;
+}
+
+bool collector_pin(EmeraldsCollector *gc, void *ptr) {
+  bool pinned;
+
+  collector_threads_lock(&gc->threads);
+  pinned = collector_roots_pin(&gc->roots, ptr);
+  collector_threads_unlock(&gc->threads);
+  return pinned;
+}
+
+void collector_unpin(EmeraldsCollector *gc, void *ptr) {
+  collector_threads_lock(&gc->threads);
+  collector_roots_unpin(&gc->roots, ptr);
+  collector_threads_unlock(&gc->threads);
+}
+
+void *collector_malloc_root(EmeraldsCollector *gc, size_t size) {
+  void *ptr = collector_malloc(gc, size);
+
+  if(ptr != NULL && !collector_pin(gc, ptr)) {
+    collector_free(gc, ptr);
+    return NULL;
+  }
+  return ptr;
+}
+
+static bool collector_should_finalize(EmeraldsCollector *gc) {
+  /* A callback hands the queue to a worker */
+  return gc->finalizers.number_of_ready > 0 &&
+         gc->finalizers.on_ready == NULL && !gc->finalizers.running;
+}
+
+void collector_set_policy(
+  EmeraldsCollector *gc, const struct EmeraldsCollectorPolicy *policy
+) {
+  collector_threads_lock(&gc->threads);
+  gc->policy = *policy;
+  collector_pace(gc);
+  collector_threads_unlock(&gc->threads);
+}
+
+bool collector_set_marker_threads(
+  EmeraldsCollector *gc, size_t number_of_threads
+) {
+  bool started;
+
+  collector_threads_lock(&gc->threads);
+  started = collector_markers_start(&gc->markers, number_of_threads);
+  collector_threads_unlock(&gc->threads);
+  return started;
 }
 
 void collector_terminate(EmeraldsCollector *gc) {
+  struct EmeraldsCollectorThread *thread;
+
+  collector_background_terminate(&gc->background);
+
+  /* With every mark cleared the sweep releases all objects */
+  for(thread = gc->threads.threads; thread != NULL; thread = thread->next) {
+    collector_buffer_detach(gc, thread, false);
+  }
+  gc->marking = false;
+  collector_sweep_finish(gc);
+  collector_unmark_values_for_collection(gc);
   collector_sweep(gc);
+  collector_sweep_finish(gc);
+  collector_heap_terminate(&gc->heap);
+  collector_large_terminate(&gc->large);
+  collector_worklist_terminate(&gc->worklist);
+  collector_markers_terminate(&gc->markers);
+  collector_threads_terminate(&gc->threads);
+  collector_profile_terminate(&gc->profile);
+  collector_finalizers_terminate(&gc->finalizers);
+  collector_roots_terminate(&gc->roots);
   free(gc->garbage);
-  free(gc->list_of_unreachable_elements);
+  free(gc->flags.marked);
 }
 
-void *collector_malloc(EmeraldsCollector *gc, size_t size) {
-  int state = 0;
-  void *ptr = malloc(size);
+static size_t collector_heap_slot_at(
+  EmeraldsCollector *gc, struct EmeraldsCollectorPage *page, void *ptr
+) {
+  size_t slot = collector_page_slot_of(&gc->heap, page, ptr);
+  if(slot != COLLECTOR_NO_SLOT &&
+     collector_page_slot_address(page, slot) != ptr) {
+    return COLLECTOR_NO_SLOT;
+  }
+  return slot;
+}
+
+static void *collector_malloc_small(
+  EmeraldsCollector *gc,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+) {
+  /* Collect before carving the slot, the new object is not reachable yet */
+  collector_allocation_step(gc, 1);
+  if(!collector_reserve(gc, size)) {
+    return NULL;
+  }
+  return collector_carve_small(gc, size, layout);
+}
+
+static void *collector_carve_small(
+  EmeraldsCollector *gc,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+) {
+  void *ptr = collector_heap_allocate_layout(&gc->heap, size, layout);
   if(ptr != NULL) {
-    collector_set(gc, ptr, size, state);
+    gc->number_of_young++;
+    gc->bytes_since_collection += collector_page_of(ptr)->object_size;
+    collector_update_bounds(gc, collector_page_of(ptr), COLLECTOR_PAGE_SIZE);
   }
   return ptr;
 }
 
-void *collector_calloc(EmeraldsCollector *gc, size_t nitems, size_t size) {
-  int state = 0;
-  void *ptr = calloc(nitems, size);
+static void *collector_malloc_large(
+  EmeraldsCollector *gc,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+) {
+  /* Collect before mapping the object, the new object is not reachable yet */
+  collector_allocation_step(gc, 1);
+  if(!collector_reserve(gc, size)) {
+    return NULL;
+  }
+  return collector_carve_large(gc, size, layout);
+}
+
+static void *collector_carve_large(
+  EmeraldsCollector *gc,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+) {
+  void *ptr = collector_large_allocate(&gc->large, size, layout);
   if(ptr != NULL) {
-    collector_set(gc, ptr, nitems * size, state);
+    gc->number_of_young++;
+    gc->bytes_since_collection += size;
+    collector_update_bounds(
+      gc, ptr, collector_large_find(&gc->large, ptr, false)->mapped
+    );
+  }
+  return ptr;
+}
+
+static void *collector_malloc_layout(
+  EmeraldsCollector *gc,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+) {
+  int state = 0;
+  void *ptr;
+
+  if(size <= COLLECTOR_MAX_SMALL_SIZE) {
+    return collector_malloc_small(gc, size, layout);
   }
+  if(size >= COLLECTOR_LARGE_THRESHOLD) {
+    return collector_malloc_large(gc, size, layout);
+  }
+
+  /* Collect before saving the block, a slice must not mark it before the
+      mutator initialized it */
+  collector_allocation_step(gc, 1);
+  if(!collector_reserve(gc, size)) {
+    return NULL;
+  }
+
+  ptr = malloc(size);
+  if(ptr != NULL && !collector_insert(gc, ptr, size, state, layout)) {
+    ptr = NULL;
+  }
+  return ptr;
+}
+
+void *collector_malloc(EmeraldsCollector *gc, size_t size) {
+  return collector_malloc_typed(gc, size, NULL);
+}
+
+void *collector_malloc_atomic(EmeraldsCollector *gc, size_t size) {
+  return collector_malloc_typed(gc, size, COLLECTOR_LAYOUT_ATOMIC);
+}
+
+void *collector_malloc_typed(
+  EmeraldsCollector *gc,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+) {
+  struct EmeraldsCollectorThread *thread =
+    collector_threads_current(&gc->threads);
+  struct EmeraldsCollectorBufferBin *bin = NULL;
+  void *ptr;
+
+  if(thread != NULL && thread->buffer != NULL &&
+     size <= COLLECTOR_MAX_SMALL_SIZE &&
+     collector_heap_kind_of(layout) != COLLECTOR_KIND_TYPED) {
+    bin = &thread->buffer
+             ->bins[collector_heap_class_of(&gc->heap, size, layout)];
+    ptr = collector_buffer_pop(bin);
+    if(ptr != NULL) {
+      return collector_sample(gc, ptr, size);
+    }
+  }
+
+  /* Bins stay empty while marking, fresh objects are white until the
+      mutator initialized them */
+  collector_threads_lock(&gc->threads);
+  if(bin != NULL && !gc->marking) {
+    ptr = collector_buffer_refill(gc, bin, size, layout);
+  } else {
+    ptr = collector_malloc_layout(gc, size, layout);
+  }
+  collector_threads_unlock(&gc->threads);
+  return collector_sample(gc, ptr, size);
+}
+
+static void *collector_sample(EmeraldsCollector *gc, void *ptr, size_t size) {
+  struct EmeraldsCollectorThread *thread;
+  void *frames[COLLECTOR_PROFILE_MAX_FRAMES];
+  size_t number_of_frames;
+  size_t *countdown;
+
+  if(gc->profile.rate == 0 || ptr == NULL) {
+    return ptr;
+  }
+  thread = collector_threads_current(&gc->threads);
+  if(thread == NULL || thread->buffer == NULL) {
+    return ptr;
+  }
+
+  /* Every thread counts down on its own, without taking the lock */
+  countdown = &thread->buffer->bytes_until_sample;
+  if(*countdown == 0) {
+    collector_threads_lock(&gc->threads);
+    *countdown = collector_profile_next(&gc->profile);
+    collector_threads_unlock(&gc->threads);
+  }
+  if(*countdown > size) {
+    *countdown -= size;
+    return ptr;
+  }
+
+  /* The stack is walked before locking, only the record needs the lock */
+  number_of_frames = collector_profile_backtrace(frames, 1);
+  collector_threads_lock(&gc->threads);
+  if(gc->profile.rate != 0) {
+    collector_profile_record(&gc->profile, ptr, size, frames, number_of_frames);
+    *countdown = collector_profile_next(&gc->profile);
+  }
+  collector_threads_unlock(&gc->threads);
   return ptr;
 }
 
+static void *collector_buffer_pop(struct EmeraldsCollectorBufferBin *bin) {
+#if defined(__COLLECTOR_THREADS)
+  size_t number_of_slots =
+    __atomic_load_n(&bin->number_of_slots, __ATOMIC_RELAXED);
+
+  /* The slot is read before it is taken, so it is always in a register
+      or in the bin when a collection parks the thread in between */
+  while(number_of_slots > 0) {
+    void *ptr = bin->slots[number_of_slots - 1];
+    if(__atomic_compare_exchange_n(
+         &bin->number_of_slots,
+         &number_of_slots,
+         number_of_slots - 1,
+         false,
+         __ATOMIC_RELEASE,
+         __ATOMIC_RELAXED
+       )) {
+      return ptr;
+    }
+  }
+  return NULL;
+#else
+  return bin->number_of_slots > 0 ? bin->slots[--bin->number_of_slots] : NULL;
+#endif
+}
+
+static void *collector_buffer_refill(
+  EmeraldsCollector *gc,
+  struct EmeraldsCollectorBufferBin *bin,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+) {
+  size_t i;
+
+  /* The batch is published at once, it pays for all of its allocations */
+  collector_allocation_step(gc, COLLECTOR_BUFFER_SLOTS);
+  if(!collector_reserve(gc, size)) {
+    return NULL;
+  }
+
+  /* The step may have started an incremental cycle, the bin stays empty */
+  if(gc->marking) {
+    return collector_carve_small(gc, size, layout);
+  }
+
+  /* Near the memory limit the batch shrinks to what still fits */
+  for(i = 0; i < COLLECTOR_BUFFER_SLOTS; i++) {
+    if(i > 0 && !collector_fits(gc, size)) {
+      break;
+    }
+    bin->slots[i] = collector_heap_allocate_layout(&gc->heap, size, layout);
+    if(bin->slots[i] == NULL) {
+      break;
+    }
+    collector_update_bounds(
+      gc, collector_page_of(bin->slots[i]), COLLECTOR_PAGE_SIZE
+    );
+    gc->bytes_since_collection += collector_page_of(bin->slots[i])->object_size;
+  }
+  gc->number_of_young += i;
+  if(i == 0) {
+    return NULL;
+  }
+  bin->number_of_slots = i - 1;
+  return bin->slots[i - 1];
+}
+
+size_t collector_malloc_batch(
+  EmeraldsCollector *gc, size_t size, size_t count, void **ptrs
+) {
+  size_t number_of_objects = 0;
+  size_t entries;
+  size_t i;
+
+  if(count == 0 || size * count / count != size) {
+    for(i = 0; i < count; i++) {
+      ptrs[i] = NULL;
+    }
+    return 0;
+  }
+
+  collector_threads_lock(&gc->threads);
+
+  /* The batch pays for all of its allocations with a single check */
+  collector_allocation_step(gc, count);
+  collector_reserve(gc, size * count);
+
+  /* Saved elements find their slots in the table after a single rehash */
+  entries = gc->number_of_garbage + count + 1;
+  if(size > COLLECTOR_MAX_SMALL_SIZE && size < COLLECTOR_LARGE_THRESHOLD &&
+     entries * 4 > gc->gc_size * 3) {
+    collector_rehash(gc, collector_table_size(entries));
+  }
+
+  /* Near the memory limit the batch shrinks to what still fits */
+  while(number_of_objects < count && collector_fits(gc, size)) {
+    void *ptr;
+
+    if(size <= COLLECTOR_MAX_SMALL_SIZE) {
+      ptr = collector_carve_small(gc, size, NULL);
+    } else if(size >= COLLECTOR_LARGE_THRESHOLD) {
+      ptr = collector_carve_large(gc, size, NULL);
+    } else {
+      ptr = malloc(size);
+      if(ptr != NULL && !collector_insert(gc, ptr, size, false, NULL)) {
+        ptr = NULL;
+      }
+    }
+    if(ptr == NULL) {
+      break;
+    }
+    ptrs[number_of_objects++] = ptr;
+  }
+  collector_threads_unlock(&gc->threads);
+
+  for(i = 0; i < number_of_objects; i++) {
+    collector_sample(gc, ptrs[i], size);
+  }
+  for(i = number_of_objects; i < count; i++) {
+    ptrs[i] = NULL;
+  }
+  return number_of_objects;
+}
+
+void *collector_calloc(EmeraldsCollector *gc, size_t nitems, size_t size) {
+  int state = 0;
+  void *ptr;
+
+  if(nitems != 0 && nitems * size / nitems != size) {
+    return NULL;
+  }
+  if(nitems * size <= COLLECTOR_MAX_SMALL_SIZE ||
+     nitems * size >= COLLECTOR_LARGE_THRESHOLD) {
+    /* Conservative heap slots and fresh mappings are always zeroed */
+    return collector_malloc(gc, nitems * size);
+  }
+
+  collector_threads_lock(&gc->threads);
+  collector_allocation_step(gc, 1);
+  if(!collector_reserve(gc, nitems * size)) {
+    collector_threads_unlock(&gc->threads);
+    return NULL;
+  }
+  ptr = calloc(nitems, size);
+  if(ptr != NULL && !collector_insert(gc, ptr, nitems * size, state, NULL)) {
+    ptr = NULL;
+  }
+  collector_threads_unlock(&gc->threads);
+  return collector_sample(gc, ptr, nitems * size);
+}
+
 void *collector_realloc(EmeraldsCollector *gc, void *ptr, size_t new_size) {
+  void *new_ptr;
+
+  collector_threads_lock(&gc->threads);
+  new_ptr = collector_reallocate(gc, ptr, new_size);
+
+  /* The profiler sees the resized block as a new allocation, its
+      finalizer, weak references and pin follow it */
+  if(new_ptr != NULL && ptr != NULL) {
+    collector_profile_forget(&gc->profile, ptr);
+    collector_finalizers_move(&gc->finalizers, ptr, new_ptr);
+    if(new_ptr != ptr && collector_roots_unpin(&gc->roots, ptr)) {
+      collector_roots_pin(&gc->roots, new_ptr);
+    }
+  }
+  collector_threads_unlock(&gc->threads);
+  return collector_sample(gc, new_ptr, new_size);
+}
+
+static void *
+collector_reallocate(EmeraldsCollector *gc, void *ptr, size_t new_size) {
   /* Reallocate memory for the new pointer */
   struct EmeraldsCollectorGarbage *item_to_realloc;
-  void *new_ptr = realloc(ptr, new_size);
+  struct EmeraldsCollectorPage *page;
+  void *new_ptr;
+  size_t growth;
+
+  page = collector_heap_find_page(&gc->heap, ptr);
+  if(page != NULL) {
+    size_t slot = collector_heap_slot_at(gc, page, ptr);
+    if(slot == COLLECTOR_NO_SLOT) {
+      return NULL;
+    }
+
+    /* Slots cannot grow in place, move to a bigger one when needed */
+    if(new_size <= page->object_size) {
+      return ptr;
+    }
+    /* The moved object keeps its kind and layout */
+    new_ptr =
+      collector_malloc_layout(gc, new_size, collector_page_layout(page, slot));
+    if(new_ptr != NULL) {
+      _memcpy(new_ptr, ptr, page->object_size);
+      collector_heap_free(&gc->heap, page, slot);
+    }
+    return new_ptr;
+  }
+  if(new_size >= COLLECTOR_LARGE_THRESHOLD ||
+     collector_large_find(&gc->large, ptr, false) != NULL) {
+    return collector_reallocate_large(gc, ptr, new_size);
+  }
+
+  /* Only the growth of a saved element counts against the memory limit */
+  growth = new_size;
+  if(ptr != NULL && gc->gc_size > 0) {
+    item_to_realloc = collector_get(gc, ptr);
+    if(item_to_realloc != NULL) {
+      growth = item_to_realloc->size < new_size
+                 ? new_size - item_to_realloc->size
+                 : 0;
+    }
+  }
+  if(!collector_reserve(gc, growth)) {
+    return NULL;
+  }
+  new_ptr = realloc(ptr, new_size);
 
   if(new_ptr == NULL) {
     collector_remove(gc, ptr);
     return new_ptr;
   }
   if(ptr == NULL) {
-    collector_set(gc, new_ptr, new_size, 0);
+    collector_set(gc, new_ptr, new_size, 0, NULL);
     return new_ptr;
   }
 
   item_to_realloc = collector_get(gc, ptr);
 
   if(item_to_realloc && new_ptr == ptr) {
+    /* The grown tail can hold anything, the block is remembered */
+    gc->bytes_of_garbage -= item_to_realloc->size;
+    gc->bytes_of_garbage += new_size;
+    gc->bytes_since_collection += growth;
+
     item_to_realloc->size = new_size;
+    collector_bitmap_set(
+      gc->flags.dirty, (size_t)(item_to_realloc - gc->garbage)
+    );
     return new_ptr;
   }
   if(item_to_realloc && new_ptr != ptr) {
-    bool root = item_to_realloc->root;
+    bool root = collector_bitmap_test(
+      gc->flags.root, (size_t)(item_to_realloc - gc->garbage)
+    );
+    const struct EmeraldsCollectorLayout *layout = item_to_realloc->layout;
     collector_remove(gc, ptr);
-    collector_set(gc, new_ptr, new_size, root);
+    collector_set(gc, new_ptr, new_size, root, layout);
     return new_ptr;
   }
 
   return NULL;
 }
 
-void collector_free(EmeraldsCollector *gc, void *ptr) {
-  struct EmeraldsCollectorGarbage *ptr_to_free = collector_get(gc, ptr);
-  if(ptr_to_free) {
-    free(ptr);
+static void *
+collector_reallocate_large(EmeraldsCollector *gc, void *ptr, size_t new_size) {
+  struct EmeraldsCollectorLargeObject *object =
+    collector_large_find(&gc->large, ptr, false);
+  struct EmeraldsCollectorGarbage *item;
+  const struct EmeraldsCollectorLayout *layout = NULL;
+  size_t size                                  = 0;
+  void *new_ptr;
+
+  if(object != NULL) {
+    size_t growth = object->size < new_size ? new_size - object->size : 0;
+    if(!collector_reserve(gc, growth)) {
+      return NULL;
+    }
+
+    /* Reserving may have collected, the descriptors moved around */
+    object = collector_large_find(&gc->large, ptr, false);
+    if(object == NULL) {
+      return NULL;
+    }
+    new_ptr = collector_large_resize(&gc->large, object, new_size);
+    if(new_ptr == NULL) {
+      return NULL;
+    }
+    object = collector_large_find(&gc->large, new_ptr, false);
+    gc->bytes_since_collection += growth;
+    collector_update_bounds(gc, new_ptr, object->mapped);
+
+    /* Chunks queued at the old address are gone, it is traced again */
+    if(new_ptr != ptr && gc->marking) {
+      object->marked = false;
+    }
+    return new_ptr;
+  }
+
+  /* A saved element growing past the threshold moves to a mapping */
+  if(ptr != NULL) {
+    item = gc->gc_size > 0 ? collector_get(gc, ptr) : NULL;
+    if(item == NULL) {
+      return NULL;
+    }
+    layout = item->layout;
+    size   = item->size;
+  }
+  new_ptr = collector_malloc_large(gc, new_size, layout);
+  if(new_ptr != NULL && ptr != NULL) {
+    _memcpy(new_ptr, ptr, size);
     collector_remove(gc, ptr);
+    free(ptr);
+  }
+  return new_ptr;
+}
+
+void collector_free(EmeraldsCollector *gc, void *ptr) {
+  collector_threads_lock(&gc->threads);
+  collector_free_object(gc, ptr);
+  collector_threads_unlock(&gc->threads);
+}
+
+void collector_free_batch(EmeraldsCollector *gc, void **ptrs, size_t count) {
+  size_t i;
+
+  collector_threads_lock(&gc->threads);
+  for(i = 0; i < count; i++) {
+    collector_free_object(gc, ptrs[i]);
+  }
+  collector_threads_unlock(&gc->threads);
+}
+
+static void collector_free_object(EmeraldsCollector *gc, void *ptr) {
+  struct EmeraldsCollectorGarbage *ptr_to_free;
+  struct EmeraldsCollectorLargeObject *object;
+  struct EmeraldsCollectorPage *page;
+
+  collector_profile_forget(&gc->profile, ptr);
+  collector_finalizers_move(&gc->finalizers, ptr, NULL);
+  collector_roots_unpin(&gc->roots, ptr);
+  page   = collector_heap_find_page(&gc->heap, ptr);
+  object = page == NULL ? collector_large_find(&gc->large, ptr, false) : NULL;
+  if(page != NULL) {
+    size_t slot = collector_heap_slot_at(gc, page, ptr);
+    if(slot != COLLECTOR_NO_SLOT) {
+      collector_heap_free(&gc->heap, page, slot);
+    }
+  } else if(object != NULL) {
+    collector_large_free(&gc->large, object);
+  } else if(gc->gc_size > 0) {
+    ptr_to_free = collector_get(gc, ptr);
+    if(ptr_to_free) {
+      collector_remove(gc, ptr);
+      free(ptr);
+    }
   }
 }
@@ -2,10 +2,23 @@
 #define __COLLECTOR_BASE_H_
 
 #include "../../libs/EmeraldsBool/export/EmeraldsBool.h"
+#include "../collector_background/collector_background.h"
+#include "../collector_finalizers/collector_finalizers.h"
+#include "../collector_heap/collector_heap.h"
+#include "../collector_large/collector_large.h"
+#include "../collector_layout/collector_layout.h"
+#include "../collector_markers/collector_markers.h"
+#include "../collector_profile/collector_profile.h"
+#include "../collector_roots/collector_roots.h"
+#include "../collector_scan/collector_scan.h"
+#include "../collector_stats/collector_stats.h"
+#include "../collector_threads/collector_threads.h"
+#include "../collector_worklist/collector_worklist.h"
 
 #include <setjmp.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <time.h>
 
 /* TODO MAKE INTO A MODULE */
 #define __THROW_THE_TRASH_OUT true
@@ -50,6 +63,74 @@
   #define __MAX_UINT (18446744073709551615UL)
 #endif
 
+/* Conservative stack scans read memory that sanitizers consider poisoned */
+#if defined(__GNUC__)
+  #define __COLLECTOR_NO_SANITIZE __attribute__((no_sanitize_address))
+#else
+  #define __COLLECTOR_NO_SANITIZE
+#endif
+
+/**
+ * @brief The work every allocation does while a sweep is pending. The pause
+ *          only covers marking, the sweep is paid for by the allocations
+ *          that follow it
+ **/
+#define COLLECTOR_SWEEP_PAGES_PER_STEP   ((size_t)1)
+#define COLLECTOR_SWEEP_ENTRIES_PER_STEP ((size_t)32)
+
+/**
+ * @brief The objects every allocation scans while an incremental mark
+ *          phase is pending, and the slice `collector_step` checks its
+ *          budget after
+ **/
+#define COLLECTOR_MARK_OBJECTS_PER_STEP ((size_t)32)
+
+/** `collector_compact` empties pages with fewer live slots than this **/
+#define COLLECTOR_COMPACT_PERCENT ((size_t)50)
+
+/** The stack below `collector_compact` zeroed before the pinning scan **/
+#define COLLECTOR_CLEAR_STACK_SIZE ((size_t)4096)
+
+/** The default number of allocations between two minor collections **/
+#define COLLECTOR_NURSERY_SIZE ((size_t)1 << 16)
+
+/** By default the heap may grow by its live size before the next collection **/
+#define COLLECTOR_GROWTH_PERCENT ((size_t)100)
+
+/** Heaps smaller than this are never collected by the trigger alone **/
+#define COLLECTOR_MINIMUM_HEAP ((size_t)4 << 20)
+
+/** Large objects are queued in pieces of this size, markers share them **/
+#define COLLECTOR_LARGE_CHUNK_SIZE ((size_t)1 << 16)
+
+/** Empty pages kept resident for reuse besides the room up to the trigger **/
+#define COLLECTOR_RETAINED_MEMORY ((size_t)1 << 20)
+
+/** The slots a thread takes from a size class whenever its bin runs dry **/
+#define COLLECTOR_BUFFER_SLOTS ((size_t)32)
+
+/** The table of saved elements is a power of two at least this long **/
+#define COLLECTOR_MINIMUM_TABLE_SIZE ((size_t)16)
+
+/**
+ * @brief The word size divided by the golden ratio. Multiplying a pointer
+ *          by it spreads the bits that alignment leaves at zero over the
+ *          top bits of the product, which index the table
+ **/
+#if SIZE_MAX > 4294967295UL
+  #define COLLECTOR_FIBONACCI_MULTIPLIER \
+    (((size_t)0x9e3779b9 << 32) | (size_t)0x7f4a7c15)
+#else
+  #define COLLECTOR_FIBONACCI_MULTIPLIER ((size_t)0x9e3779b9)
+#endif
+
+/**
+ * @brief Conservative and atomic size classes are buffered, typed slots
+ *          need their layout when allocated and always take the lock
+ **/
+#define COLLECTOR_NUMBER_OF_BUFFERED_CLASSES \
+  (2 * COLLECTOR_NUMBER_OF_SIZE_CLASSES)
+
 /* TODO MAKE INTO A MODULE */
 /**
  * @brief Performs integer hashing
@@ -66,44 +147,187 @@ size_t _64bit_integer_hash(void *ptr);
 
 
 /**
- * @brief The definition of the garbage collector element to insert
+ * @brief The definition of the garbage collector element to insert, its
+ *          flags live in the side bitmaps of the table
+ *
  * @param ptr -> The void pointer that is saved
- * @param marked -> A flag signaling if the element is reachable or not
- * @param root -> A flag signaling if the element is a root pointer
  * @param id -> A unique hash value that works as an item id
  * @param size -> The size of the element stored as garbage
+ * @param layout -> NULL for conservative scanning, COLLECTOR_LAYOUT_ATOMIC
+ *                  for elements that are never scanned, or the words of the
+ *                  element that hold pointers
  **/
 struct EmeraldsCollectorGarbage {
   void *ptr;
-  bool marked;
-  bool root;
   size_t id;
   size_t size;
+  const struct EmeraldsCollectorLayout *layout;
+};
+
+/** The flags of an entry, gathered while the entry changes its slot **/
+#define COLLECTOR_ENTRY_MARKED (1U << 0)
+#define COLLECTOR_ENTRY_ROOT   (1U << 1)
+#define COLLECTOR_ENTRY_OLD    (1U << 2)
+#define COLLECTOR_ENTRY_DIRTY  (1U << 3)
+
+/**
+ * @brief The flags of the garbage table, one bit per slot in bitmaps of
+ *          their own so that mark phases and sweeps read a word for a
+ *          whole run of entries. Empty slots keep every bit cleared
+ *
+ * @param marked -> Set for the elements that are reachable
+ * @param root -> Set for the elements that are root pointers
+ * @param old -> Set for the elements that have been promoted
+ * @param dirty -> Set by the write barrier
+ * @param age -> The collections a young element survived, one per slot
+ **/
+struct EmeraldsCollectorGarbageFlags {
+  size_t *marked;
+  size_t *root;
+  size_t *old;
+  size_t *dirty;
+  unsigned char *age;
+};
+
+/** The bitmap words covering `size` slots of the table **/
+#define COLLECTOR_FLAGS_WORDS(size) \
+  (((size) + COLLECTOR_BITS_PER_WORD - 1) / COLLECTOR_BITS_PER_WORD)
+
+/**
+ * @brief Small slots of a single size class reserved by a thread
+ * @param slots -> The batch, handed out from the end
+ * @param number_of_slots -> The slots not handed out yet
+ **/
+struct EmeraldsCollectorBufferBin {
+  void *slots[COLLECTOR_BUFFER_SLOTS];
+  size_t number_of_slots;
+};
+
+/**
+ * @brief A thread local allocation buffer. Allocations pop a slot from
+ *          their bin without locking, only refills take the lock. Every
+ *          collection gives the slots left in the bins back to the heap
+ *
+ * @param bins -> One bin per buffered size class
+ * @param bytes_until_sample -> The bytes the thread allocates before the
+ *                              profiler samples again, 0 until drawn
+ **/
+struct EmeraldsCollectorAllocationBuffer {
+  struct EmeraldsCollectorBufferBin bins[COLLECTOR_NUMBER_OF_BUFFERED_CLASSES];
+  size_t bytes_until_sample;
+};
+
+/**
+ * @brief Decides when collections run. After every full collection the
+ *          next one is scheduled once the heap grows by `growth_percent`
+ *          of the bytes that survived. When the collector spent more than
+ *          `cpu_percent` of the time marking, the heap grows further so
+ *          that, at the measured allocation rate, marking stays within
+ *          the target. The schedule never goes below `minimum_heap` or
+ *          above `memory_limit`
+ *
+ * @param growth_percent -> The growth allowed over the live bytes,
+ *                          COLLECTOR_GROWTH_PERCENT by default
+ * @param memory_limit -> The bytes the heap may never exceed, allocations
+ *                        that would exceed it collect everything first
+ *                        and fail when that does not make room, 0 for none
+ * @param cpu_percent -> The share of time marking may take, 0 for no target
+ * @param minimum_heap -> The heap size below which no collection is
+ *                        triggered, COLLECTOR_MINIMUM_HEAP by default
+ **/
+struct EmeraldsCollectorPolicy {
+  size_t growth_percent;
+  size_t memory_limit;
+  size_t cpu_percent;
+  size_t minimum_heap;
 };
 
 /**
  * @brief The object defining the garbage collector
  * @param garbage -> A list of garbage* elements to store
- * @param list_of_unreachable_elements -> The list of garbage* to free
- * @param gc_size -> The size of the gc
+ * @param flags -> The flags of every slot of `garbage`
+ * @param gc_size -> The size of the gc, a power of two
+ * @param hash_shift -> Keeps the top bits of a hash that index the table
  * @param number_of_garbage -> The number of saved elements
- * @param available_memory_slots -> The number of available spots
- *                                  for garbage before resizing
+ * @param bytes_of_garbage -> The bytes taken by the saved elements
+ * @param collection_trigger -> The heap bytes that start the next
+ *                              full collection
+ * @param policy -> How `collection_trigger` is scheduled
+ * @param retained_memory -> The bytes of empty pages kept resident
+ * @param bytes_since_collection -> The bytes allocated since the last
+ *                                  full mark phase started
+ * @param allocation_rate -> The bytes allocated per clock tick between
+ *                           the last two full mark phases
+ * @param mark_time -> The clock ticks the last full mark phase spent
+ *                     marking, its slices summed up
+ * @param end_of_mark -> The clock when the last full mark phase ended
  * @param high_memory_bound -> A very high number
  * @param low_memory_bound -> A very low (positive) number
- * @param bottom_of_stack -> The variable holding the current stack 'esp'
- * @param number_of_unreachable_elements -> The count of items to be deleted
+ * @param bottom_of_stack -> The stack base of the thread that created the gc
+ * @param sweep_cursor -> The next garbage entry the pending sweep visits
+ * @param sweeping -> Set from the end of a mark phase until every page
+ *                    and garbage entry has been swept
+ * @param minor -> Set while a collection only traces the young generation
+ * @param marking -> Set from the start of a mark phase until the roots
+ *                   have been scanned and the worklist drained
+ * @param incremental -> Set when mark phases are spread over allocations
+ * @param concurrent -> Set while `background` marks instead of them
+ * @param pinning -> Set while stack words pin the slots they point at
+ *                   instead of marking them
+ * @param number_of_young -> The allocations since the last collection
+ * @param nursery_size -> The allocations that trigger a minor collection
+ * @param heap -> The size classed pages serving every small allocation,
+ *                only allocations that do not fit are saved as garbage
+ * @param large -> The objects of at least COLLECTOR_LARGE_THRESHOLD bytes,
+ *                 every one of them mapped on its own
+ * @param worklist -> The objects marked but not scanned yet
+ * @param markers -> The thread pool draining the worklist in parallel
+ * @param threads -> The mutator threads whose stacks are scanned for roots
+ * @param background -> The thread marking and sweeping next to the
+ *                      mutators in concurrent mode
+ * @param recorder -> The statistics of every cycle and pause
+ * @param profile -> The sampled allocations and their call stacks
+ * @param finalizers -> The objects with finalizers or weak references,
+ *                      and the finalizers waiting to run
+ * @param roots -> The blocks scanned next to the stacks, like the data and
+ *                 bss of the program, and the pinned objects
  **/
 typedef struct EmeraldsCollector {
   struct EmeraldsCollectorGarbage *garbage;
-  struct EmeraldsCollectorGarbage *list_of_unreachable_elements;
+  struct EmeraldsCollectorGarbageFlags flags;
   size_t gc_size;
+  size_t hash_shift;
   size_t number_of_garbage;
-  size_t available_memory_slots;
+  size_t bytes_of_garbage;
+  size_t collection_trigger;
+  struct EmeraldsCollectorPolicy policy;
+  size_t retained_memory;
+  size_t bytes_since_collection;
+  double allocation_rate;
+  clock_t mark_time;
+  clock_t end_of_mark;
   size_t high_memory_bound;
   size_t low_memory_bound;
   void *bottom_of_stack;
-  size_t number_of_unreachable_elements;
+  size_t sweep_cursor;
+  bool sweeping;
+  bool minor;
+  bool marking;
+  bool incremental;
+  bool concurrent;
+  bool pinning;
+  size_t number_of_young;
+  size_t nursery_size;
+  struct EmeraldsCollectorHeap heap;
+  struct EmeraldsCollectorLargeSpace large;
+  struct EmeraldsCollectorWorklist worklist;
+  struct EmeraldsCollectorMarkers markers;
+  struct EmeraldsCollectorThreads threads;
+  struct EmeraldsCollectorBackground background;
+  struct EmeraldsCollectorRecorder recorder;
+  struct EmeraldsCollectorProfile profile;
+  struct EmeraldsCollectorFinalizers finalizers;
+  struct EmeraldsCollectorRoots roots;
 } EmeraldsCollector;
 
 /**
@@ -115,6 +339,358 @@ typedef struct EmeraldsCollector {
  **/
 void collector_new(EmeraldsCollector *gc, void *stack_base);
 
+/**
+ * @brief Lets the calling thread use the collector. Every thread other
+ *          than the one that created the collector has to register before
+ *          its first call and unregister before it exits. Collections
+ *          stop all registered threads with a signal and scan their
+ *          stacks and registers, so the signal must not be blocked
+ *
+ * @param gc -> The collector to use
+ * @param stack_base -> The address of a variable in the outermost frame
+ *                      of the thread that uses the collector
+ * @return false if the thread could not be recorded
+ **/
+bool collector_register_thread(EmeraldsCollector *gc, void *stack_base);
+
+/**
+ * @brief Stops scanning the stack of the calling thread, objects only it
+ *          referenced become collectable
+ *
+ * @param gc -> The collector to use
+ **/
+void collector_unregister_thread(EmeraldsCollector *gc);
+
+/**
+ * @brief Decides whether a pointer into the middle of a heap object keeps
+ *          the object alive. Enabled by default, disabling it only lets
+ *          exact base pointers retain objects which limits false retention
+ *
+ * @param gc -> The collector to configure
+ * @param enabled -> true to recognize interior pointers
+ **/
+void collector_set_interior_pointers(EmeraldsCollector *gc, bool enabled);
+
+/**
+ * @brief Turns generational collection on or off. Survivors of
+ *          `promotion_age` collections move to the old generation, which
+ *          is only traced once the heap outgrows its limit. In between,
+ *          minor collections run every `nursery_size` allocations and
+ *          trace the roots plus the old objects recorded by `wwrite`.
+ *          Every pointer stored into an already allocated object has to
+ *          go through `wwrite` (or `collector_remember`) in this mode
+ *
+ * @param gc -> The collector to configure
+ * @param nursery_size -> Allocations between minor collections, 0 for off
+ * @param promotion_age -> The collections an object survives before it
+ *                         is promoted, at most COLLECTOR_MAX_PROMOTION_AGE
+ **/
+void collector_set_generational(
+  EmeraldsCollector *gc, size_t nursery_size, size_t promotion_age
+);
+
+/**
+ * @brief Replaces the policy that schedules collections. The next
+ *          collection is rescheduled from the current heap size
+ *
+ * @param gc -> The collector to configure
+ * @param policy -> The policy to copy
+ **/
+void collector_set_policy(
+  EmeraldsCollector *gc, const struct EmeraldsCollectorPolicy *policy
+);
+
+/**
+ * @brief Turns incremental marking on or off. Collections then only
+ *          queue what the roots and stacks point at, and every allocation
+ *          scans a few marked objects until none are left. A last slice
+ *          stops the world to scan the stacks and registers and to drain
+ *          what they reach. Marked objects are scanned again once `wwrite`
+ *          records a store into them. Objects are handed out unmarked and
+ *          only a slice marks them, so the stores initializing an object
+ *          before the thread allocates again need no barrier. Every other
+ *          pointer store has to go through `wwrite` (or
+ *          `collector_remember`) in this mode, and so do initializing
+ *          stores while other threads allocate or the background thread
+ *          of concurrent mode marks
+ *
+ * @param gc -> The collector to configure
+ * @param enabled -> true to spread mark phases over allocations
+ **/
+void collector_set_incremental(EmeraldsCollector *gc, bool enabled);
+
+/**
+ * @brief Collects everything and compacts the heap, a mostly copying
+ *          collection. Slots pointed at by a word of a stack, a register,
+ *          a global, a root range or a conservative object stay in place,
+ *          and so does every slot sharing a page with them. The other live
+ *          slots of sparse pages move into denser pages of their size
+ *          class, and the pointer words of typed objects, weak references
+ *          and finalizers are updated. Pointers kept where the collector
+ *          does not look, like memory from malloc, are not updated and go
+ *          stale once their object moves. The emptied pages join the free
+ *          page pool. Saved elements bigger than the size classes never
+ *          move. Other threads are only stopped to mark, move and fix the
+ *          pointers, the sweep and the callbacks run after they resume
+ *
+ * @param gc -> The collector to compact
+ * @return The number of pages emptied
+ **/
+size_t collector_compact(EmeraldsCollector *gc);
+
+/**
+ * @brief Sets how much memory of empty heap pages stays resident for
+ *          reuse. Whenever a sweep completes, the empty pages the heap
+ *          cannot grow into before its next collection is due are handed
+ *          back to the system, unless they fit in `bytes`. Defaults to
+ *          COLLECTOR_RETAINED_MEMORY
+ *
+ * @param gc -> The collector to configure
+ * @param bytes -> The bytes of empty pages to retain
+ **/
+void collector_set_retained_memory(EmeraldsCollector *gc, size_t bytes);
+
+/**
+ * @brief Completes the pending sweep and unmaps every empty heap page.
+ *          Elements bigger than the size classes are already freed
+ *          to libc, which is asked to trim its free memory on glibc
+ *
+ * @param gc -> The collector to shrink
+ * @return The number of bytes unmapped
+ **/
+size_t collector_release_memory(EmeraldsCollector *gc);
+
+/**
+ * @brief Moves marking and sweeping to a background thread. Collections
+ *          turn incremental, the mutator that starts one only scans the
+ *          stacks and wakes the thread. The thread marks in slices while
+ *          the mutators keep running and stops them once more to rescan
+ *          the stacks at the end. Allocations only help marking once the
+ *          heap outgrows its trigger by half. Disabling it joins the
+ *          thread and leaves incremental marking on
+ *
+ * @param gc -> The collector to configure
+ * @param enabled -> true to start the background thread
+ * @return false if the thread could not be created
+ **/
+bool collector_set_concurrent(EmeraldsCollector *gc, bool enabled);
+
+/**
+ * @brief Does pending collection work until the budget runs out, meant
+ *          for the idle time of an event loop. Pending sweeps and
+ *          incremental mark phases make progress, and a collection that
+ *          is due is started. Without incremental marking that start
+ *          marks the whole heap at once. The last slice of a mark phase
+ *          scans every stack and may overrun the budget. Time is measured
+ *          as process time with `clock`
+ *
+ * @param gc -> The collector to use
+ * @param budget_ns -> The nanoseconds the call may take
+ * @return true if no collection work is left pending
+ **/
+bool collector_step(EmeraldsCollector *gc, size_t budget_ns);
+
+/**
+ * @brief Copies the statistics of the collector, the counters since it
+ *          was created, its current heap and table sizes and the last
+ *          completed cycle
+ *
+ * @param gc -> The collector to read
+ * @param stats -> The statistics to fill
+ **/
+void collector_stats(
+  EmeraldsCollector *gc, struct EmeraldsCollectorStats *stats
+);
+
+/**
+ * @brief Sets the callbacks called at the start and at the end of every
+ *          collection cycle, meant for exporting the statistics. A cycle
+ *          starts with its mark phase and ends once its sweep completed.
+ *          The callbacks run on the thread doing the work, the background
+ *          thread in concurrent mode, and must not call into the collector
+ *
+ * @param gc -> The collector to configure
+ * @param on_start -> Called when a cycle starts, NULL for none
+ * @param on_end -> Called when a cycle ends, NULL for none
+ * @param data -> Passed to both callbacks
+ **/
+void collector_set_stats_callbacks(
+  EmeraldsCollector *gc,
+  EmeraldsCollectorStatsCallback on_start,
+  EmeraldsCollectorStatsCallback on_end,
+  void *data
+);
+
+/**
+ * @brief Turns sampling heap profiling on or off. Allocations are sampled
+ *          every `rate` bytes on average and the call stack of each sample
+ *          is kept until its object is collected or freed. Off by default,
+ *          COLLECTOR_PROFILE_RATE keeps the overhead low enough to leave
+ *          it on. Call stacks come from `backtrace`, only on glibc and
+ *          Apple platforms, and threads without an allocation buffer are
+ *          not sampled
+ *
+ * @param gc -> The collector to configure
+ * @param rate -> The mean bytes allocated between two samples, 0 for off
+ **/
+void collector_set_profile_rate(EmeraldsCollector *gc, size_t rate);
+
+/**
+ * @brief Writes a heap profile in the folded stack format, the estimated
+ *          live heap per call stack, or the allocation rate between the
+ *          last two collections. Frames are named from the dynamic symbol
+ *          table, link with `-rdynamic` to name the functions of the
+ *          program itself
+ *
+ * @param gc -> The collector to read
+ * @param file -> The file to write to
+ * @param kind -> One of the COLLECTOR_PROFILE_* profiles
+ * @return false if writing failed
+ **/
+bool collector_write_profile(EmeraldsCollector *gc, FILE *file, int kind);
+
+/**
+ * @brief Sets the finalizer of an object, replacing the one it had. Once a
+ *          collection finds the object unreachable the finalizer is queued
+ *          and the object kept alive, along with everything it points at,
+ *          until the finalizer ran. Objects freed explicitly drop theirs.
+ *          Finalizers of objects dying together run in no particular order
+ *
+ * @param gc -> The collector owning the object
+ * @param ptr -> An object returned by the collector
+ * @param finalizer -> Runs once the object died, NULL to drop the one set
+ * @param data -> Passed to the finalizer
+ * @return false if there was no memory to watch the object
+ **/
+bool collector_register_finalizer(
+  EmeraldsCollector *gc,
+  void *ptr,
+  EmeraldsCollectorFinalizer finalizer,
+  void *data
+);
+
+/**
+ * @brief Runs the queued finalizers on the calling thread, which has to
+ *          be registered, without holding the lock. Explicit collections
+ *          and steps run them as well unless a callback was set, programs
+ *          relying on neither call this or hand it to a worker thread
+ *
+ * @param gc -> The collector to use
+ * @return The number of finalizers run, 0 while another thread runs them
+ **/
+size_t collector_run_finalizers(EmeraldsCollector *gc);
+
+/**
+ * @brief Sets the callback told when collections queued finalizers. A
+ *          worker woken by it calls `collector_run_finalizers`, and
+ *          explicit collections leave the queue to it
+ *
+ * @param gc -> The collector to configure
+ * @param on_ready -> Called with the collector locked once the other
+ *                   threads resumed, NULL for none
+ * @param data -> Passed to the callback
+ **/
+void collector_set_finalizer_callback(
+  EmeraldsCollector *gc,
+  EmeraldsCollectorFinalizerCallback on_ready,
+  void *data
+);
+
+/**
+ * @brief Creates a weak reference, that does not keep `target` alive. It
+ *          is kept outside of the collector and freed by its owner
+ *
+ * @param gc -> The collector owning the target
+ * @param target -> An object returned by the collector, or NULL
+ * @return The new reference, NULL if there was no memory
+ **/
+EmeraldsCollectorWeak *collector_weak_new(EmeraldsCollector *gc, void *target);
+
+/**
+ * @brief Reads a weak reference
+ * @param gc -> The collector owning the target
+ * @param weak -> The reference to read
+ * @return The target, NULL once a collection found it unreachable or it
+ *          was freed explicitly
+ **/
+void *collector_weak_get(EmeraldsCollector *gc, EmeraldsCollectorWeak *weak);
+
+/**
+ * @brief Frees a weak reference, its target is not affected
+ * @param gc -> The collector owning the target
+ * @param weak -> The reference to free, or NULL
+ **/
+void collector_weak_free(EmeraldsCollector *gc, EmeraldsCollectorWeak *weak);
+
+/**
+ * @brief Scans a block of memory the collector does not own for pointers
+ *          on every collection, like the thread local storage of a thread
+ *          or a buffer of a custom allocator. The data and bss of the
+ *          program are scanned from the start. Objects the block points
+ *          at stay alive and never move
+ *
+ * @param gc -> The collector to use
+ * @param start -> The first byte of the block
+ * @param size -> The size of the block in bytes
+ * @return false if there was no memory to register the block
+ **/
+bool collector_add_root_range(EmeraldsCollector *gc, void *start, size_t size);
+
+/**
+ * @brief Stops scanning a block added by `collector_add_root_range`
+ * @param gc -> The collector to use
+ * @param start -> The first byte of the block, as it was added
+ * @return false if no block started there
+ **/
+bool collector_remove_root_range(EmeraldsCollector *gc, void *start);
+
+/**
+ * @brief Keeps an object alive and in place until it is unpinned, for
+ *          objects only referenced from memory the collector cannot see.
+ *          Pins do not nest, freeing the object drops its pin
+ *
+ * @param gc -> The collector owning the object
+ * @param ptr -> An object returned by the collector
+ * @return false if there was no memory to pin the object
+ **/
+bool collector_pin(EmeraldsCollector *gc, void *ptr);
+
+/**
+ * @brief Lets a pinned object die once it is unreachable
+ * @param gc -> The collector owning the object
+ * @param ptr -> The pinned object
+ **/
+void collector_unpin(EmeraldsCollector *gc, void *ptr);
+
+/**
+ * @brief Allocates an object that is pinned from the start
+ * @param gc -> The collector to use
+ * @param size -> The size of the memory block to allocate
+ * @return The new memory, NULL if there was no memory to pin it
+ **/
+void *collector_malloc_root(EmeraldsCollector *gc, size_t size);
+
+/**
+ * @brief The write barrier, records that an object was written to
+ * @param gc -> The collector owning the object
+ * @param object -> The object that was written to
+ **/
+void collector_remember(EmeraldsCollector *gc, void *object);
+
+/**
+ * @brief Sets the number of threads draining the mark phase. The thread
+ *          running the collection marks too, so `number_of_threads - 1`
+ *          helper threads are started. Marking is serial by default,
+ *          0 or 1 turns parallel marking back off
+ *
+ * @param gc -> The collector to configure
+ * @param number_of_threads -> The number of marker threads
+ * @return false if the helper threads could not be started
+ **/
+bool collector_set_marker_threads(
+  EmeraldsCollector *gc, size_t number_of_threads
+);
+
 /**
  * @brief Sweeps for the remaining elements and stops the collector
  * @param gc -> The collector to stop
@@ -136,6 +712,50 @@ void collector_collect(EmeraldsCollector *gc);
  **/
 void *collector_malloc(EmeraldsCollector *gc, size_t size);
 
+/**
+ * @brief Allocates memory that never holds pointers, like strings or
+ *          pixel buffers. The block is not zeroed and never scanned, so
+ *          its contents cannot falsely retain other objects
+ *
+ * @param gc -> The collector to use
+ * @param size -> The size of the memory block to allocate
+ * @return The newly created memory
+ **/
+void *collector_malloc_atomic(EmeraldsCollector *gc, size_t size);
+
+/**
+ * @brief Allocates memory that is scanned precisely. Only the words marked
+ *          in `layout` are traced, repeating the layout for arrays
+ *
+ * @param gc -> The collector to use
+ * @param size -> The size of the memory block to allocate
+ * @param layout -> The pointer words of the block, has to outlive the block
+ * @return The newly created memory
+ **/
+void *collector_malloc_typed(
+  EmeraldsCollector *gc,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+);
+
+/**
+ * @brief Allocates many objects of the same size at once, like the nodes
+ *          of a graph being built. The batch runs a single collection
+ *          check, reserves its table slots in a single rehash and carves
+ *          small objects from consecutive heap slots. The objects are
+ *          scanned conservatively and only survive while reachable, so
+ *          `ptrs` has to live on the stack or in the collector
+ *
+ * @param gc -> The collector to use
+ * @param size -> The size of every object
+ * @param count -> The number of objects to allocate
+ * @param ptrs -> Receives the objects, NULL for the ones that failed
+ * @return The number of objects allocated, the first ones in `ptrs`
+ **/
+size_t collector_malloc_batch(
+  EmeraldsCollector *gc, size_t size, size_t count, void **ptrs
+);
+
 /**
  * @brief Allocates and initializes a memory block, and saves it
  * @param gc -> The collector to use
@@ -161,6 +781,14 @@ void *collector_realloc(EmeraldsCollector *gc, void *ptr, size_t new_size);
  **/
 void collector_free(EmeraldsCollector *gc, void *ptr);
 
+/**
+ * @brief Deallocates many objects at once, taking the lock a single time
+ * @param gc -> The collector to use
+ * @param ptrs -> The pointers to free of memory, NULL ones are skipped
+ * @param count -> The number of pointers
+ **/
+void collector_free_batch(EmeraldsCollector *gc, void **ptrs, size_t count);
+
 /**
  * @brief An equivalent replacement of the standard 'memset'
  *          for setting bytes to a char ptr
@@ -180,7 +808,10 @@ static void _memset(void *src, char ch, size_t size);
 static void _memcpy(void *dest, void *src, size_t size);
 
 /**
- * @brief Flush all used registers to zero to prepare them for marking
+ * @brief Spill all callee saved registers into a buffer on the stack and
+ *          scan the stack from within the same frame, so that pointers
+ *          living only inside of registers are seen by the stack scan
+ *
  * @param gc -> The collector to use
  **/
 static void collector_mark_register_memory(EmeraldsCollector *gc);
@@ -196,160 +827,917 @@ static void collector_mark_register_memory(EmeraldsCollector *gc);
 static void collector_mark_volatile_stack(EmeraldsCollector *gc);
 
 /**
- * @brief Mark all sub pointers under a root value
+ * @brief Mark the words of a memory block that may hold pointers
  * @param gc -> The collector to use
- * @param value -> The index to start iterating from
+ * @param worklist -> The worklist receiving newly marked objects
+ * @param ptr -> The start of the block
+ * @param size -> The size of the block in bytes
+ * @param layout -> The pointer words of the block, NULL for every word
  **/
-static void collector_mark_gc_garbage(EmeraldsCollector *gc, size_t value);
+static void collector_mark_memory(
+  EmeraldsCollector *gc,
+  struct EmeraldsCollectorWorklist *worklist,
+  void *ptr,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+);
 
 /**
- * @brief Start the mark phase by first marking root values and sub elements
- *          then zeroing out all registers and then marking all stack elements
- *
+ * @brief Queue the sub pointers under a root value for scanning
  * @param gc -> The collector to use
+ * @param worklist -> The worklist receiving the value
+ * @param value -> The index to start iterating from
  **/
-static void collector_mark(EmeraldsCollector *gc);
+static void collector_mark_gc_garbage(
+  EmeraldsCollector *gc,
+  struct EmeraldsCollectorWorklist *worklist,
+  size_t value
+);
 
 /**
- * @brief Find the stack boundaries and mark all values in between
- *          The stack is obviously considered as a free and reachable
- *          memory space which, being contiguous is easy to scan iteratevly
+ * @brief Queue the body of a large object in chunks, so that parallel
+ *          markers split it and incremental slices stay short
  *
- * @param gc -> The collector to use
+ * @param worklist -> The worklist receiving the chunks
+ * @param object -> The marked large object
  **/
-static void collector_mark_stack(EmeraldsCollector *gc);
+static void collector_mark_large(
+  struct EmeraldsCollectorWorklist *worklist,
+  struct EmeraldsCollectorLargeObject *object
+);
 
 /**
- * @brief Iterate through root values and mark all subsequent nodes
+ * @brief The scan callback handed to the parallel markers
  * @param gc -> The collector to use
- * @param ptr -> The pointer to mark
+ * @param worklist -> The worklist of the calling marker
+ * @param item -> The object to scan
  **/
-static void collector_iterate_mark(EmeraldsCollector *gc, void *ptr);
-
+static void collector_mark_scan_item(
+  void *gc,
+  struct EmeraldsCollectorWorklist *worklist,
+  struct EmeraldsCollectorWorkItem *item
+);
 
 /**
- * @brief Memset all memory nodes to zero
+ * @brief Scan queued objects until the worklist is empty
  * @param gc -> The collector to use
- * @param value -> The hashed value of the pointer location
  **/
-static void
-collector_zero_out_memory_subtrees(EmeraldsCollector *gc, size_t value);
+static void collector_mark_pop_all(EmeraldsCollector *gc);
 
 /**
- * @brief Reallocate the list of elements to be freed
+ * @brief Scan the body of every marked object again, used after the
+ *          worklist overflowed and dropped some objects unscanned
+ *
  * @param gc -> The collector to use
- * @return The reallocated list
  **/
-static void *collector_resize_list_of(EmeraldsCollector *gc);
+static void collector_mark_rescan(EmeraldsCollector *gc);
 
 /**
- * @brief Check for marked or root elements (those are considered reachable)
+ * @brief Finish the mark phase by scanning every queued object,
+ *          rescanning the marked objects as long as the worklist overflows
+ *
  * @param gc -> The collector to use
- * @return The number of elements
  **/
-static size_t collector_count_unreachable_pointers(EmeraldsCollector *gc);
+static void collector_mark_drain(EmeraldsCollector *gc);
 
 /**
- * @brief Create the list of unreachable elements and increase the count
+ * @brief Start the mark phase by clearing the marks of the previous one
+ *          and queueing the root values saved in the collector, and the
+ *          stacks when marking is incremental. Starting over while a
+ *          phase is pending abandons it
+ *
  * @param gc -> The collector to use
  **/
-static void collector_setup_freelist(EmeraldsCollector *gc);
+static void collector_mark_begin(EmeraldsCollector *gc);
 
 /**
- * @brief Unmark elements for the pending garbage collection
+ * @brief End the mark phase with the world stopped by zeroing out all
+ *          registers, marking all stack elements and draining the worklist
+ *
  * @param gc -> The collector to use
  **/
-static void collector_unmark_values_for_collection(EmeraldsCollector *gc);
+static void collector_mark_finish(EmeraldsCollector *gc);
 
 /**
- * @brief Start the sweep phase by unmarking unreachable
- *      elements and clearing them from memory space
- *
- * @param gc -> The collector to use
+ * @brief Marks the roots of the stopped threads and drains the worklist
+ * @param gc -> The collector to use, with every other thread stopped
  **/
-static void collector_sweep(EmeraldsCollector *gc);
+static void collector_mark_stopped(EmeraldsCollector *gc);
 
+/**
+ * @brief Scans at most `number_of_objects` queued objects
+ * @param gc -> The collector to use
+ * @param number_of_objects -> The objects to pop from the worklist
+ * @return true if the worklist is empty
+ **/
+static bool
+collector_mark_slice(EmeraldsCollector *gc, size_t number_of_objects);
 
 /**
- * @brief Decrease the size of the collector by a factor of 1.5
- *          Using a 1.5 factor is the most efficient approximation
- *          for saving memory space and avoiding fragmentation.
- *          1.5 is very close to the ideal 1.618 (golden ratio)
- *          at which ratio allocations and deallocations produce
- *          the least fragmented memory blocks in general
+ * @brief Marks a slice of a pending mark phase, and ends it and queues
+ *          the sweep once the worklist runs dry
  *
  * @param gc -> The collector to use
- * @return true if the resize is successfull
+ * @param number_of_objects -> The objects to scan in this slice
+ * @return true if the mark phase ended
  **/
-static bool collector_decrease_size(EmeraldsCollector *gc);
+static bool
+collector_mark_step(EmeraldsCollector *gc, size_t number_of_objects);
 
 /**
- * @brief Increase the size of the collector by a factor of 1.5
+ * @brief Adds the time a piece of a full mark phase took to its total
  * @param gc -> The collector to use
- * @return true if the resize is successfull
+ * @param start -> The clock when the piece started
  **/
-static bool collector_increase_size(EmeraldsCollector *gc);
+static void collector_mark_clock(EmeraldsCollector *gc, clock_t start);
 
 /**
- * @brief Rehash all elements of the gc to a newly allocated space with
- *      the new size provided by the increase or descrease of size
+ * @brief Find the stack boundaries and mark all values in between
+ *          The stack is obviously considered as a free and reachable
+ *          memory space which, being contiguous is easy to scan iteratevly
  *
  * @param gc -> The collector to use
- * @param new_size -> The new size to reallocate
- * @return true if the rehash is successfull
  **/
-static bool collector_rehash(EmeraldsCollector *gc, size_t new_size);
+static void collector_mark_stack(EmeraldsCollector *gc);
 
 /**
- * @brief Validates if the hash of a specific element is positive
- *          When we hash an element the result is a positive non zero
- *          number. We use this function to perform a linear search of
- *          the elements that are hashed. If the function returns correctly
- *          it means that we found a position in memory that contains a gc
- *index
+ * @brief Mark the stacks and registers of the threads parked by the
+ *          stop of the world
  *
  * @param gc -> The collector to use
- * @param index -> The index to search
- * @return The position of our pointer in memory
  **/
-static size_t
-collector_validate_item(EmeraldsCollector *gc, size_t index, size_t id);
-
+static void collector_mark_threads(EmeraldsCollector *gc);
 
 /**
- * @brief Check for memory bounds before adding a new value to the collector
+ * @brief Mark the registered blocks and the pinned objects, or pin what
+ *          the blocks point at while pinning
+ *
  * @param gc -> The collector to use
- * @param size -> The size of the new pointer we want to add
- * @param root -> The state of the pointer
  **/
-static void
-collector_set(EmeraldsCollector *gc, void *ptr, size_t size, bool root);
+static void collector_mark_roots(EmeraldsCollector *gc);
 
 /**
- * @brief Add a new value to the collector. A new addition can either be a
- *          root value of a sub value of another root, hence the parameter
+ * @brief Mark every word between two stack addresses, both included and in
+ *          either order, also used for the blocks of the roots
  *
  * @param gc -> The collector to use
- * @param ptr -> The pointer to add
- * @param size -> The size of the pointer
- * @param root -> The state of the pointer
+ * @param esp -> The top of the stack
+ * @param ebp -> The bottom of the stack, nothing is marked for NULL
  **/
 static void
-collector_set_ptr(EmeraldsCollector *gc, void *ptr, size_t size, bool root);
+collector_mark_range(EmeraldsCollector *gc, void *esp, void *ebp);
 
 /**
- * @brief Get the value of a specific pointer on the collector
- *          Used specifically when we want to arbitrarily free
- *          some memory location or when we want to use realloc
- *          so that every memory segment of the collector is
- *          moved correctly to the new spot
- *
- * @param gc -> The collector used
- * @param ptr -> The pointer to get
- * @return The garbage object containing the pointer
+ * @brief Marks a word of a stack, or pins what it points at while pinning
+ * @param gc -> The collector to use
+ * @param ptr -> The ambiguous word
  **/
-static struct EmeraldsCollectorGarbage *
-collector_get(EmeraldsCollector *gc, void *ptr);
+static void collector_mark_word(EmeraldsCollector *gc, void *ptr);
+
+/**
+ * @brief Keeps the heap slot an ambiguous word points at in place
+ * @param gc -> The collector to use
+ * @param ptr -> The ambiguous word
+ **/
+static void collector_pin_word(EmeraldsCollector *gc, void *ptr);
+
+/**
+ * @brief Pins the slots every word of a block points at
+ * @param gc -> The collector to use
+ * @param ptr -> The block
+ * @param size -> The size of the block in bytes
+ **/
+static void
+collector_pin_memory(EmeraldsCollector *gc, void *ptr, size_t size);
+
+/**
+ * @brief Zeroes `COLLECTOR_CLEAR_STACK_SIZE` bytes of the stack below the
+ *          caller, so that dead frames hold no stale addresses
+ **/
+static void collector_clear_stack(void);
+
+/**
+ * @brief Pins every slot an ambiguous word of a live object, a root or a
+ *          stopped thread points at, after marking and before sweeping
+ *
+ * @param gc -> The collector to use
+ **/
+static void collector_pin_ambiguous(EmeraldsCollector *gc);
+
+/**
+ * @brief Rewrites the pointer words of a typed block that point at
+ *          moved slots
+ *
+ * @param gc -> The collector to use
+ * @param ptr -> The block
+ * @param size -> The size of the block in bytes
+ * @param layout -> The layout repeated over the block
+ **/
+static void collector_fix_memory(
+  EmeraldsCollector *gc,
+  void *ptr,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+);
+
+/**
+ * @brief Rewrites every pointer to a moved slot held by a typed object
+ * @param gc -> The collector to use
+ **/
+static void collector_fix_pointers(EmeraldsCollector *gc);
+
+/**
+ * @brief Mark a candidate pointer and queue it on the worklist, so that
+ *          all subsequent nodes get marked once the worklist is drained
+ *
+ * @param gc -> The collector to use
+ * @param worklist -> The worklist receiving newly marked objects
+ * @param ptr -> The pointer to mark
+ **/
+static void collector_iterate_mark(
+  EmeraldsCollector *gc, struct EmeraldsCollectorWorklist *worklist, void *ptr
+);
+
+/**
+ * @brief Set the mark flag of a large object, atomically while parallel
+ *          markers are running
+ *
+ * @param gc -> The collector to use
+ * @param marked -> The flag to set
+ * @return true if this call was the one marking the object
+ **/
+static bool collector_mark_entry(EmeraldsCollector *gc, bool *marked);
+
+/**
+ * @brief Set a mark bit, atomically while parallel markers are running
+ * @param gc -> The collector to use
+ * @param bitmap -> The mark bitmap
+ * @param bit -> The bit to set
+ * @return true if this call was the one setting the bit
+ **/
+static bool
+collector_mark_bit(EmeraldsCollector *gc, size_t *bitmap, size_t bit);
+
+/**
+ * @brief Check if a word points at an object of the young generation
+ * @param gc -> The collector to use
+ * @param ptr -> The candidate pointer
+ * @return true for young objects, false for old objects and other words
+ **/
+static bool collector_is_young(EmeraldsCollector *gc, void *ptr);
+
+/**
+ * @brief Mark the young objects a remembered old object points at
+ * @param gc -> The collector to use
+ * @param ptr -> The start of the old object
+ * @param size -> The size of the old object in bytes
+ * @param layout -> The pointer words of the object, NULL for every word
+ * @return true if the object still points into the young generation
+ **/
+static bool collector_mark_remembered_object(
+  EmeraldsCollector *gc,
+  void *ptr,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+);
+
+/**
+ * @brief Use the dirty old objects as extra roots of a minor collection
+ * @param gc -> The collector to use
+ **/
+static void collector_mark_remembered(EmeraldsCollector *gc);
+
+/**
+ * @brief Mark a slot of the size classed heap and queue it for scanning
+ * @param gc -> The collector to use
+ * @param worklist -> The worklist receiving the slot
+ * @param page -> The page containing the candidate pointer
+ * @param ptr -> The candidate pointer
+ **/
+static void collector_mark_heap_object(
+  EmeraldsCollector *gc,
+  struct EmeraldsCollectorWorklist *worklist,
+  struct EmeraldsCollectorPage *page,
+  void *ptr
+);
+
+
+/**
+ * @brief Memset all memory nodes to zero
+ * @param gc -> The collector to use
+ * @param value -> The hashed value of the pointer location
+ **/
+static void
+collector_zero_out_memory_subtrees(EmeraldsCollector *gc, size_t value);
+
+/**
+ * @brief Unmark elements for the pending garbage collection, the table
+ *          is cleared a bitmap word at a time
+ *
+ * @param gc -> The collector to use
+ **/
+static void collector_unmark_values_for_collection(EmeraldsCollector *gc);
+
+/**
+ * @brief Count a survived collection for a young entry and promote it once
+ *          it is old enough
+ *
+ * @param gc -> The collector to use
+ * @param value -> The index of the entry the sweep is visiting
+ **/
+static void collector_age_entry(EmeraldsCollector *gc, size_t value);
+
+/**
+ * @brief Sweep a single entry of the table in place. Unmarked entries are
+ *          freed and leave a hole, live ones are moved back over the holes
+ *          left before them as far as their home position allows
+ *
+ * @param gc -> The collector to use
+ * @param value -> The index of the entry
+ * @param holes -> The number of empty slots right before the entry
+ * @return The number of empty slots right after the entry
+ **/
+static size_t
+collector_sweep_entry(EmeraldsCollector *gc, size_t value, size_t holes);
+
+/**
+ * @brief Free the unmarked entries of the next slice of the table and
+ *          compact the survivors in the same pass. Marks are left in
+ *          place, they are cleared when the next mark phase starts
+ *
+ * @param gc -> The collector to use
+ * @param number_of_entries -> The most entries to visit
+ * @return true when the whole table has been swept
+ **/
+static bool
+collector_sweep_table(EmeraldsCollector *gc, size_t number_of_entries);
+
+/**
+ * @brief Start the sweep phase after marking, the unreachable elements
+ *          are cleared from memory space by the following allocations
+ *
+ * @param gc -> The collector to use
+ **/
+static void collector_sweep(EmeraldsCollector *gc);
+
+/**
+ * @brief Sweep a bounded slice of the pending sweep, the collector is
+ *          resized once nothing is left to sweep
+ *
+ * @param gc -> The collector to use
+ * @param number_of_pages -> The most heap pages to sweep
+ * @param number_of_entries -> The most garbage entries to visit
+ **/
+static void collector_sweep_step(
+  EmeraldsCollector *gc, size_t number_of_pages, size_t number_of_entries
+);
+
+/**
+ * @brief Sweep everything left of the pending sweep
+ * @param gc -> The collector to use
+ **/
+static void collector_sweep_finish(EmeraldsCollector *gc);
+
+/**
+ * @brief Pay a slice of the pending sweep or incremental mark phase, or
+ *          start a collection once the heap outgrew its trigger
+ *
+ * @param gc -> The collector to use
+ * @param number_of_allocations -> The allocations paying, a refilled
+ *                                 buffer pays for its whole batch
+ **/
+static void collector_allocation_step(
+  EmeraldsCollector *gc, size_t number_of_allocations
+);
+
+/**
+ * @brief Starts a collection, which only queues its roots when marking
+ *          is incremental and marks and queues the sweep otherwise
+ *
+ * @param gc -> The collector to use
+ **/
+static void collector_start_cycle(EmeraldsCollector *gc);
+
+/**
+ * @brief Does a slice of the pending mark or sweep on the background
+ *          thread, taking the lock for the slice only
+ *
+ * @param collector -> The collector to use
+ * @return true if no work is left pending
+ **/
+static bool collector_background_work(void *collector);
+
+/**
+ * @brief Checks whether an allocation has to mark a slice itself
+ *          although a background thread marks
+ *
+ * @param gc -> The collector to use
+ * @return true if the allocation helps marking
+ **/
+static bool collector_should_assist(EmeraldsCollector *gc);
+
+/**
+ * @brief Give the calling thread its own allocation buffer
+ * @param gc -> The collector to use
+ **/
+static void collector_buffer_attach(EmeraldsCollector *gc);
+
+/**
+ * @brief Free the allocation buffer of a thread
+ * @param gc -> The collector to use
+ * @param thread -> The thread owning the buffer
+ * @param release -> Whether the slots not handed out go back to the heap
+ **/
+static void collector_buffer_detach(
+  EmeraldsCollector *gc, struct EmeraldsCollectorThread *thread, bool release
+);
+
+/**
+ * @brief Reserve a new batch of slots once a bin runs dry
+ * @param gc -> The collector to use
+ * @param bin -> The empty bin to refill
+ * @param size -> The size of the requested allocation
+ * @param layout -> NULL or COLLECTOR_LAYOUT_ATOMIC
+ * @return The first slot of the batch, or NULL if none could be reserved
+ **/
+static void *collector_buffer_refill(
+  EmeraldsCollector *gc,
+  struct EmeraldsCollectorBufferBin *bin,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+);
+
+/**
+ * @brief Take a slot from a bin of the calling thread without locking
+ * @param bin -> The bin to take from
+ * @return The slot or NULL when the bin is empty
+ **/
+static void *collector_buffer_pop(struct EmeraldsCollectorBufferBin *bin);
+
+/**
+ * @brief Give the slots left in a buffer back to the heap
+ * @param gc -> The collector to use
+ * @param buffer -> The buffer to empty
+ **/
+static void collector_buffer_release(
+  EmeraldsCollector *gc, struct EmeraldsCollectorAllocationBuffer *buffer
+);
+
+/**
+ * @brief Empty the buffers of every thread while the world is stopped, so
+ *          reserved slots are never mistaken for live or dead objects
+ *
+ * @param gc -> The collector to use
+ **/
+static void collector_buffer_flush(EmeraldsCollector *gc);
+
+/**
+ * @brief Check if the heap has outgrown the collection trigger, or the
+ *          nursery is full, and a collection is due
+ *
+ * @param gc -> The collector to use
+ * @return true if a collection should run
+ **/
+static bool collector_should_collect(EmeraldsCollector *gc);
+
+/**
+ * @brief The bytes taken by the heap slots and the saved elements
+ * @param gc -> The collector to use
+ * @return The number of bytes
+ **/
+static size_t collector_heap_bytes(EmeraldsCollector *gc);
+
+/**
+ * @brief The heap slots, the saved elements and the large objects in use
+ * @param gc -> The collector to use
+ * @return The number of objects
+ **/
+static size_t collector_live_objects(EmeraldsCollector *gc);
+
+/**
+ * @brief Counts an allocation towards the next sample of the profiler and
+ *          records it when its turn came
+ *
+ * @param gc -> The collector to use, unlocked
+ * @param ptr -> The allocated object, NULL if the allocation failed
+ * @param size -> The bytes requested for it
+ * @return `ptr`
+ **/
+static void *collector_sample(EmeraldsCollector *gc, void *ptr, size_t size);
+
+/**
+ * @brief Decides whether an object survived the last mark phase, for the
+ *          profiler and the finalizers to follow
+ *
+ * @param ptr -> The object
+ * @param collector -> The collector, past its mark phase
+ * @return `ptr` if it is marked, NULL if the sweep frees it
+ **/
+static void *collector_locate_live(void *ptr, void *collector);
+
+/**
+ * @brief Follows an object to where compaction moved it
+ * @param ptr -> The object
+ * @param collector -> The collector that moved it
+ * @return The new address of the object
+ **/
+static void *collector_locate_forward(void *ptr, void *collector);
+
+/**
+ * @brief Marks the objects waiting for their finalizers
+ * @param gc -> The collector to use, marking
+ **/
+static void collector_mark_ready(EmeraldsCollector *gc);
+
+/**
+ * @brief Clears the weak references of the objects found unreachable and
+ *          queues their finalizers, keeping those objects alive
+ *
+ * @param gc -> The collector to use, done marking
+ **/
+static void collector_mark_finalizable(EmeraldsCollector *gc);
+
+/**
+ * @brief Tells the finalizer callback about the finalizers the last pause
+ *          queued. Parked threads may hold locks the callback takes, so
+ *          it only runs once they resumed
+ *
+ * @param gc -> The collector to use, with the world started
+ **/
+static void collector_notify_finalizers(EmeraldsCollector *gc);
+
+/**
+ * @brief Decides whether an explicit collection runs the queued finalizers
+ * @param gc -> The collector to use, locked
+ * @return true if finalizers wait and no worker was set up for them
+ **/
+static bool collector_should_finalize(EmeraldsCollector *gc);
+
+/**
+ * @brief Copies the current heap and table sizes into the statistics
+ * @param gc -> The collector to use
+ **/
+static void collector_stats_refresh(EmeraldsCollector *gc);
+
+/**
+ * @brief Starts counting a cycle and calls its start callback
+ * @param gc -> The collector to use
+ **/
+static void collector_cycle_begin(EmeraldsCollector *gc);
+
+/**
+ * @brief Ends the cycle in progress and calls its end callback
+ * @param gc -> The collector to use
+ **/
+static void collector_cycle_end(EmeraldsCollector *gc);
+
+/**
+ * @brief Measures the allocation rate since the previous full mark
+ *          phase ended, the current one starts its time from zero
+ *
+ * @param gc -> The collector to use
+ * @param start -> The clock when the current mark phase started
+ **/
+static void collector_measure(EmeraldsCollector *gc, clock_t start);
+
+/**
+ * @brief Schedules the next full collection from the bytes that survived
+ *          the last one, following the policy
+ *
+ * @param gc -> The collector to use
+ **/
+static void collector_pace(EmeraldsCollector *gc);
+
+/**
+ * @brief Decommits the empty pages past the retained memory and the room
+ *          left before the next collection is due
+ *
+ * @param gc -> The collector to use
+ **/
+static void collector_scavenge(EmeraldsCollector *gc);
+
+/**
+ * @brief Marks and sweeps the whole heap, old generation included
+ * @param gc -> The collector to use
+ **/
+static void collector_collect_all(EmeraldsCollector *gc);
+
+/**
+ * @brief Makes sure an allocation stays within the memory limit,
+ *          collecting everything once when it would not
+ *
+ * @param gc -> The collector to use
+ * @param size -> The bytes about to be allocated
+ * @return false if the allocation would exceed the limit
+ **/
+static bool collector_reserve(EmeraldsCollector *gc, size_t size);
+
+/**
+ * @brief Checks the memory limit without collecting
+ * @param gc -> The collector to use
+ * @param size -> The bytes about to be allocated
+ * @return true if the allocation fits
+ **/
+static bool collector_fits(EmeraldsCollector *gc, size_t size);
+
+/**
+ * @brief Shrink the table once it is less than a quarter full, back to
+ *          the smallest power of two that keeps it at most three quarters
+ *          full. The gap between the two keeps the table from resizing
+ *          back and forth around a single size
+ *
+ * @param gc -> The collector to use
+ * @return true if the resize is successfull
+ **/
+static bool collector_decrease_size(EmeraldsCollector *gc);
+
+/**
+ * @brief Double the table once it would be more than three quarters full
+ * @param gc -> The collector to use
+ * @return true if the resize is successfull
+ **/
+static bool collector_increase_size(EmeraldsCollector *gc);
+
+/**
+ * @brief The table size that holds a number of elements at most three
+ *          quarters full
+ *
+ * @param number_of_elements -> The elements the table has to hold
+ * @return A power of two of at least COLLECTOR_MINIMUM_TABLE_SIZE
+ **/
+static size_t collector_table_size(size_t number_of_elements);
+
+/**
+ * @brief Rehash all elements of the gc to a newly allocated space with
+ *      the new size provided by the increase or descrease of size
+ *
+ * @param gc -> The collector to use
+ * @param new_size -> The new size to reallocate
+ * @return true if the rehash is successfull
+ **/
+static bool collector_rehash(EmeraldsCollector *gc, size_t new_size);
+
+/**
+ * @brief Allocate the flags of a table, every bit and age cleared
+ * @param flags -> The flags to allocate, in a single block
+ * @param size -> The number of slots of the table
+ * @return true if the allocation is successfull
+ **/
+static bool
+collector_flags_new(struct EmeraldsCollectorGarbageFlags *flags, size_t size);
+
+/**
+ * @brief Gather the flags of a slot
+ * @param flags -> The flags of the table
+ * @param value -> The index of the slot
+ * @return The COLLECTOR_ENTRY_* flags set for the slot
+ **/
+static unsigned collector_flags_get(
+  const struct EmeraldsCollectorGarbageFlags *flags, size_t value
+);
+
+/**
+ * @brief Set or clear every flag of a slot at once
+ * @param flags -> The flags of the table
+ * @param value -> The index of the slot
+ * @param entry_flags -> The COLLECTOR_ENTRY_* flags to leave set
+ **/
+static void collector_flags_put(
+  struct EmeraldsCollectorGarbageFlags *flags,
+  size_t value,
+  unsigned entry_flags
+);
+
+/**
+ * @brief Write an entry with its flags and age into a slot
+ * @param gc -> The collector to use
+ * @param value -> The index of the slot
+ * @param item -> The entry to write
+ * @param entry_flags -> The COLLECTOR_ENTRY_* flags of the entry
+ * @param age -> The age of the entry
+ **/
+static void collector_entry_store(
+  EmeraldsCollector *gc,
+  size_t value,
+  const struct EmeraldsCollectorGarbage *item,
+  unsigned entry_flags,
+  unsigned char age
+);
+
+/**
+ * @brief Move an entry with its flags and age to another slot
+ * @param gc -> The collector to use
+ * @param to -> The index of the empty slot receiving the entry
+ * @param from -> The index of the entry, empty afterwards
+ **/
+static void collector_entry_move(EmeraldsCollector *gc, size_t to, size_t from);
+
+/**
+ * @brief Empty a slot and clear its flags
+ * @param gc -> The collector to use
+ * @param value -> The index of the slot
+ **/
+static void collector_entry_clear(EmeraldsCollector *gc, size_t value);
+
+/**
+ * @brief Validates if the hash of a specific element is positive
+ *          When we hash an element the result is a positive non zero
+ *          number. We use this function to perform a linear search of
+ *          the elements that are hashed. If the function returns correctly
+ *          it means that we found a position in memory that contains a gc
+ *index
+ *
+ * @param gc -> The collector to use
+ * @param index -> The index to search
+ * @param id -> The id of the element found at `index`
+ * @return The distance of the element from its home position
+ **/
+static size_t
+collector_validate_item(EmeraldsCollector *gc, size_t index, size_t id);
+
+/**
+ * @brief The home slot of a pointer in the table, by Fibonacci hashing.
+ *          The table is a power of two, so there is no division
+ *
+ * @param gc -> The collector to use
+ * @param ptr -> The pointer to place
+ * @return The slot the search for `ptr` starts from
+ **/
+static size_t collector_home(EmeraldsCollector *gc, void *ptr);
+
+
+/**
+ * @brief Widen the memory bounds so they contain a new memory block
+ * @param gc -> The collector to use
+ * @param ptr -> The start of the new block
+ * @param size -> The size of the new block
+ **/
+static void
+collector_update_bounds(EmeraldsCollector *gc, void *ptr, size_t size);
+
+/**
+ * @brief Check for memory bounds before adding a new value to the collector
+ * @param gc -> The collector to use
+ * @param size -> The size of the new pointer we want to add
+ * @param root -> The state of the pointer
+ * @param layout -> The layout the pointer is scanned with
+ **/
+static void collector_set(
+  EmeraldsCollector *gc,
+  void *ptr,
+  size_t size,
+  bool root,
+  const struct EmeraldsCollectorLayout *layout
+);
+
+/**
+ * @brief Saves a new value in the table, growing it when full, without
+ *          checking for a collection
+ *
+ * @param gc -> The collector to use
+ * @param ptr -> The new pointer, freed when the table cannot grow
+ * @param size -> The size of the new pointer
+ * @param root -> The state of the pointer
+ * @param layout -> The layout the pointer is scanned with
+ * @return false if the table could not grow
+ **/
+static bool collector_insert(
+  EmeraldsCollector *gc,
+  void *ptr,
+  size_t size,
+  bool root,
+  const struct EmeraldsCollectorLayout *layout
+);
+
+/**
+ * @brief Add a new value to the collector. A new addition can either be a
+ *          root value of a sub value of another root, hence the parameter
+ *
+ * @param gc -> The collector to use
+ * @param ptr -> The pointer to add
+ * @param size -> The size of the pointer
+ * @param root -> The state of the pointer
+ * @param layout -> The layout the pointer is scanned with
+ **/
+static void collector_set_ptr(
+  EmeraldsCollector *gc,
+  void *ptr,
+  size_t size,
+  bool root,
+  const struct EmeraldsCollectorLayout *layout
+);
+
+/**
+ * @brief Insert a prepared element, its id is derived from its pointer
+ * @param gc -> The collector to use
+ * @param item -> The element to insert
+ * @param entry_flags -> The COLLECTOR_ENTRY_* flags of the element
+ * @param age -> The age of the element
+ **/
+static void collector_set_item(
+  EmeraldsCollector *gc,
+  struct EmeraldsCollectorGarbage item,
+  unsigned entry_flags,
+  unsigned char age
+);
+
+/**
+ * @brief Get the value of a specific pointer on the collector
+ *          Used specifically when we want to arbitrarily free
+ *          some memory location or when we want to use realloc
+ *          so that every memory segment of the collector is
+ *          moved correctly to the new spot
+ *
+ * @param gc -> The collector used
+ * @param ptr -> The pointer to get
+ * @return The garbage object containing the pointer
+ **/
+static struct EmeraldsCollectorGarbage *
+collector_get(EmeraldsCollector *gc, void *ptr);
+
+/**
+ * @brief Resolve the slot of a heap object from its exact base address,
+ *          as required by free and realloc even with interior pointers
+ *
+ * @param gc -> The collector to use
+ * @param page -> The page containing the pointer
+ * @param ptr -> The pointer to resolve
+ * @return The slot index or COLLECTOR_NO_SLOT
+ **/
+static size_t collector_heap_slot_at(
+  EmeraldsCollector *gc, struct EmeraldsCollectorPage *page, void *ptr
+);
+
+/**
+ * @brief Allocate a small object from the size classed heap, running
+ *          a collection first when the heap has outgrown its slots
+ *
+ * @param gc -> The collector to use
+ * @param size -> The size of the object, at most COLLECTOR_MAX_SMALL_SIZE
+ * @param layout -> The layout the object is scanned with
+ * @return The newly created memory
+ **/
+static void *collector_malloc_small(
+  EmeraldsCollector *gc,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+);
+
+/**
+ * @brief Carve a small object from the size classed heap, without
+ *          checking for a collection
+ *
+ * @param gc -> The collector to use
+ * @param size -> The size of the object, at most COLLECTOR_MAX_SMALL_SIZE
+ * @param layout -> The layout the object is scanned with
+ * @return The newly created memory
+ **/
+static void *collector_carve_small(
+  EmeraldsCollector *gc,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+);
+
+/**
+ * @brief Map a large object of its own, running a collection first
+ *          when one is due
+ *
+ * @param gc -> The collector to use
+ * @param size -> The size of the object, at least COLLECTOR_LARGE_THRESHOLD
+ * @param layout -> The layout the object is scanned with
+ * @return The newly created memory
+ **/
+static void *collector_malloc_large(
+  EmeraldsCollector *gc,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+);
+
+/**
+ * @brief Map a large object of its own, without checking for a collection
+ * @param gc -> The collector to use
+ * @param size -> The size of the object, at least COLLECTOR_LARGE_THRESHOLD
+ * @param layout -> The layout the object is scanned with
+ * @return The newly created memory
+ **/
+static void *collector_carve_large(
+  EmeraldsCollector *gc,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+);
+
+/**
+ * @brief Allocate an object of any size scanned with `layout`
+ * @param gc -> The collector to use
+ * @param size -> The size of the object
+ * @param layout -> NULL, COLLECTOR_LAYOUT_ATOMIC or the pointer words
+ * @return The newly created memory
+ **/
+static void *collector_malloc_layout(
+  EmeraldsCollector *gc,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+);
 
 /**
  * @brief Remove a pointer from the garbage collector
@@ -358,6 +1746,35 @@ collector_get(EmeraldsCollector *gc, void *ptr);
  **/
 static void collector_remove(EmeraldsCollector *gc, void *ptr);
 
+/**
+ * @brief Frees an object of any kind with the collector lock held
+ * @param gc -> The collector to use
+ * @param ptr -> The object to free, unknown pointers are ignored
+ **/
+static void collector_free_object(EmeraldsCollector *gc, void *ptr);
+
+/**
+ * @brief Changes the size of an object with the collector lock held
+ * @param gc -> The collector to use
+ * @param ptr -> The object to resize
+ * @param new_size -> The new size in bytes
+ * @return The resized object or NULL
+ **/
+static void *
+collector_reallocate(EmeraldsCollector *gc, void *ptr, size_t new_size);
+
+/**
+ * @brief Resizes a large object in place, or moves a saved element that
+ *          grew past COLLECTOR_LARGE_THRESHOLD into a mapping of its own
+ *
+ * @param gc -> The collector to use
+ * @param ptr -> The object to resize, or NULL
+ * @param new_size -> The new size in bytes
+ * @return The resized object or NULL
+ **/
+static void *
+collector_reallocate_large(EmeraldsCollector *gc, void *ptr, size_t new_size);
+
 
 
 /* If our collector is activated then set the
@@ -367,21 +1784,15 @@ static void collector_remove(EmeraldsCollector *gc, void *ptr);
   #define ccalloc(nitems, size)   collector_calloc(&gc, nitems, size)
   #define rrealloc(ptr, new_size) collector_realloc(&gc, ptr, new_size)
   #define ffree(ptr)              collector_free(&gc, ptr)
+  #define wwrite(object, field, value) \
+    ((object)->field = (value), collector_remember(&gc, object))
 #else
   /* Fall back to stdlib methods */
   #define mmalloc(size)           malloc(size)
   #define ccalloc(nitems, size)   calloc(nitems, size)
   #define rrealloc(ptr, new_size) realloc(ptr, new_size)
   #define ffree(ptr)              free(ptr)
-#endif
-
-/* Define a hash function acoording to the OS */
-#if defined(__ENVIRONMENT_WIN_64) || defined(__ENVIRONMENT_NIX_64) || \
-  defined(__ENVIRONMENT_APPLE_64)
-  #define collector_hash(ptr) _64bit_integer_hash(ptr)
-
-#elif defined(__ENVIRONMENT_WIN_32) || defined(__ENVIRONMENT_NIX_32)
-  #define collector_hash(ptr) _32bit_integer_hash(ptr)
+  #define wwrite(object, field, value) ((object)->field = (value))
 #endif
 
 #endif
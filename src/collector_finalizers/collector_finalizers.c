@@ -0,0 +1,392 @@
+#include "collector_finalizers.h"
+
+#include <stdlib.h>
+
+#define COLLECTOR_FINALIZERS_INITIAL_SIZE ((size_t)64)
+
+static size_t collector_finalizers_hash(void *ptr) {
+  size_t key = (size_t)ptr;
+  key        = ((key >> 16) ^ key) * 0x45d9f3b;
+  key        = ((key >> 16) ^ key) * 0x45d9f3b;
+  return (key >> 16) ^ key;
+}
+
+static struct EmeraldsCollectorFinalizable *collector_finalizers_slot(
+  struct EmeraldsCollectorFinalizable *entries, size_t size, void *ptr
+) {
+  size_t slot = collector_finalizers_hash(ptr) & (size - 1);
+
+  while(entries[slot].ptr != NULL && entries[slot].ptr != ptr) {
+    slot = (slot + 1) & (size - 1);
+  }
+  return &entries[slot];
+}
+
+static struct EmeraldsCollectorFinalizable *collector_finalizers_find(
+  struct EmeraldsCollectorFinalizers *finalizers, void *ptr
+) {
+  struct EmeraldsCollectorFinalizable *entry;
+
+  if(finalizers->number_of_entries == 0 || ptr == NULL) {
+    return NULL;
+  }
+  entry = collector_finalizers_slot(
+    finalizers->entries, finalizers->entries_size, ptr
+  );
+  return entry->ptr != NULL ? entry : NULL;
+}
+
+/* Points every weak reference of a chain at `target` */
+static void
+collector_finalizers_retarget(EmeraldsCollectorWeak *weak, void *target) {
+  while(weak != NULL) {
+    EmeraldsCollectorWeak *next = weak->next;
+
+    weak->target = target;
+    if(target == NULL) {
+      weak->prev = NULL;
+      weak->next = NULL;
+    }
+    weak = next;
+  }
+}
+
+static void collector_finalizers_delete(
+  struct EmeraldsCollectorFinalizers *finalizers,
+  struct EmeraldsCollectorFinalizable *entry
+) {
+  size_t mask = finalizers->entries_size - 1;
+  size_t slot = (size_t)(entry - finalizers->entries);
+  size_t next = slot;
+
+  /* Linear probing closes the gap by shifting the entries after it back */
+  while(true) {
+    size_t home;
+
+    next = (next + 1) & mask;
+    if(finalizers->entries[next].ptr == NULL) {
+      break;
+    }
+    home = collector_finalizers_hash(finalizers->entries[next].ptr) & mask;
+    if(((next - home) & mask) >= ((next - slot) & mask)) {
+      finalizers->entries[slot] = finalizers->entries[next];
+      slot                      = next;
+    }
+  }
+  finalizers->entries[slot].ptr = NULL;
+  finalizers->number_of_entries--;
+}
+
+/* Moves the entries into a fresh table, `locate` decides where they go */
+static size_t collector_finalizers_rebuild(
+  struct EmeraldsCollectorFinalizers *finalizers,
+  struct EmeraldsCollectorFinalizable *entries,
+  size_t size,
+  void *(*locate)(void *ptr, void *data),
+  void *data
+) {
+  size_t number_of_queued = 0;
+  size_t i;
+
+  for(i = 0; i < size; i++) {
+    entries[i].ptr = NULL;
+  }
+  finalizers->number_of_entries = 0;
+  for(i = 0; i < finalizers->entries_size; i++) {
+    struct EmeraldsCollectorFinalizable entry = finalizers->entries[i];
+    void *ptr;
+
+    if(entry.ptr == NULL) {
+      continue;
+    }
+    ptr = locate != NULL ? locate(entry.ptr, data) : entry.ptr;
+    if(ptr == NULL) {
+      /* Weak references are cleared before the finalizer can resurrect */
+      collector_finalizers_retarget(entry.weak, NULL);
+      if(entry.finalizer != NULL) {
+        entry.weak = NULL;
+        finalizers->ready
+          [finalizers->ready_start + finalizers->number_of_ready++] = entry;
+        number_of_queued++;
+      }
+      continue;
+    }
+    if(ptr != entry.ptr) {
+      collector_finalizers_retarget(entry.weak, ptr);
+      entry.ptr = ptr;
+    }
+    *collector_finalizers_slot(entries, size, ptr) = entry;
+    finalizers->number_of_entries++;
+  }
+  finalizers->entries      = entries;
+  finalizers->entries_size = size;
+  return number_of_queued;
+}
+
+/* Moves the queue of finalizers back to the front of its array */
+static void
+collector_finalizers_rewind(struct EmeraldsCollectorFinalizers *finalizers) {
+  size_t i;
+
+  for(i = 0; i < finalizers->number_of_ready; i++) {
+    finalizers->ready[i] = finalizers->ready[finalizers->ready_start + i];
+  }
+  finalizers->ready_start = 0;
+}
+
+/* Sets memory aside for one more watched object and its finalizer */
+static bool
+collector_finalizers_reserve(struct EmeraldsCollectorFinalizers *finalizers) {
+  struct EmeraldsCollectorFinalizable *entries;
+  struct EmeraldsCollectorFinalizable *spare;
+  size_t capacity =
+    finalizers->number_of_ready + finalizers->number_of_entries + 1;
+  size_t size;
+
+  if(finalizers->ready_start + capacity > finalizers->ready_capacity) {
+    collector_finalizers_rewind(finalizers);
+  }
+  if(capacity > finalizers->ready_capacity) {
+    struct EmeraldsCollectorFinalizable *ready = realloc(
+      finalizers->ready,
+      capacity * 2 * sizeof(struct EmeraldsCollectorFinalizable)
+    );
+    if(ready == NULL) {
+      return false;
+    }
+    finalizers->ready          = ready;
+    finalizers->ready_capacity = capacity * 2;
+  }
+
+  /* The table stays at most half full */
+  if((finalizers->number_of_entries + 1) * 2 <= finalizers->entries_size) {
+    return true;
+  }
+  size    = finalizers->entries_size == 0 ? COLLECTOR_FINALIZERS_INITIAL_SIZE
+                                          : finalizers->entries_size * 2;
+  entries = malloc(size * sizeof(struct EmeraldsCollectorFinalizable));
+  spare   = malloc(size * sizeof(struct EmeraldsCollectorFinalizable));
+  if(entries == NULL || spare == NULL) {
+    free(entries);
+    free(spare);
+    return false;
+  }
+  free(finalizers->spare);
+  finalizers->spare = finalizers->entries;
+  collector_finalizers_rebuild(finalizers, entries, size, NULL, NULL);
+  free(finalizers->spare);
+  finalizers->spare = spare;
+  return true;
+}
+
+/* Finds the entry of an object or adds an empty one */
+static struct EmeraldsCollectorFinalizable *collector_finalizers_add(
+  struct EmeraldsCollectorFinalizers *finalizers, void *ptr
+) {
+  struct EmeraldsCollectorFinalizable *entry =
+    collector_finalizers_find(finalizers, ptr);
+
+  if(entry != NULL) {
+    return entry;
+  }
+  if(!collector_finalizers_reserve(finalizers)) {
+    return NULL;
+  }
+  entry = collector_finalizers_slot(
+    finalizers->entries, finalizers->entries_size, ptr
+  );
+  entry->ptr       = ptr;
+  entry->finalizer = NULL;
+  entry->data      = NULL;
+  entry->weak      = NULL;
+  finalizers->number_of_entries++;
+  return entry;
+}
+
+void collector_finalizers_new(struct EmeraldsCollectorFinalizers *finalizers) {
+  finalizers->entries           = NULL;
+  finalizers->spare             = NULL;
+  finalizers->number_of_entries = 0;
+  finalizers->entries_size      = 0;
+  finalizers->ready             = NULL;
+  finalizers->ready_start       = 0;
+  finalizers->number_of_ready   = 0;
+  finalizers->ready_capacity    = 0;
+  finalizers->running           = false;
+  finalizers->queued            = false;
+  finalizers->on_ready          = NULL;
+  finalizers->data              = NULL;
+}
+
+void collector_finalizers_terminate(
+  struct EmeraldsCollectorFinalizers *finalizers
+) {
+  size_t i;
+
+  /* The references belong to their owners, they only lose their targets */
+  for(i = 0; i < finalizers->entries_size; i++) {
+    if(finalizers->entries[i].ptr != NULL) {
+      collector_finalizers_retarget(finalizers->entries[i].weak, NULL);
+    }
+  }
+  free(finalizers->entries);
+  free(finalizers->spare);
+  free(finalizers->ready);
+  collector_finalizers_new(finalizers);
+}
+
+bool collector_finalizers_register(
+  struct EmeraldsCollectorFinalizers *finalizers,
+  void *ptr,
+  EmeraldsCollectorFinalizer finalizer,
+  void *data
+) {
+  struct EmeraldsCollectorFinalizable *entry;
+
+  if(ptr == NULL) {
+    return false;
+  }
+  if(finalizer == NULL) {
+    entry = collector_finalizers_find(finalizers, ptr);
+    if(entry != NULL) {
+      entry->finalizer = NULL;
+      entry->data      = NULL;
+      if(entry->weak == NULL) {
+        collector_finalizers_delete(finalizers, entry);
+      }
+    }
+    return true;
+  }
+
+  entry = collector_finalizers_add(finalizers, ptr);
+  if(entry == NULL) {
+    return false;
+  }
+  entry->finalizer = finalizer;
+  entry->data      = data;
+  return true;
+}
+
+EmeraldsCollectorWeak *collector_finalizers_weak_new(
+  struct EmeraldsCollectorFinalizers *finalizers, void *target
+) {
+  struct EmeraldsCollectorFinalizable *entry;
+  EmeraldsCollectorWeak *weak = malloc(sizeof(EmeraldsCollectorWeak));
+
+  if(weak == NULL) {
+    return NULL;
+  }
+  weak->target = NULL;
+  weak->prev   = NULL;
+  weak->next   = NULL;
+  if(target == NULL) {
+    return weak;
+  }
+
+  entry = collector_finalizers_add(finalizers, target);
+  if(entry == NULL) {
+    free(weak);
+    return NULL;
+  }
+  weak->target = target;
+  weak->next   = entry->weak;
+  if(entry->weak != NULL) {
+    entry->weak->prev = weak;
+  }
+  entry->weak = weak;
+  return weak;
+}
+
+void collector_finalizers_weak_free(
+  struct EmeraldsCollectorFinalizers *finalizers, EmeraldsCollectorWeak *weak
+) {
+  struct EmeraldsCollectorFinalizable *entry;
+
+  if(weak == NULL) {
+    return;
+  }
+  entry = collector_finalizers_find(finalizers, weak->target);
+  if(entry != NULL) {
+    if(weak->prev != NULL) {
+      weak->prev->next = weak->next;
+    } else {
+      entry->weak = weak->next;
+    }
+    if(weak->next != NULL) {
+      weak->next->prev = weak->prev;
+    }
+    if(entry->weak == NULL && entry->finalizer == NULL) {
+      collector_finalizers_delete(finalizers, entry);
+    }
+  }
+  free(weak);
+}
+
+void collector_finalizers_move(
+  struct EmeraldsCollectorFinalizers *finalizers, void *from, void *to
+) {
+  struct EmeraldsCollectorFinalizable *entry =
+    collector_finalizers_find(finalizers, from);
+  struct EmeraldsCollectorFinalizable moved;
+
+  if(entry == NULL || from == to) {
+    return;
+  }
+  moved = *entry;
+  collector_finalizers_delete(finalizers, entry);
+  collector_finalizers_retarget(moved.weak, to);
+  if(to == NULL) {
+    return;
+  }
+
+  /* The slot freed above keeps the table at most half full */
+  moved.ptr = to;
+  *collector_finalizers_slot(
+    finalizers->entries, finalizers->entries_size, to
+  ) = moved;
+  finalizers->number_of_entries++;
+}
+
+size_t collector_finalizers_relocate(
+  struct EmeraldsCollectorFinalizers *finalizers,
+  void *(*locate)(void *ptr, void *data),
+  void *data
+) {
+  struct EmeraldsCollectorFinalizable *entries;
+  size_t i;
+
+  for(i = 0; i < finalizers->number_of_ready; i++) {
+    struct EmeraldsCollectorFinalizable *ready =
+      &finalizers->ready[finalizers->ready_start + i];
+    ready->ptr = locate(ready->ptr, data);
+  }
+  if(finalizers->number_of_entries == 0) {
+    return 0;
+  }
+
+  /* Every entry had room set aside in the queue when it was added */
+  if(finalizers->ready_start + finalizers->number_of_ready +
+       finalizers->number_of_entries >
+     finalizers->ready_capacity) {
+    collector_finalizers_rewind(finalizers);
+  }
+  entries           = finalizers->spare;
+  finalizers->spare = finalizers->entries;
+  return collector_finalizers_rebuild(
+    finalizers, entries, finalizers->entries_size, locate, data
+  );
+}
+
+bool collector_finalizers_pop(
+  struct EmeraldsCollectorFinalizers *finalizers,
+  struct EmeraldsCollectorFinalizable *ready
+) {
+  if(finalizers->number_of_ready == 0) {
+    return false;
+  }
+  *ready = finalizers->ready[finalizers->ready_start++];
+  if(--finalizers->number_of_ready == 0) {
+    finalizers->ready_start = 0;
+  }
+  return true;
+}
@@ -0,0 +1,190 @@
+#ifndef __COLLECTOR_FINALIZERS_H_
+#define __COLLECTOR_FINALIZERS_H_
+
+#include "../../libs/EmeraldsBool/export/EmeraldsBool.h"
+
+#include <stddef.h>
+
+/**
+ * @brief Cleans up after an object the collector found unreachable, like
+ *          closing the file it wraps. It runs outside of any pause, once,
+ *          and the object is freed by the next collection that finds it
+ *          unreachable again
+ *
+ * @param object -> The object that died
+ * @param data -> The pointer given with the finalizer
+ **/
+typedef void (*EmeraldsCollectorFinalizer)(void *object, void *data);
+
+/**
+ * @brief Called once collections queued finalizers, with the collector
+ *          locked and after the other threads resumed. It must not call
+ *          into the collector, a worker waiting for finalizers to run gets
+ *          woken from here
+ *
+ * @param number_of_ready -> The finalizers waiting to run
+ * @param data -> The pointer given with the callback
+ **/
+typedef void (*EmeraldsCollectorFinalizerCallback)(
+  size_t number_of_ready, void *data
+);
+
+/**
+ * @brief A reference that does not keep its target alive. It is cleared
+ *          with every other weak reference to the same target as soon as
+ *          a collection finds the target unreachable, before finalizers
+ *          can bring the target back
+ *
+ * @param target -> The object referenced, NULL once it died
+ * @param prev -> The previous reference to the same target
+ * @param next -> The next reference to the same target
+ **/
+typedef struct EmeraldsCollectorWeak {
+  void *target;
+  struct EmeraldsCollectorWeak *prev;
+  struct EmeraldsCollectorWeak *next;
+} EmeraldsCollectorWeak;
+
+/**
+ * @brief An object with a finalizer or weak references to it
+ * @param ptr -> The object, NULL for a free slot
+ * @param finalizer -> Runs once the object died, or NULL
+ * @param data -> Passed to the finalizer
+ * @param weak -> The first weak reference to the object, or NULL
+ **/
+struct EmeraldsCollectorFinalizable {
+  void *ptr;
+  EmeraldsCollectorFinalizer finalizer;
+  void *data;
+  EmeraldsCollectorWeak *weak;
+};
+
+/**
+ * @brief The objects the collector has to watch as they die, and the
+ *          finalizers of the ones that died, kept in order until they run.
+ *          Objects waiting for their finalizers are kept alive along with
+ *          everything they point at. Collections find the watched objects
+ *          without allocating, memory is set aside as they are watched
+ *
+ * @param entries -> The hash table of the watched objects by address
+ * @param spare -> A table as long as `entries` to move them into
+ * @param number_of_entries -> The number of watched objects
+ * @param entries_size -> The length of `entries`, a power of two
+ * @param ready -> The queue of finalizers waiting to run, room is kept
+ *                 for every watched object to join it
+ * @param ready_start -> The index of the oldest finalizer in `ready`
+ * @param number_of_ready -> The number of finalizers waiting to run
+ * @param ready_capacity -> The allocated length of `ready`
+ * @param running -> Set while a thread runs finalizers
+ * @param queued -> Set once a pause queued finalizers, until `on_ready`
+ *                  is told after it
+ * @param on_ready -> Called once collections queued finalizers, or NULL
+ * @param data -> Passed to `on_ready`
+ **/
+struct EmeraldsCollectorFinalizers {
+  struct EmeraldsCollectorFinalizable *entries;
+  struct EmeraldsCollectorFinalizable *spare;
+  size_t number_of_entries;
+  size_t entries_size;
+  struct EmeraldsCollectorFinalizable *ready;
+  size_t ready_start;
+  size_t number_of_ready;
+  size_t ready_capacity;
+  bool running;
+  bool queued;
+  EmeraldsCollectorFinalizerCallback on_ready;
+  void *data;
+};
+
+/**
+ * @brief Initializes an empty set of watched objects
+ * @param finalizers -> The set to initialize
+ **/
+void collector_finalizers_new(struct EmeraldsCollectorFinalizers *finalizers);
+
+/**
+ * @brief Drops every finalizer without running it and clears every weak
+ *          reference, their owners still free them
+ *
+ * @param finalizers -> The set to destroy
+ **/
+void collector_finalizers_terminate(
+  struct EmeraldsCollectorFinalizers *finalizers
+);
+
+/**
+ * @brief Sets the finalizer of an object, replacing the one it had
+ * @param finalizers -> The set to use
+ * @param ptr -> The object to watch
+ * @param finalizer -> Runs once the object died, NULL to drop the one set
+ * @param data -> Passed to the finalizer
+ * @return false if there was no memory to watch the object
+ **/
+bool collector_finalizers_register(
+  struct EmeraldsCollectorFinalizers *finalizers,
+  void *ptr,
+  EmeraldsCollectorFinalizer finalizer,
+  void *data
+);
+
+/**
+ * @brief Creates a weak reference
+ * @param finalizers -> The set to use
+ * @param target -> The object to reference, or NULL
+ * @return The new reference, NULL if there was no memory
+ **/
+EmeraldsCollectorWeak *collector_finalizers_weak_new(
+  struct EmeraldsCollectorFinalizers *finalizers, void *target
+);
+
+/**
+ * @brief Frees a weak reference, its target is not affected
+ * @param finalizers -> The set to use
+ * @param weak -> The reference to free
+ **/
+void collector_finalizers_weak_free(
+  struct EmeraldsCollectorFinalizers *finalizers, EmeraldsCollectorWeak *weak
+);
+
+/**
+ * @brief Follows an object that was moved or freed explicitly. Its finalizer
+ *          and weak references move along, or are dropped and cleared
+ *
+ * @param finalizers -> The set to use
+ * @param from -> The old address of the object
+ * @param to -> The new address of the object, NULL once it was freed
+ **/
+void collector_finalizers_move(
+  struct EmeraldsCollectorFinalizers *finalizers, void *from, void *to
+);
+
+/**
+ * @brief Finds every watched object where it lives now. The weak
+ *          references of objects that died are cleared and their
+ *          finalizers queued, moved objects take theirs along. Objects
+ *          already queued have to be found alive
+ *
+ * @param finalizers -> The set to use
+ * @param locate -> Returns the current address of an object, NULL when
+ *                  it died
+ * @param data -> Passed to `locate`
+ * @return The number of finalizers queued
+ **/
+size_t collector_finalizers_relocate(
+  struct EmeraldsCollectorFinalizers *finalizers,
+  void *(*locate)(void *ptr, void *data),
+  void *data
+);
+
+/**
+ * @brief Takes the oldest finalizer off the queue
+ * @param finalizers -> The set to use
+ * @param ready -> Receives the object and its finalizer
+ * @return false if no finalizer was waiting
+ **/
+bool collector_finalizers_pop(
+  struct EmeraldsCollectorFinalizers *finalizers,
+  struct EmeraldsCollectorFinalizable *ready
+);
+
+#endif
@@ -0,0 +1,856 @@
+#if defined(__unix__) || defined(__APPLE__)
+  #define _DEFAULT_SOURCE
+  #define _DARWIN_C_SOURCE
+  #define __COLLECTOR_HEAP_MMAP
+#endif
+
+#include "collector_heap.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__COLLECTOR_HEAP_MMAP)
+  #include <sys/mman.h>
+  #include <unistd.h>
+  #if !defined(MAP_ANONYMOUS)
+    #define MAP_ANONYMOUS MAP_ANON
+  #endif
+#endif
+
+static const size_t collector_size_classes[COLLECTOR_NUMBER_OF_SIZE_CLASSES] = {
+  16,  32,  48,  64,  80,  96,   112,  128,  160,  192,  224,  256,
+  320, 384, 448, 512, 640, 768, 896, 1024, 1280, 1536, 1792, 2048
+};
+
+/* Slots start after the page header, rounded to the granule */
+#define COLLECTOR_PAGE_HEADER_SIZE                                       \
+  ((sizeof(struct EmeraldsCollectorPage) + COLLECTOR_GRANULE_SIZE - 1) & \
+   ~(COLLECTOR_GRANULE_SIZE - 1))
+
+static size_t collector_first_zero_bit(size_t word) {
+#if defined(__GNUC__) && !defined(_WIN64)
+  return (size_t)__builtin_ctzl((unsigned long)~word);
+#else
+  size_t bit = 0;
+  while(word & 1) {
+    word >>= 1;
+    bit++;
+  }
+  return bit;
+#endif
+}
+
+static size_t collector_count_bits(size_t word) {
+#if defined(__GNUC__) && !defined(_WIN64)
+  return (size_t)__builtin_popcountl((unsigned long)word);
+#else
+  size_t count = 0;
+  while(word) {
+    word &= word - 1;
+    count++;
+  }
+  return count;
+#endif
+}
+
+/* The bits of a bitmap word that describe real slots of the page */
+static size_t
+collector_page_valid_bits(struct EmeraldsCollectorPage *page, size_t word) {
+  size_t first_bit = word * COLLECTOR_BITS_PER_WORD;
+  size_t remaining;
+
+  if(first_bit >= page->number_of_slots) {
+    return 0;
+  }
+  remaining = page->number_of_slots - first_bit;
+  if(remaining >= COLLECTOR_BITS_PER_WORD) {
+    return ~(size_t)0;
+  }
+  return ((size_t)1 << remaining) - 1;
+}
+
+/* Page metadata changes hands while the world is stopped for a compaction,
+    a parked thread may hold the lock of the malloc arena */
+static void *collector_metadata_map(size_t size) {
+#if defined(__COLLECTOR_HEAP_MMAP)
+  void *metadata = mmap(
+    NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+  );
+  return metadata == MAP_FAILED ? NULL : metadata;
+#else
+  return calloc(1, size);
+#endif
+}
+
+static void collector_metadata_unmap(void *metadata, size_t size) {
+#if defined(__COLLECTOR_HEAP_MMAP)
+  if(metadata != NULL) {
+    munmap(metadata, size);
+  }
+#else
+  (void)size;
+  free(metadata);
+#endif
+}
+
+/* Both arrays are sized for the slots of the current class of the page */
+static void collector_page_free_metadata(struct EmeraldsCollectorPage *page) {
+  collector_metadata_unmap(
+    page->ages, page->number_of_slots * sizeof(unsigned char)
+  );
+  collector_metadata_unmap(
+    page->layouts,
+    page->number_of_slots * sizeof(const struct EmeraldsCollectorLayout *)
+  );
+  page->ages    = NULL;
+  page->layouts = NULL;
+}
+
+static struct EmeraldsCollectorPage *collector_page_map(void) {
+#if defined(__COLLECTOR_HEAP_MMAP)
+  /* Over-map so that an aligned page always fits, then trim the excess */
+  char *raw = mmap(
+    NULL,
+    COLLECTOR_PAGE_SIZE * 2,
+    PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS,
+    -1,
+    0
+  );
+  char *aligned;
+  size_t head;
+
+  if(raw == MAP_FAILED) {
+    return NULL;
+  }
+  aligned = (char *)(((size_t)raw + COLLECTOR_PAGE_SIZE - 1) &
+                     ~(COLLECTOR_PAGE_SIZE - 1));
+  head    = aligned - raw;
+  if(head > 0) {
+    munmap(raw, head);
+  }
+  munmap(aligned + COLLECTOR_PAGE_SIZE, COLLECTOR_PAGE_SIZE - head);
+  ((struct EmeraldsCollectorPage *)aligned)->raw     = NULL;
+  ((struct EmeraldsCollectorPage *)aligned)->ages    = NULL;
+  ((struct EmeraldsCollectorPage *)aligned)->layouts = NULL;
+  return (struct EmeraldsCollectorPage *)aligned;
+#else
+  char *raw = malloc(COLLECTOR_PAGE_SIZE * 2);
+  struct EmeraldsCollectorPage *page;
+
+  if(raw == NULL) {
+    return NULL;
+  }
+  page = (struct EmeraldsCollectorPage *)(((size_t)raw + COLLECTOR_PAGE_SIZE -
+                                           1) &
+                                          ~(COLLECTOR_PAGE_SIZE - 1));
+  page->raw     = raw;
+  page->ages    = NULL;
+  page->layouts = NULL;
+  return page;
+#endif
+}
+
+static void collector_page_unmap(struct EmeraldsCollectorPage *page) {
+  collector_page_free_metadata(page);
+#if defined(__COLLECTOR_HEAP_MMAP)
+  munmap(page, COLLECTOR_PAGE_SIZE);
+#else
+  free(page->raw);
+#endif
+}
+
+/*
+ * Offsets inside of a page stay below 2^16 and slots below 2^11 bytes,
+ * so `offset * ceil(2^32 / size) >> 32` always equals `offset / size`
+ */
+static size_t collector_page_reciprocal(size_t object_size) {
+#if SIZE_MAX > 4294967295UL
+  return ((size_t)1 << 32) / object_size + 1;
+#else
+  return object_size;
+#endif
+}
+
+static size_t
+collector_page_slot_index(struct EmeraldsCollectorPage *page, size_t offset) {
+#if SIZE_MAX > 4294967295UL
+  return (offset * page->reciprocal) >> 32;
+#else
+  return offset / page->reciprocal;
+#endif
+}
+
+static bool
+collector_page_setup(struct EmeraldsCollectorPage *page, size_t size_class) {
+  size_t object_size =
+    collector_size_classes[size_class % COLLECTOR_NUMBER_OF_SIZE_CLASSES];
+  size_t word;
+
+  collector_page_free_metadata(page);
+  page->next              = NULL;
+  page->start             = (char *)page + COLLECTOR_PAGE_HEADER_SIZE;
+  page->size_class        = size_class;
+  page->kind              = size_class / COLLECTOR_NUMBER_OF_SIZE_CLASSES;
+  page->object_size       = object_size;
+  page->reciprocal        = collector_page_reciprocal(object_size);
+  page->number_of_slots   = (COLLECTOR_PAGE_SIZE - COLLECTOR_PAGE_HEADER_SIZE) /
+                          object_size;
+  page->number_of_objects = 0;
+  page->cursor            = 0;
+  page->remembered        = false;
+  page->evacuating        = false;
+  page->decommitted       = false;
+
+  if(page->kind == COLLECTOR_KIND_TYPED) {
+    page->layouts = collector_metadata_map(
+      sizeof(const struct EmeraldsCollectorLayout *) * page->number_of_slots
+    );
+    if(page->layouts == NULL) {
+      return false;
+    }
+  }
+
+  for(word = 0; word < COLLECTOR_BITMAP_WORDS; word++) {
+    /* Bits past the last slot look allocated so they are never handed out */
+    page->allocated[word] = ~collector_page_valid_bits(page, word);
+    page->marked[word]    = 0;
+    page->old[word]       = 0;
+    page->dirty[word]     = 0;
+    page->pinned[word]    = 0;
+  }
+  return true;
+}
+
+static struct EmeraldsCollectorPage *
+collector_heap_new_page(struct EmeraldsCollectorHeap *heap, size_t size_class) {
+  struct EmeraldsCollectorPage *page = heap->free_pages;
+
+  if(page != NULL) {
+    heap->free_pages = page->next;
+    heap->number_of_free_pages--;
+  } else {
+    page = collector_page_map();
+    if(page == NULL) {
+      return NULL;
+    }
+  }
+
+  /* Only pages that belong to a size class resolve through the map */
+  if(!collector_page_setup(page, size_class) ||
+     !collector_page_map_insert(&heap->map, page, COLLECTOR_PAGE_SIZE, page)) {
+    page->next       = heap->free_pages;
+    heap->free_pages = page;
+    heap->number_of_free_pages++;
+    return NULL;
+  }
+  page->next                        = heap->classes[size_class].pages;
+  heap->classes[size_class].pages   = page;
+  heap->classes[size_class].current = page;
+  return page;
+}
+
+/* Empty pages leave the map and can be handed to any size class */
+static void collector_heap_pool_page(
+  struct EmeraldsCollectorHeap *heap, struct EmeraldsCollectorPage *page
+) {
+  collector_page_map_remove(&heap->map, page, COLLECTOR_PAGE_SIZE);
+  page->next       = heap->free_pages;
+  heap->free_pages = page;
+  heap->number_of_free_pages++;
+}
+
+static size_t collector_page_take_slot(struct EmeraldsCollectorPage *page) {
+  size_t word;
+  for(word = page->cursor; word < COLLECTOR_BITMAP_WORDS; word++) {
+    if(page->allocated[word] != ~(size_t)0) {
+      size_t slot = word * COLLECTOR_BITS_PER_WORD +
+                    collector_first_zero_bit(page->allocated[word]);
+      page->cursor = word;
+      collector_bitmap_set(page->allocated, slot);
+      page->number_of_objects++;
+      return slot;
+    }
+  }
+  page->cursor = COLLECTOR_BITMAP_WORDS;
+  return COLLECTOR_NO_SLOT;
+}
+
+/* Counts a survived collection for every young slot set in `survivors` */
+static void collector_page_age(
+  struct EmeraldsCollectorHeap *heap,
+  struct EmeraldsCollectorPage *page,
+  size_t word,
+  size_t survivors
+) {
+  if(page->ages == NULL && heap->promotion_age > 1) {
+    /* Without ages every survivor is promoted right away */
+    page->ages =
+      collector_metadata_map(page->number_of_slots * sizeof(unsigned char));
+  }
+
+  while(survivors != 0) {
+    size_t bit  = collector_first_zero_bit(~survivors);
+    size_t slot = word * COLLECTOR_BITS_PER_WORD + bit;
+
+    survivors &= survivors - 1;
+    if(page->ages != NULL && ++page->ages[slot] < heap->promotion_age) {
+      continue;
+    }
+
+    /* It may point at younger objects that no barrier ever recorded */
+    collector_bitmap_set(page->old, slot);
+    collector_page_remember(page, slot);
+  }
+}
+
+/* Releases the unmarked slots of a page, returns the number released */
+static size_t collector_page_sweep(
+  struct EmeraldsCollectorHeap *heap, struct EmeraldsCollectorPage *page
+) {
+  size_t freed = 0;
+  size_t word;
+
+  /* A whole word of slots is swept at once, no object is touched */
+  for(word = 0; word < COLLECTOR_BITMAP_WORDS; word++) {
+    size_t dead = page->allocated[word] & ~page->marked[word] &
+                  collector_page_valid_bits(page, word);
+    if(dead != 0) {
+      page->allocated[word] &= ~dead;
+      page->old[word] &= ~dead;
+      page->dirty[word] &= ~dead;
+      freed += collector_count_bits(dead);
+    }
+    if(heap->generational) {
+      collector_page_age(
+        heap, page, word, page->allocated[word] & page->marked[word] &
+                            ~page->old[word] &
+                            collector_page_valid_bits(page, word)
+      );
+    }
+
+    /* Old slots stay marked, minor collections do not trace through them */
+    page->marked[word] = page->old[word];
+  }
+  page->number_of_objects -= freed;
+  page->cursor = 0;
+  heap->number_of_bytes -= freed * page->object_size;
+  return freed;
+}
+
+/* Sweeps the first unswept page of a class and files it where it belongs */
+static struct EmeraldsCollectorPage *collector_heap_sweep_page(
+  struct EmeraldsCollectorHeap *heap, size_t size_class
+) {
+  struct EmeraldsCollectorSizeClass *sc = &heap->classes[size_class];
+  struct EmeraldsCollectorPage *page    = sc->unswept;
+
+  sc->unswept = page->next;
+  heap->number_of_unswept--;
+  heap->number_of_objects -= collector_page_sweep(heap, page);
+
+  if(page->number_of_objects == 0) {
+    collector_heap_pool_page(heap, page);
+    return NULL;
+  }
+
+  page->next = sc->pages;
+  sc->pages  = page;
+  if(page->number_of_objects < page->number_of_slots) {
+    sc->exhausted = false;
+    return page;
+  }
+  return NULL;
+}
+
+/* Sweeps the pages of a class until one of them has a free slot */
+static struct EmeraldsCollectorPage *collector_heap_sweep_class(
+  struct EmeraldsCollectorHeap *heap, size_t size_class
+) {
+  while(heap->classes[size_class].unswept != NULL) {
+    struct EmeraldsCollectorPage *page =
+      collector_heap_sweep_page(heap, size_class);
+    if(page != NULL) {
+      return page;
+    }
+  }
+  return NULL;
+}
+
+void collector_heap_new(struct EmeraldsCollectorHeap *heap) {
+  size_t size_class = 0;
+  size_t granules;
+
+  for(granules = 0;
+      granules <= COLLECTOR_MAX_SMALL_SIZE / COLLECTOR_GRANULE_SIZE;
+      granules++) {
+    while(collector_size_classes[size_class] <
+          granules * COLLECTOR_GRANULE_SIZE) {
+      size_class++;
+    }
+    heap->class_of_granules[granules] = (unsigned char)size_class;
+  }
+  for(size_class = 0; size_class < COLLECTOR_NUMBER_OF_CLASSES;
+      size_class++) {
+    heap->classes[size_class].pages     = NULL;
+    heap->classes[size_class].unswept   = NULL;
+    heap->classes[size_class].current   = NULL;
+    heap->classes[size_class].exhausted = false;
+  }
+
+  heap->free_pages           = NULL;
+  heap->evacuated            = NULL;
+  heap->number_of_objects    = 0;
+  heap->number_of_bytes      = 0;
+  heap->number_of_unswept    = 0;
+  heap->sweep_class          = 0;
+  heap->number_of_free_pages = 0;
+  heap->interior_pointers    = true;
+  heap->generational         = false;
+  heap->promotion_age        = 1;
+  collector_page_map_new(&heap->map);
+}
+
+static void collector_heap_unmap_list(struct EmeraldsCollectorPage *page) {
+  while(page != NULL) {
+    struct EmeraldsCollectorPage *next = page->next;
+    collector_page_unmap(page);
+    page = next;
+  }
+}
+
+void collector_heap_terminate(struct EmeraldsCollectorHeap *heap) {
+  size_t size_class;
+  bool interior_pointers = heap->interior_pointers;
+  bool generational      = heap->generational;
+  size_t promotion_age   = heap->promotion_age;
+
+  for(size_class = 0; size_class < COLLECTOR_NUMBER_OF_CLASSES;
+      size_class++) {
+    collector_heap_unmap_list(heap->classes[size_class].pages);
+    collector_heap_unmap_list(heap->classes[size_class].unswept);
+  }
+  collector_heap_unmap_list(heap->free_pages);
+  collector_heap_unmap_list(heap->evacuated);
+  collector_page_map_terminate(&heap->map);
+  collector_heap_new(heap);
+  heap->interior_pointers = interior_pointers;
+  heap->generational      = generational;
+  heap->promotion_age     = promotion_age;
+}
+
+void *collector_heap_allocate(struct EmeraldsCollectorHeap *heap, size_t size) {
+  return collector_heap_allocate_layout(heap, size, NULL);
+}
+
+void *collector_heap_allocate_layout(
+  struct EmeraldsCollectorHeap *heap,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+) {
+  size_t size_class = collector_heap_class_of(heap, size, layout);
+  struct EmeraldsCollectorSizeClass *sc = &heap->classes[size_class];
+  struct EmeraldsCollectorPage *page    = sc->current;
+  size_t slot                           = COLLECTOR_NO_SLOT;
+  size_t *words;
+  size_t i;
+
+  if(page != NULL) {
+    slot = collector_page_take_slot(page);
+  }
+  while(slot == COLLECTOR_NO_SLOT) {
+    /* Move on to the next page of the class that still has room */
+    if(!sc->exhausted) {
+      page = page == NULL ? sc->pages : page->next;
+      while(page != NULL && page->number_of_objects == page->number_of_slots) {
+        page = page->next;
+      }
+      sc->exhausted = page == NULL;
+    } else {
+      page = NULL;
+    }
+    if(page == NULL) {
+      page = collector_heap_sweep_class(heap, size_class);
+    }
+    if(page == NULL) {
+      page = collector_heap_new_page(heap, size_class);
+      if(page == NULL) {
+        return NULL;
+      }
+    }
+    sc->current = page;
+    slot        = collector_page_take_slot(page);
+  }
+  heap->number_of_objects++;
+  heap->number_of_bytes += page->object_size;
+  if(page->ages != NULL) {
+    page->ages[slot] = 0;
+  }
+  words = (size_t *)collector_page_slot_address(page, slot);
+  if(page->kind == COLLECTOR_KIND_ATOMIC) {
+    return words;
+  }
+  if(page->kind == COLLECTOR_KIND_TYPED) {
+    page->layouts[slot] = layout;
+  }
+
+  /* Stale words of a dead object would otherwise be scanned as pointers */
+  for(i = 0; i < page->object_size / sizeof(size_t); i++) {
+    words[i] = 0;
+  }
+  return words;
+}
+
+size_t collector_page_slot_of(
+  struct EmeraldsCollectorHeap *heap,
+  struct EmeraldsCollectorPage *page,
+  void *ptr
+) {
+  size_t offset;
+  size_t slot;
+
+  if((char *)ptr < page->start) {
+    return COLLECTOR_NO_SLOT;
+  }
+  offset = (char *)ptr - page->start;
+  slot   = collector_page_slot_index(page, offset);
+  if(slot >= page->number_of_slots ||
+     !collector_bitmap_test(page->allocated, slot)) {
+    return COLLECTOR_NO_SLOT;
+  }
+  if(!heap->interior_pointers && slot * page->object_size != offset) {
+    return COLLECTOR_NO_SLOT;
+  }
+  return slot;
+}
+
+void collector_heap_free(
+  struct EmeraldsCollectorHeap *heap,
+  struct EmeraldsCollectorPage *page,
+  size_t slot
+) {
+  collector_bitmap_clear(page->allocated, slot);
+  collector_bitmap_clear(page->marked, slot);
+  collector_bitmap_clear(page->old, slot);
+  collector_bitmap_clear(page->dirty, slot);
+  page->number_of_objects--;
+  heap->number_of_objects--;
+  heap->number_of_bytes -= page->object_size;
+  heap->classes[page->size_class].exhausted = false;
+  if(slot / COLLECTOR_BITS_PER_WORD < page->cursor) {
+    page->cursor = slot / COLLECTOR_BITS_PER_WORD;
+  }
+}
+
+/* Calls `visit` on every swept and unswept page of the heap */
+static void collector_heap_each_page(
+  struct EmeraldsCollectorHeap *heap,
+  void (*visit)(struct EmeraldsCollectorPage *page)
+) {
+  size_t size_class;
+
+  for(size_class = 0; size_class < COLLECTOR_NUMBER_OF_CLASSES;
+      size_class++) {
+    struct EmeraldsCollectorPage *page;
+    for(page = heap->classes[size_class].pages; page != NULL;
+        page = page->next) {
+      visit(page);
+    }
+    for(page = heap->classes[size_class].unswept; page != NULL;
+        page = page->next) {
+      visit(page);
+    }
+  }
+}
+
+static void collector_page_clear_marks(struct EmeraldsCollectorPage *page) {
+  size_t word;
+  for(word = 0; word < COLLECTOR_BITMAP_WORDS; word++) {
+    page->marked[word] = 0;
+  }
+}
+
+static void
+collector_page_clear_generations(struct EmeraldsCollectorPage *page) {
+  size_t word;
+  for(word = 0; word < COLLECTOR_BITMAP_WORDS; word++) {
+    page->marked[word] = 0;
+    page->old[word]    = 0;
+    page->dirty[word]  = 0;
+  }
+  page->remembered = false;
+  collector_metadata_unmap(
+    page->ages, page->number_of_slots * sizeof(unsigned char)
+  );
+  page->ages = NULL;
+}
+
+void collector_heap_clear_marks(struct EmeraldsCollectorHeap *heap) {
+  collector_heap_each_page(heap, collector_page_clear_marks);
+}
+
+void collector_heap_set_generational(
+  struct EmeraldsCollectorHeap *heap, bool generational, size_t promotion_age
+) {
+  collector_heap_each_page(heap, collector_page_clear_generations);
+  heap->generational  = generational;
+  heap->promotion_age = promotion_age < 1 ? 1
+                        : promotion_age > COLLECTOR_MAX_PROMOTION_AGE
+                          ? COLLECTOR_MAX_PROMOTION_AGE
+                          : promotion_age;
+}
+
+void collector_heap_sweep_begin(struct EmeraldsCollectorHeap *heap) {
+  size_t size_class;
+
+  /* Pages left over from the previous sweep still hold its marks */
+  collector_heap_sweep_step(heap, heap->number_of_unswept);
+
+  for(size_class = 0; size_class < COLLECTOR_NUMBER_OF_CLASSES;
+      size_class++) {
+    struct EmeraldsCollectorSizeClass *sc = &heap->classes[size_class];
+    struct EmeraldsCollectorPage *page;
+
+    for(page = sc->pages; page != NULL; page = page->next) {
+      heap->number_of_unswept++;
+    }
+    sc->unswept   = sc->pages;
+    sc->pages     = NULL;
+    sc->current   = NULL;
+    sc->exhausted = false;
+  }
+  heap->sweep_class = 0;
+}
+
+bool collector_heap_sweep_step(
+  struct EmeraldsCollectorHeap *heap, size_t number_of_pages
+) {
+  while(number_of_pages > 0 && heap->number_of_unswept > 0) {
+    while(heap->classes[heap->sweep_class].unswept == NULL) {
+      heap->sweep_class =
+        (heap->sweep_class + 1) % COLLECTOR_NUMBER_OF_CLASSES;
+    }
+    collector_heap_sweep_page(heap, heap->sweep_class);
+    number_of_pages--;
+  }
+  return heap->number_of_unswept == 0;
+}
+
+size_t collector_heap_sweep(struct EmeraldsCollectorHeap *heap) {
+  size_t number_of_objects;
+
+  collector_heap_sweep_step(heap, heap->number_of_unswept);
+  number_of_objects = heap->number_of_objects;
+  collector_heap_sweep_begin(heap);
+  collector_heap_sweep_step(heap, heap->number_of_unswept);
+  return number_of_objects - heap->number_of_objects;
+}
+
+/* Only marked slots count, the rest die with the next sweep anyway */
+static bool collector_page_is_sparse(
+  struct EmeraldsCollectorPage *page, size_t percent
+) {
+  size_t live = 0;
+  size_t word;
+
+  for(word = 0; word < COLLECTOR_BITMAP_WORDS; word++) {
+    if(page->pinned[word] != 0) {
+      return false;
+    }
+    live += collector_count_bits(page->allocated[word] & page->marked[word] &
+                                 collector_page_valid_bits(page, word));
+  }
+  return live * 100 < page->number_of_slots * percent;
+}
+
+/* Carries the generation of a moved slot over to its new place */
+static void collector_page_move_bits(
+  struct EmeraldsCollectorPage *from,
+  size_t from_slot,
+  struct EmeraldsCollectorPage *to,
+  size_t to_slot
+) {
+  if(from->ages != NULL && to->ages != NULL) {
+    to->ages[to_slot] = from->ages[from_slot];
+  }
+
+  /* The sweep that follows the move must find the slot alive */
+  collector_bitmap_set(to->marked, to_slot);
+  if(collector_bitmap_test(from->old, from_slot)) {
+    /* Old slots may hold young pointers that no barrier recorded */
+    collector_bitmap_set(to->old, to_slot);
+    collector_page_remember(to, to_slot);
+  }
+}
+
+static size_t collector_page_evacuate(
+  struct EmeraldsCollectorHeap *heap, struct EmeraldsCollectorPage *page
+) {
+  size_t moved = 0;
+  size_t slot;
+
+  for(slot = 0; slot < page->number_of_slots; slot++) {
+    struct EmeraldsCollectorPage *target;
+    size_t *from;
+    size_t *to;
+    size_t i;
+
+    if(!collector_bitmap_test(page->allocated, slot) ||
+       !collector_bitmap_test(page->marked, slot)) {
+      continue;
+    }
+    to = collector_heap_allocate_layout(
+      heap, page->object_size, collector_page_layout(page, slot)
+    );
+    if(to == NULL) {
+      /* Without room the slot stays, pinned like an ambiguous one */
+      collector_bitmap_set(page->pinned, slot);
+      continue;
+    }
+
+    from = (size_t *)collector_page_slot_address(page, slot);
+    for(i = 0; i < page->object_size / sizeof(size_t); i++) {
+      to[i] = from[i];
+    }
+    target = collector_page_of(to);
+    collector_page_move_bits(
+      page,
+      slot,
+      target,
+      collector_page_slot_index(target, (char *)to - target->start)
+    );
+    from[0] = (size_t)to;
+    moved++;
+  }
+  return moved;
+}
+
+size_t
+collector_heap_evacuate(struct EmeraldsCollectorHeap *heap, size_t percent) {
+  struct EmeraldsCollectorPage *page;
+  size_t size_class;
+  size_t moved = 0;
+
+  /* Sparse pages leave their class first so they never receive slots */
+  for(size_class = 0; size_class < COLLECTOR_NUMBER_OF_CLASSES;
+      size_class++) {
+    struct EmeraldsCollectorSizeClass *sc = &heap->classes[size_class];
+    struct EmeraldsCollectorPage **link   = &sc->pages;
+
+    while(*link != NULL) {
+      page = *link;
+      if(!collector_page_is_sparse(page, percent)) {
+        link = &page->next;
+        continue;
+      }
+      *link            = page->next;
+      page->evacuating = true;
+      page->next       = heap->evacuated;
+      heap->evacuated  = page;
+    }
+    sc->current   = NULL;
+    sc->exhausted = false;
+  }
+
+  for(page = heap->evacuated; page != NULL; page = page->next) {
+    moved += collector_page_evacuate(heap, page);
+  }
+  return moved;
+}
+
+void *collector_heap_forward(struct EmeraldsCollectorHeap *heap, void *ptr) {
+  struct EmeraldsCollectorPage *page = collector_heap_find_page(heap, ptr);
+  size_t slot;
+  char *base;
+
+  if(page == NULL || !page->evacuating) {
+    return ptr;
+  }
+  slot = collector_page_slot_of(heap, page, ptr);
+  if(slot == COLLECTOR_NO_SLOT || collector_bitmap_test(page->pinned, slot)) {
+    return ptr;
+  }
+  base = (char *)collector_page_slot_address(page, slot);
+  return *(char **)base + ((char *)ptr - base);
+}
+
+static void collector_page_clear_pins(struct EmeraldsCollectorPage *page) {
+  size_t word;
+  for(word = 0; word < COLLECTOR_BITMAP_WORDS; word++) {
+    page->pinned[word] = 0;
+  }
+}
+
+size_t collector_heap_release_evacuated(struct EmeraldsCollectorHeap *heap) {
+  size_t released = 0;
+
+  while(heap->evacuated != NULL) {
+    struct EmeraldsCollectorPage *page = heap->evacuated;
+    size_t slot;
+
+    heap->evacuated  = page->next;
+    page->evacuating = false;
+    for(slot = 0; slot < page->number_of_slots; slot++) {
+      if(collector_bitmap_test(page->allocated, slot) &&
+         !collector_bitmap_test(page->pinned, slot)) {
+        collector_heap_free(heap, page, slot);
+      }
+    }
+
+    if(page->number_of_objects == 0) {
+      collector_heap_pool_page(heap, page);
+      released++;
+    } else {
+      struct EmeraldsCollectorSizeClass *sc = &heap->classes[page->size_class];
+      page->next                            = sc->pages;
+      sc->pages                             = page;
+    }
+  }
+  collector_heap_each_page(heap, collector_page_clear_pins);
+  return released;
+}
+
+/* The metadata of a pooled page is rebuilt by `collector_page_setup` */
+static void collector_page_decommit(struct EmeraldsCollectorPage *page) {
+#if defined(__COLLECTOR_HEAP_MMAP)
+  size_t system_page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t header =
+    (COLLECTOR_PAGE_HEADER_SIZE + system_page - 1) & ~(system_page - 1);
+
+  if(header < COLLECTOR_PAGE_SIZE) {
+    madvise(
+      (char *)page + header, COLLECTOR_PAGE_SIZE - header, MADV_DONTNEED
+    );
+  }
+#endif
+  collector_page_free_metadata(page);
+  page->decommitted = true;
+}
+
+size_t collector_heap_scavenge(
+  struct EmeraldsCollectorHeap *heap, size_t retained_pages
+) {
+  struct EmeraldsCollectorPage *page = heap->free_pages;
+  size_t kept                        = 0;
+  size_t decommitted                 = 0;
+
+  /* Pages are reused from the front, so the back of the pool goes first */
+  for(; page != NULL; page = page->next) {
+    if(kept < retained_pages) {
+      kept++;
+    } else if(!page->decommitted) {
+      collector_page_decommit(page);
+      decommitted += COLLECTOR_PAGE_SIZE;
+    }
+  }
+  return decommitted;
+}
+
+size_t collector_heap_release_free_pages(struct EmeraldsCollectorHeap *heap) {
+  size_t released = heap->number_of_free_pages * COLLECTOR_PAGE_SIZE;
+
+  collector_heap_unmap_list(heap->free_pages);
+  heap->free_pages           = NULL;
+  heap->number_of_free_pages = 0;
+  return released;
+}
@@ -0,0 +1,376 @@
+#ifndef __COLLECTOR_HEAP_H_
+#define __COLLECTOR_HEAP_H_
+
+#include "../../libs/EmeraldsBool/export/EmeraldsBool.h"
+#include "../collector_layout/collector_layout.h"
+#include "../collector_page_map/collector_page_map.h"
+
+#include <stddef.h>
+
+/**
+ * @brief Every heap page is this big and aligned to its own size, so the
+ *          page owning any slot is found by masking the slot address
+ **/
+#define COLLECTOR_PAGE_SIZE ((size_t)1 << COLLECTOR_PAGE_MAP_PAGE_BITS)
+
+/** The smallest slot size, every size class is a multiple of it **/
+#define COLLECTOR_GRANULE_SIZE ((size_t)16)
+
+/** Anything bigger than this is not allocated from the size classed pages **/
+#define COLLECTOR_MAX_SMALL_SIZE ((size_t)2048)
+
+#define COLLECTOR_NUMBER_OF_SIZE_CLASSES (24)
+
+/**
+ * @brief Objects of different kinds never share a page. Conservative
+ *          slots are scanned word by word, atomic slots hold no pointers
+ *          and are never scanned, typed slots carry a layout each
+ **/
+#define COLLECTOR_KIND_CONSERVATIVE (0)
+#define COLLECTOR_KIND_ATOMIC       (1)
+#define COLLECTOR_KIND_TYPED        (2)
+#define COLLECTOR_NUMBER_OF_KINDS   (3)
+
+/** Every kind has its own set of size classes **/
+#define COLLECTOR_NUMBER_OF_CLASSES \
+  (COLLECTOR_NUMBER_OF_KINDS * COLLECTOR_NUMBER_OF_SIZE_CLASSES)
+
+#define COLLECTOR_BITS_PER_WORD (sizeof(size_t) * 8)
+
+/** Enough bitmap words to describe a page full of granule sized slots **/
+#define COLLECTOR_BITMAP_WORDS \
+  (COLLECTOR_PAGE_SIZE / COLLECTOR_GRANULE_SIZE / COLLECTOR_BITS_PER_WORD)
+
+/** Returned by `collector_page_slot_of` for words that are not objects **/
+#define COLLECTOR_NO_SLOT ((size_t)-1)
+
+/** The largest promotion age, ages are counted in a byte per slot **/
+#define COLLECTOR_MAX_PROMOTION_AGE ((size_t)255)
+
+/**
+ * @brief A page carved into fixed size slots of a single size class
+ * @param next -> The next page of the same size class (or the free pool)
+ * @param raw -> The unaligned block backing the page when mmap is missing
+ * @param start -> The address of the first slot
+ * @param size_class -> The index of the size class the page belongs to
+ * @param kind -> The kind of every slot in the page
+ * @param object_size -> The size of every slot in bytes
+ * @param reciprocal -> Turns the division by `object_size` into a multiply
+ * @param number_of_slots -> How many slots fit in the page
+ * @param number_of_objects -> How many slots are currently allocated
+ * @param cursor -> The first bitmap word that might still have a free slot
+ * @param ages -> The collections every young slot survived, allocated by
+ *                the first sweep that has to age a slot of the page
+ * @param layouts -> The layout of every slot, only for typed pages
+ * @param remembered -> Set when any slot of the page is dirty
+ * @param evacuating -> Set while the slots of the page are being moved
+ *                      out, every moved slot starts with its new address
+ * @param decommitted -> Set for pooled pages whose slots were handed back
+ *                       to the system, only the header stays resident
+ * @param allocated -> One bit per slot, set when the slot is in use
+ * @param marked -> One bit per slot, set when the slot is reachable
+ * @param old -> One bit per slot, set once the slot has been promoted
+ * @param dirty -> One bit per slot, set by the write barrier
+ * @param pinned -> One bit per slot, set for slots that must not move
+ **/
+struct EmeraldsCollectorPage {
+  struct EmeraldsCollectorPage *next;
+  void *raw;
+  char *start;
+  size_t size_class;
+  size_t kind;
+  size_t object_size;
+  size_t reciprocal;
+  size_t number_of_slots;
+  size_t number_of_objects;
+  size_t cursor;
+  unsigned char *ages;
+  const struct EmeraldsCollectorLayout **layouts;
+  bool remembered;
+  bool evacuating;
+  bool decommitted;
+  size_t allocated[COLLECTOR_BITMAP_WORDS];
+  size_t marked[COLLECTOR_BITMAP_WORDS];
+  size_t old[COLLECTOR_BITMAP_WORDS];
+  size_t dirty[COLLECTOR_BITMAP_WORDS];
+  size_t pinned[COLLECTOR_BITMAP_WORDS];
+};
+
+/**
+ * @brief All pages of a single size class
+ * @param pages -> The list of swept pages carved into this class
+ * @param unswept -> Pages still holding the marks of the last collection
+ * @param current -> The page allocations are currently served from
+ * @param exhausted -> Set when every swept page of the class is full
+ **/
+struct EmeraldsCollectorSizeClass {
+  struct EmeraldsCollectorPage *pages;
+  struct EmeraldsCollectorPage *unswept;
+  struct EmeraldsCollectorPage *current;
+  bool exhausted;
+};
+
+/**
+ * @brief The size segregated heap owned by the collector
+ * @param classes -> The page lists of every size class of every kind
+ * @param class_of_granules -> Maps a size in granules to its size class
+ * @param free_pages -> Empty pages waiting to be reused by any size class
+ * @param evacuated -> Pages whose slots were moved, until they are released
+ * @param map -> Resolves addresses to the pages of the size classes
+ * @param number_of_objects -> The number of allocated slots in all pages
+ * @param number_of_bytes -> The bytes taken by the allocated slots
+ * @param number_of_unswept -> The number of pages waiting to be swept
+ * @param number_of_free_pages -> The number of pages in the free page pool
+ * @param sweep_class -> The size class the next sweep step starts from
+ * @param interior_pointers -> Set when pointers into the middle
+ *                             of a slot keep the slot alive
+ * @param generational -> Set when survivors are promoted to the old
+ *                        generation, old slots then keep their mark bits
+ *                        between collections
+ * @param promotion_age -> The collections a slot survives before promotion
+ **/
+struct EmeraldsCollectorHeap {
+  struct EmeraldsCollectorSizeClass classes[COLLECTOR_NUMBER_OF_CLASSES];
+  unsigned char
+    class_of_granules[COLLECTOR_MAX_SMALL_SIZE / COLLECTOR_GRANULE_SIZE + 1];
+  struct EmeraldsCollectorPage *free_pages;
+  struct EmeraldsCollectorPage *evacuated;
+  struct EmeraldsCollectorPageMap map;
+  size_t number_of_objects;
+  size_t number_of_bytes;
+  size_t number_of_unswept;
+  size_t number_of_free_pages;
+  size_t sweep_class;
+  bool interior_pointers;
+  bool generational;
+  size_t promotion_age;
+};
+
+/** The page that owns a slot address (only valid for heap addresses) **/
+#define collector_page_of(ptr)   \
+  ((struct EmeraldsCollectorPage \
+      *)((size_t)(ptr) & ~(COLLECTOR_PAGE_SIZE - 1)))
+
+/** The kind of the slots serving objects scanned with `layout` **/
+#define collector_heap_kind_of(layout)                                 \
+  ((layout) == NULL                      ? COLLECTOR_KIND_CONSERVATIVE \
+   : (layout) == COLLECTOR_LAYOUT_ATOMIC ? COLLECTOR_KIND_ATOMIC       \
+                                         : COLLECTOR_KIND_TYPED)
+
+/** The size class of the right kind serving a small allocation **/
+#define collector_heap_class_of(heap, size, layout)                    \
+  (collector_heap_kind_of(layout) * COLLECTOR_NUMBER_OF_SIZE_CLASSES + \
+   (heap)->class_of_granules                                           \
+     [((size) + COLLECTOR_GRANULE_SIZE - 1) / COLLECTOR_GRANULE_SIZE])
+
+/** The layout of a slot, NULL for conservatively scanned slots **/
+#define collector_page_layout(page, slot)                      \
+  ((page)->kind == COLLECTOR_KIND_ATOMIC  ? COLLECTOR_LAYOUT_ATOMIC \
+   : (page)->kind == COLLECTOR_KIND_TYPED ? (page)->layouts[slot]   \
+                                          : NULL)
+
+/** The address of a slot inside of a page **/
+#define collector_page_slot_address(page, slot) \
+  ((void *)((page)->start + (slot) * (page)->object_size))
+
+#define collector_bitmap_test(bitmap, bit)       \
+  (((bitmap)[(bit) / COLLECTOR_BITS_PER_WORD] >> \
+    ((bit) % COLLECTOR_BITS_PER_WORD)) &         \
+   1)
+
+#define collector_bitmap_set(bitmap, bit)      \
+  ((bitmap)[(bit) / COLLECTOR_BITS_PER_WORD] |= \
+   ((size_t)1 << ((bit) % COLLECTOR_BITS_PER_WORD)))
+
+#define collector_bitmap_clear(bitmap, bit)    \
+  ((bitmap)[(bit) / COLLECTOR_BITS_PER_WORD] &= \
+   ~((size_t)1 << ((bit) % COLLECTOR_BITS_PER_WORD)))
+
+/**
+ * @brief Initializes an empty heap and its size class lookup table
+ * @param heap -> The heap to initialize
+ **/
+void collector_heap_new(struct EmeraldsCollectorHeap *heap);
+
+/**
+ * @brief Gives every page of the heap back to the system
+ * @param heap -> The heap to destroy
+ **/
+void collector_heap_terminate(struct EmeraldsCollectorHeap *heap);
+
+/**
+ * @brief Allocates a zeroed slot from the size class fitting `size`
+ * @param heap -> The heap to allocate from
+ * @param size -> The requested size, at most COLLECTOR_MAX_SMALL_SIZE
+ * @return The slot or NULL when no new page could be mapped
+ **/
+void *collector_heap_allocate(struct EmeraldsCollectorHeap *heap, size_t size);
+
+/**
+ * @brief Allocates a slot from the pages of the kind matching `layout`.
+ *          Atomic slots are not zeroed, they are never scanned
+ *
+ * @param heap -> The heap to allocate from
+ * @param size -> The requested size, at most COLLECTOR_MAX_SMALL_SIZE
+ * @param layout -> NULL, COLLECTOR_LAYOUT_ATOMIC or the layout of the slot
+ * @return The slot or NULL when no new page could be mapped
+ **/
+void *collector_heap_allocate_layout(
+  struct EmeraldsCollectorHeap *heap,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+);
+
+/**
+ * @brief Finds the page containing an arbitrary word in O(1)
+ * @param heap -> The heap to search
+ * @param ptr -> The candidate pointer
+ * @return The page or NULL when the word does not point inside the heap
+ **/
+#define collector_heap_find_page(heap, ptr) \
+  ((struct EmeraldsCollectorPage *)collector_page_map_find(&(heap)->map, ptr))
+
+/**
+ * @brief Resolves a pointer into the index of an allocated slot
+ * @param heap -> The heap owning the page
+ * @param page -> The page containing the pointer
+ * @param ptr -> The candidate pointer
+ * @return The slot index or COLLECTOR_NO_SLOT if `ptr` is not the base
+ *          address of an allocated slot (or any address inside of one
+ *          when interior pointers are enabled)
+ **/
+size_t collector_page_slot_of(
+  struct EmeraldsCollectorHeap *heap,
+  struct EmeraldsCollectorPage *page,
+  void *ptr
+);
+
+/**
+ * @brief Releases a single slot before the collector would have swept it
+ * @param heap -> The heap owning the page
+ * @param page -> The page owning the slot
+ * @param slot -> The index of the slot to release
+ **/
+void collector_heap_free(
+  struct EmeraldsCollectorHeap *heap,
+  struct EmeraldsCollectorPage *page,
+  size_t slot
+);
+
+/**
+ * @brief Marks a slot as written to, the next minor collection scans it
+ *          for pointers to young objects
+ *
+ * @param page -> The page owning the slot
+ * @param slot -> The index of the slot
+ **/
+#define collector_page_remember(page, slot) \
+  (collector_bitmap_set((page)->dirty, slot), (page)->remembered = true)
+
+/**
+ * @brief Clears every mark bit, old slots included. Full collections of
+ *          a generational heap start from here
+ *
+ * @param heap -> The heap to clear
+ **/
+void collector_heap_clear_marks(struct EmeraldsCollectorHeap *heap);
+
+/**
+ * @brief Turns generational collection on or off. Every slot becomes
+ *          young again, so no old slot can hold an unremembered pointer
+ *          into the young generation
+ *
+ * @param heap -> The heap to configure, with no sweep pending
+ * @param generational -> Whether survivors get promoted
+ * @param promotion_age -> The collections a slot survives before promotion
+ **/
+void collector_heap_set_generational(
+  struct EmeraldsCollectorHeap *heap, bool generational, size_t promotion_age
+);
+
+/**
+ * @brief Queues every page for sweeping after a mark phase. Allocations
+ *          sweep the pages of their own size class before using them
+ *
+ * @param heap -> The heap to sweep
+ **/
+void collector_heap_sweep_begin(struct EmeraldsCollectorHeap *heap);
+
+/**
+ * @brief Sweeps a bounded number of the queued pages. Unmarked slots are
+ *          released, marks are cleared and empty pages are moved into
+ *          the free page pool. In generational mode surviving young slots
+ *          age, the ones old enough get promoted and remembered, and old
+ *          slots keep their mark bits
+ *
+ * @param heap -> The heap to sweep
+ * @param number_of_pages -> The most pages to sweep in this step
+ * @return true when no page is left to sweep
+ **/
+bool collector_heap_sweep_step(
+  struct EmeraldsCollectorHeap *heap, size_t number_of_pages
+);
+
+/**
+ * @brief Sweeps the whole heap at once
+ * @param heap -> The heap to sweep
+ * @return The number of released objects
+ **/
+size_t collector_heap_sweep(struct EmeraldsCollectorHeap *heap);
+
+/**
+ * @brief Moves every marked slot out of the sparse pages of the heap,
+ *          denser pages of the same size class receive them. Pages with a
+ *          pinned slot stay where they are. Every moved slot keeps its new
+ *          address in its first word until the pages are released, so
+ *          pointers to it can be updated with `collector_heap_forward`.
+ *          Runs between marking and sweeping, unmarked slots are left to
+ *          `collector_heap_release_evacuated`. Page metadata is mapped, so
+ *          no malloc lock is taken
+ *
+ * @param heap -> The marked heap to compact, with no sweep pending
+ * @param percent -> Pages with fewer marked slots than this percentage
+ *                   are evacuated
+ * @return The number of moved slots
+ **/
+size_t
+collector_heap_evacuate(struct EmeraldsCollectorHeap *heap, size_t percent);
+
+/**
+ * @brief Translates a pointer into a moved slot to its new address
+ * @param heap -> The heap that moved the slot
+ * @param ptr -> Any word, interior pointers keep their offset
+ * @return The new address, or `ptr` itself if it points at no moved slot
+ **/
+void *collector_heap_forward(struct EmeraldsCollectorHeap *heap, void *ptr);
+
+/**
+ * @brief Releases the moved and the unmarked slots of the evacuated pages,
+ *          emptied pages join the free page pool. Clears every pin
+ *
+ * @param heap -> The heap that moved the slots
+ * @return The number of pages emptied
+ **/
+size_t collector_heap_release_evacuated(struct EmeraldsCollectorHeap *heap);
+
+/**
+ * @brief Hands the slots of the free pages past the first `retained_pages`
+ *          back to the system with `madvise`. The pages stay mapped and
+ *          pooled, slots of a reused page are zeroed on allocation anyway
+ *
+ * @param heap -> The heap to scavenge
+ * @param retained_pages -> The free pages that stay resident
+ * @return The number of bytes decommitted
+ **/
+size_t collector_heap_scavenge(
+  struct EmeraldsCollectorHeap *heap, size_t retained_pages
+);
+
+/**
+ * @brief Unmaps every page of the free page pool
+ * @param heap -> The heap to shrink
+ * @return The number of bytes unmapped
+ **/
+size_t collector_heap_release_free_pages(struct EmeraldsCollectorHeap *heap);
+
+#endif
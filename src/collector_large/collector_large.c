@@ -0,0 +1,279 @@
+#if defined(__linux__)
+  #define _GNU_SOURCE
+  #define __COLLECTOR_LARGE_MREMAP
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+  #define _DEFAULT_SOURCE
+  #define _DARWIN_C_SOURCE
+  #define __COLLECTOR_LARGE_MMAP
+#endif
+
+#include "collector_large.h"
+
+#include <stdlib.h>
+
+#if defined(__COLLECTOR_LARGE_MMAP)
+  #include <sys/mman.h>
+  #include <unistd.h>
+  #if !defined(MAP_ANONYMOUS)
+    #define MAP_ANONYMOUS MAP_ANON
+  #endif
+#endif
+
+static size_t collector_large_round(size_t size) {
+#if defined(__COLLECTOR_LARGE_MMAP)
+  size_t system_page = (size_t)sysconf(_SC_PAGESIZE);
+  return (size + system_page - 1) & ~(system_page - 1);
+#else
+  return size;
+#endif
+}
+
+static void *collector_large_map(size_t mapped) {
+#if defined(__COLLECTOR_LARGE_MMAP)
+  void *ptr = mmap(
+    NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+  );
+  return ptr == MAP_FAILED ? NULL : ptr;
+#else
+  return calloc(1, mapped);
+#endif
+}
+
+static void collector_large_unmap(void *ptr, size_t mapped) {
+#if defined(__COLLECTOR_LARGE_MMAP)
+  munmap(ptr, mapped);
+#else
+  (void)mapped;
+  free(ptr);
+#endif
+}
+
+static void collector_large_zero(char *from, char *to) {
+  for(; from < to; from++) {
+    *from = 0;
+  }
+}
+
+/* Fresh pages come zeroed, only the tail of the old mapping is cleared */
+static void *collector_large_remap(
+  struct EmeraldsCollectorLargeObject *object, size_t size, size_t mapped
+) {
+  char *ptr = object->ptr;
+  char *moved;
+
+  if(size > object->size) {
+    collector_large_zero(
+      ptr + object->size, ptr + (size < object->mapped ? size : object->mapped)
+    );
+  }
+#if defined(__COLLECTOR_LARGE_MREMAP)
+  moved = mremap(ptr, object->mapped, mapped, MREMAP_MAYMOVE);
+  return moved == MAP_FAILED ? NULL : moved;
+#elif defined(__COLLECTOR_LARGE_MMAP)
+  if(mapped <= object->mapped) {
+    munmap(ptr + mapped, object->mapped - mapped);
+    return ptr;
+  }
+  moved = collector_large_map(mapped);
+  if(moved != NULL) {
+    size_t i;
+    for(i = 0; i < object->size; i++) {
+      moved[i] = ptr[i];
+    }
+    munmap(ptr, object->mapped);
+  }
+  return moved;
+#else
+  moved = realloc(ptr, mapped);
+  if(moved != NULL && mapped > object->mapped) {
+    collector_large_zero(moved + object->mapped, moved + mapped);
+  }
+  return moved;
+#endif
+}
+
+/* The index of the first object starting above `ptr` */
+static size_t
+collector_large_search(struct EmeraldsCollectorLargeSpace *large, void *ptr) {
+  size_t low  = 0;
+  size_t high = large->number_of_objects;
+
+  while(low < high) {
+    size_t middle = low + (high - low) / 2;
+    if((size_t)large->objects[middle].ptr <= (size_t)ptr) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+static bool collector_large_insert(
+  struct EmeraldsCollectorLargeSpace *large,
+  struct EmeraldsCollectorLargeObject *object
+) {
+  size_t index;
+  size_t i;
+
+  if(large->number_of_objects == large->capacity) {
+    size_t capacity = large->capacity == 0 ? 16 : large->capacity * 2;
+    struct EmeraldsCollectorLargeObject *objects = realloc(
+      large->objects, capacity * sizeof(struct EmeraldsCollectorLargeObject)
+    );
+    if(objects == NULL) {
+      return false;
+    }
+    large->objects  = objects;
+    large->capacity = capacity;
+  }
+
+  index = collector_large_search(large, object->ptr);
+  for(i = large->number_of_objects; i > index; i--) {
+    large->objects[i] = large->objects[i - 1];
+  }
+  large->objects[index] = *object;
+  large->number_of_objects++;
+  large->number_of_bytes += object->size;
+  return true;
+}
+
+static void collector_large_remove(
+  struct EmeraldsCollectorLargeSpace *large,
+  struct EmeraldsCollectorLargeObject *object
+) {
+  size_t i;
+
+  large->number_of_bytes -= object->size;
+  large->number_of_objects--;
+  for(i = (size_t)(object - large->objects); i < large->number_of_objects;
+      i++) {
+    large->objects[i] = large->objects[i + 1];
+  }
+}
+
+void collector_large_new(struct EmeraldsCollectorLargeSpace *large) {
+  large->objects           = NULL;
+  large->number_of_objects = 0;
+  large->capacity          = 0;
+  large->number_of_bytes   = 0;
+}
+
+void collector_large_terminate(struct EmeraldsCollectorLargeSpace *large) {
+  size_t i;
+  for(i = 0; i < large->number_of_objects; i++) {
+    collector_large_unmap(large->objects[i].ptr, large->objects[i].mapped);
+  }
+  free(large->objects);
+  collector_large_new(large);
+}
+
+void *collector_large_allocate(
+  struct EmeraldsCollectorLargeSpace *large,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+) {
+  struct EmeraldsCollectorLargeObject object;
+
+  object.size   = size;
+  object.mapped = collector_large_round(size);
+  object.ptr    = collector_large_map(object.mapped);
+  object.layout = layout;
+  object.marked = false;
+  object.old    = false;
+  object.dirty  = false;
+  object.age    = 0;
+  if(object.ptr == NULL) {
+    return NULL;
+  }
+  if(!collector_large_insert(large, &object)) {
+    collector_large_unmap(object.ptr, object.mapped);
+    return NULL;
+  }
+  return object.ptr;
+}
+
+struct EmeraldsCollectorLargeObject *collector_large_find(
+  struct EmeraldsCollectorLargeSpace *large, void *ptr, bool interior
+) {
+  struct EmeraldsCollectorLargeObject *object;
+  size_t index;
+
+  if(large->number_of_objects == 0) {
+    return NULL;
+  }
+  index = collector_large_search(large, ptr);
+  if(index == 0) {
+    return NULL;
+  }
+  object = &large->objects[index - 1];
+  if(object->ptr == ptr ||
+     (interior && (size_t)ptr < (size_t)object->ptr + object->size)) {
+    return object;
+  }
+  return NULL;
+}
+
+void collector_large_free(
+  struct EmeraldsCollectorLargeSpace *large,
+  struct EmeraldsCollectorLargeObject *object
+) {
+  collector_large_unmap(object->ptr, object->mapped);
+  collector_large_remove(large, object);
+}
+
+void *collector_large_resize(
+  struct EmeraldsCollectorLargeSpace *large,
+  struct EmeraldsCollectorLargeObject *object,
+  size_t size
+) {
+  struct EmeraldsCollectorLargeObject resized = *object;
+
+  resized.mapped = collector_large_round(size);
+  resized.size   = size;
+  if(resized.mapped != object->mapped) {
+    resized.ptr = collector_large_remap(object, size, resized.mapped);
+    if(resized.ptr == NULL) {
+      return NULL;
+    }
+  } else if(size > object->size) {
+    collector_large_zero(
+      (char *)object->ptr + object->size, (char *)object->ptr + size
+    );
+  }
+
+  /* A moved mapping has to be filed under its new address */
+  collector_large_remove(large, object);
+  collector_large_insert(large, &resized);
+  return resized.ptr;
+}
+
+size_t collector_large_sweep(
+  struct EmeraldsCollectorLargeSpace *large,
+  bool generational,
+  size_t promotion_age
+) {
+  size_t freed = 0;
+  size_t i;
+  size_t j;
+
+  for(i = 0, j = 0; i < large->number_of_objects; i++) {
+    struct EmeraldsCollectorLargeObject *object = &large->objects[i];
+
+    if(!object->marked) {
+      collector_large_unmap(object->ptr, object->mapped);
+      large->number_of_bytes -= object->size;
+      freed++;
+      continue;
+    }
+    if(generational && !object->old && ++object->age >= promotion_age) {
+      /* It may point at younger objects that no barrier ever recorded */
+      object->old   = true;
+      object->dirty = true;
+    }
+    large->objects[j++] = *object;
+  }
+  large->number_of_objects = j;
+  return freed;
+}
@@ -0,0 +1,132 @@
+#ifndef __COLLECTOR_LARGE_H_
+#define __COLLECTOR_LARGE_H_
+
+#include "../../libs/EmeraldsBool/export/EmeraldsBool.h"
+#include "../collector_layout/collector_layout.h"
+
+#include <stddef.h>
+
+/** Allocations of at least this many bytes get a mapping of their own **/
+#ifndef COLLECTOR_LARGE_THRESHOLD
+  #define COLLECTOR_LARGE_THRESHOLD ((size_t)1 << 20)
+#endif
+
+/**
+ * @brief An object mapped on its own, outside of the size classed pages
+ * @param ptr -> The start of the object, the start of its mapping too
+ * @param size -> The requested size of the object
+ * @param mapped -> The bytes of the mapping, rounded to system pages
+ * @param layout -> NULL for conservative scanning, COLLECTOR_LAYOUT_ATOMIC
+ *                  for objects that are never scanned, or the pointer words
+ * @param marked -> Set when the object is reachable
+ * @param old -> Set once the object has been promoted
+ * @param dirty -> Set by the write barrier
+ * @param age -> The collections a young object survived
+ **/
+struct EmeraldsCollectorLargeObject {
+  void *ptr;
+  size_t size;
+  size_t mapped;
+  const struct EmeraldsCollectorLayout *layout;
+  bool marked;
+  bool old;
+  bool dirty;
+  unsigned char age;
+};
+
+/**
+ * @brief Every large object, sorted by address so that any word is
+ *          resolved with a binary search
+ *
+ * @param objects -> The descriptors, ordered by their start address
+ * @param number_of_objects -> The number of live large objects
+ * @param capacity -> The allocated length of `objects`
+ * @param number_of_bytes -> The requested bytes of every large object
+ **/
+struct EmeraldsCollectorLargeSpace {
+  struct EmeraldsCollectorLargeObject *objects;
+  size_t number_of_objects;
+  size_t capacity;
+  size_t number_of_bytes;
+};
+
+/**
+ * @brief Initializes an empty large object space
+ * @param large -> The space to initialize
+ **/
+void collector_large_new(struct EmeraldsCollectorLargeSpace *large);
+
+/**
+ * @brief Unmaps every large object and frees the descriptors
+ * @param large -> The space to destroy
+ **/
+void collector_large_terminate(struct EmeraldsCollectorLargeSpace *large);
+
+/**
+ * @brief Maps a zeroed object of its own
+ * @param large -> The space to allocate in
+ * @param size -> The requested size
+ * @param layout -> The layout the object is scanned with
+ * @return The object or NULL when it could not be mapped
+ **/
+void *collector_large_allocate(
+  struct EmeraldsCollectorLargeSpace *large,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+);
+
+/**
+ * @brief Finds the large object containing a word in O(log n)
+ * @param large -> The space to search
+ * @param ptr -> Any word, it does not need to be a valid pointer
+ * @param interior -> true to resolve addresses inside of an object,
+ *                    false to only resolve start addresses
+ * @return The descriptor or NULL, valid until the space changes
+ **/
+struct EmeraldsCollectorLargeObject *collector_large_find(
+  struct EmeraldsCollectorLargeSpace *large, void *ptr, bool interior
+);
+
+/**
+ * @brief Unmaps a single object before the collector would have swept it
+ * @param large -> The space owning the object
+ * @param object -> The descriptor of the object
+ **/
+void collector_large_free(
+  struct EmeraldsCollectorLargeSpace *large,
+  struct EmeraldsCollectorLargeObject *object
+);
+
+/**
+ * @brief Resizes an object in place or moves its pages with `mremap`,
+ *          its contents are never copied on linux. The grown tail is zeroed
+ *
+ * @param large -> The space owning the object
+ * @param object -> The descriptor of the object, invalid afterwards
+ * @param size -> The new requested size
+ * @return The new address of the object, or NULL when it stays unchanged
+ **/
+void *collector_large_resize(
+  struct EmeraldsCollectorLargeSpace *large,
+  struct EmeraldsCollectorLargeObject *object,
+  size_t size
+);
+
+/**
+ * @brief Unmaps every unmarked object. In generational mode surviving
+ *          young objects age, and the ones old enough get promoted and
+ *          remembered. Marks are left in place
+ *
+ * @param large -> The space to sweep
+ * @param generational -> Whether survivors get promoted
+ * @param promotion_age -> The collections an object survives before
+ *                         it is promoted
+ * @return The number of unmapped objects
+ **/
+size_t collector_large_sweep(
+  struct EmeraldsCollectorLargeSpace *large,
+  bool generational,
+  size_t promotion_age
+);
+
+#endif
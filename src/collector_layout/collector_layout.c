@@ -0,0 +1,43 @@
+#include "collector_layout.h"
+
+#include <stdlib.h>
+
+#define COLLECTOR_LAYOUT_BITS_PER_WORD (sizeof(size_t) * 8)
+
+const struct EmeraldsCollectorLayout collector_layout_atomic = {0, NULL};
+
+bool collector_layout_new(struct EmeraldsCollectorLayout *layout, size_t size) {
+  layout->number_of_words = (size + sizeof(void *) - 1) / sizeof(void *);
+  layout->pointers        = NULL;
+  if(layout->number_of_words == 0) {
+    return true;
+  }
+
+  layout->pointers = calloc(
+    (layout->number_of_words + COLLECTOR_LAYOUT_BITS_PER_WORD - 1) /
+      COLLECTOR_LAYOUT_BITS_PER_WORD,
+    sizeof(size_t)
+  );
+  if(layout->pointers == NULL) {
+    layout->number_of_words = 0;
+    return false;
+  }
+  return true;
+}
+
+void collector_layout_terminate(struct EmeraldsCollectorLayout *layout) {
+  free(layout->pointers);
+  layout->pointers        = NULL;
+  layout->number_of_words = 0;
+}
+
+void collector_layout_set_pointer(
+  struct EmeraldsCollectorLayout *layout, size_t offset
+) {
+  size_t word = offset / sizeof(void *);
+  if(word >= layout->number_of_words) {
+    return;
+  }
+  layout->pointers[word / COLLECTOR_LAYOUT_BITS_PER_WORD] |=
+    (size_t)1 << (word % COLLECTOR_LAYOUT_BITS_PER_WORD);
+}
@@ -0,0 +1,61 @@
+#ifndef __COLLECTOR_LAYOUT_H_
+#define __COLLECTOR_LAYOUT_H_
+
+#include "../../libs/EmeraldsBool/export/EmeraldsBool.h"
+
+#include <stddef.h>
+
+/**
+ * @brief Describes which words of an object hold pointers. Objects longer
+ *          than the layout repeat it, so a layout of one struct also
+ *          describes an array of that struct
+ *
+ * @param number_of_words -> The length of a single element in words,
+ *                           0 for objects that hold no pointers at all
+ * @param pointers -> One bit per word of the element, set for pointers
+ **/
+struct EmeraldsCollectorLayout {
+  size_t number_of_words;
+  size_t *pointers;
+};
+
+/** The layout of pointer free objects, their bodies are never scanned **/
+extern const struct EmeraldsCollectorLayout collector_layout_atomic;
+#define COLLECTOR_LAYOUT_ATOMIC (&collector_layout_atomic)
+
+/**
+ * @brief Check if a word of an element is marked as a pointer
+ * @param layout -> The layout to check
+ * @param word -> The index of the word inside of the element
+ **/
+#define collector_layout_is_pointer(layout, word)                       \
+  (((layout)->pointers[(word) / (sizeof(size_t) * 8)] >>               \
+    ((word) % (sizeof(size_t) * 8))) &                                 \
+   1)
+
+/**
+ * @brief Creates a layout without pointers for elements of `size` bytes
+ * @param layout -> The layout to initialize
+ * @param size -> The size of a single element in bytes
+ * @return false if the bitmap could not be allocated
+ **/
+bool collector_layout_new(struct EmeraldsCollectorLayout *layout, size_t size);
+
+/**
+ * @brief Frees the bitmap of a layout
+ * @param layout -> The layout to destroy
+ **/
+void collector_layout_terminate(struct EmeraldsCollectorLayout *layout);
+
+/**
+ * @brief Marks the word at a byte offset of the element as a pointer,
+ *          usually called with `offsetof(struct, field)`
+ *
+ * @param layout -> The layout to change
+ * @param offset -> The offset of the pointer field in bytes
+ **/
+void collector_layout_set_pointer(
+  struct EmeraldsCollectorLayout *layout, size_t offset
+);
+
+#endif
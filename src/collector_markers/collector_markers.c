@@ -0,0 +1,329 @@
+#if defined(__unix__) || defined(__APPLE__)
+  #define _DEFAULT_SOURCE
+#endif
+
+#include "collector_markers.h"
+
+#include <stdlib.h>
+
+#if defined(__COLLECTOR_MARKERS_THREADS)
+  #include <sched.h>
+#endif
+
+/* Moves the `count` oldest objects of `from` on top of `to` */
+static void collector_markers_transfer(
+  struct EmeraldsCollectorWorklist *from,
+  struct EmeraldsCollectorWorklist *to,
+  size_t count
+) {
+  size_t i;
+
+  for(i = 0; i < count; i++) {
+    collector_worklist_push(
+      to, from->items[i].ptr, from->items[i].size, from->items[i].layout
+    );
+  }
+  for(i = count; i < from->number_of_items; i++) {
+    from->items[i - count] = from->items[i];
+  }
+  from->number_of_items -= count;
+}
+
+#if defined(__COLLECTOR_MARKERS_THREADS)
+/* Publish the oldest half of the private work once nothing is shared */
+static void collector_marker_share(struct EmeraldsCollectorMarker *marker) {
+  if(marker->local.number_of_items < COLLECTOR_MARKERS_SHARE_THRESHOLD ||
+     __atomic_load_n(&marker->number_of_shared, __ATOMIC_RELAXED) != 0) {
+    return;
+  }
+  pthread_mutex_lock(&marker->lock);
+  collector_markers_transfer(
+    &marker->local, &marker->shared, marker->local.number_of_items / 2
+  );
+  __atomic_store_n(
+    &marker->number_of_shared, marker->shared.number_of_items, __ATOMIC_RELAXED
+  );
+  pthread_mutex_unlock(&marker->lock);
+}
+
+/* Refill the private work from the own shared list, or steal from others */
+static bool collector_marker_take(struct EmeraldsCollectorMarker *marker) {
+  struct EmeraldsCollectorMarkers *markers = marker->markers;
+  size_t index = marker - markers->markers;
+  size_t i;
+
+  for(i = 0; i < markers->number_of_markers; i++) {
+    struct EmeraldsCollectorMarker *victim =
+      &markers->markers[(index + i) % markers->number_of_markers];
+    size_t count;
+
+    if(__atomic_load_n(&victim->number_of_shared, __ATOMIC_RELAXED) == 0) {
+      continue;
+    }
+    pthread_mutex_lock(&victim->lock);
+    count = victim == marker ? victim->shared.number_of_items
+                             : (victim->shared.number_of_items + 1) / 2;
+    collector_markers_transfer(&victim->shared, &marker->local, count);
+    __atomic_store_n(
+      &victim->number_of_shared,
+      victim->shared.number_of_items,
+      __ATOMIC_RELAXED
+    );
+    pthread_mutex_unlock(&victim->lock);
+    if(count > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool collector_markers_has_shared_work(
+  struct EmeraldsCollectorMarkers *markers
+) {
+  size_t i;
+  for(i = 0; i < markers->number_of_markers; i++) {
+    struct EmeraldsCollectorMarker *marker = &markers->markers[i];
+    if(__atomic_load_n(&marker->number_of_shared, __ATOMIC_RELAXED) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void collector_marker_work(struct EmeraldsCollectorMarker *marker) {
+  struct EmeraldsCollectorMarkers *markers = marker->markers;
+  struct EmeraldsCollectorWorkItem item;
+
+  while(true) {
+    while(collector_worklist_pop(&marker->local, &item)) {
+      markers->scan(markers->context, &marker->local, &item);
+      collector_marker_share(marker);
+    }
+    if(collector_marker_take(marker)) {
+      continue;
+    }
+
+    /* Out of work, wait until someone shares or everybody is idle */
+    __atomic_add_fetch(&markers->number_of_idle, 1, __ATOMIC_SEQ_CST);
+    while(true) {
+      if(__atomic_load_n(&markers->number_of_idle, __ATOMIC_SEQ_CST) ==
+         markers->number_of_markers) {
+        return;
+      }
+      if(collector_markers_has_shared_work(markers)) {
+        __atomic_sub_fetch(&markers->number_of_idle, 1, __ATOMIC_SEQ_CST);
+        if(collector_marker_take(marker)) {
+          break;
+        }
+        __atomic_add_fetch(&markers->number_of_idle, 1, __ATOMIC_SEQ_CST);
+      }
+      sched_yield();
+    }
+  }
+}
+
+static void *collector_marker_thread(void *arg) {
+  struct EmeraldsCollectorMarker *marker   = arg;
+  struct EmeraldsCollectorMarkers *markers = marker->markers;
+  size_t round;
+
+  pthread_mutex_lock(&markers->lock);
+  round = 0;
+  while(true) {
+    while(!markers->stopping && markers->round == round) {
+      pthread_cond_wait(&markers->wake, &markers->lock);
+    }
+    if(markers->stopping) {
+      break;
+    }
+    round = markers->round;
+    pthread_mutex_unlock(&markers->lock);
+
+    collector_marker_work(marker);
+
+    pthread_mutex_lock(&markers->lock);
+    if(--markers->number_of_working == 0) {
+      pthread_cond_signal(&markers->finished);
+    }
+  }
+  pthread_mutex_unlock(&markers->lock);
+  return NULL;
+}
+#endif
+
+void collector_markers_new(struct EmeraldsCollectorMarkers *markers) {
+  markers->markers           = NULL;
+  markers->number_of_markers = 0;
+  markers->scan              = NULL;
+  markers->context           = NULL;
+  markers->running           = false;
+#if defined(__COLLECTOR_MARKERS_THREADS)
+  pthread_mutex_init(&markers->lock, NULL);
+  pthread_cond_init(&markers->wake, NULL);
+  pthread_cond_init(&markers->finished, NULL);
+  markers->round             = 0;
+  markers->number_of_working = 0;
+  markers->number_of_idle    = 0;
+  markers->stopping          = false;
+#endif
+}
+
+static void collector_markers_stop(struct EmeraldsCollectorMarkers *markers) {
+  size_t i;
+
+  if(markers->markers == NULL) {
+    return;
+  }
+#if defined(__COLLECTOR_MARKERS_THREADS)
+  pthread_mutex_lock(&markers->lock);
+  markers->stopping = true;
+  pthread_cond_broadcast(&markers->wake);
+  pthread_mutex_unlock(&markers->lock);
+  for(i = 1; i < markers->number_of_markers; i++) {
+    pthread_join(markers->markers[i].thread, NULL);
+  }
+  markers->stopping = false;
+#endif
+
+  for(i = 0; i < markers->number_of_markers; i++) {
+    collector_worklist_terminate(&markers->markers[i].local);
+    collector_worklist_terminate(&markers->markers[i].shared);
+#if defined(__COLLECTOR_MARKERS_THREADS)
+    pthread_mutex_destroy(&markers->markers[i].lock);
+#endif
+  }
+  free(markers->markers);
+  markers->markers           = NULL;
+  markers->number_of_markers = 0;
+}
+
+void collector_markers_terminate(struct EmeraldsCollectorMarkers *markers) {
+  collector_markers_stop(markers);
+#if defined(__COLLECTOR_MARKERS_THREADS)
+  pthread_mutex_destroy(&markers->lock);
+  pthread_cond_destroy(&markers->wake);
+  pthread_cond_destroy(&markers->finished);
+#endif
+}
+
+bool collector_markers_start(
+  struct EmeraldsCollectorMarkers *markers, size_t number_of_markers
+) {
+#if defined(__COLLECTOR_MARKERS_THREADS)
+  size_t i;
+
+  collector_markers_stop(markers);
+  if(number_of_markers <= 1) {
+    return true;
+  }
+
+  /* New threads wait for the first round after this one */
+  markers->round = 0;
+
+  markers->markers =
+    calloc(number_of_markers, sizeof(struct EmeraldsCollectorMarker));
+  if(markers->markers == NULL) {
+    return false;
+  }
+  for(i = 0; i < number_of_markers; i++) {
+    collector_worklist_new(&markers->markers[i].local);
+    collector_worklist_new(&markers->markers[i].shared);
+    pthread_mutex_init(&markers->markers[i].lock, NULL);
+    markers->markers[i].markers = markers;
+  }
+
+  markers->number_of_markers = 1;
+  for(i = 1; i < number_of_markers; i++) {
+    if(pthread_create(
+         &markers->markers[i].thread,
+         NULL,
+         collector_marker_thread,
+         &markers->markers[i]
+       ) != 0) {
+      break;
+    }
+    markers->number_of_markers++;
+  }
+  if(markers->number_of_markers < number_of_markers) {
+    collector_markers_stop(markers);
+    return false;
+  }
+  return true;
+#else
+  (void)markers;
+  return number_of_markers <= 1;
+#endif
+}
+
+bool collector_markers_run(
+  struct EmeraldsCollectorMarkers *markers,
+  struct EmeraldsCollectorWorklist *seed,
+  void (*scan)(
+    void *context,
+    struct EmeraldsCollectorWorklist *worklist,
+    struct EmeraldsCollectorWorkItem *item
+  ),
+  void *context
+) {
+  bool overflowed = false;
+  size_t i;
+
+  markers->scan    = scan;
+  markers->context = context;
+
+#if defined(__COLLECTOR_MARKERS_THREADS)
+  if(markers->number_of_markers > 1) {
+    struct EmeraldsCollectorWorkItem item;
+
+    /* Deal the seed out so every marker starts with something to steal */
+    i = 0;
+    while(collector_worklist_pop(seed, &item)) {
+      collector_worklist_push(
+        &markers->markers[i++ % markers->number_of_markers].shared,
+        item.ptr,
+        item.size,
+        item.layout
+      );
+    }
+    for(i = 0; i < markers->number_of_markers; i++) {
+      markers->markers[i].number_of_shared =
+        markers->markers[i].shared.number_of_items;
+    }
+
+    markers->running        = true;
+    markers->number_of_idle = 0;
+    pthread_mutex_lock(&markers->lock);
+    markers->number_of_working = markers->number_of_markers - 1;
+    markers->round++;
+    pthread_cond_broadcast(&markers->wake);
+    pthread_mutex_unlock(&markers->lock);
+
+    collector_marker_work(&markers->markers[0]);
+
+    pthread_mutex_lock(&markers->lock);
+    while(markers->number_of_working > 0) {
+      pthread_cond_wait(&markers->finished, &markers->lock);
+    }
+    pthread_mutex_unlock(&markers->lock);
+    markers->running = false;
+
+    for(i = 0; i < markers->number_of_markers; i++) {
+      overflowed = overflowed || markers->markers[i].local.overflowed ||
+                   markers->markers[i].shared.overflowed;
+      markers->markers[i].local.overflowed  = false;
+      markers->markers[i].shared.overflowed = false;
+    }
+    return overflowed;
+  }
+#endif
+
+  /* Without helper threads the seed is drained in place */
+  {
+    struct EmeraldsCollectorWorkItem item;
+    while(collector_worklist_pop(seed, &item)) {
+      scan(context, seed, &item);
+    }
+  }
+  (void)i;
+  return overflowed;
+}
@@ -0,0 +1,121 @@
+#ifndef __COLLECTOR_MARKERS_H_
+#define __COLLECTOR_MARKERS_H_
+
+#include "../../libs/EmeraldsBool/export/EmeraldsBool.h"
+#include "../collector_worklist/collector_worklist.h"
+
+#include <stddef.h>
+
+/* Parallel marking needs posix threads and the gcc atomic builtins */
+#if(defined(__unix__) || defined(__APPLE__)) && defined(__GNUC__)
+  #define __COLLECTOR_MARKERS_THREADS
+  #include <pthread.h>
+#endif
+
+/** A marker publishes half of its private work above this many objects **/
+#define COLLECTOR_MARKERS_SHARE_THRESHOLD ((size_t)64)
+
+/**
+ * @brief A single mark thread and its work
+ * @param local -> Private objects, pushed and popped without locking
+ * @param shared -> Objects published for other markers to steal
+ * @param number_of_shared -> The size of `shared`, readable without the lock
+ * @param lock -> Guards `shared`
+ * @param thread -> The thread running this marker (unused for marker 0)
+ * @param markers -> The pool the marker belongs to
+ **/
+struct EmeraldsCollectorMarker {
+  struct EmeraldsCollectorWorklist local;
+  struct EmeraldsCollectorWorklist shared;
+  size_t number_of_shared;
+#if defined(__COLLECTOR_MARKERS_THREADS)
+  pthread_mutex_t lock;
+  pthread_t thread;
+#endif
+  struct EmeraldsCollectorMarkers *markers;
+};
+
+/**
+ * @brief A pool of mark threads that drain a worklist in parallel,
+ *          balancing the load by stealing from each other
+ *
+ * @param markers -> The markers, the first one runs on the calling thread
+ * @param number_of_markers -> The number of markers in the pool
+ * @param scan -> Scans an object pushing newly marked ones to `worklist`
+ * @param context -> Passed to `scan` unchanged
+ * @param running -> Set while the markers run, mark bits need atomics then
+ * @param lock -> Guards the round bookkeeping below
+ * @param wake -> Signals the threads that a round started or the pool stops
+ * @param finished -> Signals the caller that every thread ended its round
+ * @param round -> Incremented every time the pool is run
+ * @param number_of_working -> The threads that did not finish the round
+ * @param number_of_idle -> The markers that ran out of work
+ * @param stopping -> Set when the threads have to exit
+ **/
+struct EmeraldsCollectorMarkers {
+  struct EmeraldsCollectorMarker *markers;
+  size_t number_of_markers;
+  void (*scan)(
+    void *context,
+    struct EmeraldsCollectorWorklist *worklist,
+    struct EmeraldsCollectorWorkItem *item
+  );
+  void *context;
+  bool running;
+#if defined(__COLLECTOR_MARKERS_THREADS)
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t finished;
+  size_t round;
+  size_t number_of_working;
+  size_t number_of_idle;
+  bool stopping;
+#endif
+};
+
+/**
+ * @brief Initializes an empty pool that marks on the calling thread only
+ * @param markers -> The pool to initialize
+ **/
+void collector_markers_new(struct EmeraldsCollectorMarkers *markers);
+
+/**
+ * @brief Stops the pool, joins its threads and frees its worklists
+ * @param markers -> The pool to stop
+ **/
+void collector_markers_terminate(struct EmeraldsCollectorMarkers *markers);
+
+/**
+ * @brief Replaces the threads of the pool. Marking runs on the calling
+ *          thread plus `number_of_markers - 1` helper threads
+ *
+ * @param markers -> The pool to resize
+ * @param number_of_markers -> The total number of markers, 0 or 1 for none
+ * @return false if the threads could not be created, the pool then
+ *          falls back to marking on the calling thread alone
+ **/
+bool collector_markers_start(
+  struct EmeraldsCollectorMarkers *markers, size_t number_of_markers
+);
+
+/**
+ * @brief Drains `seed` and everything reachable from it on all markers
+ * @param markers -> The pool to run
+ * @param seed -> The initial objects, emptied and spread across markers
+ * @param scan -> The scan callback, may be called from any marker thread
+ * @param context -> Passed to `scan` unchanged
+ * @return true if a worklist of a marker overflowed and marked objects
+ *          need a rescan (an overflow of `seed` itself stays flagged on it)
+ **/
+bool collector_markers_run(
+  struct EmeraldsCollectorMarkers *markers,
+  struct EmeraldsCollectorWorklist *seed,
+  void (*scan)(
+    void *context,
+    struct EmeraldsCollectorWorklist *worklist,
+    struct EmeraldsCollectorWorkItem *item
+  ),
+  void *context
+);
+
+#endif
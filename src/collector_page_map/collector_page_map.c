@@ -0,0 +1,133 @@
+#if defined(__unix__) || defined(__APPLE__)
+  #define _DEFAULT_SOURCE
+  #define _DARWIN_C_SOURCE
+  #define __COLLECTOR_PAGE_MAP_MMAP
+#endif
+
+#include "collector_page_map.h"
+
+#include <stdlib.h>
+
+#if defined(__COLLECTOR_PAGE_MAP_MMAP)
+  #include <sys/mman.h>
+  #if !defined(MAP_ANONYMOUS)
+    #define MAP_ANONYMOUS MAP_ANON
+  #endif
+#endif
+
+#define COLLECTOR_PAGE_MAP_PAGE_SIZE ((size_t)1 << COLLECTOR_PAGE_MAP_PAGE_BITS)
+
+#define COLLECTOR_PAGE_MAP_ROOT_SIZE            \
+  (((size_t)1 << COLLECTOR_PAGE_MAP_ROOT_BITS) * \
+   sizeof(struct EmeraldsCollectorPageMapLeaf *))
+
+/* Compactions insert pages while the world is stopped, a parked thread may
+    hold the lock of the malloc arena. Fresh mappings are already zeroed */
+static void *collector_page_map_level_map(size_t size) {
+#if defined(__COLLECTOR_PAGE_MAP_MMAP)
+  void *level = mmap(
+    NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+  );
+  return level == MAP_FAILED ? NULL : level;
+#else
+  return calloc(1, size);
+#endif
+}
+
+static void collector_page_map_level_unmap(void *level, size_t size) {
+#if defined(__COLLECTOR_PAGE_MAP_MMAP)
+  if(level != NULL) {
+    munmap(level, size);
+  }
+#else
+  (void)size;
+  free(level);
+#endif
+}
+
+void collector_page_map_new(struct EmeraldsCollectorPageMap *map) {
+  map->leaves = NULL;
+}
+
+void collector_page_map_terminate(struct EmeraldsCollectorPageMap *map) {
+  size_t i;
+
+  if(map->leaves == NULL) {
+    return;
+  }
+  for(i = 0; i < ((size_t)1 << COLLECTOR_PAGE_MAP_ROOT_BITS); i++) {
+    collector_page_map_level_unmap(
+      map->leaves[i], sizeof(struct EmeraldsCollectorPageMapLeaf)
+    );
+  }
+  collector_page_map_level_unmap(map->leaves, COLLECTOR_PAGE_MAP_ROOT_SIZE);
+  map->leaves = NULL;
+}
+
+bool collector_page_map_insert(
+  struct EmeraldsCollectorPageMap *map,
+  void *start,
+  size_t size,
+  void *descriptor
+) {
+  size_t address;
+
+  if(!collector_page_map_in_range((char *)start + size - 1)) {
+    return false;
+  }
+  if(map->leaves == NULL) {
+    /* The untouched parts of the root stay lazily zero mapped */
+    map->leaves = collector_page_map_level_map(COLLECTOR_PAGE_MAP_ROOT_SIZE);
+    if(map->leaves == NULL) {
+      return false;
+    }
+  }
+
+  for(address = (size_t)start; address < (size_t)start + size;
+      address += COLLECTOR_PAGE_MAP_PAGE_SIZE) {
+    struct EmeraldsCollectorPageMapLeaf **leaf =
+      &map->leaves[collector_page_map_root_index(address)];
+
+    if(*leaf == NULL) {
+      *leaf = collector_page_map_level_map(
+        sizeof(struct EmeraldsCollectorPageMapLeaf)
+      );
+      if(*leaf == NULL) {
+        collector_page_map_remove(map, start, address - (size_t)start);
+        return false;
+      }
+    }
+    if((*leaf)->pages[collector_page_map_leaf_index(address)] == NULL) {
+      (*leaf)->number_of_pages++;
+    }
+    (*leaf)->pages[collector_page_map_leaf_index(address)] = descriptor;
+  }
+  return true;
+}
+
+void collector_page_map_remove(
+  struct EmeraldsCollectorPageMap *map, void *start, size_t size
+) {
+  size_t address;
+
+  if(map->leaves == NULL) {
+    return;
+  }
+  for(address = (size_t)start; address < (size_t)start + size;
+      address += COLLECTOR_PAGE_MAP_PAGE_SIZE) {
+    struct EmeraldsCollectorPageMapLeaf **leaf =
+      &map->leaves[collector_page_map_root_index(address)];
+
+    if(*leaf == NULL ||
+       (*leaf)->pages[collector_page_map_leaf_index(address)] == NULL) {
+      continue;
+    }
+    (*leaf)->pages[collector_page_map_leaf_index(address)] = NULL;
+    if(--(*leaf)->number_of_pages == 0) {
+      collector_page_map_level_unmap(
+        *leaf, sizeof(struct EmeraldsCollectorPageMapLeaf)
+      );
+      *leaf = NULL;
+    }
+  }
+}
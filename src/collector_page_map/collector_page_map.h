@@ -0,0 +1,106 @@
+#ifndef __COLLECTOR_PAGE_MAP_H_
+#define __COLLECTOR_PAGE_MAP_H_
+
+#include "../../libs/EmeraldsBool/export/EmeraldsBool.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Page numbers are addresses shifted by the 64 KiB page size **/
+#define COLLECTOR_PAGE_MAP_PAGE_BITS (16)
+
+/* Only user space addresses can be mapped, anything above is rejected */
+#if SIZE_MAX > 4294967295UL
+  #define COLLECTOR_PAGE_MAP_ADDRESS_BITS (48)
+  #define COLLECTOR_PAGE_MAP_LEAF_BITS    (16)
+  #define collector_page_map_in_range(ptr) \
+    (((size_t)(ptr) >> COLLECTOR_PAGE_MAP_ADDRESS_BITS) == 0)
+#else
+  #define COLLECTOR_PAGE_MAP_ADDRESS_BITS  (32)
+  #define COLLECTOR_PAGE_MAP_LEAF_BITS     (8)
+  #define collector_page_map_in_range(ptr) (true)
+#endif
+
+#define COLLECTOR_PAGE_MAP_ROOT_BITS                                   \
+  (COLLECTOR_PAGE_MAP_ADDRESS_BITS - COLLECTOR_PAGE_MAP_PAGE_BITS - \
+   COLLECTOR_PAGE_MAP_LEAF_BITS)
+
+/**
+ * @brief The second level of the map, one entry per page of address space
+ * @param pages -> The page descriptor of every page, or NULL
+ * @param number_of_pages -> How many entries of the leaf are in use
+ **/
+struct EmeraldsCollectorPageMapLeaf {
+  void *pages[1 << COLLECTOR_PAGE_MAP_LEAF_BITS];
+  size_t number_of_pages;
+};
+
+/**
+ * @brief A two level radix table resolving any address to the descriptor
+ *          of the page containing it, with a single dependent load per level
+ *
+ * @param leaves -> The first level, allocated on the first insertion
+ **/
+struct EmeraldsCollectorPageMap {
+  struct EmeraldsCollectorPageMapLeaf **leaves;
+};
+
+#define collector_page_map_root_index(ptr) \
+  ((size_t)(ptr) >>                        \
+   (COLLECTOR_PAGE_MAP_PAGE_BITS + COLLECTOR_PAGE_MAP_LEAF_BITS))
+
+#define collector_page_map_leaf_index(ptr)                  \
+  (((size_t)(ptr) >> COLLECTOR_PAGE_MAP_PAGE_BITS) &        \
+   (((size_t)1 << COLLECTOR_PAGE_MAP_LEAF_BITS) - 1))
+
+/**
+ * @brief Looks up the descriptor of the page containing `ptr` in O(1)
+ * @param map -> The page map to search
+ * @param ptr -> Any word, it does not need to be a valid pointer
+ * @return The descriptor or NULL for addresses outside of mapped pages
+ **/
+#define collector_page_map_find(map, ptr)                          \
+  ((map)->leaves != NULL && collector_page_map_in_range(ptr) &&    \
+       (map)->leaves[collector_page_map_root_index(ptr)] != NULL   \
+     ? (map)->leaves[collector_page_map_root_index(ptr)]           \
+         ->pages[collector_page_map_leaf_index(ptr)]               \
+     : NULL)
+
+/**
+ * @brief Initializes an empty page map
+ * @param map -> The map to initialize
+ **/
+void collector_page_map_new(struct EmeraldsCollectorPageMap *map);
+
+/**
+ * @brief Frees every level of the map
+ * @param map -> The map to destroy
+ **/
+void collector_page_map_terminate(struct EmeraldsCollectorPageMap *map);
+
+/**
+ * @brief Maps every page overlapping [start, start + size) to a descriptor
+ * @param map -> The map to use
+ * @param start -> The first address of the range, page aligned
+ * @param size -> The length of the range in bytes
+ * @param descriptor -> The value every page of the range resolves to
+ * @return false if a leaf could not be allocated
+ **/
+bool collector_page_map_insert(
+  struct EmeraldsCollectorPageMap *map,
+  void *start,
+  size_t size,
+  void *descriptor
+);
+
+/**
+ * @brief Unmaps every page overlapping [start, start + size)
+ * @param map -> The map to use
+ * @param start -> The first address of the range, page aligned
+ * @param size -> The length of the range in bytes
+ **/
+void collector_page_map_remove(
+  struct EmeraldsCollectorPageMap *map, void *start, size_t size
+);
+
+#endif
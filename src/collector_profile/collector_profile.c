@@ -0,0 +1,552 @@
+#if defined(__unix__) || defined(__APPLE__)
+  #define _DEFAULT_SOURCE
+#endif
+
+#include "collector_profile.h"
+
+#include "../collector_stats/collector_stats.h"
+
+#include <stdlib.h>
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+  #include <execinfo.h>
+  #define __COLLECTOR_PROFILE_BACKTRACE
+#endif
+
+#define COLLECTOR_PROFILE_INITIAL_SIZE ((size_t)64)
+
+static size_t collector_profile_hash(size_t key) {
+  key = ((key >> 16) ^ key) * 0x45d9f3b;
+  key = ((key >> 16) ^ key) * 0x45d9f3b;
+  return (key >> 16) ^ key;
+}
+
+/* The natural logarithm of `x` in (0, 1], libm is not linked */
+static double collector_profile_log(double x) {
+  double halvings = 0;
+  double z;
+  double z2;
+  double term;
+  double sum = 0;
+  size_t i;
+
+  while(x < 0.5) {
+    x *= 2;
+    halvings++;
+  }
+
+  /* ln(x) = 2 atanh((x - 1) / (x + 1)), |z| <= 1/3 converges quickly */
+  z    = (x - 1) / (x + 1);
+  z2   = z * z;
+  term = z;
+  for(i = 1; i < 24; i += 2) {
+    sum += term / (double)i;
+    term *= z2;
+  }
+  return 2 * sum - halvings * 0.69314718055994530942;
+}
+
+/* e^-x for a non negative `x` */
+static double collector_profile_exp(double x) {
+  size_t halvings = 0;
+  double term     = 1;
+  double sum      = 1;
+  size_t i;
+
+  if(x > 700) {
+    return 0;
+  }
+  while(x > 0.5) {
+    x /= 2;
+    halvings++;
+  }
+  for(i = 1; i < 16; i++) {
+    term *= -x / (double)i;
+    sum += term;
+  }
+  while(halvings-- > 0) {
+    sum *= sum;
+  }
+  return sum;
+}
+
+void collector_profile_new(struct EmeraldsCollectorProfile *profile) {
+  profile->rate              = 0;
+  profile->random            = 2463534242UL;
+  profile->stacks            = NULL;
+  profile->number_of_stacks  = 0;
+  profile->stacks_capacity   = 0;
+  profile->stack_index       = NULL;
+  profile->stack_index_size  = 0;
+  profile->samples           = NULL;
+  profile->number_of_samples = 0;
+  profile->samples_size      = 0;
+  profile->started           = collector_stats_now();
+  profile->interval_ns       = 0;
+}
+
+void collector_profile_terminate(struct EmeraldsCollectorProfile *profile) {
+  free(profile->stacks);
+  free(profile->stack_index);
+  free(profile->samples);
+  collector_profile_new(profile);
+}
+
+size_t collector_profile_next(struct EmeraldsCollectorProfile *profile) {
+  unsigned long x = profile->random;
+  double uniform;
+  double bytes;
+
+  /* xorshift32, kept to 32 bits where longs are wider */
+  x ^= (x << 13) & 0xffffffffUL;
+  x ^= x >> 17;
+  x ^= (x << 5) & 0xffffffffUL;
+  profile->random = x;
+
+  /* Exponential gaps make the samples a Poisson process over the bytes */
+  uniform = ((double)x + 1) / 4294967296.0;
+  bytes   = -collector_profile_log(uniform) * (double)profile->rate;
+  if(bytes < 1) {
+    return 1;
+  }
+  return bytes < (double)((size_t)-1) ? (size_t)bytes : (size_t)-1;
+}
+
+size_t collector_profile_backtrace(
+  void *frames[COLLECTOR_PROFILE_MAX_FRAMES], size_t skip
+) {
+#if defined(__COLLECTOR_PROFILE_BACKTRACE)
+  void *all[COLLECTOR_PROFILE_MAX_FRAMES + 8];
+  size_t number_of_frames;
+  size_t i;
+
+  /* This frame is left out along with the callers asked for */
+  skip++;
+  if(skip > 8) {
+    skip = 8;
+  }
+  number_of_frames = (size_t)backtrace(all, COLLECTOR_PROFILE_MAX_FRAMES + 8);
+  if(number_of_frames <= skip) {
+    return 0;
+  }
+  number_of_frames -= skip;
+  if(number_of_frames > COLLECTOR_PROFILE_MAX_FRAMES) {
+    number_of_frames = COLLECTOR_PROFILE_MAX_FRAMES;
+  }
+  for(i = 0; i < number_of_frames; i++) {
+    frames[i] = all[skip + i];
+  }
+  return number_of_frames;
+#else
+  (void)frames;
+  (void)skip;
+  return 0;
+#endif
+}
+
+static size_t collector_profile_stack_hash(
+  void *const *frames, size_t number_of_frames
+) {
+  size_t hash = number_of_frames;
+  size_t i;
+
+  for(i = 0; i < number_of_frames; i++) {
+    hash = collector_profile_hash(hash ^ (size_t)frames[i]);
+  }
+  return hash;
+}
+
+static bool collector_profile_same_stack(
+  const struct EmeraldsCollectorProfileStack *stack,
+  size_t hash,
+  void *const *frames,
+  size_t number_of_frames
+) {
+  size_t i;
+
+  if(stack->hash != hash || stack->number_of_frames != number_of_frames) {
+    return false;
+  }
+  for(i = 0; i < number_of_frames; i++) {
+    if(stack->frames[i] != frames[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool collector_profile_grow_stacks(
+  struct EmeraldsCollectorProfile *profile
+) {
+  size_t capacity;
+  size_t size;
+  size_t *index;
+  size_t i;
+
+  if(profile->number_of_stacks == profile->stacks_capacity) {
+    struct EmeraldsCollectorProfileStack *stacks;
+
+    capacity = profile->stacks_capacity == 0 ? COLLECTOR_PROFILE_INITIAL_SIZE
+                                             : profile->stacks_capacity * 2;
+    stacks   = realloc(
+      profile->stacks, capacity * sizeof(struct EmeraldsCollectorProfileStack)
+    );
+    if(stacks == NULL) {
+      return false;
+    }
+    profile->stacks          = stacks;
+    profile->stacks_capacity = capacity;
+  }
+
+  /* The index stays at most half full */
+  if((profile->number_of_stacks + 1) * 2 <= profile->stack_index_size) {
+    return true;
+  }
+  size  = profile->stack_index_size == 0 ? COLLECTOR_PROFILE_INITIAL_SIZE * 2
+                                         : profile->stack_index_size * 2;
+  index = calloc(size, sizeof(size_t));
+  if(index == NULL) {
+    return false;
+  }
+  for(i = 0; i < profile->number_of_stacks; i++) {
+    size_t slot = profile->stacks[i].hash & (size - 1);
+    while(index[slot] != 0) {
+      slot = (slot + 1) & (size - 1);
+    }
+    index[slot] = i + 1;
+  }
+  free(profile->stack_index);
+  profile->stack_index      = index;
+  profile->stack_index_size = size;
+  return true;
+}
+
+/* Finds the call stack or adds it, returns its index plus one or 0 */
+static size_t collector_profile_find_stack(
+  struct EmeraldsCollectorProfile *profile,
+  void *const *frames,
+  size_t number_of_frames
+) {
+  size_t hash = collector_profile_stack_hash(frames, number_of_frames);
+  struct EmeraldsCollectorProfileStack *stack;
+  size_t slot;
+  size_t i;
+
+  if(profile->stack_index_size > 0) {
+    slot = hash & (profile->stack_index_size - 1);
+    while(profile->stack_index[slot] != 0) {
+      size_t found = profile->stack_index[slot];
+      if(collector_profile_same_stack(
+           &profile->stacks[found - 1], hash, frames, number_of_frames
+         )) {
+        return found;
+      }
+      slot = (slot + 1) & (profile->stack_index_size - 1);
+    }
+  }
+
+  if(!collector_profile_grow_stacks(profile)) {
+    return 0;
+  }
+  stack = &profile->stacks[profile->number_of_stacks];
+  for(i = 0; i < number_of_frames; i++) {
+    stack->frames[i] = frames[i];
+  }
+  stack->number_of_frames  = number_of_frames;
+  stack->hash              = hash;
+  stack->live_objects      = 0;
+  stack->live_bytes        = 0;
+  stack->allocated_objects = 0;
+  stack->allocated_bytes   = 0;
+  stack->rate_objects      = 0;
+  stack->rate_bytes        = 0;
+
+  slot = hash & (profile->stack_index_size - 1);
+  while(profile->stack_index[slot] != 0) {
+    slot = (slot + 1) & (profile->stack_index_size - 1);
+  }
+  profile->stack_index[slot] = ++profile->number_of_stacks;
+  return profile->number_of_stacks;
+}
+
+static struct EmeraldsCollectorProfileSample *collector_profile_slot(
+  struct EmeraldsCollectorProfileSample *samples, size_t size, void *ptr
+) {
+  size_t slot = collector_profile_hash((size_t)ptr) & (size - 1);
+
+  while(samples[slot].stack != 0 && samples[slot].ptr != ptr) {
+    slot = (slot + 1) & (size - 1);
+  }
+  return &samples[slot];
+}
+
+/* Moves the samples into a fresh table, `locate` decides where they go */
+static bool collector_profile_rebuild(
+  struct EmeraldsCollectorProfile *profile,
+  size_t size,
+  void *(*locate)(void *ptr, void *data),
+  void *data
+) {
+  struct EmeraldsCollectorProfileSample *samples;
+  size_t i;
+
+  samples = calloc(size, sizeof(struct EmeraldsCollectorProfileSample));
+  if(samples == NULL) {
+    return false;
+  }
+  profile->number_of_samples = 0;
+  for(i = 0; i < profile->samples_size; i++) {
+    struct EmeraldsCollectorProfileSample sample = profile->samples[i];
+    struct EmeraldsCollectorProfileStack *stack;
+
+    if(sample.stack == 0) {
+      continue;
+    }
+    stack = &profile->stacks[sample.stack - 1];
+    if(locate != NULL) {
+      sample.ptr = locate(sample.ptr, data);
+    }
+    if(sample.ptr == NULL) {
+      stack->live_objects -= sample.objects;
+      stack->live_bytes -= sample.bytes;
+      continue;
+    }
+    *collector_profile_slot(samples, size, sample.ptr) = sample;
+    profile->number_of_samples++;
+  }
+  free(profile->samples);
+  profile->samples      = samples;
+  profile->samples_size = size;
+  return true;
+}
+
+bool collector_profile_record(
+  struct EmeraldsCollectorProfile *profile,
+  void *ptr,
+  size_t size,
+  void *const *frames,
+  size_t number_of_frames
+) {
+  struct EmeraldsCollectorProfileSample *sample;
+  struct EmeraldsCollectorProfileStack *stack;
+  double probability;
+  size_t index;
+
+  /* The table stays at most half full */
+  if((profile->number_of_samples + 1) * 2 > profile->samples_size &&
+     !collector_profile_rebuild(
+       profile,
+       profile->samples_size == 0 ? COLLECTOR_PROFILE_INITIAL_SIZE
+                                  : profile->samples_size * 2,
+       NULL,
+       NULL
+     )) {
+    return false;
+  }
+  index = collector_profile_find_stack(profile, frames, number_of_frames);
+  if(index == 0) {
+    return false;
+  }
+
+  /* An object of `size` bytes is picked with this probability */
+  collector_profile_forget(profile, ptr);
+  probability = 1 - collector_profile_exp((double)size / (double)profile->rate);
+  if(probability <= 0) {
+    probability = 1;
+  }
+  sample =
+    collector_profile_slot(profile->samples, profile->samples_size, ptr);
+  sample->ptr     = ptr;
+  sample->stack   = index;
+  sample->objects = 1 / probability;
+  sample->bytes   = (double)size / probability;
+  profile->number_of_samples++;
+
+  stack = &profile->stacks[index - 1];
+  stack->live_objects += sample->objects;
+  stack->live_bytes += sample->bytes;
+  stack->allocated_objects += sample->objects;
+  stack->allocated_bytes += sample->bytes;
+  return true;
+}
+
+void collector_profile_forget(
+  struct EmeraldsCollectorProfile *profile, void *ptr
+) {
+  struct EmeraldsCollectorProfileSample *sample;
+  struct EmeraldsCollectorProfileStack *stack;
+  size_t slot;
+  size_t next;
+
+  if(profile->number_of_samples == 0) {
+    return;
+  }
+  sample = collector_profile_slot(profile->samples, profile->samples_size, ptr);
+  if(sample->stack == 0) {
+    return;
+  }
+  stack = &profile->stacks[sample->stack - 1];
+  stack->live_objects -= sample->objects;
+  stack->live_bytes -= sample->bytes;
+  profile->number_of_samples--;
+
+  /* Linear probing closes the gap by shifting the samples after it back */
+  slot = (size_t)(sample - profile->samples);
+  next = slot;
+  while(true) {
+    size_t home;
+
+    next = (next + 1) & (profile->samples_size - 1);
+    if(profile->samples[next].stack == 0) {
+      break;
+    }
+    home = collector_profile_hash((size_t)profile->samples[next].ptr) &
+           (profile->samples_size - 1);
+    if(((next - home) & (profile->samples_size - 1)) >=
+       ((next - slot) & (profile->samples_size - 1))) {
+      profile->samples[slot] = profile->samples[next];
+      slot                   = next;
+    }
+  }
+  profile->samples[slot].stack = 0;
+  profile->samples[slot].ptr   = NULL;
+}
+
+void collector_profile_relocate(
+  struct EmeraldsCollectorProfile *profile,
+  void *(*locate)(void *ptr, void *data),
+  void *data
+) {
+  size_t i;
+
+  if(profile->number_of_samples == 0) {
+    return;
+  }
+  if(collector_profile_rebuild(profile, profile->samples_size, locate, data)) {
+    return;
+  }
+
+  /* Without memory for the move no sample can be trusted, all are dropped */
+  for(i = 0; i < profile->number_of_stacks; i++) {
+    profile->stacks[i].live_objects = 0;
+    profile->stacks[i].live_bytes   = 0;
+  }
+  for(i = 0; i < profile->samples_size; i++) {
+    profile->samples[i].stack = 0;
+    profile->samples[i].ptr   = NULL;
+  }
+  profile->number_of_samples = 0;
+}
+
+void collector_profile_cycle(struct EmeraldsCollectorProfile *profile) {
+  double now = collector_stats_now();
+  size_t i;
+
+  for(i = 0; i < profile->number_of_stacks; i++) {
+    struct EmeraldsCollectorProfileStack *stack = &profile->stacks[i];
+    stack->rate_objects      = stack->allocated_objects;
+    stack->rate_bytes        = stack->allocated_bytes;
+    stack->allocated_objects = 0;
+    stack->allocated_bytes   = 0;
+  }
+  profile->interval_ns = now - profile->started;
+  profile->started     = now;
+}
+
+static void collector_profile_write_frame(
+  FILE *file, void *frame, const char *symbol
+) {
+  const char *name = NULL;
+  size_t length    = 0;
+
+  /* glibc describes a frame as "binary(function+offset) [address]" */
+#if defined(__GLIBC__)
+  if(symbol != NULL) {
+    while(*symbol != '\0' && *symbol != '(') {
+      symbol++;
+    }
+    if(*symbol == '(') {
+      name = ++symbol;
+      while(name[length] != '\0' && name[length] != '+' &&
+            name[length] != ')') {
+        length++;
+      }
+    }
+  }
+#else
+  (void)symbol;
+#endif
+  if(length > 0) {
+    fprintf(file, "%.*s", (int)length, name);
+  } else {
+    fprintf(file, "%p", frame);
+  }
+}
+
+static double collector_profile_value(
+  const struct EmeraldsCollectorProfile *profile,
+  const struct EmeraldsCollectorProfileStack *stack,
+  int kind
+) {
+  double seconds = profile->interval_ns / 1e9;
+  double objects = stack->rate_objects;
+  double bytes   = stack->rate_bytes;
+
+  /* Before the first collection the interval so far is used */
+  if(profile->interval_ns == 0) {
+    seconds = (collector_stats_now() - profile->started) / 1e9;
+    objects = stack->allocated_objects;
+    bytes   = stack->allocated_bytes;
+  }
+  if(seconds <= 0) {
+    seconds = 1e-9;
+  }
+
+  if(kind == COLLECTOR_PROFILE_LIVE_BYTES) {
+    return stack->live_bytes;
+  }
+  if(kind == COLLECTOR_PROFILE_LIVE_OBJECTS) {
+    return stack->live_objects;
+  }
+  if(kind == COLLECTOR_PROFILE_ALLOCATED_BYTES) {
+    return bytes / seconds;
+  }
+  if(kind == COLLECTOR_PROFILE_ALLOCATED_OBJECTS) {
+    return objects / seconds;
+  }
+  return 0;
+}
+
+bool collector_profile_write(
+  const struct EmeraldsCollectorProfile *profile, FILE *file, int kind
+) {
+  size_t i;
+
+  for(i = 0; i < profile->number_of_stacks; i++) {
+    const struct EmeraldsCollectorProfileStack *stack = &profile->stacks[i];
+    double value = collector_profile_value(profile, stack, kind);
+    char **symbols = NULL;
+    size_t frame;
+
+    if(value < 0.5) {
+      continue;
+    }
+#if defined(__COLLECTOR_PROFILE_BACKTRACE)
+    symbols = backtrace_symbols(stack->frames, (int)stack->number_of_frames);
+#endif
+    for(frame = stack->number_of_frames; frame > 0; frame--) {
+      collector_profile_write_frame(
+        file,
+        stack->frames[frame - 1],
+        symbols != NULL ? symbols[frame - 1] : NULL
+      );
+      fputc(frame > 1 ? ';' : ' ', file);
+    }
+    if(stack->number_of_frames == 0) {
+      fputs("[unknown] ", file);
+    }
+    fprintf(file, "%.0f\n", value);
+    free(symbols);
+  }
+  return !ferror(file);
+}
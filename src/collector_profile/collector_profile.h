@@ -0,0 +1,200 @@
+#ifndef __COLLECTOR_PROFILE_H_
+#define __COLLECTOR_PROFILE_H_
+
+#include "../../libs/EmeraldsBool/export/EmeraldsBool.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+/** The deepest call stack kept for a sampled allocation **/
+#define COLLECTOR_PROFILE_MAX_FRAMES (32)
+
+/** A sample every 512 KiB allocated on average, cheap enough to leave on **/
+#define COLLECTOR_PROFILE_RATE ((size_t)512 * 1024)
+
+/** The estimated bytes of the sampled objects still alive, per call stack **/
+#define COLLECTOR_PROFILE_LIVE_BYTES (0)
+
+/** The estimated number of sampled objects still alive, per call stack **/
+#define COLLECTOR_PROFILE_LIVE_OBJECTS (1)
+
+/** The estimated bytes allocated per second between the last two
+ * collections, per call stack **/
+#define COLLECTOR_PROFILE_ALLOCATED_BYTES (2)
+
+/** The estimated allocations per second between the last two collections,
+ * per call stack **/
+#define COLLECTOR_PROFILE_ALLOCATED_OBJECTS (3)
+
+/**
+ * @brief A call stack that allocated sampled objects. Every count is an
+ *          estimate, a sample stands for all the allocations it was
+ *          picked out of
+ *
+ * @param frames -> The return addresses, innermost first
+ * @param number_of_frames -> The number of return addresses
+ * @param hash -> The hash of the return addresses
+ * @param live_objects -> The sampled objects not collected yet
+ * @param live_bytes -> The bytes of those objects
+ * @param allocated_objects -> The objects allocated since the last
+ *                             collection
+ * @param allocated_bytes -> The bytes of those objects
+ * @param rate_objects -> The objects allocated between the last two
+ *                        collections
+ * @param rate_bytes -> The bytes of those objects
+ **/
+struct EmeraldsCollectorProfileStack {
+  void *frames[COLLECTOR_PROFILE_MAX_FRAMES];
+  size_t number_of_frames;
+  size_t hash;
+  double live_objects;
+  double live_bytes;
+  double allocated_objects;
+  double allocated_bytes;
+  double rate_objects;
+  double rate_bytes;
+};
+
+/**
+ * @brief A sampled object that was not collected yet
+ * @param ptr -> The address of the object
+ * @param stack -> The index of its call stack plus one, 0 for a free slot
+ * @param objects -> The objects the sample stands for
+ * @param bytes -> The bytes the sample stands for
+ **/
+struct EmeraldsCollectorProfileSample {
+  void *ptr;
+  size_t stack;
+  double objects;
+  double bytes;
+};
+
+/**
+ * @brief A sampling heap profiler. Allocations are sampled as a Poisson
+ *          process over the allocated bytes, every byte has the same
+ *          chance of being picked, so large objects are always seen and
+ *          small ones in proportion to their share of the allocations
+ *
+ * @param rate -> The mean bytes between two samples, 0 when off
+ * @param random -> The state of the random number generator
+ * @param stacks -> Every call stack that allocated a sample
+ * @param number_of_stacks -> The number of call stacks
+ * @param stacks_capacity -> The allocated length of `stacks`
+ * @param stack_index -> The hash table finding a call stack by its hash,
+ *                       holding indices into `stacks` plus one
+ * @param stack_index_size -> The length of `stack_index`, a power of two
+ * @param samples -> The hash table of the sampled objects by address
+ * @param number_of_samples -> The number of sampled objects
+ * @param samples_size -> The length of `samples`, a power of two
+ * @param started -> The time of the collection ending the last interval
+ * @param interval_ns -> The time between the last two collections
+ **/
+struct EmeraldsCollectorProfile {
+  size_t rate;
+  unsigned long random;
+  struct EmeraldsCollectorProfileStack *stacks;
+  size_t number_of_stacks;
+  size_t stacks_capacity;
+  size_t *stack_index;
+  size_t stack_index_size;
+  struct EmeraldsCollectorProfileSample *samples;
+  size_t number_of_samples;
+  size_t samples_size;
+  double started;
+  double interval_ns;
+};
+
+/**
+ * @brief Initializes a profiler that samples nothing
+ * @param profile -> The profiler to initialize
+ **/
+void collector_profile_new(struct EmeraldsCollectorProfile *profile);
+
+/**
+ * @brief Frees the samples and the call stacks of the profiler
+ * @param profile -> The profiler to destroy
+ **/
+void collector_profile_terminate(struct EmeraldsCollectorProfile *profile);
+
+/**
+ * @brief Draws the bytes to allocate before the next sample
+ * @param profile -> The profiler to use, sampling at its rate
+ * @return The number of bytes, at least 1
+ **/
+size_t collector_profile_next(struct EmeraldsCollectorProfile *profile);
+
+/**
+ * @brief Captures the call stack of the caller
+ * @param frames -> Receives the return addresses, innermost first
+ * @param skip -> The innermost callers to leave out
+ * @return The number of return addresses, 0 where backtraces are missing
+ **/
+size_t collector_profile_backtrace(
+  void *frames[COLLECTOR_PROFILE_MAX_FRAMES], size_t skip
+);
+
+/**
+ * @brief Records a sampled allocation under its call stack
+ * @param profile -> The profiler to use
+ * @param ptr -> The sampled object
+ * @param size -> The bytes requested for it
+ * @param frames -> The call stack that allocated it
+ * @param number_of_frames -> The depth of the call stack
+ * @return false if there was no memory to keep the sample
+ **/
+bool collector_profile_record(
+  struct EmeraldsCollectorProfile *profile,
+  void *ptr,
+  size_t size,
+  void *const *frames,
+  size_t number_of_frames
+);
+
+/**
+ * @brief Drops the sample of an object that was freed explicitly
+ * @param profile -> The profiler to use
+ * @param ptr -> The freed object, sampled or not
+ **/
+void collector_profile_forget(
+  struct EmeraldsCollectorProfile *profile, void *ptr
+);
+
+/**
+ * @brief Finds every sampled object where it lives now. Samples of the
+ *          objects that died are dropped and moved ones follow their
+ *          objects
+ *
+ * @param profile -> The profiler to use
+ * @param locate -> Returns the current address of a sampled object,
+ *                  NULL when it died
+ * @param data -> Passed to `locate`
+ **/
+void collector_profile_relocate(
+  struct EmeraldsCollectorProfile *profile,
+  void *(*locate)(void *ptr, void *data),
+  void *data
+);
+
+/**
+ * @brief Ends an allocation interval at a collection, the allocations
+ *          counted since the previous one become the allocation rate
+ *
+ * @param profile -> The profiler to use
+ **/
+void collector_profile_cycle(struct EmeraldsCollectorProfile *profile);
+
+/**
+ * @brief Writes a profile in the folded stack format flame graph tools
+ *          read. Every line holds the frames of a call stack, outermost
+ *          first and separated by semicolons, then the estimated count
+ *
+ * @param profile -> The profiler to read
+ * @param file -> The file to write to
+ * @param kind -> One of the COLLECTOR_PROFILE_* profiles
+ * @return false if writing failed
+ **/
+bool collector_profile_write(
+  const struct EmeraldsCollectorProfile *profile, FILE *file, int kind
+);
+
+#endif
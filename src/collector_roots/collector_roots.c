@@ -0,0 +1,257 @@
+#if defined(__linux__)
+  #define _GNU_SOURCE
+  #define __COLLECTOR_ROOTS_PHDR
+#endif
+
+#include "collector_roots.h"
+
+#include <stdlib.h>
+
+#if defined(__COLLECTOR_ROOTS_PHDR)
+  #include <link.h>
+#endif
+
+#define COLLECTOR_ROOTS_INITIAL_SIZE ((size_t)64)
+
+static size_t collector_roots_hash(void *ptr) {
+  size_t key = (size_t)ptr;
+  key        = ((key >> 16) ^ key) * 0x45d9f3b;
+  key        = ((key >> 16) ^ key) * 0x45d9f3b;
+  return (key >> 16) ^ key;
+}
+
+static void **collector_roots_slot(void **objects, size_t size, void *ptr) {
+  size_t slot = collector_roots_hash(ptr) & (size - 1);
+
+  while(objects[slot] != NULL && objects[slot] != ptr) {
+    slot = (slot + 1) & (size - 1);
+  }
+  return &objects[slot];
+}
+
+/* Keeps the set at most half full once one more object joins it */
+static bool collector_roots_reserve(struct EmeraldsCollectorRoots *roots) {
+  void **objects;
+  size_t size;
+  size_t i;
+
+  if((roots->number_of_objects + 1) * 2 <= roots->objects_size) {
+    return true;
+  }
+  size    = roots->objects_size == 0 ? COLLECTOR_ROOTS_INITIAL_SIZE
+                                     : roots->objects_size * 2;
+  objects = malloc(size * sizeof(void *));
+  if(objects == NULL) {
+    return false;
+  }
+  for(i = 0; i < size; i++) {
+    objects[i] = NULL;
+  }
+  for(i = 0; i < roots->objects_size; i++) {
+    if(roots->objects[i] != NULL) {
+      *collector_roots_slot(objects, size, roots->objects[i]) =
+        roots->objects[i];
+    }
+  }
+  free(roots->objects);
+  roots->objects      = objects;
+  roots->objects_size = size;
+  return true;
+}
+
+#if defined(__COLLECTOR_ROOTS_PHDR)
+/**
+ * @brief The state of a walk over the program headers
+ * @param roots -> The set the segments are added to
+ * @param number_of_segments -> The segments added so far
+ **/
+struct EmeraldsCollectorRootsWalk {
+  struct EmeraldsCollectorRoots *roots;
+  size_t number_of_segments;
+};
+
+static int collector_roots_add_object(
+  struct dl_phdr_info *info, size_t size, void *data
+) {
+  struct EmeraldsCollectorRootsWalk *walk = data;
+  size_t i;
+
+  (void)size;
+  for(i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr) *header = &info->dlpi_phdr[i];
+
+    /* The writable load segments are the data and bss of the object */
+    if(header->p_type == PT_LOAD && (header->p_flags & PF_W) &&
+       collector_roots_add_range(
+         walk->roots,
+         (void *)(info->dlpi_addr + header->p_vaddr),
+         header->p_memsz
+       )) {
+      walk->number_of_segments++;
+    }
+  }
+
+  /* The executable always comes first */
+  return 1;
+}
+#endif
+
+void collector_roots_new(struct EmeraldsCollectorRoots *roots) {
+  roots->ranges            = NULL;
+  roots->number_of_ranges  = 0;
+  roots->ranges_capacity   = 0;
+  roots->objects           = NULL;
+  roots->number_of_objects = 0;
+  roots->objects_size      = 0;
+}
+
+void collector_roots_terminate(struct EmeraldsCollectorRoots *roots) {
+  free(roots->ranges);
+  free(roots->objects);
+  collector_roots_new(roots);
+}
+
+bool collector_roots_add_range(
+  struct EmeraldsCollectorRoots *roots, void *start, size_t size
+) {
+  size_t first = ((size_t)start + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+  size_t last  = ((size_t)start + size) & ~(sizeof(void *) - 1);
+
+  if(size == 0 || first >= last) {
+    return true;
+  }
+  if(roots->number_of_ranges == roots->ranges_capacity) {
+    size_t capacity = roots->ranges_capacity == 0
+                        ? 8
+                        : roots->ranges_capacity * 2;
+    struct EmeraldsCollectorRootRange *ranges = realloc(
+      roots->ranges, capacity * sizeof(struct EmeraldsCollectorRootRange)
+    );
+    if(ranges == NULL) {
+      return false;
+    }
+    roots->ranges          = ranges;
+    roots->ranges_capacity = capacity;
+  }
+  roots->ranges[roots->number_of_ranges].start = (void **)first;
+  roots->ranges[roots->number_of_ranges].end   = (void **)last;
+  roots->number_of_ranges++;
+  return true;
+}
+
+bool collector_roots_remove_range(
+  struct EmeraldsCollectorRoots *roots, void *start
+) {
+  size_t first = ((size_t)start + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+  size_t i;
+
+  for(i = 0; i < roots->number_of_ranges; i++) {
+    if((size_t)roots->ranges[i].start == first) {
+      roots->ranges[i] = roots->ranges[--roots->number_of_ranges];
+      return true;
+    }
+  }
+  return false;
+}
+
+bool collector_roots_exclude(
+  struct EmeraldsCollectorRoots *roots, void *start, size_t size
+) {
+  void **first = (void **)((size_t)start & ~(sizeof(void *) - 1));
+  void **last  = (void **)(((size_t)start + size + sizeof(void *) - 1) &
+                          ~(sizeof(void *) - 1));
+  size_t i;
+
+  for(i = 0; i < roots->number_of_ranges; i++) {
+    struct EmeraldsCollectorRootRange range = roots->ranges[i];
+
+    if(range.end <= first || range.start >= last) {
+      continue;
+    }
+
+    /* The part after the block becomes a range of its own */
+    if(range.end > last) {
+      if(!collector_roots_add_range(
+           roots, last, (size_t)((char *)range.end - (char *)last)
+         )) {
+        return false;
+      }
+    }
+    roots->ranges[i].end = range.start < first ? first : range.start;
+  }
+
+  /* Ranges left empty are dropped */
+  for(i = 0; i < roots->number_of_ranges;) {
+    if(roots->ranges[i].start >= roots->ranges[i].end) {
+      roots->ranges[i] = roots->ranges[--roots->number_of_ranges];
+    } else {
+      i++;
+    }
+  }
+  return true;
+}
+
+size_t
+collector_roots_add_data_segments(struct EmeraldsCollectorRoots *roots) {
+#if defined(__COLLECTOR_ROOTS_PHDR)
+  struct EmeraldsCollectorRootsWalk walk;
+
+  walk.roots              = roots;
+  walk.number_of_segments = 0;
+  dl_iterate_phdr(collector_roots_add_object, &walk);
+  return walk.number_of_segments;
+#else
+  (void)roots;
+  return 0;
+#endif
+}
+
+bool collector_roots_pin(struct EmeraldsCollectorRoots *roots, void *ptr) {
+  void **slot;
+
+  if(ptr == NULL || !collector_roots_reserve(roots)) {
+    return false;
+  }
+  slot = collector_roots_slot(roots->objects, roots->objects_size, ptr);
+  if(*slot == NULL) {
+    *slot = ptr;
+    roots->number_of_objects++;
+  }
+  return true;
+}
+
+bool collector_roots_unpin(struct EmeraldsCollectorRoots *roots, void *ptr) {
+  void **found;
+  size_t mask;
+  size_t slot;
+  size_t next;
+
+  if(roots->number_of_objects == 0 || ptr == NULL) {
+    return false;
+  }
+  found = collector_roots_slot(roots->objects, roots->objects_size, ptr);
+  if(*found == NULL) {
+    return false;
+  }
+
+  /* Linear probing closes the gap by shifting the objects after it back */
+  mask = roots->objects_size - 1;
+  slot = (size_t)(found - roots->objects);
+  next = slot;
+  while(true) {
+    size_t home;
+
+    next = (next + 1) & mask;
+    if(roots->objects[next] == NULL) {
+      break;
+    }
+    home = collector_roots_hash(roots->objects[next]) & mask;
+    if(((next - home) & mask) >= ((next - slot) & mask)) {
+      roots->objects[slot] = roots->objects[next];
+      slot                 = next;
+    }
+  }
+  roots->objects[slot] = NULL;
+  roots->number_of_objects--;
+  return true;
+}
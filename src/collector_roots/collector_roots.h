@@ -0,0 +1,119 @@
+#ifndef __COLLECTOR_ROOTS_H_
+#define __COLLECTOR_ROOTS_H_
+
+#include "../../libs/EmeraldsBool/export/EmeraldsBool.h"
+
+#include <stddef.h>
+
+/**
+ * @brief A block of memory outside of the collector scanned on every
+ *          collection, like the globals of a program or a buffer of a
+ *          custom allocator
+ *
+ * @param start -> The first word of the block
+ * @param end -> The address right after the last word of the block
+ **/
+struct EmeraldsCollectorRootRange {
+  void **start;
+  void **end;
+};
+
+/**
+ * @brief Everything that keeps objects alive besides the stacks. Ranges
+ *          are scanned conservatively, pinned objects are live until they
+ *          are unpinned and never move
+ *
+ * @param ranges -> The registered ranges, in no particular order
+ * @param number_of_ranges -> The number of registered ranges
+ * @param ranges_capacity -> The allocated length of `ranges`
+ * @param objects -> The hash set of the pinned objects by address
+ * @param number_of_objects -> The number of pinned objects
+ * @param objects_size -> The length of `objects`, a power of two
+ **/
+struct EmeraldsCollectorRoots {
+  struct EmeraldsCollectorRootRange *ranges;
+  size_t number_of_ranges;
+  size_t ranges_capacity;
+  void **objects;
+  size_t number_of_objects;
+  size_t objects_size;
+};
+
+/**
+ * @brief Initializes an empty set of roots
+ * @param roots -> The set to initialize
+ **/
+void collector_roots_new(struct EmeraldsCollectorRoots *roots);
+
+/**
+ * @brief Drops every range and every pinned object
+ * @param roots -> The set to destroy
+ **/
+void collector_roots_terminate(struct EmeraldsCollectorRoots *roots);
+
+/**
+ * @brief Registers a block to scan. The block is shrunk to the whole words
+ *          inside of it, blocks holding none are ignored
+ *
+ * @param roots -> The set to use
+ * @param start -> The first byte of the block
+ * @param size -> The size of the block in bytes
+ * @return false if there was no memory to hold the range
+ **/
+bool collector_roots_add_range(
+  struct EmeraldsCollectorRoots *roots, void *start, size_t size
+);
+
+/**
+ * @brief Stops scanning a block
+ * @param roots -> The set to use
+ * @param start -> The first byte of the block, as it was registered
+ * @return false if no range started there
+ **/
+bool collector_roots_remove_range(
+  struct EmeraldsCollectorRoots *roots, void *start
+);
+
+/**
+ * @brief Stops scanning the words of a block inside of the ranges, like
+ *          a collector living in the data of the program
+ *
+ * @param roots -> The set to use
+ * @param start -> The first byte of the block
+ * @param size -> The size of the block in bytes
+ * @return false if there was no memory to split a range around the block
+ **/
+bool collector_roots_exclude(
+  struct EmeraldsCollectorRoots *roots, void *start, size_t size
+);
+
+/**
+ * @brief Registers the writable segments of the executable, its data and
+ *          bss, found through `dl_iterate_phdr`. Shared libraries are left
+ *          out, their blocks are added by hand when they hold pointers
+ *
+ * @param roots -> The set to use
+ * @return The number of segments registered, 0 where the program headers
+ *          cannot be read
+ **/
+size_t collector_roots_add_data_segments(struct EmeraldsCollectorRoots *roots);
+
+/**
+ * @brief Keeps an object alive and in place. Pins do not nest, a single
+ *          unpin releases an object pinned twice
+ *
+ * @param roots -> The set to use
+ * @param ptr -> The object to pin
+ * @return false if there was no memory to hold the pin
+ **/
+bool collector_roots_pin(struct EmeraldsCollectorRoots *roots, void *ptr);
+
+/**
+ * @brief Releases a pinned object
+ * @param roots -> The set to use
+ * @param ptr -> The object to release
+ * @return false if the object was not pinned
+ **/
+bool collector_roots_unpin(struct EmeraldsCollectorRoots *roots, void *ptr);
+
+#endif
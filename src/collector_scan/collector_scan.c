@@ -0,0 +1,134 @@
+#include "collector_scan.h"
+
+#if defined(__COLLECTOR_SCAN_X86_64)
+  #include <immintrin.h>
+#endif
+
+/* Stack words are read as well, sanitizers consider them poisoned */
+#if defined(__GNUC__)
+  #define __COLLECTOR_SCAN_NO_SANITIZE __attribute__((no_sanitize_address))
+#else
+  #define __COLLECTOR_SCAN_NO_SANITIZE
+#endif
+
+/* Words below `low` wrap around and end up above the range too */
+#define collector_scan_outside(word, low, range) \
+  ((size_t)(word) - (low) > (range))
+
+#if defined(__COLLECTOR_SCAN_X86_64)
+/* Unsigned 64 bit compare of biased lanes out of 32 bit compares */
+static int collector_scan_above_sse2(__m128i value, __m128i limit) {
+  __m128i above = _mm_cmpgt_epi32(value, limit);
+  __m128i equal = _mm_cmpeq_epi32(value, limit);
+
+  /* The low halves only decide the lanes whose high halves are equal */
+  above =
+    _mm_or_si128(above, _mm_and_si128(equal, _mm_slli_epi64(above, 32)));
+  return _mm_movemask_pd(_mm_castsi128_pd(above));
+}
+
+__COLLECTOR_SCAN_NO_SANITIZE static size_t collector_scan_skip_sse2(
+  void *const *words, size_t i, size_t n, size_t low, size_t range
+) {
+  const __m128i bias  = _mm_slli_epi32(_mm_set1_epi32(1), 31);
+  const __m128i base  = _mm_set1_epi64x(low);
+  const __m128i limit = _mm_xor_si128(_mm_set1_epi64x(range), bias);
+
+  for(; i + 4 <= n; i += 4) {
+    __m128i first  = _mm_loadu_si128((const __m128i *)(words + i));
+    __m128i second = _mm_loadu_si128((const __m128i *)(words + i + 2));
+
+    first  = _mm_xor_si128(_mm_sub_epi64(first, base), bias);
+    second = _mm_xor_si128(_mm_sub_epi64(second, base), bias);
+    if((collector_scan_above_sse2(first, limit) &
+        collector_scan_above_sse2(second, limit)) != 3) {
+      break;
+    }
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) __COLLECTOR_SCAN_NO_SANITIZE static size_t
+collector_scan_skip_avx2(
+  void *const *words, size_t i, size_t n, size_t low, size_t range
+) {
+  const __m256i bias  = _mm256_slli_epi64(_mm256_set1_epi64x(1), 63);
+  const __m256i base  = _mm256_set1_epi64x(low);
+  const __m256i limit = _mm256_xor_si256(_mm256_set1_epi64x(range), bias);
+
+  for(; i + 8 <= n; i += 8) {
+    __m256i first  = _mm256_loadu_si256((const __m256i *)(words + i));
+    __m256i second = _mm256_loadu_si256((const __m256i *)(words + i + 4));
+
+    first  = _mm256_xor_si256(_mm256_sub_epi64(first, base), bias);
+    second = _mm256_xor_si256(_mm256_sub_epi64(second, base), bias);
+    if(_mm256_movemask_epi8(_mm256_and_si256(
+         _mm256_cmpgt_epi64(first, limit), _mm256_cmpgt_epi64(second, limit)
+       )) != -1) {
+      break;
+    }
+  }
+  return i;
+}
+#else
+__COLLECTOR_SCAN_NO_SANITIZE static size_t collector_scan_skip_scalar(
+  void *const *words, size_t i, size_t n, size_t low, size_t range
+) {
+  /* A single branch for every 4 words */
+  for(; i + 4 <= n; i += 4) {
+    if(!(collector_scan_outside(words[i], low, range) &
+         collector_scan_outside(words[i + 1], low, range) &
+         collector_scan_outside(words[i + 2], low, range) &
+         collector_scan_outside(words[i + 3], low, range))) {
+      break;
+    }
+  }
+  return i;
+}
+#endif
+
+/* Skips the blocks with no candidate, up to the block holding one */
+static size_t collector_scan_skip(
+  void *const *words, size_t i, size_t n, size_t low, size_t range
+) {
+#if defined(__COLLECTOR_SCAN_X86_64)
+  if(__builtin_cpu_supports("avx2")) {
+    return collector_scan_skip_avx2(words, i, n, low, range);
+  }
+  return collector_scan_skip_sse2(words, i, n, low, range);
+#else
+  return collector_scan_skip_scalar(words, i, n, low, range);
+#endif
+}
+
+__COLLECTOR_SCAN_NO_SANITIZE size_t collector_scan_next(
+  void *const *words,
+  size_t from,
+  size_t number_of_words,
+  size_t low,
+  size_t high
+) {
+  size_t range;
+  size_t i;
+
+  if(low > high) {
+    return number_of_words;
+  }
+  range = high - low;
+  for(i = collector_scan_skip(words, from, number_of_words, low, range);
+      i < number_of_words;
+      i++) {
+    if(!collector_scan_outside(words[i], low, range)) {
+      return i;
+    }
+  }
+  return number_of_words;
+}
+
+const char *collector_scan_kernel(void) {
+#if defined(__COLLECTOR_SCAN_X86_64)
+  return __builtin_cpu_supports("avx2") ? "avx2" : "sse2";
+#else
+  return "scalar";
+#endif
+}
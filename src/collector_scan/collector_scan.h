@@ -0,0 +1,40 @@
+#ifndef __COLLECTOR_SCAN_H_
+#define __COLLECTOR_SCAN_H_
+
+#include <stddef.h>
+
+/* Vector kernels need gcc or clang on x86_64, define COLLECTOR_SCAN_SCALAR
+ * to build the scalar kernel alone */
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__SSE2__) && \
+  !defined(COLLECTOR_SCAN_SCALAR)
+  #define __COLLECTOR_SCAN_X86_64
+#endif
+
+/**
+ * @brief Finds the next word of a block that falls within `[low, high]`.
+ *          Words are range checked 8 at a time with AVX2 when the
+ *          processor has it, 4 at a time with SSE2 or scalar code
+ *          otherwise, so only the candidates reach the heap lookups
+ *
+ * @param words -> The block, it does not need to be aligned
+ * @param from -> The index of the first word to check
+ * @param number_of_words -> The length of the block in words
+ * @param low -> The lowest address accepted
+ * @param high -> The highest address accepted, below `low` for none
+ * @return The index of the word or `number_of_words` when none is left
+ **/
+size_t collector_scan_next(
+  void *const *words,
+  size_t from,
+  size_t number_of_words,
+  size_t low,
+  size_t high
+);
+
+/**
+ * @brief The kernel `collector_scan_next` runs on this processor
+ * @return "avx2", "sse2" or "scalar"
+ **/
+const char *collector_scan_kernel(void);
+
+#endif
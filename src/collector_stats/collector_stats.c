@@ -0,0 +1,183 @@
+#if defined(__unix__) || defined(__APPLE__)
+  #define _DEFAULT_SOURCE
+#endif
+
+#include "collector_stats.h"
+
+#include <time.h>
+
+static void collector_cycle_clear(struct EmeraldsCollectorCycleStats *cycle) {
+  cycle->minor            = false;
+  cycle->heap_before      = 0;
+  cycle->heap_after       = 0;
+  cycle->bytes_freed      = 0;
+  cycle->objects_freed    = 0;
+  cycle->mark_ns          = 0;
+  cycle->sweep_ns         = 0;
+  cycle->pause_ns         = 0;
+  cycle->max_pause_ns     = 0;
+  cycle->number_of_pauses = 0;
+}
+
+void collector_recorder_new(struct EmeraldsCollectorRecorder *recorder) {
+  struct EmeraldsCollectorStats *stats = &recorder->stats;
+  size_t i;
+
+  stats->collections             = 0;
+  stats->minor_collections       = 0;
+  stats->compactions             = 0;
+  stats->rehashes                = 0;
+  stats->bytes_allocated         = 0;
+  stats->bytes_freed             = 0;
+  stats->objects_freed           = 0;
+  stats->mark_ns                 = 0;
+  stats->sweep_ns                = 0;
+  stats->pause_ns                = 0;
+  stats->max_pause_ns            = 0;
+  stats->number_of_pauses        = 0;
+  stats->heap_bytes              = 0;
+  stats->collection_trigger      = 0;
+  stats->number_of_garbage       = 0;
+  stats->gc_size                 = 0;
+  stats->load_factor             = 0;
+  stats->number_of_large_objects = 0;
+  for(i = 0; i < COLLECTOR_STATS_PAUSE_BUCKETS; i++) {
+    stats->pauses[i] = 0;
+  }
+  collector_cycle_clear(&stats->last_cycle);
+  collector_cycle_clear(&recorder->cycle);
+  recorder->cycling         = false;
+  recorder->ended_in_pause  = false;
+  recorder->pause_depth     = 0;
+  recorder->pause_start     = 0;
+  recorder->bytes_allocated = 0;
+  recorder->on_start        = NULL;
+  recorder->on_end          = NULL;
+  recorder->data            = NULL;
+}
+
+void collector_recorder_cycle_begin(
+  struct EmeraldsCollectorRecorder *recorder, bool minor, size_t heap_bytes
+) {
+  collector_cycle_clear(&recorder->cycle);
+  recorder->cycle.minor       = minor;
+  recorder->cycle.heap_before = heap_bytes;
+  recorder->cycling           = true;
+  recorder->stats.collections++;
+  if(minor) {
+    recorder->stats.minor_collections++;
+  }
+}
+
+bool collector_recorder_cycle_end(
+  struct EmeraldsCollectorRecorder *recorder, size_t heap_bytes
+) {
+  if(!recorder->cycling) {
+    return false;
+  }
+  recorder->cycle.heap_after = heap_bytes;
+  recorder->stats.last_cycle = recorder->cycle;
+  recorder->cycling          = false;
+  recorder->ended_in_pause   = recorder->pause_depth > 0;
+  return true;
+}
+
+void collector_recorder_pause_begin(
+  struct EmeraldsCollectorRecorder *recorder
+) {
+  if(recorder->pause_depth++ == 0) {
+    recorder->ended_in_pause = false;
+    recorder->pause_start    = collector_stats_now();
+  }
+}
+
+void collector_recorder_pause_end(struct EmeraldsCollectorRecorder *recorder) {
+  struct EmeraldsCollectorStats *stats = &recorder->stats;
+  struct EmeraldsCollectorCycleStats *cycle;
+  double ns;
+
+  if(--recorder->pause_depth > 0) {
+    return;
+  }
+  ns = collector_stats_now() - recorder->pause_start;
+  stats->pauses[collector_stats_pause_bucket(ns)]++;
+  stats->number_of_pauses++;
+  stats->pause_ns += ns;
+  if(ns > stats->max_pause_ns) {
+    stats->max_pause_ns = ns;
+  }
+
+  /* A cycle completed within the pause gets it after its end callback */
+  if(recorder->cycling) {
+    cycle = &recorder->cycle;
+  } else if(recorder->ended_in_pause) {
+    cycle = &stats->last_cycle;
+  } else {
+    return;
+  }
+  cycle->number_of_pauses++;
+  cycle->pause_ns += ns;
+  if(ns > cycle->max_pause_ns) {
+    cycle->max_pause_ns = ns;
+  }
+}
+
+void collector_recorder_mark(
+  struct EmeraldsCollectorRecorder *recorder, double ns
+) {
+  recorder->stats.mark_ns += ns;
+  recorder->cycle.mark_ns += ns;
+}
+
+void collector_recorder_sweep(
+  struct EmeraldsCollectorRecorder *recorder,
+  double ns,
+  size_t bytes,
+  size_t objects
+) {
+  recorder->stats.sweep_ns += ns;
+  recorder->stats.bytes_freed += bytes;
+  recorder->stats.objects_freed += objects;
+  recorder->cycle.sweep_ns += ns;
+  recorder->cycle.bytes_freed += bytes;
+  recorder->cycle.objects_freed += objects;
+}
+
+double collector_stats_now(void) {
+#if defined(CLOCK_MONOTONIC)
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+#else
+  return (double)clock() * 1e9 / CLOCKS_PER_SEC;
+#endif
+}
+
+size_t collector_stats_pause_bucket(double ns) {
+  double limit  = 1000;
+  size_t bucket = 0;
+
+  while(bucket < COLLECTOR_STATS_PAUSE_BUCKETS - 1 && ns >= limit) {
+    limit *= 2;
+    bucket++;
+  }
+  return bucket;
+}
+
+double collector_stats_pause_percentile(
+  const struct EmeraldsCollectorStats *stats, double percent
+) {
+  size_t wanted = (size_t)((double)stats->number_of_pauses * percent / 100);
+  size_t seen   = 0;
+  double limit  = 1000;
+  size_t bucket;
+
+  for(bucket = 0; bucket < COLLECTOR_STATS_PAUSE_BUCKETS; bucket++) {
+    seen += stats->pauses[bucket];
+    if(seen > wanted) {
+      return limit < stats->max_pause_ns ? limit : stats->max_pause_ns;
+    }
+    limit *= 2;
+  }
+  return stats->max_pause_ns;
+}
@@ -0,0 +1,222 @@
+#ifndef __COLLECTOR_STATS_H_
+#define __COLLECTOR_STATS_H_
+
+#include "../../libs/EmeraldsBool/export/EmeraldsBool.h"
+
+#include <stddef.h>
+
+/** Pauses are counted in power of two buckets of microseconds, the first
+ * one holds pauses below 1us and the last one every pause of 2^30us and up **/
+#define COLLECTOR_STATS_PAUSE_BUCKETS (32)
+
+/**
+ * @brief What a single collection cycle did, from the start of its mark
+ *          phase until its sweep completed. Times are wall clock
+ *          nanoseconds
+ *
+ * @param minor -> Set when only the young generation was traced
+ * @param heap_before -> The heap bytes when marking started
+ * @param heap_after -> The heap bytes when the sweep completed
+ * @param bytes_freed -> The bytes the sweep reclaimed
+ * @param objects_freed -> The objects the sweep reclaimed
+ * @param mark_ns -> The time spent marking, its slices summed up
+ * @param sweep_ns -> The time spent sweeping, its slices summed up
+ * @param pause_ns -> The time mutators waited on the cycle
+ * @param max_pause_ns -> The longest of those waits
+ * @param number_of_pauses -> The number of those waits
+ **/
+struct EmeraldsCollectorCycleStats {
+  bool minor;
+  size_t heap_before;
+  size_t heap_after;
+  size_t bytes_freed;
+  size_t objects_freed;
+  double mark_ns;
+  double sweep_ns;
+  double pause_ns;
+  double max_pause_ns;
+  size_t number_of_pauses;
+};
+
+/**
+ * @brief Counters of everything the collector did since it was created,
+ *          followed by its current state and the last completed cycle.
+ *          A pause is a span a mutator waited on collection work: an
+ *          explicit collection or compaction, the start of a cycle, an
+ *          allocation helping to mark and every stop of the world.
+ *          Lazy sweep slices are too short to be counted as pauses
+ *
+ * @param collections -> The cycles started, minor ones included
+ * @param minor_collections -> The cycles that only traced the young
+ * @param compactions -> The calls to `collector_compact`
+ * @param rehashes -> The times the table of saved elements was resized
+ * @param bytes_allocated -> The bytes handed out by allocations
+ * @param bytes_freed -> The bytes reclaimed by sweeps
+ * @param objects_freed -> The objects reclaimed by sweeps
+ * @param mark_ns -> The wall clock nanoseconds spent marking
+ * @param sweep_ns -> The wall clock nanoseconds spent sweeping
+ * @param pause_ns -> The nanoseconds of every pause summed up
+ * @param max_pause_ns -> The longest pause
+ * @param number_of_pauses -> The number of pauses
+ * @param pauses -> The number of pauses in every bucket
+ * @param heap_bytes -> The bytes of every live or unswept object
+ * @param collection_trigger -> The heap bytes that start the next
+ *                              full collection
+ * @param number_of_garbage -> The elements saved in the table
+ * @param gc_size -> The slots of the table
+ * @param load_factor -> `number_of_garbage` over `gc_size`
+ * @param number_of_large_objects -> The individually mapped objects
+ * @param last_cycle -> The last cycle whose sweep completed
+ **/
+struct EmeraldsCollectorStats {
+  size_t collections;
+  size_t minor_collections;
+  size_t compactions;
+  size_t rehashes;
+  size_t bytes_allocated;
+  size_t bytes_freed;
+  size_t objects_freed;
+  double mark_ns;
+  double sweep_ns;
+  double pause_ns;
+  double max_pause_ns;
+  size_t number_of_pauses;
+  size_t pauses[COLLECTOR_STATS_PAUSE_BUCKETS];
+  size_t heap_bytes;
+  size_t collection_trigger;
+  size_t number_of_garbage;
+  size_t gc_size;
+  double load_factor;
+  size_t number_of_large_objects;
+  struct EmeraldsCollectorCycleStats last_cycle;
+};
+
+/**
+ * @brief Called at the start or at the end of a collection cycle, on the
+ *          thread running it and with the collector locked. It must not
+ *          call into the collector. When a cycle completes during a pause,
+ *          like an explicit collection, that pause is added to
+ *          `last_cycle` after the end callback returned
+ *
+ * @param stats -> The counters, with `last_cycle` set at the end
+ * @param data -> The pointer given with the callback
+ **/
+typedef void (*EmeraldsCollectorStatsCallback)(
+  const struct EmeraldsCollectorStats *stats, void *data
+);
+
+/**
+ * @brief Keeps the counters up to date as a collector works
+ * @param stats -> The counters handed out
+ * @param cycle -> The cycle in progress
+ * @param cycling -> Set from the start of a cycle until its sweep completed
+ * @param ended_in_pause -> Set when the last cycle completed during the
+ *                          pause in progress
+ * @param pause_depth -> The number of nested pauses in progress
+ * @param pause_start -> The time the outermost pause in progress started
+ * @param bytes_allocated -> The allocated bytes already accounted for
+ * @param on_start -> Called once a cycle started, or NULL
+ * @param on_end -> Called once a cycle ended, or NULL
+ * @param data -> Passed to both callbacks
+ **/
+struct EmeraldsCollectorRecorder {
+  struct EmeraldsCollectorStats stats;
+  struct EmeraldsCollectorCycleStats cycle;
+  bool cycling;
+  bool ended_in_pause;
+  size_t pause_depth;
+  double pause_start;
+  size_t bytes_allocated;
+  EmeraldsCollectorStatsCallback on_start;
+  EmeraldsCollectorStatsCallback on_end;
+  void *data;
+};
+
+/**
+ * @brief Initializes a recorder with every counter at 0 and no callbacks
+ * @param recorder -> The recorder to initialize
+ **/
+void collector_recorder_new(struct EmeraldsCollectorRecorder *recorder);
+
+/**
+ * @brief Starts counting a cycle
+ * @param recorder -> The recorder to use
+ * @param minor -> true if the cycle only traces the young generation
+ * @param heap_bytes -> The heap bytes when marking starts
+ **/
+void collector_recorder_cycle_begin(
+  struct EmeraldsCollectorRecorder *recorder, bool minor, size_t heap_bytes
+);
+
+/**
+ * @brief Completes the cycle in progress and keeps it as the last one
+ * @param recorder -> The recorder to use
+ * @param heap_bytes -> The heap bytes once the sweep completed
+ * @return false if no cycle was in progress
+ **/
+bool collector_recorder_cycle_end(
+  struct EmeraldsCollectorRecorder *recorder, size_t heap_bytes
+);
+
+/**
+ * @brief Starts a pause, nested pauses count as part of the outermost one
+ * @param recorder -> The recorder to use
+ **/
+void collector_recorder_pause_begin(struct EmeraldsCollectorRecorder *recorder);
+
+/**
+ * @brief Ends a pause and counts it once the outermost one ended
+ * @param recorder -> The recorder to use
+ **/
+void collector_recorder_pause_end(struct EmeraldsCollectorRecorder *recorder);
+
+/**
+ * @brief Adds time spent marking
+ * @param recorder -> The recorder to use
+ * @param ns -> The nanoseconds spent
+ **/
+void collector_recorder_mark(
+  struct EmeraldsCollectorRecorder *recorder, double ns
+);
+
+/**
+ * @brief Adds time spent sweeping and what it reclaimed
+ * @param recorder -> The recorder to use
+ * @param ns -> The nanoseconds spent
+ * @param bytes -> The bytes reclaimed
+ * @param objects -> The objects reclaimed
+ **/
+void collector_recorder_sweep(
+  struct EmeraldsCollectorRecorder *recorder,
+  double ns,
+  size_t bytes,
+  size_t objects
+);
+
+/**
+ * @brief The time used for statistics, a monotonic clock where there is
+ *          one and process time otherwise
+ *
+ * @return The current time in nanoseconds
+ **/
+double collector_stats_now(void);
+
+/**
+ * @brief Finds the histogram bucket of a pause
+ * @param ns -> The length of the pause in nanoseconds
+ * @return The index into `pauses`
+ **/
+size_t collector_stats_pause_bucket(double ns);
+
+/**
+ * @brief Estimates a percentile of the pauses from their histogram
+ * @param stats -> The counters to read
+ * @param percent -> The percentile, like 99
+ * @return The upper bound of the bucket holding the percentile, at most
+ *          the longest pause, 0 without pauses
+ **/
+double collector_stats_pause_percentile(
+  const struct EmeraldsCollectorStats *stats, double percent
+);
+
+#endif
@@ -0,0 +1,217 @@
+#if defined(__unix__) || defined(__APPLE__)
+  #define _DEFAULT_SOURCE
+#endif
+
+#include "collector_threads.h"
+
+#include <stdlib.h>
+
+#if defined(__COLLECTOR_THREADS)
+  #include <errno.h>
+  #include <sched.h>
+  #include <setjmp.h>
+  #include <signal.h>
+
+/* Signal handlers are process wide, so only one world is stopped at a time */
+static pthread_mutex_t collector_threads_world_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t collector_threads_handlers    = PTHREAD_ONCE_INIT;
+static struct EmeraldsCollectorThreads *collector_threads_world;
+
+static void collector_threads_suspend_handler(int signal) {
+  struct EmeraldsCollectorThreads *threads =
+    __atomic_load_n(&collector_threads_world, __ATOMIC_ACQUIRE);
+  struct EmeraldsCollectorThread *thread;
+  int saved_errno = errno;
+  sigset_t mask;
+  jmp_buf regs;
+  size_t i;
+
+  (void)signal;
+  if(threads == NULL) {
+    return;
+  }
+  thread = collector_threads_current(threads);
+  if(thread == NULL) {
+    return;
+  }
+
+  /* The collector scans this frame once `suspended` is published, so every
+      write to it comes before */
+  sigfillset(&mask);
+  sigdelset(&mask, COLLECTOR_THREADS_RESUME_SIGNAL);
+
+  /* Callee saved registers land in this frame, the rest in the signal frame.
+      `setjmp` leaves the saved signal mask unwritten, stale words would
+      keep dead objects alive */
+  for(i = 0; i < sizeof(regs); i++) {
+    ((volatile char *)&regs)[i] = 0;
+  }
+  setjmp(regs);
+  __atomic_store_n(&thread->top_of_stack, (void *)&regs, __ATOMIC_RELAXED);
+  __atomic_store_n(&thread->suspended, true, __ATOMIC_RELEASE);
+
+  do {
+    sigsuspend(&mask);
+  } while(__atomic_load_n(&threads->stopped, __ATOMIC_ACQUIRE));
+
+  __atomic_store_n(&thread->suspended, false, __ATOMIC_RELEASE);
+  errno = saved_errno;
+}
+
+static void collector_threads_resume_handler(int signal) { (void)signal; }
+
+static void collector_threads_install_handlers(void) {
+  struct sigaction action;
+
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaddset(&action.sa_mask, COLLECTOR_THREADS_RESUME_SIGNAL);
+  action.sa_handler = collector_threads_suspend_handler;
+  sigaction(COLLECTOR_THREADS_SUSPEND_SIGNAL, &action, NULL);
+
+  sigemptyset(&action.sa_mask);
+  action.sa_handler = collector_threads_resume_handler;
+  sigaction(COLLECTOR_THREADS_RESUME_SIGNAL, &action, NULL);
+}
+#endif
+
+void collector_threads_new(struct EmeraldsCollectorThreads *threads) {
+  threads->threads           = NULL;
+  threads->number_of_threads = 0;
+  threads->stopped           = false;
+#if defined(__COLLECTOR_THREADS)
+  pthread_mutex_init(&threads->lock, NULL);
+  pthread_key_create(&threads->self, NULL);
+  pthread_once(&collector_threads_handlers, collector_threads_install_handlers);
+#endif
+}
+
+void collector_threads_terminate(struct EmeraldsCollectorThreads *threads) {
+  while(threads->threads != NULL) {
+    struct EmeraldsCollectorThread *next = threads->threads->next;
+    free(threads->threads);
+    threads->threads = next;
+  }
+  threads->number_of_threads = 0;
+#if defined(__COLLECTOR_THREADS)
+  pthread_key_delete(threads->self);
+  pthread_mutex_destroy(&threads->lock);
+#endif
+}
+
+bool collector_threads_register(
+  struct EmeraldsCollectorThreads *threads, void *stack_base
+) {
+  struct EmeraldsCollectorThread *thread = collector_threads_current(threads);
+
+  if(thread != NULL) {
+    thread->bottom_of_stack = stack_base;
+    return true;
+  }
+  thread = malloc(sizeof(struct EmeraldsCollectorThread));
+  if(thread == NULL) {
+    return false;
+  }
+#if defined(__COLLECTOR_THREADS)
+  if(pthread_setspecific(threads->self, thread) != 0) {
+    free(thread);
+    return false;
+  }
+  thread->thread = pthread_self();
+#endif
+  thread->bottom_of_stack = stack_base;
+  thread->top_of_stack    = NULL;
+  thread->suspended       = false;
+  thread->buffer          = NULL;
+  thread->next            = threads->threads;
+  threads->threads        = thread;
+  threads->number_of_threads++;
+  return true;
+}
+
+void collector_threads_unregister(struct EmeraldsCollectorThreads *threads) {
+  struct EmeraldsCollectorThread *thread = collector_threads_current(threads);
+  struct EmeraldsCollectorThread **link;
+
+  if(thread == NULL) {
+    return;
+  }
+  for(link = &threads->threads; *link != thread; link = &(*link)->next) {
+  }
+  *link = thread->next;
+#if defined(__COLLECTOR_THREADS)
+  pthread_setspecific(threads->self, NULL);
+#endif
+  free(thread);
+  threads->number_of_threads--;
+}
+
+struct EmeraldsCollectorThread *
+collector_threads_current(struct EmeraldsCollectorThreads *threads) {
+#if defined(__COLLECTOR_THREADS)
+  return pthread_getspecific(threads->self);
+#else
+  /* Without threads the only record belongs to the caller */
+  return threads->threads;
+#endif
+}
+
+void collector_threads_stop_world(struct EmeraldsCollectorThreads *threads) {
+#if defined(__COLLECTOR_THREADS)
+  struct EmeraldsCollectorThread *thread;
+  pthread_t self = pthread_self();
+
+  /* An unregistered caller, like a background marker, stops every thread */
+  if(threads->number_of_threads == 0 ||
+     (threads->number_of_threads == 1 &&
+      collector_threads_current(threads) != NULL)) {
+    return;
+  }
+  pthread_mutex_lock(&collector_threads_world_lock);
+  __atomic_store_n(&threads->stopped, true, __ATOMIC_RELAXED);
+  __atomic_store_n(&collector_threads_world, threads, __ATOMIC_RELEASE);
+
+  for(thread = threads->threads; thread != NULL; thread = thread->next) {
+    __atomic_store_n(&thread->top_of_stack, NULL, __ATOMIC_RELAXED);
+    if(pthread_equal(thread->thread, self)) {
+      continue;
+    }
+    /* Threads that exited without unregistering have no stack to scan */
+    if(pthread_kill(thread->thread, COLLECTOR_THREADS_SUSPEND_SIGNAL) != 0) {
+      continue;
+    }
+    while(!__atomic_load_n(&thread->suspended, __ATOMIC_ACQUIRE)) {
+      sched_yield();
+    }
+  }
+#else
+  (void)threads;
+#endif
+}
+
+void collector_threads_start_world(struct EmeraldsCollectorThreads *threads) {
+#if defined(__COLLECTOR_THREADS)
+  struct EmeraldsCollectorThread *thread;
+
+  if(!threads->stopped) {
+    return;
+  }
+  __atomic_store_n(&threads->stopped, false, __ATOMIC_RELEASE);
+  for(thread = threads->threads; thread != NULL; thread = thread->next) {
+    if(thread->top_of_stack == NULL) {
+      continue;
+    }
+    pthread_kill(thread->thread, COLLECTOR_THREADS_RESUME_SIGNAL);
+
+    /* A thread still parked would answer the next stop with a stale stack */
+    while(__atomic_load_n(&thread->suspended, __ATOMIC_ACQUIRE)) {
+      sched_yield();
+    }
+    thread->top_of_stack = NULL;
+  }
+  __atomic_store_n(&collector_threads_world, NULL, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&collector_threads_world_lock);
+#else
+  (void)threads;
+#endif
+}
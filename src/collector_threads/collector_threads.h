@@ -0,0 +1,130 @@
+#ifndef __COLLECTOR_THREADS_H_
+#define __COLLECTOR_THREADS_H_
+
+#include "../../libs/EmeraldsBool/export/EmeraldsBool.h"
+
+#include <stddef.h>
+
+/* Stopping other threads needs posix signals and the gcc atomic builtins */
+#if(defined(__unix__) || defined(__APPLE__)) && defined(__GNUC__)
+  #define __COLLECTOR_THREADS
+  #include <pthread.h>
+#endif
+
+/** Sent to a registered thread to park it while the collector marks **/
+#ifndef COLLECTOR_THREADS_SUSPEND_SIGNAL
+  #define COLLECTOR_THREADS_SUSPEND_SIGNAL SIGUSR1
+#endif
+
+/** Sent to a parked thread once the collector is done marking **/
+#ifndef COLLECTOR_THREADS_RESUME_SIGNAL
+  #define COLLECTOR_THREADS_RESUME_SIGNAL SIGUSR2
+#endif
+
+/**
+ * @brief A mutator thread whose stack holds roots of the collector
+ * @param next -> The next registered thread
+ * @param thread -> The posix handle of the thread
+ * @param bottom_of_stack -> The oldest stack address the thread owns
+ * @param top_of_stack -> The stack pointer of the thread while it is parked,
+ *                        its registers are spilled above it
+ * @param suspended -> Set by the thread itself while it is parked
+ * @param buffer -> The slots the thread allocates from without locking,
+ *                  owned by the collector
+ **/
+struct EmeraldsCollectorThread {
+  struct EmeraldsCollectorThread *next;
+#if defined(__COLLECTOR_THREADS)
+  pthread_t thread;
+#endif
+  void *bottom_of_stack;
+  void *top_of_stack;
+  bool suspended;
+  struct EmeraldsCollectorAllocationBuffer *buffer;
+};
+
+/**
+ * @brief Every thread allowed to use a collector, and the lock that
+ *          serializes them on it
+ *
+ * @param threads -> The registered threads
+ * @param number_of_threads -> The number of registered threads
+ * @param lock -> Held by any thread inside of the collector
+ * @param self -> Maps every registered thread to its own record
+ * @param stopped -> Set from the moment the world is stopped until it resumes
+ **/
+struct EmeraldsCollectorThreads {
+  struct EmeraldsCollectorThread *threads;
+  size_t number_of_threads;
+#if defined(__COLLECTOR_THREADS)
+  pthread_mutex_t lock;
+  pthread_key_t self;
+#endif
+  bool stopped;
+};
+
+#if defined(__COLLECTOR_THREADS)
+  #define collector_threads_lock(threads) pthread_mutex_lock(&(threads)->lock)
+  #define collector_threads_unlock(threads) \
+    pthread_mutex_unlock(&(threads)->lock)
+#else
+  #define collector_threads_lock(threads)   ((void)(threads))
+  #define collector_threads_unlock(threads) ((void)(threads))
+#endif
+
+/**
+ * @brief Initializes an empty registry and installs the signal handlers
+ * @param threads -> The registry to initialize
+ **/
+void collector_threads_new(struct EmeraldsCollectorThreads *threads);
+
+/**
+ * @brief Forgets every registered thread and destroys the lock
+ * @param threads -> The registry to destroy
+ **/
+void collector_threads_terminate(struct EmeraldsCollectorThreads *threads);
+
+/**
+ * @brief Adds the calling thread to the registry, the lock has to be held
+ * @param threads -> The registry to add to
+ * @param stack_base -> The address of a variable in the outermost frame
+ *                      of the thread that still uses the collector
+ * @return false if the thread could not be recorded
+ **/
+bool collector_threads_register(
+  struct EmeraldsCollectorThreads *threads, void *stack_base
+);
+
+/**
+ * @brief Removes the calling thread from the registry, the lock has to
+ *          be held. Its stack stops keeping objects alive
+ *
+ * @param threads -> The registry to remove from
+ **/
+void collector_threads_unregister(struct EmeraldsCollectorThreads *threads);
+
+/**
+ * @brief Finds the record of the calling thread, without locking
+ * @param threads -> The registry to search
+ * @return The record or NULL if the calling thread is not registered
+ **/
+struct EmeraldsCollectorThread *
+collector_threads_current(struct EmeraldsCollectorThreads *threads);
+
+/**
+ * @brief Parks every other registered thread inside of a signal handler
+ *          and waits until all of them published their stack pointers.
+ *          The lock has to be held, no other thread is inside of the
+ *          collector then
+ *
+ * @param threads -> The registry of the threads to stop
+ **/
+void collector_threads_stop_world(struct EmeraldsCollectorThreads *threads);
+
+/**
+ * @brief Lets the threads parked by `collector_threads_stop_world` go
+ * @param threads -> The registry of the stopped threads
+ **/
+void collector_threads_start_world(struct EmeraldsCollectorThreads *threads);
+
+#endif
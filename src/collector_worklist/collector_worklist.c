@@ -0,0 +1,118 @@
+#if defined(__unix__) || defined(__APPLE__)
+  #define _DEFAULT_SOURCE
+  #define _DARWIN_C_SOURCE
+  #define __COLLECTOR_WORKLIST_MMAP
+#endif
+
+#include "collector_worklist.h"
+
+#include <stdlib.h>
+
+#if defined(__COLLECTOR_WORKLIST_MMAP)
+  #include <sys/mman.h>
+  #if !defined(MAP_ANONYMOUS)
+    #define MAP_ANONYMOUS MAP_ANON
+  #endif
+#endif
+
+/* Worklists grow while the world is stopped, a parked thread may hold the
+    lock of the malloc arena that realloc would need */
+static struct EmeraldsCollectorWorkItem *
+collector_worklist_map(size_t capacity) {
+#if defined(__COLLECTOR_WORKLIST_MMAP)
+  void *items = mmap(
+    NULL,
+    capacity * sizeof(struct EmeraldsCollectorWorkItem),
+    PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS,
+    -1,
+    0
+  );
+  return items == MAP_FAILED ? NULL : items;
+#else
+  return malloc(capacity * sizeof(struct EmeraldsCollectorWorkItem));
+#endif
+}
+
+static void collector_worklist_unmap(
+  struct EmeraldsCollectorWorkItem *items, size_t capacity
+) {
+#if defined(__COLLECTOR_WORKLIST_MMAP)
+  if(items != NULL) {
+    munmap(items, capacity * sizeof(struct EmeraldsCollectorWorkItem));
+  }
+#else
+  (void)capacity;
+  free(items);
+#endif
+}
+
+static bool
+collector_worklist_grow(struct EmeraldsCollectorWorklist *worklist) {
+  struct EmeraldsCollectorWorkItem *items;
+  size_t new_capacity = worklist->capacity == 0
+                          ? COLLECTOR_WORKLIST_INITIAL_CAPACITY
+                          : worklist->capacity * 2;
+  size_t i;
+
+  if(new_capacity > worklist->max_capacity) {
+    new_capacity = worklist->max_capacity;
+  }
+  if(new_capacity <= worklist->capacity) {
+    return false;
+  }
+
+  items = collector_worklist_map(new_capacity);
+  if(items == NULL) {
+    return false;
+  }
+  for(i = 0; i < worklist->number_of_items; i++) {
+    items[i] = worklist->items[i];
+  }
+  collector_worklist_unmap(worklist->items, worklist->capacity);
+  worklist->items    = items;
+  worklist->capacity = new_capacity;
+  return true;
+}
+
+void collector_worklist_new(struct EmeraldsCollectorWorklist *worklist) {
+  worklist->items           = NULL;
+  worklist->number_of_items = 0;
+  worklist->capacity        = 0;
+  worklist->max_capacity    = COLLECTOR_WORKLIST_MAX_CAPACITY;
+  worklist->overflowed      = false;
+}
+
+void collector_worklist_terminate(struct EmeraldsCollectorWorklist *worklist) {
+  collector_worklist_unmap(worklist->items, worklist->capacity);
+  collector_worklist_new(worklist);
+}
+
+void collector_worklist_push(
+  struct EmeraldsCollectorWorklist *worklist,
+  void *ptr,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+) {
+  if(worklist->number_of_items == worklist->capacity &&
+     !collector_worklist_grow(worklist)) {
+    /* The object stays marked, a rescan will pick its body up again */
+    worklist->overflowed = true;
+    return;
+  }
+  worklist->items[worklist->number_of_items].ptr    = ptr;
+  worklist->items[worklist->number_of_items].size   = size;
+  worklist->items[worklist->number_of_items].layout = layout;
+  worklist->number_of_items++;
+}
+
+bool collector_worklist_pop(
+  struct EmeraldsCollectorWorklist *worklist,
+  struct EmeraldsCollectorWorkItem *item
+) {
+  if(worklist->number_of_items == 0) {
+    return false;
+  }
+  *item = worklist->items[--worklist->number_of_items];
+  return true;
+}
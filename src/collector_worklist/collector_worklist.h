@@ -0,0 +1,89 @@
+#ifndef __COLLECTOR_WORKLIST_H_
+#define __COLLECTOR_WORKLIST_H_
+
+#include "../../libs/EmeraldsBool/export/EmeraldsBool.h"
+#include "../collector_layout/collector_layout.h"
+
+#include <stddef.h>
+
+/** The number of entries the worklist starts with **/
+#define COLLECTOR_WORKLIST_INITIAL_CAPACITY ((size_t)4096)
+
+/** The worklist never grows past this many entries (16 MiB on 64 bits) **/
+#ifndef COLLECTOR_WORKLIST_MAX_CAPACITY
+  #define COLLECTOR_WORKLIST_MAX_CAPACITY ((size_t)1 << 20)
+#endif
+
+/**
+ * @brief A marked object whose body still has to be scanned
+ * @param ptr -> The start of the object
+ * @param size -> The size of the object in bytes
+ * @param layout -> The pointer words of the object, NULL to scan them all
+ **/
+struct EmeraldsCollectorWorkItem {
+  void *ptr;
+  size_t size;
+  const struct EmeraldsCollectorLayout *layout;
+};
+
+/**
+ * @brief A bounded stack of marked but unscanned objects, replacing
+ *          recursion so that mark depth is independent of graph shape
+ *
+ * @param items -> The stack of pending objects, mapped so that it grows
+ *                 without malloc while the world is stopped
+ * @param number_of_items -> The number of pending objects
+ * @param capacity -> The allocated length of `items`
+ * @param max_capacity -> The length `items` is never grown past
+ * @param overflowed -> Set when an object could not be pushed, meaning
+ *                      that marked objects have to be rescanned
+ **/
+struct EmeraldsCollectorWorklist {
+  struct EmeraldsCollectorWorkItem *items;
+  size_t number_of_items;
+  size_t capacity;
+  size_t max_capacity;
+  bool overflowed;
+};
+
+/**
+ * @brief Initializes an empty worklist, memory is allocated on first push
+ * @param worklist -> The worklist to initialize
+ **/
+void collector_worklist_new(struct EmeraldsCollectorWorklist *worklist);
+
+/**
+ * @brief Frees the memory of the worklist
+ * @param worklist -> The worklist to destroy
+ **/
+void collector_worklist_terminate(struct EmeraldsCollectorWorklist *worklist);
+
+/**
+ * @brief Pushes an object, growing the stack up to its maximum capacity.
+ *          When the stack is full the object is dropped and the
+ *          worklist is flagged as overflowed instead
+ *
+ * @param worklist -> The worklist to push to
+ * @param ptr -> The start of the object
+ * @param size -> The size of the object in bytes
+ * @param layout -> The pointer words of the object, NULL to scan them all
+ **/
+void collector_worklist_push(
+  struct EmeraldsCollectorWorklist *worklist,
+  void *ptr,
+  size_t size,
+  const struct EmeraldsCollectorLayout *layout
+);
+
+/**
+ * @brief Pops the most recently pushed object
+ * @param worklist -> The worklist to pop from
+ * @param item -> Receives the popped object
+ * @return false when the worklist is empty
+ **/
+bool collector_worklist_pop(
+  struct EmeraldsCollectorWorklist *worklist,
+  struct EmeraldsCollectorWorkItem *item
+);
+
+#endif